@@ -7,7 +7,15 @@
 #include <stdio.h>
 
 #include "MyTypes.h"
+#include "MySleep.h"
+#ifdef _WIN32
 #include <sys\timeb.h>
+#include <process.h>
+#else
+#include <sys/time.h>
+#include <limits.h>
+#include <pthread.h>
+#endif
 
 
 int os_io_fopen(char *fileName, char *arg, FILE **fp)
@@ -24,15 +32,45 @@ int os_io_fopen(char *fileName, char *arg, FILE **fp)
 
 int os_c_get(OS_STR_TIME_POSIX *sys_posix_time)
 {
+#ifdef _WIN32
     struct timeb tm;
     ftime(&tm);
 
 	sys_posix_time->sec = tm.time;
 	sys_posix_time->nanosec = tm.millitm * 1000000UL;
+#else
+	struct timeval tv;
+	gettimeofday(&tv, NULL);
+
+	sys_posix_time->sec = tv.tv_sec;
+	sys_posix_time->nanosec = tv.tv_usec * 1000UL;
+#endif
 
 	return OK;
 }
 
+/* Microseconds from startTime to endTime, both from os_c_get() */
+uint32_t ElapsedUsecs(const OS_STR_TIME_POSIX *startTime, const OS_STR_TIME_POSIX *endTime)
+{
+	uint32_t elapsedUs = 0;
+
+	elapsedUs = (endTime->sec - startTime->sec) * 1000000UL;
+	elapsedUs += (endTime->nanosec / 1000);
+	elapsedUs -= (startTime->nanosec / 1000);
+
+	return elapsedUs;
+}
+
+/* os_c_get() in milliseconds, wraps; only differences are meaningful */
+uint32_t NowMsecs(void)
+{
+	OS_STR_TIME_POSIX now;
+
+	os_c_get(&now);
+
+	return (now.sec * 1000) + (now.nanosec / 1000000);
+}
+
 int MDComAPI_putMsgQ( uint32_t comId, 			/* ComId */
 					  const char *RTDMStream_ptr, 	/* Data buffer */
 					  uint32_t actual_buffer_size,	/* Number of data to be send */
@@ -44,3 +82,66 @@ int MDComAPI_putMsgQ( uint32_t comId, 			/* ComId */
 {
 	return IPT_OK;
 }
+
+#ifdef _WIN32
+/* Thread entry adapter, _beginthread wants a function with an argument */
+static void TaskEntry(void *entry)
+{
+	((void (*)(void)) entry)();
+}
+#else
+/* Thread entry adapter, pthread_create wants a function with an argument */
+static void *TaskEntry(void *entry)
+{
+	((void (*)(void)) entry)();
+
+	return NULL;
+}
+#endif
+
+/* The PC build has no task names or priorities, taskName and priority are ignored */
+int os_t_spawn(char *taskName, int priority, uint32_t stackSize, void (*entry)(void))
+{
+#ifdef _WIN32
+	(void) taskName;
+	(void) priority;
+
+	/* windows.h clashes with MyTypes.h (BOOL), so use the C runtime thread call */
+	if (_beginthread(TaskEntry, stackSize, (void *) entry) == (uintptr_t) -1L)
+	{
+		return ERROR;
+	}
+#else
+	pthread_t thread;
+	pthread_attr_t attr;
+	int result = 0;
+
+	(void) taskName;
+	(void) priority;
+
+	/* POSIX refuses a stack below PTHREAD_STACK_MIN */
+	if (stackSize < PTHREAD_STACK_MIN)
+	{
+		stackSize = PTHREAD_STACK_MIN;
+	}
+
+	pthread_attr_init(&attr);
+	pthread_attr_setstacksize(&attr, stackSize);
+	result = pthread_create(&thread, &attr, TaskEntry, (void *) entry);
+	pthread_attr_destroy(&attr);
+
+	if (result != 0)
+	{
+		return ERROR;
+	}
+
+	pthread_detach(thread);
+#endif
+
+	return OK;
+}
+
+void os_t_delay(uint32_t msecs)
+{
+	MySleep(msecs);
+}
@@ -12,6 +12,12 @@ struct OS_STR_TIME_POSIX;
 
 int os_io_fopen(char *fileName, char *arg, FILE **fp);
 int os_c_get(OS_STR_TIME_POSIX *sys_posix_time);
+uint32_t ElapsedUsecs(const OS_STR_TIME_POSIX *startTime, const OS_STR_TIME_POSIX *endTime);
+uint32_t NowMsecs(void);
+int os_t_spawn(char *taskName, int priority, uint32_t stackSize, void (*entry)(void));
+void os_t_delay(uint32_t msecs);
+int MDComAPI_putMsgQ(uint32_t comId, const char *RTDMStream_ptr, uint32_t actual_buffer_size,
+		uint32_t a, uint32_t b, uint32_t c, const char* destUri, uint32_t d);
 
 
 #endif /* MYFUNCS_H_ */
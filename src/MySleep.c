@@ -5,9 +5,17 @@
  *      Author: Dave
  */
 
+#ifdef _WIN32
 #include <windows.h>
+#else
+#include <unistd.h>
+#endif
 
 void MySleep (int time)
 {
+#ifdef _WIN32
     Sleep(time);
+#else
+    usleep(time * 1000);
+#endif
 }
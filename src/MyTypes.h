@@ -8,13 +8,8 @@
 #ifndef MYTYPES_H_
 #define MYTYPES_H_
 
-/* Data Types */
-typedef unsigned short	uint16_t;
-typedef unsigned long		uint32_t;
-typedef unsigned char		uint8_t;
-typedef signed short		int16_t;
-typedef signed long		int32_t;
-typedef signed char		int8_t;
+/* Data Types - fixed width from the compiler so 64 bit Linux hosts get 32 bit UINT32 */
+#include <stdint.h>
 
 typedef uint16_t			UINT16;
 typedef uint32_t			UINT32;
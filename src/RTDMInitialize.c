@@ -22,6 +22,7 @@
 #include "RtdmStream.h"
 #include "RtdmXml.h"
 #include "RtdmDataLog.h"
+#include "RtdmScrubber.h"
 
 void RTDMInitialize(TYPE_RTDM_STREAM_IF *interface, RtdmXmlStr *rtdmXmlData)
 {
@@ -33,5 +34,7 @@ void RTDMInitialize(TYPE_RTDM_STREAM_IF *interface, RtdmXmlStr *rtdmXmlData)
 
 	InitializeDataLog(interface, rtdmXmlData);
 
+	InitializeScrubber(interface);
+
 }
 
@@ -13,6 +13,8 @@
 /* If Main Header is changed these #defines will need adjusted */
 /* Main Header Size - 071-ICD-0004_rev3_TCMS Common ECN Interface.pdf Section 3.2.3.1.2 */
 #define STREAM_HEADER_SIZE			85
+/* Header extension following the main header from Header Version 3 on, see STRM_Header_Ext_Struct */
+#define STREAM_HEADER_EXT_SIZE		7
 /* The header size needs reduced by this size for the checksum */
 /* Stream Header Checksum does not include the first 11 bytes, starts at Version */
 #define STREAM_HEADER_CHECKSUM_ADJUST		11
@@ -20,6 +22,30 @@
 /* RTDM Header Checksum does not include the first 11 bytes, starts at Version */
 #define RTDM_HEADER_CHECKSUM_ADJUST			11
 
+/* Data Log segment (N.dan) Header Checksum does not include the first 11 bytes, starts at Version */
+#define DAN_HEADER_CHECKSUM_ADJUST			11
+
+/* Data Log block Checksum does not include the first 10 bytes, starts at Sequence */
+#define DAN_BLOCK_CHECKSUM_ADJUST			10
+
+/* Data Log segment index Checksum does not include the first 11 bytes, starts at Version, covers the entries */
+#define DAN_INDEX_CHECKSUM_ADJUST			11
+
+/* Data Log catalog Checksum does not include the first 11 bytes, starts at Version, covers the entries */
+#define DAN_CATALOG_CHECKSUM_ADJUST			11
+
+/* Zone map file (N.zon) Header Checksum does not include the first 11 bytes, starts at Version */
+#define DAN_ZONE_CHECKSUM_ADJUST			11
+
+/* Zone map record Checksum does not include the first 4 bytes, starts at Sequence */
+#define DAN_ZONE_RECORD_CHECKSUM_ADJUST		4
+
+/* Stream fragment Checksum does not include the first 11 bytes, starts at Version, covers the payload */
+#define FRAG_HEADER_CHECKSUM_ADJUST			11
+
+/* Event message Checksum does not include the first 11 bytes, starts at Version, covers the events */
+#define EVNT_HEADER_CHECKSUM_ADJUST			11
+
 /* Add sample_size, samples checksum, and number of samples to size */
 #define SAMPLE_SIZE_ADJUSTMENT				8
 
@@ -31,8 +57,52 @@
 /* RTDM Header Version */
 #define RTDM_HEADER_VERSION			2
 
-/* Stream Header Verion */
-#define STREAM_HEADER_VERSION		2	
+/* Data Log segment (N.dan) Header Version */
+#define DAN_HEADER_VERSION			2
+
+/* Number of samples framed into each fixed size data log block (1 second at 50 msec) */
+#define DAN_BLOCK_SAMPLES			20
+
+/* Data Log segment index Version */
+#define DAN_INDEX_VERSION			1
+
+/* Blocks from one segment index entry to the next (10 seconds at 50 msec) */
+#define DAN_INDEX_INTERVAL_BLOCKS	10
+
+/* Data Log catalog (DanCatalog.bin) Version */
+#define DAN_CATALOG_VERSION			1
+
+/* Catalog entries, one per data log ring segment (1.dan ... 25.dan) */
+#define DAN_CATALOG_ENTRIES			25
+
+/* State of a segment in the catalog */
+#define DAN_SEGMENT_EMPTY			0
+#define DAN_SEGMENT_CLOSED			1
+#define DAN_SEGMENT_OPEN			2
+
+/* Zone map file (N.zon) Version */
+#define DAN_ZONE_VERSION			1
+
+/* Signals with a zone map, Value_0 ... Value_23 of SignalStr */
+#define DAN_ZONE_SIGNALS			24
+
+/* How the samples of a segment are stored */
+#define DAN_CODEC_BLOCKS			0 /* DAN_Block_Struct, uncompressed */
+
+/* Stream fragment Header Version */
+#define FRAG_HEADER_VERSION			1
+
+/* Event message Header Version */
+#define EVNT_HEADER_VERSION			1
+
+/* Stream Header Verion - 3 adds the header extension, Header_Size is then 85 + STREAM_HEADER_EXT_SIZE */
+#define STREAM_HEADER_VERSION		3
+
+/* Stream Header extension Version */
+#define STREAM_HEADER_EXT_VERSION	1
+
+/* Stream_Sequence of a message replayed from the data log, live messages never use it */
+#define STREAM_SEQUENCE_REPLAY		0
 
 #define BIG_ENDIAN					0
 
@@ -67,6 +137,8 @@
 #define BAD_TIME					11
 #define NO_COMID					12
 #define NO_BUFFERSIZE				13
+#define DAN_CRC_FAIL				14
+#define NO_STREAM_BUFFER			15
 
 /* Error Codes for RTDM Data Recorder */
 UINT8 error_code_dan;
@@ -167,6 +239,16 @@ typedef struct
     uint16_t Num_Samples __attribute__ ((packed));
 } STRM_Header_Struct;
 
+/* Follows STRM_Header_Struct when Header_Version >= 3. The Header_Checksum covers it as well. A newer
+ * extension only appends fields, so a receiver reads the fields it knows and skips Ext_Size. */
+typedef struct
+{
+    uint8_t Ext_Version;
+    uint16_t Ext_Size __attribute__ ((packed)); /* size of the extension including this field */
+    uint32_t Stream_Sequence __attribute__ ((packed)); /* +1 per stream message, kept across restarts,
+                                                           STREAM_SEQUENCE_REPLAY if replayed */
+} STRM_Header_Ext_Struct;
+
 /* Structure to contain variables in the RTDM header of the message */
 typedef struct
 {
@@ -187,6 +269,184 @@ typedef struct
     uint32_t Num_Streams __attribute__ ((packed));
 } RTDM_Header_Struct;
 
+/* Structure to contain variables in the header at the start of each data log segment (N.dan) */
+typedef struct
+{
+    char Delimiter[4];
+    uint8_t Endiannes;
+    uint16_t Header_Size __attribute__ ((packed));
+    uint32_t Header_Checksum __attribute__ ((packed));
+    uint8_t Header_Version;
+    uint32_t Num_Samples __attribute__ ((packed));
+    uint32_t FirstTimeStamp_S __attribute__ ((packed));
+    uint16_t FirstTimeStamp_mS __attribute__ ((packed));
+    uint32_t LastTimeStamp_S __attribute__ ((packed));
+    uint16_t LastTimeStamp_mS __attribute__ ((packed));
+    uint16_t Block_Size __attribute__ ((packed));
+    uint32_t Num_Blocks __attribute__ ((packed));
+} DAN_Header_Struct;
+
+/* Structure to contain variables in the header of each fixed size block that follows the
+ * segment header. Sequence is the position of the block within the segment. */
+typedef struct
+{
+    char Delimiter[4];
+    uint16_t Block_Size __attribute__ ((packed));
+    uint32_t Block_Checksum __attribute__ ((packed));
+    uint32_t Sequence __attribute__ ((packed));
+    uint16_t Num_Samples __attribute__ ((packed));
+} DAN_Block_Header_Struct;
+
+/* Data log block, always written in full so every block in a segment is the same size */
+typedef struct
+{
+    DAN_Block_Header_Struct Header;
+    RTDM_Struct Sample[DAN_BLOCK_SAMPLES];
+} DAN_Block_Struct;
+
+/* Sparse time index written after the last block when a segment is closed, at
+ * Header_Size + (Num_Blocks * Block_Size) of the finalized segment header. Num_Entries
+ * DAN_Index_Entry_Struct follow, one for every Interval_Blocks blocks starting at block 0. */
+typedef struct
+{
+    char Delimiter[4]; /* "DIDX" */
+    uint8_t Endiannes;
+    uint16_t Header_Size __attribute__ ((packed));
+    uint32_t Index_Checksum __attribute__ ((packed));
+    uint8_t Header_Version;
+    uint16_t Entry_Size __attribute__ ((packed));
+    uint16_t Interval_Blocks __attribute__ ((packed));
+    uint32_t Num_Entries __attribute__ ((packed));
+} DAN_Index_Header_Struct;
+
+/* First sample of an indexed block */
+typedef struct
+{
+    uint32_t TimeStamp_S __attribute__ ((packed));
+    uint16_t TimeStamp_mS __attribute__ ((packed));
+    uint32_t Sequence __attribute__ ((packed)); /* block number */
+    uint32_t Sample_Number __attribute__ ((packed)); /* within the segment */
+    uint32_t Offset __attribute__ ((packed)); /* of the block from the start of the segment */
+} DAN_Index_Entry_Struct;
+
+/* Smallest and largest value of every signal over a set of samples, the values widened to 32
+ * bits (Value_9 is held as int32_t like every other signal) */
+typedef struct
+{
+    int32_t Min[DAN_ZONE_SIGNALS];
+    int32_t Max[DAN_ZONE_SIGNALS];
+    uint8_t Any_Set[DAN_ZONE_SIGNALS]; /* OR of the values, for the discretes Value_10 ... Value_22 */
+} DAN_Zone_Struct;
+
+/* Zone map file written next to each data log segment (1.zon for 1.dan). One record per block,
+ * at Header_Size + (Sequence * Record_Size); records are written a few blocks at a time. The
+ * header is rewritten with the zone of the whole segment when the segment is closed; records are
+ * only valid while Segment_Checksum matches the Header_Checksum of the closed segment. */
+typedef struct
+{
+    char Delimiter[4]; /* "DZON" */
+    uint8_t Endiannes;
+    uint16_t Header_Size __attribute__ ((packed));
+    uint32_t Header_Checksum __attribute__ ((packed));
+    uint8_t Header_Version;
+    uint16_t Record_Size __attribute__ ((packed));
+    uint16_t Num_Signals __attribute__ ((packed));
+    uint32_t Num_Records __attribute__ ((packed)); /* 0 while the segment is open */
+    uint32_t Segment_Checksum __attribute__ ((packed));
+    DAN_Zone_Struct Zone; /* whole segment */
+} DAN_Zone_Header_Struct;
+
+typedef struct
+{
+    uint32_t Record_Checksum __attribute__ ((packed));
+    uint32_t Sequence __attribute__ ((packed)); /* block number */
+    DAN_Zone_Struct Zone;
+} DAN_Zone_Record_Struct;
+
+/* Data log catalog (DanCatalog.bin), describes every ring segment so readers choose segments
+ * without opening them. The file holds two copies of DAN_Catalog_Struct; an update is written
+ * over the older copy, so a power cut during the write leaves the other copy intact. The copy
+ * with a good checksum and the higher Catalog_Sequence is the current one. */
+typedef struct
+{
+    char Delimiter[4]; /* "DCAT" */
+    uint8_t Endiannes;
+    uint16_t Header_Size __attribute__ ((packed));
+    uint32_t Catalog_Checksum __attribute__ ((packed));
+    uint8_t Header_Version;
+    uint32_t Catalog_Sequence __attribute__ ((packed)); /* +1 per update */
+    uint32_t Generation __attribute__ ((packed)); /* of the segment being written */
+    uint16_t Current_Index __attribute__ ((packed)); /* ring index of the segment being written */
+    uint16_t Entry_Size __attribute__ ((packed));
+    uint16_t Num_Entries __attribute__ ((packed));
+} DAN_Catalog_Header_Struct;
+
+typedef struct
+{
+    char File_Name[8];
+    uint8_t State; /* DAN_SEGMENT_EMPTY, CLOSED or OPEN */
+    uint8_t Codec;
+    uint32_t Generation __attribute__ ((packed)); /* +1 per segment opened, oldest is lowest */
+    uint32_t FirstTimeStamp_S __attribute__ ((packed));
+    uint16_t FirstTimeStamp_mS __attribute__ ((packed));
+    uint32_t LastTimeStamp_S __attribute__ ((packed));
+    uint16_t LastTimeStamp_mS __attribute__ ((packed));
+    uint32_t Num_Samples __attribute__ ((packed));
+    uint32_t Num_Blocks __attribute__ ((packed));
+    uint32_t Segment_Checksum __attribute__ ((packed)); /* Header_Checksum of the closed segment */
+} DAN_Catalog_Entry_Struct;
+
+typedef struct
+{
+    DAN_Catalog_Header_Struct Header;
+    DAN_Catalog_Entry_Struct Entry[DAN_CATALOG_ENTRIES];
+} DAN_Catalog_Struct;
+
+/* Header in front of each fragment of a stream message sent over a datagram transport */
+typedef struct
+{
+    char Delimiter[4]; /* "FRAG" */
+    uint8_t Endiannes;
+    uint16_t Header_Size __attribute__ ((packed));
+    uint32_t Frag_Checksum __attribute__ ((packed)); /* header from Version on plus payload */
+    uint8_t Header_Version;
+    uint32_t Message_Sequence __attribute__ ((packed)); /* same for every fragment of one message */
+    uint32_t Message_Size __attribute__ ((packed)); /* whole message */
+    uint16_t Fragment_Index __attribute__ ((packed)); /* 0 .. Fragment_Count - 1 */
+    uint16_t Fragment_Count __attribute__ ((packed));
+    uint32_t Fragment_Offset __attribute__ ((packed)); /* position of the payload in the message */
+    uint16_t Fragment_Size __attribute__ ((packed)); /* payload bytes following this header */
+} FRAG_Header_Struct;
+
+/* Header of an event message, followed by Num_Events EVNT_Record_Struct. The timestamp is the one
+ * of the stream sample taken in the same cycle, so a decoder can drop the copy it sees twice. */
+typedef struct
+{
+    char Delimiter[4]; /* "EVNT" */
+    uint8_t Endiannes;
+    uint16_t Header_Size __attribute__ ((packed));
+    uint32_t Event_Checksum __attribute__ ((packed)); /* header from Version on plus the events */
+    uint8_t Header_Version;
+    uint8_t Consist_ID[16];
+    uint8_t Car_ID[16];
+    uint8_t Device_ID[16];
+    uint16_t Data_Record_ID __attribute__ ((packed));
+    uint16_t Data_Record_Version __attribute__ ((packed));
+    uint32_t Event_Sequence __attribute__ ((packed)); /* counts event messages */
+    uint32_t TimeStamp_S __attribute__ ((packed));
+    uint16_t TimeStamp_mS __attribute__ ((packed));
+    uint8_t TimeStamp_accuracy;
+    uint16_t Num_Events __attribute__ ((packed));
+} EVNT_Header_Struct;
+
+/* One transition of a priority signal */
+typedef struct
+{
+    uint16_t Signal_ID __attribute__ ((packed));
+    int32_t Previous_Value __attribute__ ((packed));
+    int32_t Value __attribute__ ((packed));
+} EVNT_Record_Struct;
+
 /* Structure to contain all variables for Data Logging */
 struct DataLog_Info
 {
@@ -204,5 +464,8 @@ struct DataLog_Info DataLog_Info_str;
 
 void Write_RTDM ();
 
+/* Value of one signal by ID, widened to 32 bits (RtdmStream.c) */
+int32_t GetSignalValue (const SignalStr *signals, uint16_t signalId);
+
 #endif
 
@@ -0,0 +1,391 @@
+/****************************************************************************************************************
+ * PROJECT    : BART
+ *
+ * MODULE     : RtdmBacklog.c
+ *
+ * DESCRIPTON : 	Store-and-forward backlog for stream messages that could not be sent.
+ *
+ *	A finished stream message goes to the backlog when the network is not available
+ *	(VNC_CarData_S_WhoAmISts) or when MDComAPI_putMsgQ refused it. Messages are stored exactly as
+ *	built, header included, so the original timestamps and checksums reach the MDS unchanged.
+ *
+ *	The backlog is a FIFO in two levels:
+ *	   RAM  - BACKLOG_RAM_MESSAGES message slots allocated at start up
+ *	   disk - StreamBacklog.dat, used once the RAM slots are full, bounded by BACKLOG_DISK_MAX_BYTES
+ *	Once something has spilled to disk every newer message also goes to disk until the disk queue is
+ *	empty, so the RAM slots always hold the oldest messages and the order is kept.
+ *
+ *	The disk queue starts with a small header holding the read and write offsets, rewritten after
+ *	every change, so a backlog still pending at power down is sent after the restart. Each record is
+ *	framed with its size and a CRC of the message: a record whose message fails the CRC is skipped
+ *	and counted as a drop. A record whose frame can not be read leaves no way to find the next one,
+ *	the rest of the disk queue is then dropped, counted and logged.
+ *
+ *	When the network is back the backlog is drained at a controlled rate: at most one message every
+ *	BACKLOG_DRAIN_CYCLES cycles and only while the shaper and sender have nothing else queued, so live
+ *	data keeps priority. A drained message is copied into a free stream buffer and goes through the
+ *	shaper and sender like a live one; if that send fails it comes back to the backlog.
+ *
+ *	If the disk queue is full the new message is dropped and counted.
+ *
+ * FUNCTIONS:
+ *	void InitializeBacklog (RtdmXmlStr *rtdmXmlData)
+ *	BOOL StoreBacklogMessage (const UINT8 *message, UINT32 messageSize)
+ *	void ServiceBacklog (TYPE_RTDM_STREAM_IF *interface, BOOL networkAvailable)
+ *
+ * OUTPUTS:
+ *	RTDMBacklogRam - Messages held in RAM
+ *	RTDMBacklogDisk - Messages held in the disk queue
+ *	RTDMBacklogDropCount - Messages lost because the backlog was full
+ *
+ **********************************************************************************************************************/
+
+#ifndef TEST_ON_PC
+#include "rts_api.h"
+#else
+#include "MyTypes.h"
+#include "MyFuncs.h"
+#endif
+
+#include <string.h>
+#include <stdlib.h>
+
+#include "RTDM_Stream_ext.h"
+#include "RtdmStream.h"
+#include "RtdmBufferPool.h"
+#include "RtdmSender.h"
+#include "RtdmBacklog.h"
+#include "RtdmShaper.h"
+#include "crc32.h"
+
+/*******************************************************************
+ *
+ *     C  O  N  S  T  A  N  T  S
+ *
+ *******************************************************************/
+/* Number of messages held in RAM before spilling to disk */
+#define BACKLOG_RAM_MESSAGES        4
+
+/* Disk queue file and its size limit, about 5 minutes of 60,000 byte messages every 2 seconds */
+#define BACKLOG_FILE                "StreamBacklog.dat"
+#define BACKLOG_DISK_MAX_BYTES      (16UL * 1024UL * 1024UL)
+
+/* Drain at most one message every 4 cycles (5 messages per second) */
+#define BACKLOG_DRAIN_CYCLES        4
+
+/*******************************************************************
+ *
+ *    S  T  R  U  C  T  S
+ *
+ *******************************************************************/
+/* Start of StreamBacklog.dat, each record after it is a BacklogRecordStr and the message */
+typedef struct
+{
+    char Delimiter[4]; /* "BKLG" */
+    UINT32 ReadOffset; /* next record to send */
+    UINT32 WriteOffset; /* where the next record is appended */
+    UINT32 Count; /* records between ReadOffset and WriteOffset */
+}__attribute__ ((packed)) BacklogFileHeaderStr;
+
+/* Frame of one message in StreamBacklog.dat */
+typedef struct
+{
+    char Delimiter[4]; /* "BREC" */
+    UINT32 Size; /* bytes of the message that follows */
+    UINT32 Checksum; /* crc32_fast() of the message */
+}__attribute__ ((packed)) BacklogRecordStr;
+
+/*******************************************************************
+ *
+ *    S  T  A  T  I  C      V  A  R  I  A  B  L  E  S
+ *
+ *******************************************************************/
+/* RAM FIFO, m_RamCount entries starting at m_RamHead */
+static UINT8 *m_RamMessage[BACKLOG_RAM_MESSAGES];
+static UINT32 m_RamMessageSize[BACKLOG_RAM_MESSAGES];
+static UINT16 m_RamHead = 0;
+static UINT16 m_RamCount = 0;
+
+/* Largest message that can be stored, i.e. one full stream buffer */
+static UINT32 m_MaxMessageSize = 0;
+
+static FILE *m_DiskFilePtr = NULL;
+static BacklogFileHeaderStr m_DiskHeader;
+
+static UINT32 m_DropCount = 0;
+static UINT16 m_DrainCycle = 0;
+
+/*******************************************************************
+ *
+ *    S  T  A  T  I  C      F  U  N  C  T  I  O  N  S
+ *
+ *******************************************************************/
+static void OpenDiskQueue (void);
+static BOOL AppendDiskMessage (const UINT8 *message, UINT32 messageSize);
+static UINT32 ReadDiskMessage (UINT8 *message);
+static void WriteDiskHeader (void);
+static void DrainOneMessage (void);
+
+/*******************************************************************************************
+ *
+ *   Procedure Name : InitializeBacklog
+ *
+ *   Functional Description : Allocate the RAM slots and open the disk queue, keeping any
+ *   backlog left from before a restart
+ *
+ *   Parameters : rtdmXmlData
+ *
+ *   Returned :  None
+ *
+ ******************************************************************************************/
+void InitializeBacklog (RtdmXmlStr *rtdmXmlData)
+{
+    UINT16 i = 0;
+
+    m_MaxMessageSize = sizeof(UINT16) + STREAM_HEADER_SIZE + STREAM_HEADER_EXT_SIZE
+                    + rtdmXmlData->bufferSize;
+
+    for (i = 0; i < BACKLOG_RAM_MESSAGES; i++)
+    {
+        m_RamMessage[i] = (UINT8 *) calloc (m_MaxMessageSize, sizeof(UINT8));
+    }
+
+    m_RamHead = 0;
+    m_RamCount = 0;
+
+    OpenDiskQueue ();
+}
+
+/*******************************************************************************************
+ *
+ *   Procedure Name : StoreBacklogMessage
+ *
+ *   Functional Description : Keep a copy of a stream message until it can be sent
+ *
+ *   Parameters : message - complete stream message, messageSize - bytes to send
+ *
+ *   Returned :  TRUE if stored, FALSE if the backlog is full (message dropped)
+ *
+ ******************************************************************************************/
+BOOL StoreBacklogMessage (const UINT8 *message, UINT32 messageSize)
+{
+    UINT16 slot = 0;
+
+    if (messageSize > m_MaxMessageSize)
+    {
+        m_DropCount++;
+        return FALSE;
+    }
+
+    /* RAM only while nothing newer is waiting on disk */
+    if ((m_RamCount < BACKLOG_RAM_MESSAGES) && (m_DiskHeader.Count == 0)
+                    && (m_RamMessage[0] != NULL))
+    {
+        slot = (m_RamHead + m_RamCount) % BACKLOG_RAM_MESSAGES;
+        memcpy (m_RamMessage[slot], message, messageSize);
+        m_RamMessageSize[slot] = messageSize;
+        m_RamCount++;
+        return TRUE;
+    }
+
+    if (AppendDiskMessage (message, messageSize))
+    {
+        return TRUE;
+    }
+
+    m_DropCount++;
+
+    return FALSE;
+}
+
+/*******************************************************************************************
+ *
+ *   Procedure Name : ServiceBacklog
+ *
+ *   Functional Description : Called every cycle from RTDM_Stream(). Drain the backlog at
+ *   the controlled rate while the network is available.
+ *
+ *   Parameters : interface, networkAvailable
+ *
+ *   Returned :  None
+ *
+ ******************************************************************************************/
+void ServiceBacklog (TYPE_RTDM_STREAM_IF *interface, BOOL networkAvailable)
+{
+    m_DrainCycle++;
+
+    if (networkAvailable && (m_DrainCycle >= BACKLOG_DRAIN_CYCLES)
+                    && (interface->RTDMSendQueueDepth == 0)
+                    && (interface->RTDMShaperQueueDepth == 0))
+    {
+        m_DrainCycle = 0;
+        DrainOneMessage ();
+    }
+
+    interface->RTDMBacklogRam = m_RamCount;
+    interface->RTDMBacklogDisk = m_DiskHeader.Count;
+    interface->RTDMBacklogDropCount = m_DropCount;
+}
+
+static void DrainOneMessage (void)
+{
+    StreamBufferStr *buffer = NULL;
+    UINT32 messageSize = 0;
+
+    if ((m_RamCount == 0) && (m_DiskHeader.Count == 0))
+    {
+        return;
+    }
+
+    /* Live data keeps the buffers it needs, try again next time */
+    buffer = AcquireStreamBuffer ();
+    if (buffer == NULL)
+    {
+        return;
+    }
+
+    if (m_RamCount != 0)
+    {
+        messageSize = m_RamMessageSize[m_RamHead];
+        memcpy (buffer->Stream, m_RamMessage[m_RamHead], messageSize);
+        m_RamHead = (m_RamHead + 1) % BACKLOG_RAM_MESSAGES;
+        m_RamCount--;
+    }
+    else
+    {
+        messageSize = ReadDiskMessage ((UINT8 *) buffer->Stream);
+    }
+
+    if (messageSize == 0)
+    {
+        ReleaseStreamBuffer (buffer);
+        return;
+    }
+
+    /* Only the primary destination is owed the backlog; a failed send comes back through StoreBacklogMessage() */
+    ShapeStreamForSend (buffer, messageSize, PRIMARY_DESTINATION);
+}
+
+static void OpenDiskQueue (void)
+{
+    memset (&m_DiskHeader, 0, sizeof(m_DiskHeader));
+
+    /* Keep an existing queue if its header is sane */
+    if (os_io_fopen (BACKLOG_FILE, "rb+", &m_DiskFilePtr) != ERROR)
+    {
+        if ((fread (&m_DiskHeader, 1, sizeof(m_DiskHeader), m_DiskFilePtr)
+                        == sizeof(m_DiskHeader))
+                        && (memcmp (m_DiskHeader.Delimiter, "BKLG", 4) == 0)
+                        && (m_DiskHeader.ReadOffset <= m_DiskHeader.WriteOffset)
+                        && (m_DiskHeader.WriteOffset <= BACKLOG_DISK_MAX_BYTES))
+        {
+            printf ("Stream backlog has %lu messages\n", (unsigned long) m_DiskHeader.Count);
+            return;
+        }
+
+        os_io_fclose(m_DiskFilePtr);
+    }
+
+    if (os_io_fopen (BACKLOG_FILE, "wb+", &m_DiskFilePtr) == ERROR)
+    {
+        m_DiskFilePtr = NULL;
+        return;
+    }
+
+    memset (&m_DiskHeader, 0, sizeof(m_DiskHeader));
+    WriteDiskHeader ();
+}
+
+static BOOL AppendDiskMessage (const UINT8 *message, UINT32 messageSize)
+{
+    BacklogRecordStr record;
+
+    if (m_DiskFilePtr == NULL)
+    {
+        return FALSE;
+    }
+
+    if ((m_DiskHeader.WriteOffset + sizeof(record) + messageSize) > BACKLOG_DISK_MAX_BYTES)
+    {
+        return FALSE;
+    }
+
+    memcpy (record.Delimiter, "BREC", 4);
+    record.Size = messageSize;
+    record.Checksum = crc32_fast (0, message, (int) messageSize);
+
+    fseek (m_DiskFilePtr, m_DiskHeader.WriteOffset, SEEK_SET);
+    if ((fwrite (&record, 1, sizeof(record), m_DiskFilePtr) != sizeof(record))
+                    || (fwrite (message, 1, messageSize, m_DiskFilePtr) != messageSize))
+    {
+        return FALSE;
+    }
+
+    m_DiskHeader.WriteOffset += (sizeof(record) + messageSize);
+    m_DiskHeader.Count++;
+    WriteDiskHeader ();
+
+    return TRUE;
+}
+
+/* Oldest message on disk into message[]; returns its size, 0 if it was dropped */
+static UINT32 ReadDiskMessage (UINT8 *message)
+{
+    BacklogRecordStr record;
+    UINT32 messageSize = 0;
+
+    fseek (m_DiskFilePtr, m_DiskHeader.ReadOffset, SEEK_SET);
+    if ((fread (&record, 1, sizeof(record), m_DiskFilePtr) != sizeof(record))
+                    || (memcmp (record.Delimiter, "BREC", 4) != 0) || (record.Size > m_MaxMessageSize)
+                    || ((m_DiskHeader.ReadOffset + sizeof(record) + record.Size)
+                                    > m_DiskHeader.WriteOffset))
+    {
+        /* No frame, so no way to the next record: drop the rest rather than block the drain */
+        printf ("Stream backlog unreadable at %lu, %lu messages dropped\n",
+                        (unsigned long) m_DiskHeader.ReadOffset, (unsigned long) m_DiskHeader.Count);
+        m_DropCount += m_DiskHeader.Count;
+        m_DiskHeader.Count = 0;
+    }
+    else
+    {
+        m_DiskHeader.ReadOffset += (sizeof(record) + record.Size);
+        m_DiskHeader.Count--;
+
+        /* A damaged message is skipped, the records after it are still good */
+        if ((fread (message, 1, record.Size, m_DiskFilePtr) == record.Size)
+                        && (crc32_fast (0, message, (int) record.Size) == record.Checksum))
+        {
+            messageSize = record.Size;
+        }
+        else
+        {
+            m_DropCount++;
+        }
+    }
+
+    /* Rewind once the queue is empty so the file does not grow */
+    if (m_DiskHeader.Count == 0)
+    {
+        m_DiskHeader.ReadOffset = sizeof(m_DiskHeader);
+        m_DiskHeader.WriteOffset = sizeof(m_DiskHeader);
+    }
+
+    WriteDiskHeader ();
+
+    return messageSize;
+}
+
+static void WriteDiskHeader (void)
+{
+    memcpy (m_DiskHeader.Delimiter, "BKLG", 4);
+
+    if (m_DiskHeader.WriteOffset < sizeof(m_DiskHeader))
+    {
+        m_DiskHeader.ReadOffset = sizeof(m_DiskHeader);
+        m_DiskHeader.WriteOffset = sizeof(m_DiskHeader);
+    }
+
+    fseek (m_DiskFilePtr, 0L, SEEK_SET);
+    fwrite (&m_DiskHeader, 1, sizeof(m_DiskHeader), m_DiskFilePtr);
+    fflush (m_DiskFilePtr);
+}
@@ -0,0 +1,44 @@
+/*
+ * RtdmBacklog.h
+ *
+ *  Interface of RtdmBacklog.c: store-and-forward backlog for stream messages that could not be sent.
+ */
+
+#ifndef RTDMBACKLOG_H_
+#define RTDMBACKLOG_H_
+
+/*******************************************************************
+ *
+ *     C  O  N  S  T  A  N  T  S
+ *
+ *******************************************************************/
+
+/*******************************************************************
+ *
+ *     E  N  U  M  S
+ *
+ *******************************************************************/
+
+/*******************************************************************
+ *
+ *    S  T  R  U  C  T  S
+ *
+ *******************************************************************/
+
+/*******************************************************************
+ *
+ *    E  X  T  E  R  N      V  A  R  I  A  B  L  E  S
+ *
+ *******************************************************************/
+
+/*******************************************************************
+ *
+ *    E  X  T  E  R  N      F  U  N  C  T  I  O  N  S
+ *
+ *******************************************************************/
+
+void InitializeBacklog (RtdmXmlStr *rtdmXmlData);
+BOOL StoreBacklogMessage (const UINT8 *message, UINT32 messageSize);
+void ServiceBacklog (TYPE_RTDM_STREAM_IF *interface, BOOL networkAvailable);
+
+#endif /* RTDMBACKLOG_H_ */
@@ -0,0 +1,145 @@
+/****************************************************************************************************************
+ * PROJECT    : BART
+ *
+ * MODULE     : RtdmBufferPool.c
+ *
+ * DESCRIPTON : 	Fixed pool of stream message buffers.
+ *
+ *	All STREAM_BUFFER_COUNT buffers are allocated once at start up, each large enough for the 85 byte
+ *	STRM header plus bufferSize bytes of samples. Sampling fills one buffer; when it is time to send,
+ *	the buffer is handed to the transport and sampling continues in the next free buffer. The buffer
+ *	returns to the free list when the transport signals completion. Buffers are never freed at run time.
+ *
+ * FUNCTIONS:
+ *	UINT16 InitializeBufferPool (RtdmXmlStr *rtdmXmlData)
+ *	StreamBufferStr *AcquireStreamBuffer (void)
+ *	void ReleaseStreamBuffer (StreamBufferStr *buffer)
+ *	UINT16 GetFreeStreamBufferCount (void)
+ *
+ **********************************************************************************************************************/
+
+#ifndef TEST_ON_PC
+#include "rts_api.h"
+#else
+#include "MyTypes.h"
+#endif
+
+#include <string.h>
+#include <stdlib.h>
+
+#include "RTDM_Stream_ext.h"
+#include "RtdmStream.h"
+#include "RtdmBufferPool.h"
+
+/*******************************************************************
+ *
+ *     C  O  N  S  T  A  N  T  S
+ *
+ *******************************************************************/
+
+/*******************************************************************
+ *
+ *     E  N  U  M  S
+ *
+ *******************************************************************/
+
+/*******************************************************************
+ *
+ *    S  T  R  U  C  T  S
+ *
+ *******************************************************************/
+
+/*******************************************************************
+ *
+ *    S  T  A  T  I  C      V  A  R  I  A  B  L  E  S
+ *
+ *******************************************************************/
+static StreamBufferStr m_StreamBuffers[STREAM_BUFFER_COUNT];
+
+/* Stack of free buffer indexes, m_FreeCount entries are valid */
+static UINT16 m_FreeList[STREAM_BUFFER_COUNT];
+static UINT16 m_FreeCount = 0;
+
+/*******************************************************************
+ *
+ *    S  T  A  T  I  C      F  U  N  C  T  I  O  N  S
+ *
+ *******************************************************************/
+
+/*******************************************************************************************
+ *
+ *   Procedure Name : InitializeBufferPool
+ *
+ *   Functional Description : Allocate every stream buffer according to the buffer size
+ *   from the .xml file and put them all on the free list
+ *
+ *   Parameters : rtdmXmlData
+ *
+ *   Returned :  NO_ERROR or BAD_READ_BUFFER if memory could not be allocated
+ *
+ ******************************************************************************************/
+UINT16 InitializeBufferPool (RtdmXmlStr *rtdmXmlData)
+{
+    UINT16 i = 0;
+
+    m_FreeCount = 0;
+
+    for (i = 0; i < STREAM_BUFFER_COUNT; i++)
+    {
+        m_StreamBuffers[i].Stream = (RTDMStream_str *) calloc (
+                        sizeof(UINT16) + STREAM_HEADER_SIZE + STREAM_HEADER_EXT_SIZE
+                                        + rtdmXmlData->bufferSize,
+                        sizeof(UINT8));
+
+        if (m_StreamBuffers[i].Stream == NULL)
+        {
+            return (BAD_READ_BUFFER);
+        }
+
+        /* size of buffer read from .xml file plus the size of the variable IBufferSize */
+        m_StreamBuffers[i].Stream->IBufferSize = rtdmXmlData->bufferSize + sizeof(UINT16);
+        m_StreamBuffers[i].SampleCount = 0;
+        m_StreamBuffers[i].ByteCount = 0;
+        m_StreamBuffers[i].Index = i;
+
+        m_FreeList[m_FreeCount] = i;
+        m_FreeCount++;
+    }
+
+    return (NO_ERROR);
+}
+
+/* Take a buffer off the free list; NULL if every buffer is in use */
+StreamBufferStr *AcquireStreamBuffer (void)
+{
+    StreamBufferStr *buffer = NULL;
+
+    if (m_FreeCount == 0)
+    {
+        return NULL;
+    }
+
+    m_FreeCount--;
+    buffer = &m_StreamBuffers[m_FreeList[m_FreeCount]];
+    buffer->SampleCount = 0;
+    buffer->ByteCount = 0;
+
+    return buffer;
+}
+
+/* Return a buffer to the free list once the transport is done with it */
+void ReleaseStreamBuffer (StreamBufferStr *buffer)
+{
+    if ((buffer == NULL) || (m_FreeCount >= STREAM_BUFFER_COUNT))
+    {
+        return;
+    }
+
+    m_FreeList[m_FreeCount] = buffer->Index;
+    m_FreeCount++;
+}
+
+UINT16 GetFreeStreamBufferCount (void)
+{
+    return m_FreeCount;
+}
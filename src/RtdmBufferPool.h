@@ -0,0 +1,58 @@
+/*
+ * RtdmBufferPool.h
+ *
+ *  Interface of RtdmBufferPool.c: fixed pool of stream message buffers.
+ */
+
+#ifndef RTDMBUFFERPOOL_H_
+#define RTDMBUFFERPOOL_H_
+
+/*******************************************************************
+ *
+ *     C  O  N  S  T  A  N  T  S
+ *
+ *******************************************************************/
+/* Number of pre-allocated stream buffers; one is filled while the others are in flight to one or more destinations */
+#define STREAM_BUFFER_COUNT         6
+
+/*******************************************************************
+ *
+ *     E  N  U  M  S
+ *
+ *******************************************************************/
+
+/*******************************************************************
+ *
+ *    S  T  R  U  C  T  S
+ *
+ *******************************************************************/
+/* One stream message and the bookkeeping needed while it is filled and sent */
+typedef struct
+{
+    RTDMStream_str *Stream; /* message handed to the transport */
+    UINT16 SampleCount; /* number of samples in Stream->IBufferArray */
+    UINT32 ByteCount; /* bytes of Stream->IBufferArray used by those samples */
+    UINT16 Index; /* position in the pool */
+    UINT32 MessageSize; /* bytes handed to the transport */
+    OS_STR_TIME_POSIX QueuedTime; /* when the buffer was queued for sending */
+    UINT16 RefCount; /* destinations the buffer is queued to, released to the pool at 0 */
+} StreamBufferStr;
+
+/*******************************************************************
+ *
+ *    E  X  T  E  R  N      V  A  R  I  A  B  L  E  S
+ *
+ *******************************************************************/
+
+/*******************************************************************
+ *
+ *    E  X  T  E  R  N      F  U  N  C  T  I  O  N  S
+ *
+ *******************************************************************/
+
+UINT16 InitializeBufferPool (RtdmXmlStr *rtdmXmlData);
+StreamBufferStr *AcquireStreamBuffer (void);
+void ReleaseStreamBuffer (StreamBufferStr *buffer);
+UINT16 GetFreeStreamBufferCount (void);
+
+#endif /* RTDMBUFFERPOOL_H_ */
@@ -112,6 +112,19 @@
 #define ONE_HOUR        (10)
 #define LOG_RATE_MSECS  (50)
 
+/* Blocks in a full segment */
+#define SEGMENT_BLOCKS  (((1000 / LOG_RATE_MSECS) * ONE_HOUR) / DAN_BLOCK_SAMPLES)
+
+/* Range of a zone map value, an empty zone starts inverted */
+#define ZONE_LOWEST     (-0x7FFFFFFF - 1)
+#define ZONE_HIGHEST    (0x7FFFFFFF)
+
+/* Entries in the index of a full segment */
+#define SEGMENT_INDEX_ENTRIES   ((SEGMENT_BLOCKS + DAN_INDEX_INTERVAL_BLOCKS - 1) / DAN_INDEX_INTERVAL_BLOCKS)
+
+/* Zone records held in RAM and written to the zone map file together */
+#define ZONE_BATCH_RECORDS      DAN_INDEX_INTERVAL_BLOCKS
+
 /*******************************************************************
  *
  *     E  N  U  M  S
@@ -131,15 +144,44 @@
  *******************************************************************/
 extern STRM_Header_Struct STRM_Header;
 
-static RTDM_Struct *m_RTDMDataLogPtr;
-static UINT32 m_RTDMDataLogIndex;
+/* Block currently being filled; the only sample storage the data log needs */
+static DAN_Block_Struct *m_DanBlockPtr;
+static UINT16 m_DanBlockSampleIndex;
+static UINT32 m_DanBlockCount;
 static UINT16 m_DanFileIndex;
 
+/* Segment currently being written, stays open until all of its blocks are written */
+static FILE *m_DanSegmentFilePtr = NULL;
+
+/* Sparse time index of the open segment, the entries follow the index header in the same
+ * allocation. The index is incomplete when the segment was recovered after a power cut, the
+ * entries of the blocks written before then are not known and no index is written. */
+static DAN_Index_Header_Struct *m_DanIndexPtr;
+static DAN_Index_Entry_Struct *m_DanIndexEntryPtr;
+static BOOL m_DanIndexComplete;
+
+/* Zone map file of the open segment and the zone of the whole segment so far. The records of
+ * the latest blocks wait in m_ZoneRecord until there are ZONE_BATCH_RECORDS of them or the
+ * segment is closed; a power cut loses only those, and a reader reads their blocks instead. */
+static FILE *m_ZoneFilePtr = NULL;
+static DAN_Zone_Struct m_SegmentZone;
+static DAN_Zone_Record_Struct m_ZoneRecord[ZONE_BATCH_RECORDS];
+static UINT16 m_ZoneRecordCount;
+
+/* Timestamps of the first and last sample in the segment currently being collected */
+static RTDMTimeStr m_DanFirstTime;
+static RTDMTimeStr m_DanLastTime;
+
 /* The contents of this file is a filename. The filename indicates the last data log file
  * that was written.
  */
 static char *m_FileTracker = "DanFileTracker.txt";
 
+/* Catalog of the ring segments, DAN_Catalog_Struct twice. DanFileTracker.txt is still written
+ * for readers that do not know the catalog. */
+static char *m_CatalogFile = "DanCatalog.bin";
+static DAN_Catalog_Struct m_DanCatalog;
+
 /* Each file contains an hours worth of data */
 static char *m_DanFilePtr[] =
 {
@@ -148,6 +190,14 @@ static char *m_DanFilePtr[] =
     "16.dan", "17.dan", "18.dan", "19.dan", "20.dan", "21.dan", "22.dan",
     "23.dan", "24.dan", "25.dan"};
 
+/* Zone maps, one file per segment */
+static char *m_DanZonePtr[] =
+{
+    "1.zon", "2.zon", "3.zon", "4.zon", "5.zon", "6.zon", "7.zon", "8.zon",
+    "9.zon", "10.zon", "11.zon", "12.zon", "13.zon", "14.zon", "15.zon",
+    "16.zon", "17.zon", "18.zon", "19.zon", "20.zon", "21.zon", "22.zon",
+    "23.zon", "24.zon", "25.zon"};
+
 /*******************************************************************
  *
  *    S  T  A  T  I  C      F  U  N  C  T  I  O  N  S
@@ -155,69 +205,853 @@ static char *m_DanFilePtr[] =
  *******************************************************************/
 static void Populate_RTDM_Header (RtdmXmlStr *rtdmXmlData);
 static void OpenDanTracker (void);
+static BOOL LoadDanCatalog (void);
+static void RebuildDanCatalog (void);
+static BOOL ReadDanHeader (UINT16 danIndex, DAN_Header_Struct *danHeader);
+static void CatalogClosedSegment (UINT16 danIndex, const DAN_Header_Struct *danHeader);
+static void CatalogOpenSegment (BOOL opened);
+static void WriteDanCatalog (void);
+static void PopulateDanHeader (DAN_Header_Struct *danHeader);
+static void OpenDanSegment (void);
+static void WriteDanBlock (void);
+static void AddDanIndexEntry (void);
+static void WriteDanIndex (void);
+static void CloseDanSegment (void);
+static void RotateDanSegment (void);
+static void ResetZone (DAN_Zone_Struct *zone);
+static void WriteZoneRecord (void);
+static void FlushZoneRecords (void);
+static void WriteZoneHeader (UINT32 numRecords, UINT32 segmentChecksum);
+static BOOL RecoverDanSegment (void);
+static BOOL ReadDanBlock (FILE *p_file, UINT32 blockNumber, DAN_Block_Struct *block);
 
 
 
 void InitializeDataLog (TYPE_RTDM_STREAM_IF *interface, RtdmXmlStr *rtdmXmlData)
 {
-    UINT32 requiredMemorySize = 0;
+    DAN_Header_Struct danHeader;
 
-    /* allocate enough memory to hold 1 hours worth of data
-     * sizeof(RtdmXmlStr) * 1000 msecs / 50 msec sample rate * 60 seconds * 60 minutes */
-    requiredMemorySize =
-                    sizeof(RtdmXmlStr) * (1000 / LOG_RATE_MSECS) * ONE_HOUR;
+    /* Samples are collected one block at a time and appended to the open segment, so only
+     * one block of RAM is needed regardless of the segment length */
+    m_DanBlockPtr = (DAN_Block_Struct *) calloc (1, sizeof(DAN_Block_Struct));
 
-    m_RTDMDataLogPtr = (RTDM_Struct *) calloc (requiredMemorySize,
-                    sizeof(UINT8));
+    /* Without the block nothing can be logged or recovered; reported by Check_Fault() like a
+     * failed open, and ProcessDataLog() does nothing */
+    if (m_DanBlockPtr == NULL)
+    {
+        error_code_dan = OPEN_FAIL;
+        return;
+    }
 
-    if (m_RTDMDataLogPtr == NULL)
+    m_DanIndexPtr = (DAN_Index_Header_Struct *) calloc (1,
+                    sizeof(DAN_Index_Header_Struct)
+                                    + (SEGMENT_INDEX_ENTRIES * sizeof(DAN_Index_Entry_Struct)));
+    if (m_DanIndexPtr != NULL)
     {
-        // TODO flag error
+        m_DanIndexEntryPtr = (DAN_Index_Entry_Struct *) (m_DanIndexPtr + 1);
     }
 
-    m_RTDMDataLogIndex = 0;
+    m_DanBlockSampleIndex = 0;
+    m_DanBlockCount = 0;
+
+    /* The catalog names the segment being written. Without one (first start, or written by an
+     * older version) the file tracker is used and the catalog is built from the segment headers. */
+    if (LoadDanCatalog ())
+    {
+        m_DanFileIndex = m_DanCatalog.Header.Current_Index;
+
+        /* Power cut after the segment header was finalized but before the catalog was updated */
+        if ((m_DanCatalog.Entry[m_DanFileIndex].State == DAN_SEGMENT_OPEN)
+                        && ReadDanHeader (m_DanFileIndex, &danHeader))
+        {
+            CatalogClosedSegment (m_DanFileIndex, &danHeader);
+            m_DanFileIndex++;
+            if (m_DanFileIndex >= sizeof(m_DanFilePtr) / sizeof(char *))
+            {
+                m_DanFileIndex = 0;
+            }
+        }
+    }
+    else
+    {
+        OpenDanTracker ();
+        RebuildDanCatalog ();
+    }
 
-    OpenDanTracker ();
+    /* Continue a segment that was interrupted by a power cut, otherwise start a new one */
+    if (!RecoverDanSegment ())
+    {
+        OpenDanSegment ();
+    }
+    /* Power cut after the last block was written but before the segment was closed */
+    else if (m_DanBlockCount >= SEGMENT_BLOCKS)
+    {
+        RotateDanSegment ();
+    }
+    else if (m_DanCatalog.Entry[m_DanFileIndex].State != DAN_SEGMENT_OPEN)
+    {
+        CatalogOpenSegment (TRUE);
+    }
 
 }
 
-void ProcessDataLog (TYPE_RTDM_STREAM_IF *interface, RTDM_Struct *newSignalData,
+void ProcessDataLog (TYPE_RTDM_STREAM_IF *interface, SignalStr *newSignalData,
                 RtdmXmlStr *rtdmXmlData, RTDMTimeStr *currentTime)
 {
-    FILE *p_file = NULL;
+    const UINT32 MaxBlocks = SEGMENT_BLOCKS;
 
-    const UINT32 MaxSamples = (1000 / LOG_RATE_MSECS) * ONE_HOUR;
+    RTDM_Struct *sample = NULL;
 
-    memcpy (&m_RTDMDataLogPtr[m_RTDMDataLogIndex], newSignalData,
-                    sizeof(RTDM_Struct));
+    if ((m_DanBlockPtr == NULL) || (m_DanSegmentFilePtr == NULL))
+    {
+        return;
+    }
+
+    sample = &m_DanBlockPtr->Sample[m_DanBlockSampleIndex];
+
+    sample->TimeStamp.seconds = currentTime->seconds;
+    sample->TimeStamp.msecs = (UINT16) (currentTime->nanoseconds / 1000000);
+    sample->TimeStamp.accuracy = interface->RTCTimeAccuracy;
+    sample->Count = rtdmXmlData->signal_count;
+    memcpy (&sample->Signal, newSignalData, sizeof(SignalStr));
+
+    if ((m_DanBlockCount == 0) && (m_DanBlockSampleIndex == 0))
+    {
+        m_DanFirstTime = *currentTime;
+    }
+    m_DanLastTime = *currentTime;
 
-    m_RTDMDataLogIndex++;
+    m_DanBlockSampleIndex++;
 
-    if (m_RTDMDataLogIndex >= MaxSamples)
+    if (m_DanBlockSampleIndex >= DAN_BLOCK_SAMPLES)
     {
-        if (os_io_fopen (m_DanFilePtr[m_DanFileIndex], "wb+", &p_file) != ERROR)
+        WriteDanBlock ();
+
+        if (m_DanBlockCount >= MaxBlocks)
         {
-            fseek (p_file, 0L, SEEK_SET);
-            fwrite(m_RTDMDataLogPtr, 1, sizeof(RTDM_Struct) * MaxSamples, p_file);
-            os_io_fclose(p_file);
+            RotateDanSegment ();
+        }
+    }
+
+}
+
+/* Close the full segment and start the next one around the ring */
+static void RotateDanSegment (void)
+{
+    CloseDanSegment ();
+
+    m_DanFileIndex++;
+    if (m_DanFileIndex >= sizeof(m_DanFilePtr) / sizeof(char *))
+    {
+        m_DanFileIndex = 0;
+    }
+
+    OpenDanSegment ();
+}
+
+/* Create the segment at m_DanFileIndex with a placeholder header. The header is rewritten
+ * with the totals when the segment is closed. */
+static void OpenDanSegment (void)
+{
+    DAN_Header_Struct danHeader;
+
+    m_DanBlockSampleIndex = 0;
+    m_DanBlockCount = 0;
+
+    if (m_DanIndexPtr != NULL)
+    {
+        m_DanIndexPtr->Num_Entries = 0;
+    }
+    m_DanIndexComplete = TRUE;
+
+    if (os_io_fopen (m_DanFilePtr[m_DanFileIndex], "wb+", &m_DanSegmentFilePtr) == ERROR)
+    {
+        m_DanSegmentFilePtr = NULL;
+        error_code_dan = OPEN_FAIL;
+        CatalogOpenSegment (FALSE);
+        return;
+    }
+
+    PopulateDanHeader (&danHeader);
+
+    fseek (m_DanSegmentFilePtr, 0L, SEEK_SET);
+    fwrite (&danHeader, 1, sizeof(danHeader), m_DanSegmentFilePtr);
+    fflush (m_DanSegmentFilePtr);
+
+    /* Truncated with the segment so no record of the previous pass around the ring survives */
+    ResetZone (&m_SegmentZone);
+    m_ZoneRecordCount = 0;
+    if (os_io_fopen (m_DanZonePtr[m_DanFileIndex], "wb+", &m_ZoneFilePtr) == ERROR)
+    {
+        m_ZoneFilePtr = NULL;
+    }
+    WriteZoneHeader (0, 0);
+
+    /* One catalog update per rotation, it records the segment just closed as well */
+    CatalogOpenSegment (TRUE);
+}
+
+/* Frame the full block in RAM and append it to the open segment */
+static void WriteDanBlock (void)
+{
+    char Delimiter_array[4] =
+    { "DBLK" };
+
+    memcpy (m_DanBlockPtr->Header.Delimiter, &Delimiter_array[0],
+                    sizeof(Delimiter_array));
+    m_DanBlockPtr->Header.Block_Size = sizeof(DAN_Block_Struct);
+    m_DanBlockPtr->Header.Sequence = m_DanBlockCount;
+    m_DanBlockPtr->Header.Num_Samples = m_DanBlockSampleIndex;
+
+    /* crc = 0 is flipped in crc.c to 0xFFFFFFFF */
+    m_DanBlockPtr->Header.Block_Checksum = crc32_fast (0,
+                    ((unsigned char*) &m_DanBlockPtr->Header.Sequence),
+                    (sizeof(DAN_Block_Struct) - DAN_BLOCK_CHECKSUM_ADJUST));
+
+    fseek (m_DanSegmentFilePtr,
+                    sizeof(DAN_Header_Struct) + (m_DanBlockCount * sizeof(DAN_Block_Struct)),
+                    SEEK_SET);
+    fwrite (m_DanBlockPtr, 1, sizeof(DAN_Block_Struct), m_DanSegmentFilePtr);
+    fflush (m_DanSegmentFilePtr);
+
+    WriteZoneRecord ();
+
+    if ((m_DanBlockCount % DAN_INDEX_INTERVAL_BLOCKS) == 0)
+    {
+        AddDanIndexEntry ();
+    }
+
+    m_DanBlockCount++;
+    m_DanBlockSampleIndex = 0;
+}
+
+/* Record the first sample of the block just written in the index of the open segment */
+static void AddDanIndexEntry (void)
+{
+    DAN_Index_Entry_Struct *entry = NULL;
+
+    if ((m_DanIndexPtr == NULL) || (m_DanIndexPtr->Num_Entries >= SEGMENT_INDEX_ENTRIES))
+    {
+        m_DanIndexComplete = FALSE;
+        return;
+    }
+
+    entry = &m_DanIndexEntryPtr[m_DanIndexPtr->Num_Entries];
+    entry->TimeStamp_S = m_DanBlockPtr->Sample[0].TimeStamp.seconds;
+    entry->TimeStamp_mS = m_DanBlockPtr->Sample[0].TimeStamp.msecs;
+    entry->Sequence = m_DanBlockCount;
+    entry->Sample_Number = m_DanBlockCount * DAN_BLOCK_SAMPLES;
+    entry->Offset = sizeof(DAN_Header_Struct) + (m_DanBlockCount * sizeof(DAN_Block_Struct));
+
+    m_DanIndexPtr->Num_Entries++;
+}
+
+/* Zone holding nothing yet, every value is outside it */
+static void ResetZone (DAN_Zone_Struct *zone)
+{
+    UINT16 i = 0;
+
+    for (i = 0; i < DAN_ZONE_SIGNALS; i++)
+    {
+        zone->Min[i] = ZONE_HIGHEST;
+        zone->Max[i] = ZONE_LOWEST;
+        zone->Any_Set[i] = 0;
+    }
+}
 
-            if (os_io_fopen (m_FileTracker, "wb+", &p_file) != ERROR)
+/*******************************************************************************************
+ *
+ *   Procedure Name : WriteZoneRecord
+ *
+ *   Functional Description : Zone map of the block just framed: the smallest and largest
+ *   value of every signal, and the OR of the discretes, so a reader searching for a value can
+ *   pass over the block without reading it. Also widens the zone of the whole segment. The
+ *   record is added to the batch in RAM, written once ZONE_BATCH_RECORDS are waiting.
+ *
+ *   Parameters : None
+ *
+ *   Returned :  None
+ *
+ ******************************************************************************************/
+static void WriteZoneRecord (void)
+{
+    DAN_Zone_Record_Struct *record = &m_ZoneRecord[m_ZoneRecordCount];
+    INT32 value = 0;
+    UINT16 s = 0;
+    UINT16 i = 0;
+
+    ResetZone (&record->Zone);
+
+    for (s = 0; s < m_DanBlockPtr->Header.Num_Samples; s++)
+    {
+        for (i = 0; i < DAN_ZONE_SIGNALS; i++)
+        {
+            value = GetSignalValue (&m_DanBlockPtr->Sample[s].Signal, i);
+            if (value < record->Zone.Min[i])
             {
-                fseek (p_file, 0L, SEEK_SET);
-                fprintf(p_file, "%s", m_DanFilePtr[m_DanFileIndex]);
-                os_io_fclose(p_file);
+                record->Zone.Min[i] = value;
             }
+            if (value > record->Zone.Max[i])
+            {
+                record->Zone.Max[i] = value;
+            }
+            record->Zone.Any_Set[i] |= (UINT8) value;
+        }
+    }
 
-            m_DanFileIndex++;
-            if (m_DanFileIndex >= sizeof(m_DanFilePtr) / sizeof(char *))
+    for (i = 0; i < DAN_ZONE_SIGNALS; i++)
+    {
+        if (record->Zone.Min[i] < m_SegmentZone.Min[i])
+        {
+            m_SegmentZone.Min[i] = record->Zone.Min[i];
+        }
+        if (record->Zone.Max[i] > m_SegmentZone.Max[i])
+        {
+            m_SegmentZone.Max[i] = record->Zone.Max[i];
+        }
+        m_SegmentZone.Any_Set[i] |= record->Zone.Any_Set[i];
+    }
+
+    if (m_ZoneFilePtr == NULL)
+    {
+        return;
+    }
+
+    record->Sequence = m_DanBlockCount;
+
+    /* crc = 0 is flipped in crc.c to 0xFFFFFFFF */
+    record->Record_Checksum = crc32_fast (0, ((unsigned char*) &record->Sequence),
+                    (sizeof(DAN_Zone_Record_Struct) - DAN_ZONE_RECORD_CHECKSUM_ADJUST));
+
+    m_ZoneRecordCount++;
+    if (m_ZoneRecordCount >= ZONE_BATCH_RECORDS)
+    {
+        FlushZoneRecords ();
+    }
+}
+
+/* Write the zone records waiting in RAM; they are of consecutive blocks */
+static void FlushZoneRecords (void)
+{
+    if ((m_ZoneFilePtr == NULL) || (m_ZoneRecordCount == 0))
+    {
+        m_ZoneRecordCount = 0;
+        return;
+    }
+
+    fseek (m_ZoneFilePtr,
+                    sizeof(DAN_Zone_Header_Struct)
+                                    + (m_ZoneRecord[0].Sequence * sizeof(DAN_Zone_Record_Struct)),
+                    SEEK_SET);
+    fwrite (m_ZoneRecord, sizeof(DAN_Zone_Record_Struct), m_ZoneRecordCount, m_ZoneFilePtr);
+    fflush (m_ZoneFilePtr);
+
+    m_ZoneRecordCount = 0;
+}
+
+/* Zone map file header; numRecords 0 and no segment checksum while the segment is open */
+static void WriteZoneHeader (UINT32 numRecords, UINT32 segmentChecksum)
+{
+    char Delimiter_array[4] =
+    { "DZON" };
+    DAN_Zone_Header_Struct zoneHeader;
+
+    if (m_ZoneFilePtr == NULL)
+    {
+        return;
+    }
+
+    memset (&zoneHeader, 0, sizeof(zoneHeader));
+    memcpy (zoneHeader.Delimiter, &Delimiter_array[0], sizeof(Delimiter_array));
+    zoneHeader.Endiannes = BIG_ENDIAN;
+    zoneHeader.Header_Size = sizeof(DAN_Zone_Header_Struct);
+    zoneHeader.Header_Version = DAN_ZONE_VERSION;
+    zoneHeader.Record_Size = sizeof(DAN_Zone_Record_Struct);
+    zoneHeader.Num_Signals = DAN_ZONE_SIGNALS;
+    zoneHeader.Num_Records = numRecords;
+    zoneHeader.Segment_Checksum = segmentChecksum;
+    memcpy (&zoneHeader.Zone, &m_SegmentZone, sizeof(zoneHeader.Zone));
+
+    /* crc = 0 is flipped in crc.c to 0xFFFFFFFF */
+    zoneHeader.Header_Checksum = crc32_fast (0, ((unsigned char*) &zoneHeader.Header_Version),
+                    (sizeof(DAN_Zone_Header_Struct) - DAN_ZONE_CHECKSUM_ADJUST));
+
+    fseek (m_ZoneFilePtr, 0L, SEEK_SET);
+    fwrite (&zoneHeader, 1, sizeof(zoneHeader), m_ZoneFilePtr);
+    fflush (m_ZoneFilePtr);
+}
+
+/* Append the index after the last block of the open segment. It is written before the
+ * segment header is finalized, so a closed segment always has its index in place. */
+static void WriteDanIndex (void)
+{
+    char Delimiter_array[4] =
+    { "DIDX" };
+    UINT32 indexSize = 0;
+
+    if ((m_DanIndexPtr == NULL) || !m_DanIndexComplete || (m_DanIndexPtr->Num_Entries == 0))
+    {
+        return;
+    }
+
+    indexSize = sizeof(DAN_Index_Header_Struct)
+                    + (m_DanIndexPtr->Num_Entries * sizeof(DAN_Index_Entry_Struct));
+
+    memcpy (m_DanIndexPtr->Delimiter, &Delimiter_array[0], sizeof(Delimiter_array));
+    m_DanIndexPtr->Endiannes = BIG_ENDIAN;
+    m_DanIndexPtr->Header_Size = sizeof(DAN_Index_Header_Struct);
+    m_DanIndexPtr->Header_Version = DAN_INDEX_VERSION;
+    m_DanIndexPtr->Entry_Size = sizeof(DAN_Index_Entry_Struct);
+    m_DanIndexPtr->Interval_Blocks = DAN_INDEX_INTERVAL_BLOCKS;
+
+    /* crc = 0 is flipped in crc.c to 0xFFFFFFFF */
+    m_DanIndexPtr->Index_Checksum = crc32_fast (0,
+                    ((unsigned char*) &m_DanIndexPtr->Header_Version),
+                    (indexSize - DAN_INDEX_CHECKSUM_ADJUST));
+
+    fseek (m_DanSegmentFilePtr,
+                    sizeof(DAN_Header_Struct) + (m_DanBlockCount * sizeof(DAN_Block_Struct)),
+                    SEEK_SET);
+    fwrite (m_DanIndexPtr, 1, indexSize, m_DanSegmentFilePtr);
+    fflush (m_DanSegmentFilePtr);
+}
+
+/* Write the index, finalize the segment header and record the segment in the file tracker */
+static void CloseDanSegment (void)
+{
+    FILE *p_file = NULL;
+    DAN_Header_Struct danHeader;
+
+    WriteDanIndex ();
+
+    PopulateDanHeader (&danHeader);
+
+    fseek (m_DanSegmentFilePtr, 0L, SEEK_SET);
+    fwrite (&danHeader, 1, sizeof(danHeader), m_DanSegmentFilePtr);
+    os_io_fclose(m_DanSegmentFilePtr);
+    m_DanSegmentFilePtr = NULL;
+
+    /* Ties the zone map to this pass of the segment */
+    FlushZoneRecords ();
+    WriteZoneHeader (m_DanBlockCount, danHeader.Header_Checksum);
+    if (m_ZoneFilePtr != NULL)
+    {
+        os_io_fclose(m_ZoneFilePtr);
+        m_ZoneFilePtr = NULL;
+    }
+
+    CatalogClosedSegment (m_DanFileIndex, &danHeader);
+
+    if (os_io_fopen (m_FileTracker, "wb+", &p_file) != ERROR)
+    {
+        fseek (p_file, 0L, SEEK_SET);
+        fprintf(p_file, "%s", m_DanFilePtr[m_DanFileIndex]);
+        os_io_fclose(p_file);
+    }
+}
+
+/*******************************************************************************************
+ *
+ *   Procedure Name : RecoverDanSegment
+ *
+ *   Functional Description : The segment after the one named in the file tracker is the one
+ *   that was being written when the recorder last stopped. If its header was never
+ *   finalized, find the last valid block by stepping backwards from the end of the file one
+ *   block at a time, and continue writing after it. Only the blocks at the tail are read, so
+ *   the time taken depends on the block size and not on the segment size.
+ *
+ *   Parameters : None
+ *
+ *   Returned :  TRUE if the segment was reopened for writing
+ *
+ ******************************************************************************************/
+static BOOL RecoverDanSegment (void)
+{
+    FILE *p_file = NULL;
+    DAN_Header_Struct danHeader;
+    INT32 fileSize = 0;
+    UINT32 blockNumber = 0;
+    UINT32 headerCrc = 0;
+    BOOL blockFound = FALSE;
+    UINT16 i = 0;
+
+    if (os_io_fopen (m_DanFilePtr[m_DanFileIndex], "rb+", &p_file) == ERROR)
+    {
+        return FALSE;
+    }
+
+    if ((fread (&danHeader, 1, sizeof(danHeader), p_file) != sizeof(danHeader))
+                    || (memcmp (danHeader.Delimiter, "DSEG", sizeof(danHeader.Delimiter)) != 0)
+                    || (danHeader.Header_Version != DAN_HEADER_VERSION))
+    {
+        os_io_fclose(p_file);
+        return FALSE;
+    }
+
+    headerCrc = crc32 (0, ((unsigned char*) &danHeader.Header_Version),
+                    (sizeof(DAN_Header_Struct) - DAN_HEADER_CHECKSUM_ADJUST));
+
+    /* A finalized header means the segment was closed; it holds data from the previous
+     * pass around the ring and is simply overwritten */
+    if ((headerCrc == danHeader.Header_Checksum) && (danHeader.Num_Blocks != 0))
+    {
+        os_io_fclose(p_file);
+        return FALSE;
+    }
+
+    fseek (p_file, 0L, SEEK_END);
+    fileSize = ftell (p_file);
+
+    /* A partially written block at the end is ignored */
+    blockNumber = 0;
+    if (fileSize > (INT32) sizeof(DAN_Header_Struct))
+    {
+        blockNumber = (fileSize - sizeof(DAN_Header_Struct)) / sizeof(DAN_Block_Struct);
+    }
+
+    while (blockNumber > 0)
+    {
+        blockNumber--;
+        if (ReadDanBlock (p_file, blockNumber, m_DanBlockPtr))
+        {
+            blockFound = TRUE;
+            break;
+        }
+    }
+
+    if (!blockFound)
+    {
+        os_io_fclose(p_file);
+        return FALSE;
+    }
+
+    m_DanLastTime.seconds = m_DanBlockPtr->Sample[DAN_BLOCK_SAMPLES - 1].TimeStamp.seconds;
+    m_DanLastTime.nanoseconds =
+                    m_DanBlockPtr->Sample[DAN_BLOCK_SAMPLES - 1].TimeStamp.msecs * 1000000UL;
+
+    /* The first timestamp of the segment is in block 0 */
+    if ((blockNumber == 0) || ReadDanBlock (p_file, 0, m_DanBlockPtr))
+    {
+        m_DanFirstTime.seconds = m_DanBlockPtr->Sample[0].TimeStamp.seconds;
+        m_DanFirstTime.nanoseconds = m_DanBlockPtr->Sample[0].TimeStamp.msecs * 1000000UL;
+    }
+
+    m_DanSegmentFilePtr = p_file;
+    m_DanBlockCount = blockNumber + 1;
+    m_DanBlockSampleIndex = 0;
+
+    /* The times of the blocks before the power cut are not in RAM, the segment is closed
+     * without an index and readers search its blocks instead */
+    if (m_DanIndexPtr != NULL)
+    {
+        m_DanIndexPtr->Num_Entries = 0;
+    }
+    m_DanIndexComplete = FALSE;
+
+    /* The zone records already written are kept, those still in RAM at the power cut are
+     * missing. Their values are not in RAM, so the zone of the whole segment is left open
+     * ended and never rules the segment out. */
+    m_ZoneRecordCount = 0;
+    memset (&m_SegmentZone, 0xFF, sizeof(m_SegmentZone));
+    for (i = 0; i < DAN_ZONE_SIGNALS; i++)
+    {
+        m_SegmentZone.Min[i] = ZONE_LOWEST;
+        m_SegmentZone.Max[i] = ZONE_HIGHEST;
+    }
+    if ((os_io_fopen (m_DanZonePtr[m_DanFileIndex], "rb+", &m_ZoneFilePtr) == ERROR)
+                    && (os_io_fopen (m_DanZonePtr[m_DanFileIndex], "wb+", &m_ZoneFilePtr)
+                                    == ERROR))
+    {
+        m_ZoneFilePtr = NULL;
+    }
+
+    printf ("Data log %s recovered at block %lu\n", m_DanFilePtr[m_DanFileIndex],
+                    (unsigned long) m_DanBlockCount);
+
+    return TRUE;
+}
+
+/* Read the block at blockNumber and verify its framing and CRC */
+static BOOL ReadDanBlock (FILE *p_file, UINT32 blockNumber, DAN_Block_Struct *block)
+{
+    UINT32 blockCrc = 0;
+
+    fseek (p_file, sizeof(DAN_Header_Struct) + (blockNumber * sizeof(DAN_Block_Struct)),
+    SEEK_SET);
+
+    if (fread (block, 1, sizeof(DAN_Block_Struct), p_file) != sizeof(DAN_Block_Struct))
+    {
+        return FALSE;
+    }
+
+    if ((memcmp (block->Header.Delimiter, "DBLK", sizeof(block->Header.Delimiter)) != 0)
+                    || (block->Header.Block_Size != sizeof(DAN_Block_Struct))
+                    || (block->Header.Sequence != blockNumber))
+    {
+        return FALSE;
+    }
+
+    blockCrc = crc32_fast (0, ((unsigned char*) &block->Header.Sequence),
+                    (sizeof(DAN_Block_Struct) - DAN_BLOCK_CHECKSUM_ADJUST));
+
+    return (blockCrc == block->Header.Block_Checksum);
+}
+
+/*******************************************************************************************
+ *
+ *   Procedure Name : GetDanFileCount / GetDanFileName / GetCurrentDanFileIndex
+ *
+ *   Functional Description : Access to the data log ring for the scrubber. The segment at
+ *   GetCurrentDanFileIndex() is the one currently being written and is never a closed segment.
+ *
+ ******************************************************************************************/
+UINT16 GetDanFileCount (void)
+{
+    return (UINT16) (sizeof(m_DanFilePtr) / sizeof(char *));
+}
+
+const char *GetDanFileName (UINT16 danIndex)
+{
+    if (danIndex >= GetDanFileCount ())
+    {
+        return NULL;
+    }
+
+    return m_DanFilePtr[danIndex];
+}
+
+UINT16 GetCurrentDanFileIndex (void)
+{
+    return m_DanFileIndex;
+}
+
+/* What the catalog holds on a segment, NULL if danIndex is outside the ring */
+const DAN_Catalog_Entry_Struct *GetDanCatalogEntry (UINT16 danIndex)
+{
+    if (danIndex >= GetDanFileCount ())
+    {
+        return NULL;
+    }
+
+    return &m_DanCatalog.Entry[danIndex];
+}
+
+/* The closed segment with the lowest generation, the one being written if none is closed */
+UINT16 GetOldestDanFileIndex (void)
+{
+    UINT16 oldest = m_DanFileIndex;
+    UINT32 generation = 0;
+    UINT16 danIndex = 0;
+    BOOL found = FALSE;
+
+    for (danIndex = 0; danIndex < GetDanFileCount (); danIndex++)
+    {
+        if ((m_DanCatalog.Entry[danIndex].State == DAN_SEGMENT_CLOSED)
+                        && (!found || (m_DanCatalog.Entry[danIndex].Generation < generation)))
+        {
+            oldest = danIndex;
+            generation = m_DanCatalog.Entry[danIndex].Generation;
+            found = TRUE;
+        }
+    }
+
+    return oldest;
+}
+
+/*******************************************************************************************
+ *
+ *   Procedure Name : LoadDanCatalog
+ *
+ *   Functional Description : Read both copies of the catalog and keep the newest one that
+ *   checks out. A copy torn by a power cut fails its checksum and the other one is used.
+ *
+ *   Parameters : None
+ *
+ *   Returned :  TRUE if a good copy was found
+ *
+ ******************************************************************************************/
+static BOOL LoadDanCatalog (void)
+{
+    static DAN_Catalog_Struct copy;
+    FILE *p_file = NULL;
+    UINT32 catalogCrc = 0;
+    UINT16 copyIndex = 0;
+    BOOL found = FALSE;
+
+    if (os_io_fopen (m_CatalogFile, "rb", &p_file) == ERROR)
+    {
+        return FALSE;
+    }
+
+    for (copyIndex = 0; copyIndex < 2; copyIndex++)
+    {
+        if (fread (&copy, 1, sizeof(copy), p_file) != sizeof(copy))
+        {
+            break;
+        }
+
+        catalogCrc = crc32 (0, ((unsigned char*) &copy.Header.Header_Version),
+                        (sizeof(DAN_Catalog_Struct) - DAN_CATALOG_CHECKSUM_ADJUST));
+
+        if ((memcmp (copy.Header.Delimiter, "DCAT", sizeof(copy.Header.Delimiter)) != 0)
+                        || (copy.Header.Header_Version != DAN_CATALOG_VERSION)
+                        || (catalogCrc != copy.Header.Catalog_Checksum)
+                        || (copy.Header.Num_Entries != GetDanFileCount ())
+                        || (copy.Header.Current_Index >= GetDanFileCount ()))
+        {
+            continue;
+        }
+
+        if (!found || (copy.Header.Catalog_Sequence > m_DanCatalog.Header.Catalog_Sequence))
+        {
+            memcpy (&m_DanCatalog, &copy, sizeof(m_DanCatalog));
+            found = TRUE;
+        }
+    }
+
+    os_io_fclose(p_file);
+
+    return found;
+}
+
+/* Catalog from the segment headers; generations follow the first timestamps of the closed
+ * segments, which is only a guess when the clock was set back */
+static void RebuildDanCatalog (void)
+{
+    DAN_Header_Struct danHeader;
+    UINT16 danIndex = 0;
+    UINT16 other = 0;
+    UINT16 numClosed = 0;
+
+    memset (&m_DanCatalog, 0, sizeof(m_DanCatalog));
+
+    for (danIndex = 0; danIndex < GetDanFileCount (); danIndex++)
+    {
+        if ((danIndex != m_DanFileIndex) && ReadDanHeader (danIndex, &danHeader))
+        {
+            CatalogClosedSegment (danIndex, &danHeader);
+            numClosed++;
+        }
+    }
+
+    for (danIndex = 0; danIndex < GetDanFileCount (); danIndex++)
+    {
+        if (m_DanCatalog.Entry[danIndex].State != DAN_SEGMENT_CLOSED)
+        {
+            continue;
+        }
+
+        m_DanCatalog.Entry[danIndex].Generation = 1;
+        for (other = 0; other < GetDanFileCount (); other++)
+        {
+            if ((m_DanCatalog.Entry[other].State == DAN_SEGMENT_CLOSED)
+                            && ((m_DanCatalog.Entry[other].FirstTimeStamp_S
+                                            < m_DanCatalog.Entry[danIndex].FirstTimeStamp_S)
+                                            || ((m_DanCatalog.Entry[other].FirstTimeStamp_S
+                                                            == m_DanCatalog.Entry[danIndex].FirstTimeStamp_S)
+                                                            && (other < danIndex))))
             {
-                m_DanFileIndex = 0;
+                m_DanCatalog.Entry[danIndex].Generation++;
             }
         }
+    }
+
+    m_DanCatalog.Header.Generation = numClosed;
+    m_DanCatalog.Header.Current_Index = m_DanFileIndex;
+}
 
-        m_RTDMDataLogIndex = 0;
+/* TRUE if the segment at danIndex has a finalized header */
+static BOOL ReadDanHeader (UINT16 danIndex, DAN_Header_Struct *danHeader)
+{
+    FILE *p_file = NULL;
+    UINT32 headerCrc = 0;
+    BOOL finalized = FALSE;
+
+    if (os_io_fopen (m_DanFilePtr[danIndex], "rb", &p_file) == ERROR)
+    {
+        return FALSE;
     }
 
+    if (fread (danHeader, 1, sizeof(DAN_Header_Struct), p_file) == sizeof(DAN_Header_Struct))
+    {
+        headerCrc = crc32 (0, ((unsigned char*) &danHeader->Header_Version),
+                        (sizeof(DAN_Header_Struct) - DAN_HEADER_CHECKSUM_ADJUST));
+
+        finalized = (memcmp (danHeader->Delimiter, "DSEG", sizeof(danHeader->Delimiter)) == 0)
+                        && (danHeader->Header_Version == DAN_HEADER_VERSION)
+                        && (headerCrc == danHeader->Header_Checksum) && (danHeader->Num_Blocks != 0);
+    }
+
+    os_io_fclose(p_file);
+
+    return finalized;
+}
+
+/* Record a closed segment in the catalog in RAM, its generation is kept */
+static void CatalogClosedSegment (UINT16 danIndex, const DAN_Header_Struct *danHeader)
+{
+    DAN_Catalog_Entry_Struct *entry = &m_DanCatalog.Entry[danIndex];
+
+    strncpy (entry->File_Name, m_DanFilePtr[danIndex], sizeof(entry->File_Name));
+    entry->State = DAN_SEGMENT_CLOSED;
+    entry->Codec = DAN_CODEC_BLOCKS;
+    entry->FirstTimeStamp_S = danHeader->FirstTimeStamp_S;
+    entry->FirstTimeStamp_mS = danHeader->FirstTimeStamp_mS;
+    entry->LastTimeStamp_S = danHeader->LastTimeStamp_S;
+    entry->LastTimeStamp_mS = danHeader->LastTimeStamp_mS;
+    entry->Num_Samples = danHeader->Num_Samples;
+    entry->Num_Blocks = danHeader->Num_Blocks;
+    entry->Segment_Checksum = danHeader->Header_Checksum;
+}
+
+/* Record the segment at m_DanFileIndex as the one being written and update the catalog file */
+static void CatalogOpenSegment (BOOL opened)
+{
+    DAN_Catalog_Entry_Struct *entry = &m_DanCatalog.Entry[m_DanFileIndex];
+
+    memset (entry, 0, sizeof(DAN_Catalog_Entry_Struct));
+    strncpy (entry->File_Name, m_DanFilePtr[m_DanFileIndex], sizeof(entry->File_Name));
+    entry->State = opened ? DAN_SEGMENT_OPEN : DAN_SEGMENT_EMPTY;
+    entry->Codec = DAN_CODEC_BLOCKS;
+
+    m_DanCatalog.Header.Generation++;
+    entry->Generation = m_DanCatalog.Header.Generation;
+    m_DanCatalog.Header.Current_Index = m_DanFileIndex;
+
+    WriteDanCatalog ();
+}
+
+/* Write the catalog over the older of the two copies in the file */
+static void WriteDanCatalog (void)
+{
+    char Delimiter_array[4] =
+    { "DCAT" };
+    FILE *p_file = NULL;
+
+    memcpy (m_DanCatalog.Header.Delimiter, &Delimiter_array[0], sizeof(Delimiter_array));
+    m_DanCatalog.Header.Endiannes = BIG_ENDIAN;
+    m_DanCatalog.Header.Header_Size = sizeof(DAN_Catalog_Header_Struct);
+    m_DanCatalog.Header.Header_Version = DAN_CATALOG_VERSION;
+    m_DanCatalog.Header.Entry_Size = sizeof(DAN_Catalog_Entry_Struct);
+    m_DanCatalog.Header.Num_Entries = GetDanFileCount ();
+    m_DanCatalog.Header.Catalog_Sequence++;
+
+    /* crc = 0 is flipped in crc.c to 0xFFFFFFFF */
+    m_DanCatalog.Header.Catalog_Checksum = crc32 (0,
+                    ((unsigned char*) &m_DanCatalog.Header.Header_Version),
+                    (sizeof(DAN_Catalog_Struct) - DAN_CATALOG_CHECKSUM_ADJUST));
+
+    if ((os_io_fopen (m_CatalogFile, "rb+", &p_file) == ERROR)
+                    && (os_io_fopen (m_CatalogFile, "wb+", &p_file) == ERROR))
+    {
+        return;
+    }
+
+    fseek (p_file, (m_DanCatalog.Header.Catalog_Sequence % 2) * sizeof(DAN_Catalog_Struct),
+    SEEK_SET);
+    fwrite (&m_DanCatalog, 1, sizeof(m_DanCatalog), p_file);
+    fflush (p_file);
+    os_io_fclose(p_file);
 }
 
 static void OpenDanTracker (void)
@@ -601,6 +1435,49 @@ static void Populate_RTDM_Header (RtdmXmlStr *rtdmXmlData)
 
 } /* End Populate_RTDM_Header */
 
+/*******************************************************************************************
+ *
+ *   Procedure Name : PopulateDanHeader
+ *
+ *   Functional Description : Fill the data log segment header from the blocks written so far.
+ *   The sample data itself is protected by the CRC in each block.
+ *
+ *   Parameters : danHeader
+ *
+ *   Returned :  None
+ *
+ ******************************************************************************************/
+static void PopulateDanHeader (DAN_Header_Struct *danHeader)
+{
+    char Delimiter_array[4] =
+    { "DSEG" };
+
+    memset (danHeader, 0, sizeof(DAN_Header_Struct));
+
+    memcpy (danHeader->Delimiter, &Delimiter_array[0], sizeof(Delimiter_array));
+
+    danHeader->Endiannes = BIG_ENDIAN;
+    danHeader->Header_Size = sizeof(DAN_Header_Struct);
+    danHeader->Header_Version = DAN_HEADER_VERSION;
+    danHeader->Num_Samples = m_DanBlockCount * DAN_BLOCK_SAMPLES;
+    danHeader->Block_Size = sizeof(DAN_Block_Struct);
+    danHeader->Num_Blocks = m_DanBlockCount;
+
+    if (m_DanBlockCount != 0)
+    {
+        danHeader->FirstTimeStamp_S = m_DanFirstTime.seconds;
+        danHeader->FirstTimeStamp_mS = (UINT16) (m_DanFirstTime.nanoseconds / 1000000);
+        danHeader->LastTimeStamp_S = m_DanLastTime.seconds;
+        danHeader->LastTimeStamp_mS = (UINT16) (m_DanLastTime.nanoseconds / 1000000);
+    }
+
+    /* crc = 0 is flipped in crc.c to 0xFFFFFFFF */
+    danHeader->Header_Checksum = crc32 (0,
+                    ((unsigned char*) &danHeader->Header_Version),
+                    (sizeof(DAN_Header_Struct) - DAN_HEADER_CHECKSUM_ADJUST));
+
+} /* End PopulateDanHeader */
+
 #if DAS
 /*******************************************************************************************
  *
@@ -9,9 +9,15 @@
 #define RTDMDATALOG_H_
 
 void InitializeDataLog (TYPE_RTDM_STREAM_IF *interface, RtdmXmlStr *rtdmXmlData);
-void ProcessDataLog (TYPE_RTDM_STREAM_IF *interface, RTDM_Struct *newSignalData,
+void ProcessDataLog (TYPE_RTDM_STREAM_IF *interface, SignalStr *newSignalData,
                 RtdmXmlStr *rtdmXmlData, RTDMTimeStr *currentTime);
 
 void Write_RTDM (void);
 
+UINT16 GetDanFileCount (void);
+const char *GetDanFileName (UINT16 danIndex);
+UINT16 GetCurrentDanFileIndex (void);
+const DAN_Catalog_Entry_Struct *GetDanCatalogEntry (UINT16 danIndex);
+UINT16 GetOldestDanFileIndex (void);
+
 #endif /* RTDMDATALOG_H_ */
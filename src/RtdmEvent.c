@@ -0,0 +1,252 @@
+/****************************************************************************************************************
+ * PROJECT    : BART
+ *
+ * MODULE     : RtdmEvent.c
+ *
+ * DESCRIPTON : 	Event fast path for priority signals.
+ *
+ *	With a long maxTimeBeforeSendMs a transition of a critical discrete (PRailGapDet, IPropCutout, ...)
+ *	can sit in the stream buffer for up to a minute. Signals flagged priority="TRUE" in the .xml file
+ *	are compared every cycle, and every transition found is sent in the same 50 msec cycle in a small
+ *	event message ("EVNT" header, EVNT_Header_Struct, followed by one EVNT_Record_Struct per
+ *	transition). The bulk stream is not changed and still carries the same transitions.
+ *
+ *	The event header carries the timestamp of the stream sample taken in the same cycle, so the pair
+ *	Car_ID + timestamp + Signal_ID identifies a transition in both messages. A decoder keeps the first
+ *	copy it sees and drops the other.
+ *
+ *	Events go to the primary destination (OutputStreamCfg) on their own transport channel with
+ *	eventComId (default comId) and eventTransportAddress (default transportAddress), sent directly
+ *	from the task. A FILE sink can not be shared by two channels, so with the FILE transport events
+ *	need an eventTransportAddress no destination writes to, otherwise they are not sent. They do
+ *	not wait for a stream buffer, the shaper or the sender thread. Without the network no events
+ *	are sent; the transitions reach the MDS with the bulk stream from the backlog.
+ *
+ * FUNCTIONS:
+ *	void InitializeEvents (RtdmXmlStr *rtdmXmlData)
+ *	void ServiceEvents (TYPE_RTDM_STREAM_IF *interface, SignalStr *newSignalData,
+ *	                BOOL networkAvailable, RtdmXmlStr *rtdmXmlData, RTDMTimeStr *currentTime)
+ *
+ * OUTPUTS:
+ *	RTDMEventCount - Priority signal transitions sent as events
+ *	RTDMEventFailCount - Event messages the transport refused
+ *
+ **********************************************************************************************************************/
+
+#ifndef TEST_ON_PC
+#include "global_mwt.h"
+#include "rts_api.h"
+#else
+#include "MyTypes.h"
+#include "MyFuncs.h"
+#endif
+
+#include <string.h>
+
+#include "RTDM_Stream_ext.h"
+#include "RtdmStream.h"
+#include "RtdmTransport.h"
+#include "RtdmEvent.h"
+
+/*******************************************************************
+ *
+ *     C  O  N  S  T  A  N  T  S
+ *
+ *******************************************************************/
+/* Largest event message, every signal changing in the same cycle */
+#define EVENT_MESSAGE_SIZE          (sizeof(EVNT_Header_Struct) \
+                                        + (MAX_PCU_SIGNALS * sizeof(EVNT_Record_Struct)))
+
+/*******************************************************************
+ *
+ *    S  T  A  T  I  C      F  U  N  C  T  I  O  N  S
+ *
+ *******************************************************************/
+static UINT32 BuildEventMessage (TYPE_RTDM_STREAM_IF *interface, RtdmXmlStr *rtdmXmlData,
+                RTDMTimeStr *currentTime, UINT16 eventCount);
+
+/*******************************************************************
+ *
+ *    S  T  A  T  I  C      V  A  R  I  A  B  L  E  S
+ *
+ *******************************************************************/
+static TransportChannelStr m_EventChannel;
+
+/* FALSE when no signal is flagged, events are then skipped altogether */
+static BOOL m_EventsEnabled = FALSE;
+
+/* Values of the previous cycle, indexed like signal_id_num[]; not valid until primed */
+static INT32 m_PreviousValue[MAX_PCU_SIGNALS];
+static BOOL m_Primed = FALSE;
+
+static UINT8 m_EventMessage[EVENT_MESSAGE_SIZE];
+static UINT32 m_EventSequence = 0;
+
+static UINT32 m_EventCount = 0;
+static UINT32 m_EventFailCount = 0;
+
+/*******************************************************************************************
+ *
+ *   Procedure Name : InitializeEvents
+ *
+ *   Functional Description : Open the event channel if any signal is flagged priority
+ *
+ *   Parameters : rtdmXmlData
+ *
+ *   Returned :  None
+ *
+ ******************************************************************************************/
+void InitializeEvents (RtdmXmlStr *rtdmXmlData)
+{
+    RtdmDestinationStr *primary = &rtdmXmlData->destination[0];
+    const char *address = primary->transportAddress;
+    UINT32 comId = 0;
+    UINT16 i = 0;
+
+    m_EventsEnabled = FALSE;
+    m_Primed = FALSE;
+
+    for (i = 0; i < rtdmXmlData->signal_count; i++)
+    {
+        if (rtdmXmlData->signal_priority[i])
+        {
+            m_EventsEnabled = TRUE;
+        }
+    }
+
+    if (!m_EventsEnabled)
+    {
+        return;
+    }
+
+    comId = (rtdmXmlData->eventComId != 0) ? rtdmXmlData->eventComId : primary->comId;
+    if (rtdmXmlData->eventTransportAddress[0] != '\0')
+    {
+        address = rtdmXmlData->eventTransportAddress;
+    }
+
+    /* Opening a destination's sink file again ("wb") would truncate it and interleave the writes */
+    if (strcmp (primary->transportType, "FILE") == 0)
+    {
+        for (i = 0; i < rtdmXmlData->destination_count; i++)
+        {
+            if ((strcmp (rtdmXmlData->destination[i].transportType, "FILE") == 0)
+                            && (strcmp (rtdmXmlData->destination[i].transportAddress, address) == 0))
+            {
+                printf ("Events need their own eventTransportAddress with the FILE transport, "
+                                "events are not sent\n");
+                m_EventsEnabled = FALSE;
+                return;
+            }
+        }
+    }
+
+    if (OpenTransport (&m_EventChannel, primary->transportType, address,
+                    comId, primary->uri, primary->transportMtu) != NO_ERROR)
+    {
+        printf ("Event transport %s could not be opened\n", GetTransportName (&m_EventChannel));
+    }
+}
+
+/*******************************************************************************************
+ *
+ *   Procedure Name : ServiceEvents
+ *
+ *   Functional Description : Called every cycle from RTDM_Stream() once the new signal values
+ *   are read and before they go into the stream. Send one event message holding every
+ *   priority signal that changed since the previous cycle.
+ *
+ *   Parameters : interface, newSignalData, networkAvailable, rtdmXmlData, currentTime - the
+ *                time used for this cycle's stream sample
+ *
+ *   Returned :  None
+ *
+ ******************************************************************************************/
+void ServiceEvents (TYPE_RTDM_STREAM_IF *interface, SignalStr *newSignalData,
+                BOOL networkAvailable, RtdmXmlStr *rtdmXmlData, RTDMTimeStr *currentTime)
+{
+    EVNT_Record_Struct *record = (EVNT_Record_Struct *) &m_EventMessage[sizeof(EVNT_Header_Struct)];
+    UINT32 messageSize = 0;
+    UINT16 eventCount = 0;
+    INT32 value = 0;
+    UINT16 i = 0;
+
+    if (!m_EventsEnabled)
+    {
+        return;
+    }
+
+    for (i = 0; i < rtdmXmlData->signal_count; i++)
+    {
+        if (!rtdmXmlData->signal_priority[i])
+        {
+            continue;
+        }
+
+        value = GetSignalValue (newSignalData, rtdmXmlData->signal_id_num[i]);
+
+        /* The first cycle only records the starting values */
+        if (m_Primed && (value != m_PreviousValue[i]))
+        {
+            record[eventCount].Signal_ID = rtdmXmlData->signal_id_num[i];
+            record[eventCount].Previous_Value = m_PreviousValue[i];
+            record[eventCount].Value = value;
+            eventCount++;
+        }
+
+        m_PreviousValue[i] = value;
+    }
+    m_Primed = TRUE;
+
+    if ((eventCount != 0) && networkAvailable)
+    {
+        messageSize = BuildEventMessage (interface, rtdmXmlData, currentTime, eventCount);
+
+        if (TransportSend (&m_EventChannel, m_EventMessage, messageSize) == NO_ERROR)
+        {
+            m_EventCount += eventCount;
+        }
+        else
+        {
+            m_EventFailCount++;
+        }
+    }
+
+    interface->RTDMEventCount = m_EventCount;
+    interface->RTDMEventFailCount = m_EventFailCount;
+}
+
+/* Fill in the header in front of the records already in m_EventMessage, returns the message size */
+static UINT32 BuildEventMessage (TYPE_RTDM_STREAM_IF *interface, RtdmXmlStr *rtdmXmlData,
+                RTDMTimeStr *currentTime, UINT16 eventCount)
+{
+    EVNT_Header_Struct *header = (EVNT_Header_Struct *) m_EventMessage;
+    UINT32 messageSize = sizeof(EVNT_Header_Struct) + (eventCount * sizeof(EVNT_Record_Struct));
+
+    memcpy (header->Delimiter, "EVNT", sizeof(header->Delimiter));
+    header->Endiannes = BIG_ENDIAN;
+    header->Header_Size = sizeof(EVNT_Header_Struct);
+    header->Header_Version = EVNT_HEADER_VERSION;
+
+    memcpy (header->Consist_ID, interface->VNC_CarData_X_ConsistID, sizeof(header->Consist_ID));
+    memcpy (header->Car_ID, interface->VNC_CarData_X_CarID, sizeof(header->Car_ID));
+    memcpy (header->Device_ID, interface->VNC_CarData_X_DeviceID, sizeof(header->Device_ID));
+
+    header->Data_Record_ID = rtdmXmlData->DataRecorderCfgID;
+    header->Data_Record_Version = rtdmXmlData->DataRecorderCfgVersion;
+
+    m_EventSequence++;
+    header->Event_Sequence = m_EventSequence;
+
+    /* Same as the stream sample of this cycle */
+    header->TimeStamp_S = currentTime->seconds;
+    header->TimeStamp_mS = (UINT16) (currentTime->nanoseconds / 1000000);
+    header->TimeStamp_accuracy = interface->RTCTimeAccuracy;
+
+    header->Num_Events = eventCount;
+
+    header->Event_Checksum = crc32 (0, &m_EventMessage[EVNT_HEADER_CHECKSUM_ADJUST],
+                    messageSize - EVNT_HEADER_CHECKSUM_ADJUST);
+
+    return messageSize;
+}
@@ -0,0 +1,44 @@
+/*
+ * RtdmEvent.h
+ *
+ *  Interface of RtdmEvent.c: event fast path for priority signals.
+ */
+
+#ifndef RTDMEVENT_H_
+#define RTDMEVENT_H_
+
+/*******************************************************************
+ *
+ *     C  O  N  S  T  A  N  T  S
+ *
+ *******************************************************************/
+
+/*******************************************************************
+ *
+ *     E  N  U  M  S
+ *
+ *******************************************************************/
+
+/*******************************************************************
+ *
+ *    S  T  R  U  C  T  S
+ *
+ *******************************************************************/
+
+/*******************************************************************
+ *
+ *    E  X  T  E  R  N      V  A  R  I  A  B  L  E  S
+ *
+ *******************************************************************/
+
+/*******************************************************************
+ *
+ *    E  X  T  E  R  N      F  U  N  C  T  I  O  N  S
+ *
+ *******************************************************************/
+
+void InitializeEvents (RtdmXmlStr *rtdmXmlData);
+void ServiceEvents (TYPE_RTDM_STREAM_IF *interface, SignalStr *newSignalData,
+                BOOL networkAvailable, RtdmXmlStr *rtdmXmlData, RTDMTimeStr *currentTime);
+
+#endif /* RTDMEVENT_H_ */
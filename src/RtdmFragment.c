@@ -0,0 +1,348 @@
+/****************************************************************************************************************
+ * PROJECT    : BART
+ *
+ * MODULE     : RtdmFragment.c
+ *
+ * DESCRIPTON : 	Application level fragmentation of stream messages for datagram transports.
+ *
+ *	A stream message of up to 60,094 bytes is larger than the MTU of the train network. FragmentMessage()
+ *	splits it into fragments of at most mtu bytes, each starting with a FRAG_Header_Struct that carries
+ *	the message sequence number, the fragment index and count, the fragment offset in the message and
+ *	a CRC-32 over the header (from Header_Version on) and the payload.
+ *
+ *	The reassembler puts fragments back together on the receiving side. Fragments may arrive in any
+ *	order; each one is copied to its offset and marked in a bitmap, and the message is delivered
+ *	when every fragment is present. Up to REASSEMBLY_SLOTS messages are in progress at once; a message
+ *	still incomplete after TimeoutMs is dropped, and when all slots are busy the oldest is dropped to
+ *	make room. Fragments of a message that was already delivered are reported as duplicates. There is
+ *	no retransmission; a lost fragment loses its message.
+ *
+ *	The fragmenter is used by the sending thread only. A reassembler belongs to its caller and the
+ *	caller provides the time in msecs, so it runs unchanged in off-board tools.
+ *
+ * FUNCTIONS:
+ *	UINT16 FragmentMessage (const UINT8 *message, UINT32 messageSize, UINT32 messageSequence,
+ *	                UINT32 mtu, UINT8 *fragmentBuffer, FragmentSendFunc sendFragment, void *context)
+ *	UINT16 InitializeReassembler (ReassemblerStr *reassembler, UINT32 maxMessageSize, UINT32 timeoutMs)
+ *	UINT16 ReassembleFragment (ReassemblerStr *reassembler, const UINT8 *fragment, UINT32 fragmentSize,
+ *	                UINT32 nowMs, const UINT8 **message, UINT32 *messageSize)
+ *	void ExpireReassembly (ReassemblerStr *reassembler, UINT32 nowMs)
+ *
+ **********************************************************************************************************************/
+
+#ifndef TEST_ON_PC
+#include "rts_api.h"
+#else
+#include "MyTypes.h"
+#endif
+
+#include <string.h>
+#include <stdlib.h>
+
+#include "RTDM_Stream_ext.h"
+#include "crc32.h"
+#include "RtdmFragment.h"
+
+/*******************************************************************
+ *
+ *    S  T  A  T  I  C      V  A  R  I  A  B  L  E  S
+ *
+ *******************************************************************/
+
+/*******************************************************************
+ *
+ *    S  T  A  T  I  C      F  U  N  C  T  I  O  N  S
+ *
+ *******************************************************************/
+static BOOL CheckFragment (ReassemblerStr *reassembler, const FRAG_Header_Struct *header,
+                UINT32 fragmentSize);
+static ReassemblySlotStr *FindSlot (ReassemblerStr *reassembler, const FRAG_Header_Struct *header,
+                UINT32 nowMs);
+
+/*******************************************************************************************
+ *
+ *   Procedure Name : FragmentMessage
+ *
+ *   Functional Description : Split a stream message into fragments of at most mtu bytes and
+ *   hand each one to sendFragment
+ *
+ *   Parameters : message, messageSize, messageSequence - same for all fragments of the message,
+ *                mtu - largest fragment including its header, fragmentBuffer - FRAG_MAX_MTU
+ *                bytes owned by the caller, sendFragment, context - passed to sendFragment
+ *
+ *   Returned :  NO_ERROR, or SEND_MSG_FAILED if the message does not fit in FRAG_MAX_FRAGMENTS
+ *               or a fragment could not be sent (the remaining fragments are not sent)
+ *
+ ******************************************************************************************/
+UINT16 FragmentMessage (const UINT8 *message, UINT32 messageSize, UINT32 messageSequence,
+                UINT32 mtu, UINT8 *fragmentBuffer, FragmentSendFunc sendFragment, void *context)
+{
+    FRAG_Header_Struct *header = (FRAG_Header_Struct *) fragmentBuffer;
+    UINT32 payloadSize = 0;
+    UINT32 fragmentCount = 0;
+    UINT32 offset = 0;
+    UINT16 i = 0;
+
+    if ((mtu < FRAG_MIN_MTU) || (mtu > FRAG_MAX_MTU))
+    {
+        return SEND_MSG_FAILED;
+    }
+
+    payloadSize = mtu - sizeof(FRAG_Header_Struct);
+    fragmentCount = (messageSize + payloadSize - 1) / payloadSize;
+    if (fragmentCount == 0)
+    {
+        fragmentCount = 1;
+    }
+
+    if (fragmentCount > FRAG_MAX_FRAGMENTS)
+    {
+        return SEND_MSG_FAILED;
+    }
+
+    /* Fields that are the same for every fragment */
+    memcpy (header->Delimiter, "FRAG", sizeof(header->Delimiter));
+    header->Endiannes = BIG_ENDIAN;
+    header->Header_Size = sizeof(FRAG_Header_Struct);
+    header->Header_Version = FRAG_HEADER_VERSION;
+    header->Message_Sequence = messageSequence;
+    header->Message_Size = messageSize;
+    header->Fragment_Count = (UINT16) fragmentCount;
+
+    for (i = 0; i < fragmentCount; i++)
+    {
+        offset = i * payloadSize;
+
+        header->Fragment_Index = i;
+        header->Fragment_Offset = offset;
+        header->Fragment_Size = (UINT16) (
+                        ((messageSize - offset) < payloadSize) ? (messageSize - offset) : payloadSize);
+
+        memcpy (&fragmentBuffer[sizeof(FRAG_Header_Struct)], &message[offset],
+                        header->Fragment_Size);
+
+        header->Frag_Checksum = crc32_fast (0, &fragmentBuffer[FRAG_HEADER_CHECKSUM_ADJUST],
+                        (sizeof(FRAG_Header_Struct) - FRAG_HEADER_CHECKSUM_ADJUST)
+                                        + header->Fragment_Size);
+
+        if (sendFragment (context, fragmentBuffer,
+                        sizeof(FRAG_Header_Struct) + header->Fragment_Size) != NO_ERROR)
+        {
+            return SEND_MSG_FAILED;
+        }
+    }
+
+    return NO_ERROR;
+}
+
+/*******************************************************************************************
+ *
+ *   Procedure Name : InitializeReassembler
+ *
+ *   Functional Description : Allocate one message buffer per reassembly slot
+ *
+ *   Parameters : reassembler, maxMessageSize - largest message accepted,
+ *                timeoutMs - time allowed from the first fragment to the last
+ *
+ *   Returned :  NO_ERROR or BAD_READ_BUFFER if memory could not be allocated
+ *
+ ******************************************************************************************/
+UINT16 InitializeReassembler (ReassemblerStr *reassembler, UINT32 maxMessageSize,
+                UINT32 timeoutMs)
+{
+    UINT16 i = 0;
+
+    memset (reassembler, 0, sizeof(ReassemblerStr));
+
+    reassembler->MaxMessageSize = maxMessageSize;
+    reassembler->TimeoutMs = timeoutMs;
+
+    for (i = 0; i < REASSEMBLY_SLOTS; i++)
+    {
+        reassembler->Slot[i].Message = (UINT8 *) calloc (maxMessageSize, sizeof(UINT8));
+        if (reassembler->Slot[i].Message == NULL)
+        {
+            return BAD_READ_BUFFER;
+        }
+    }
+
+    return NO_ERROR;
+}
+
+/*******************************************************************************************
+ *
+ *   Procedure Name : ReassembleFragment
+ *
+ *   Functional Description : Add one received fragment. When it completes its message, the
+ *   message is returned; it stays valid until the next call.
+ *
+ *   Parameters : reassembler, fragment, fragmentSize - one datagram as received,
+ *                nowMs - current time, message / messageSize - set on FRAG_COMPLETE
+ *
+ *   Returned :  FRAG_PENDING, FRAG_COMPLETE, FRAG_DUPLICATE or FRAG_BAD
+ *
+ ******************************************************************************************/
+UINT16 ReassembleFragment (ReassemblerStr *reassembler, const UINT8 *fragment,
+                UINT32 fragmentSize, UINT32 nowMs, const UINT8 **message, UINT32 *messageSize)
+{
+    FRAG_Header_Struct header;
+    ReassemblySlotStr *slot = NULL;
+    UINT16 i = 0;
+
+    ExpireReassembly (reassembler, nowMs);
+
+    if (fragmentSize < sizeof(FRAG_Header_Struct))
+    {
+        reassembler->BadFragments++;
+        return FRAG_BAD;
+    }
+
+    /* Copy, the datagram may not be aligned */
+    memcpy (&header, fragment, sizeof(header));
+
+    if (!CheckFragment (reassembler, &header, fragmentSize)
+                    || (crc32_fast (0, &fragment[FRAG_HEADER_CHECKSUM_ADJUST],
+                                    fragmentSize - FRAG_HEADER_CHECKSUM_ADJUST)
+                                    != header.Frag_Checksum))
+    {
+        reassembler->BadFragments++;
+        return FRAG_BAD;
+    }
+
+    /* Late fragment of a message already delivered */
+    for (i = 0; i < REASSEMBLY_SLOTS; i++)
+    {
+        if ((reassembler->Completed > i)
+                        && (reassembler->RecentSequence[i] == header.Message_Sequence))
+        {
+            reassembler->Duplicates++;
+            return FRAG_DUPLICATE;
+        }
+    }
+
+    slot = FindSlot (reassembler, &header, nowMs);
+    if (slot == NULL)
+    {
+        reassembler->BadFragments++;
+        return FRAG_BAD;
+    }
+
+    if (slot->Received[header.Fragment_Index / 8] & (1 << (header.Fragment_Index % 8)))
+    {
+        reassembler->Duplicates++;
+        return FRAG_DUPLICATE;
+    }
+
+    memcpy (&slot->Message[header.Fragment_Offset], &fragment[sizeof(FRAG_Header_Struct)],
+                    header.Fragment_Size);
+    slot->Received[header.Fragment_Index / 8] |= (UINT8) (1 << (header.Fragment_Index % 8));
+    slot->ReceivedCount++;
+
+    if (slot->ReceivedCount < slot->FragmentCount)
+    {
+        return FRAG_PENDING;
+    }
+
+    slot->InUse = FALSE;
+
+    reassembler->RecentSequence[reassembler->RecentIndex] = slot->MessageSequence;
+    reassembler->RecentIndex = (reassembler->RecentIndex + 1) % REASSEMBLY_SLOTS;
+    reassembler->Completed++;
+
+    *message = slot->Message;
+    *messageSize = slot->MessageSize;
+
+    return FRAG_COMPLETE;
+}
+
+/* Drop every message still incomplete after the timeout */
+void ExpireReassembly (ReassemblerStr *reassembler, UINT32 nowMs)
+{
+    UINT16 i = 0;
+
+    for (i = 0; i < REASSEMBLY_SLOTS; i++)
+    {
+        if (reassembler->Slot[i].InUse
+                        && ((nowMs - reassembler->Slot[i].FirstArrivalMs) > reassembler->TimeoutMs))
+        {
+            reassembler->Slot[i].InUse = FALSE;
+            reassembler->TimedOut++;
+        }
+    }
+}
+
+/* Header sanity; the fragment must lie inside a message the reassembler can hold */
+static BOOL CheckFragment (ReassemblerStr *reassembler, const FRAG_Header_Struct *header,
+                UINT32 fragmentSize)
+{
+    if ((memcmp (header->Delimiter, "FRAG", sizeof(header->Delimiter)) != 0)
+                    || (header->Header_Version != FRAG_HEADER_VERSION)
+                    || (header->Header_Size != sizeof(FRAG_Header_Struct))
+                    || ((sizeof(FRAG_Header_Struct) + header->Fragment_Size) != fragmentSize)
+                    || (header->Message_Size > reassembler->MaxMessageSize)
+                    || (header->Fragment_Count == 0)
+                    || (header->Fragment_Count > FRAG_MAX_FRAGMENTS)
+                    || (header->Fragment_Index >= header->Fragment_Count)
+                    || ((header->Fragment_Offset + header->Fragment_Size) > header->Message_Size))
+    {
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+/* Slot of the fragment's message; starts a new message in a free slot, or in the oldest one */
+static ReassemblySlotStr *FindSlot (ReassemblerStr *reassembler, const FRAG_Header_Struct *header,
+                UINT32 nowMs)
+{
+    ReassemblySlotStr *slot = NULL;
+    ReassemblySlotStr *oldest = NULL;
+    UINT16 i = 0;
+
+    for (i = 0; i < REASSEMBLY_SLOTS; i++)
+    {
+        slot = &reassembler->Slot[i];
+
+        if (slot->InUse && (slot->MessageSequence == header->Message_Sequence))
+        {
+            /* Every fragment of a message must agree on its shape */
+            if ((slot->MessageSize != header->Message_Size)
+                            || (slot->FragmentCount != header->Fragment_Count))
+            {
+                return NULL;
+            }
+            return slot;
+        }
+    }
+
+    for (i = 0; i < REASSEMBLY_SLOTS; i++)
+    {
+        slot = &reassembler->Slot[i];
+
+        if (!slot->InUse)
+        {
+            oldest = slot;
+            break;
+        }
+
+        if ((oldest == NULL) || ((nowMs - slot->FirstArrivalMs) > (nowMs - oldest->FirstArrivalMs)))
+        {
+            oldest = slot;
+        }
+    }
+
+    if (oldest->InUse)
+    {
+        reassembler->Evicted++;
+    }
+
+    oldest->InUse = TRUE;
+    oldest->MessageSequence = header->Message_Sequence;
+    oldest->MessageSize = header->Message_Size;
+    oldest->FragmentCount = header->Fragment_Count;
+    oldest->ReceivedCount = 0;
+    oldest->FirstArrivalMs = nowMs;
+    memset (oldest->Received, 0, sizeof(oldest->Received));
+
+    return oldest;
+}
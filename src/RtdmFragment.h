@@ -0,0 +1,94 @@
+/*
+ * RtdmFragment.h
+ *
+ *  Interface of RtdmFragment.c: fragmentation of stream messages for datagram transports.
+ */
+
+#ifndef RTDMFRAGMENT_H_
+#define RTDMFRAGMENT_H_
+
+/*******************************************************************
+ *
+ *     C  O  N  S  T  A  N  T  S
+ *
+ *******************************************************************/
+/* Smallest MTU accepted, leaves room for a useful payload behind the header */
+#define FRAG_MIN_MTU                256
+
+/* Largest datagram a fragment may use */
+#define FRAG_MAX_MTU                65000
+
+/* Upper bound on fragments per message, 60,094 bytes at FRAG_MIN_MTU needs 266 */
+#define FRAG_MAX_FRAGMENTS          512
+
+/* Messages that can be reassembled at the same time */
+#define REASSEMBLY_SLOTS            4
+
+/* Results of ReassembleFragment() */
+#define FRAG_PENDING                0
+#define FRAG_COMPLETE               1
+#define FRAG_DUPLICATE              2
+#define FRAG_BAD                    3
+
+/*******************************************************************
+ *
+ *     E  N  U  M  S
+ *
+ *******************************************************************/
+
+/*******************************************************************
+ *
+ *    S  T  R  U  C  T  S
+ *
+ *******************************************************************/
+/* Called by FragmentMessage() for every fragment, returns NO_ERROR if it was sent */
+typedef UINT16 (*FragmentSendFunc) (void *context, const UINT8 *fragment, UINT32 fragmentSize);
+
+/* One message being put back together */
+typedef struct
+{
+    BOOL InUse;
+    UINT32 MessageSequence;
+    UINT32 MessageSize;
+    UINT16 FragmentCount;
+    UINT16 ReceivedCount;
+    UINT32 FirstArrivalMs; /* used for the timeout */
+    UINT8 Received[FRAG_MAX_FRAGMENTS / 8]; /* one bit per fragment */
+    UINT8 *Message;
+} ReassemblySlotStr;
+
+typedef struct
+{
+    ReassemblySlotStr Slot[REASSEMBLY_SLOTS];
+    UINT32 RecentSequence[REASSEMBLY_SLOTS]; /* last messages completed, to spot late duplicates */
+    UINT16 RecentIndex;
+    UINT32 MaxMessageSize;
+    UINT32 TimeoutMs;
+    UINT32 Completed; /* messages delivered */
+    UINT32 TimedOut; /* messages dropped because a fragment never came */
+    UINT32 Evicted; /* messages dropped to make room for a newer one */
+    UINT32 Duplicates; /* fragments received twice */
+    UINT32 BadFragments; /* fragments failing checksum or sanity checks */
+} ReassemblerStr;
+
+/*******************************************************************
+ *
+ *    E  X  T  E  R  N      V  A  R  I  A  B  L  E  S
+ *
+ *******************************************************************/
+
+/*******************************************************************
+ *
+ *    E  X  T  E  R  N      F  U  N  C  T  I  O  N  S
+ *
+ *******************************************************************/
+
+UINT16 FragmentMessage (const UINT8 *message, UINT32 messageSize, UINT32 messageSequence,
+                UINT32 mtu, UINT8 *fragmentBuffer, FragmentSendFunc sendFragment, void *context);
+UINT16 InitializeReassembler (ReassemblerStr *reassembler, UINT32 maxMessageSize,
+                UINT32 timeoutMs);
+UINT16 ReassembleFragment (ReassemblerStr *reassembler, const UINT8 *fragment,
+                UINT32 fragmentSize, UINT32 nowMs, const UINT8 **message, UINT32 *messageSize);
+void ExpireReassembly (ReassemblerStr *reassembler, UINT32 nowMs);
+
+#endif /* RTDMFRAGMENT_H_ */
@@ -0,0 +1,123 @@
+/****************************************************************************************************************
+ * PROJECT    : BART
+ *
+ * MODULE     : RtdmQueue.c
+ *
+ * DESCRIPTON : 	Wait-free single producer / single consumer queue used to pass stream buffers between
+ *	the 50 msec task and the sender thread.
+ *
+ *	Head and Tail are free running counters; the slot index is the counter masked by QUEUE_SLOTS - 1.
+ *	Only the producer writes Head and only the consumer writes Tail. The barrier between storing the
+ *	item and publishing Head (and between reading the item and releasing the slot through Tail) makes
+ *	the item visible to the other thread before the counter that announces it. Neither side ever waits.
+ *
+ * FUNCTIONS:
+ *	void QueueInitialize (QueueStr *queue)
+ *	BOOL QueuePush (QueueStr *queue, void *item)
+ *	void *QueuePop (QueueStr *queue)
+ *	void *QueuePeek (QueueStr *queue)
+ *	UINT32 QueueDepth (QueueStr *queue)
+ *
+ **********************************************************************************************************************/
+
+#ifndef TEST_ON_PC
+#include "rts_api.h"
+#else
+#include "MyTypes.h"
+#endif
+
+#include <string.h>
+
+#include "RtdmQueue.h"
+
+/*******************************************************************
+ *
+ *     C  O  N  S  T  A  N  T  S
+ *
+ *******************************************************************/
+#define QUEUE_MASK                  (QUEUE_SLOTS - 1)
+
+/* Full compiler and CPU barrier */
+#define QUEUE_MEMORY_BARRIER()      __sync_synchronize ()
+
+/*******************************************************************************************
+ *
+ *   Procedure Name : QueueInitialize
+ *
+ *   Functional Description : Empty the queue. Must be called before either thread uses it.
+ *
+ *   Parameters : queue
+ *
+ *   Returned :  None
+ *
+ ******************************************************************************************/
+void QueueInitialize (QueueStr *queue)
+{
+    memset (queue, 0, sizeof(QueueStr));
+}
+
+/* Producer side; FALSE if the queue is full */
+BOOL QueuePush (QueueStr *queue, void *item)
+{
+    UINT32 head = queue->Head;
+
+    if ((head - queue->Tail) >= QUEUE_SLOTS)
+    {
+        return FALSE;
+    }
+
+    queue->Slot[head & QUEUE_MASK] = item;
+
+    /* Item must be stored before the consumer can see the new head */
+    QUEUE_MEMORY_BARRIER();
+
+    queue->Head = head + 1;
+
+    return TRUE;
+}
+
+/* Consumer side; NULL if the queue is empty */
+void *QueuePop (QueueStr *queue)
+{
+    UINT32 tail = queue->Tail;
+    void *item = NULL;
+
+    if (tail == queue->Head)
+    {
+        return NULL;
+    }
+
+    /* Head was read before the slot it announces */
+    QUEUE_MEMORY_BARRIER();
+
+    item = queue->Slot[tail & QUEUE_MASK];
+
+    /* Slot must be read before the producer can reuse it */
+    QUEUE_MEMORY_BARRIER();
+
+    queue->Tail = tail + 1;
+
+    return item;
+}
+
+/* Consumer side; oldest item without removing it, NULL if the queue is empty */
+void *QueuePeek (QueueStr *queue)
+{
+    UINT32 tail = queue->Tail;
+
+    if (tail == queue->Head)
+    {
+        return NULL;
+    }
+
+    /* Head was read before the slot it announces */
+    QUEUE_MEMORY_BARRIER();
+
+    return queue->Slot[tail & QUEUE_MASK];
+}
+
+/* Number of items waiting, may be read from either thread */
+UINT32 QueueDepth (QueueStr *queue)
+{
+    return (queue->Head - queue->Tail);
+}
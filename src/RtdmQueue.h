@@ -0,0 +1,57 @@
+/*
+ * RtdmQueue.h
+ *
+ *  Interface of RtdmQueue.c: single producer / single consumer queue between the 50 msec task and the
+ *  sender thread.
+ */
+
+#ifndef RTDMQUEUE_H_
+#define RTDMQUEUE_H_
+
+/*******************************************************************
+ *
+ *     C  O  N  S  T  A  N  T  S
+ *
+ *******************************************************************/
+/* Number of slots in a queue, MUST be a power of 2 */
+#define QUEUE_SLOTS                 16
+
+/*******************************************************************
+ *
+ *     E  N  U  M  S
+ *
+ *******************************************************************/
+
+/*******************************************************************
+ *
+ *    S  T  R  U  C  T  S
+ *
+ *******************************************************************/
+/* Single producer / single consumer ring of pointers. Head is only written by the
+ * producer and Tail only by the consumer, so no lock is needed. */
+typedef struct
+{
+    volatile UINT32 Head; /* next slot to write, free running */
+    volatile UINT32 Tail; /* next slot to read, free running */
+    void *Slot[QUEUE_SLOTS];
+} QueueStr;
+
+/*******************************************************************
+ *
+ *    E  X  T  E  R  N      V  A  R  I  A  B  L  E  S
+ *
+ *******************************************************************/
+
+/*******************************************************************
+ *
+ *    E  X  T  E  R  N      F  U  N  C  T  I  O  N  S
+ *
+ *******************************************************************/
+
+void QueueInitialize (QueueStr *queue);
+BOOL QueuePush (QueueStr *queue, void *item);
+void *QueuePop (QueueStr *queue);
+void *QueuePeek (QueueStr *queue);
+UINT32 QueueDepth (QueueStr *queue);
+
+#endif /* RTDMQUEUE_H_ */
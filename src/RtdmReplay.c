@@ -0,0 +1,764 @@
+/****************************************************************************************************************
+ * PROJECT    : BART
+ *
+ * MODULE     : RtdmReplay.c
+ *
+ * DESCRIPTON : 	Replay of a time range from the data log ring (1.dan ... N.dan) as stream messages.
+ *
+ *	When a receiver reports a gap the missing data is sent again from the on-board log rather than from
+ *	RAM. A replay is requested with a range [start, end] in seconds and the destinations to send to,
+ *	either by RequestReplay() or by a rising edge on RTDMReplayRequest with the range and destinations
+ *	taken from RTDMReplayStart_S, RTDMReplayEnd_S and RTDMReplayDestination.
+ *
+ *	The ring is visited from the oldest segment in the data log catalog to the one being written.
+ *	A closed segment whose catalog times do not overlap the range is skipped without opening it. In a segment that
+ *	does overlap, the first block holding the range is found by a binary search on the block times,
+ *	then blocks are read in order and every sample in the range is packed into a stream message, at
+ *	most max_main_buffer_count samples per message like the live stream. The replay ends at the first
+ *	sample after the range. Samples still in the data logger's RAM block (the last second) are not
+ *	on disk yet and are not replayed.
+ *
+ *	Replayed messages carry Stream_Sequence STREAM_SEQUENCE_REPLAY so receivers do not count them
+ *	against the live sequence, and the header timestamp of the last sample in the message.
+ *
+ *	Replay runs on a low priority lane. Each cycle performs at most one step of work and reads at most
+ *	REPLAY_BLOCKS_PER_CYCLE blocks. A finished message is handed to the shaper only when the network
+ *	is available, the backlog is empty, nothing live is waiting in the shaper or the primary send
+ *	queue and a spare stream buffer stays free for sampling, and not before the previous replay
+ *	message has been paced out at replayBytesPerSec. Live samples therefore never wait for a replay
+ *	message to be built or for a stream buffer.
+ *
+ * FUNCTIONS:
+ *	void InitializeReplay (RtdmXmlStr *rtdmXmlData)
+ *	BOOL RequestReplay (UINT32 startSec, UINT32 endSec, UINT16 destinationMask)
+ *	void ServiceReplay (TYPE_RTDM_STREAM_IF *interface, BOOL networkAvailable,
+ *	                RtdmXmlStr *rtdmXmlData)
+ *
+ * OUTPUTS:
+ *	RTDMReplayState - IDLE, OPEN, SEEK, READ or SEND
+ *	RTDMReplaySampleCount - Samples sent by the current or last replay
+ *	RTDMReplayMessageCount - Stream messages sent by the current or last replay
+ *
+ **********************************************************************************************************************/
+
+#ifndef TEST_ON_PC
+#include "rts_api.h"
+#else
+#include "MyTypes.h"
+#include "MyFuncs.h"
+#endif
+
+#include <string.h>
+#include <stdlib.h>
+
+#include "RTDM_Stream_ext.h"
+#include "RtdmStream.h"
+#include "RtdmDataLog.h"
+#include "RtdmBufferPool.h"
+#include "RtdmSender.h"
+#include "RtdmShaper.h"
+#include "RtdmReplay.h"
+
+/*******************************************************************
+ *
+ *     C  O  N  S  T  A  N  T  S
+ *
+ *******************************************************************/
+/* Blocks read per 50 msec cycle, the same budget as the scrubber (4 KB) */
+#define REPLAY_BLOCKS_PER_CYCLE     2
+
+/* Pace when replayBytesPerSec is not in the .xml file */
+#define REPLAY_DEFAULT_BYTES_PER_SEC    (20 * 1024)
+
+/* Index entries read at a time when a segment index is searched */
+#define REPLAY_INDEX_CHUNK          16
+
+/* Stream buffers left free for sampling when a replay message is sent */
+#define REPLAY_SPARE_BUFFERS        1
+
+/*******************************************************************
+ *
+ *     E  N  U  M  S
+ *
+ *******************************************************************/
+typedef enum
+{
+    REPLAY_IDLE, REPLAY_OPEN_SEGMENT, REPLAY_SEEK, REPLAY_READ_DATA, REPLAY_SEND
+} ReplayState;
+
+/*******************************************************************
+ *
+ *    S  T  A  T  I  C      F  U  N  C  T  I  O  N  S
+ *
+ *******************************************************************/
+static void OpenSegment (void);
+static void SearchSegmentIndex (const DAN_Header_Struct *danHeader);
+static void SeekRange (void);
+static void ReadSegmentData (RtdmXmlStr *rtdmXmlData);
+static void SendMessage (TYPE_RTDM_STREAM_IF *interface, BOOL networkAvailable,
+                RtdmXmlStr *rtdmXmlData);
+static BOOL LaneIsFree (TYPE_RTDM_STREAM_IF *interface, BOOL networkAvailable);
+static UINT32 BuildReplayMessage (TYPE_RTDM_STREAM_IF *interface, RtdmXmlStr *rtdmXmlData);
+static void NextSegment (void);
+static void EndOfRange (void);
+static UINT32 CurrentBlockCount (void);
+static BOOL ReadReplayBlock (UINT32 blockNumber);
+
+/*******************************************************************
+ *
+ *    S  T  A  T  I  C      V  A  R  I  A  B  L  E  S
+ *
+ *******************************************************************/
+static ReplayState m_ReplayState = REPLAY_IDLE;
+
+/* Range and destinations of the replay in progress */
+static UINT32 m_StartSec = 0;
+static UINT32 m_EndSec = 0;
+static UINT16 m_DestinationMask = 0;
+static UINT16 m_DestinationCount = 0;
+
+/* Segment being read and the number of ring segments not yet visited after it */
+static UINT16 m_ReplayIndex = 0;
+static UINT16 m_SegmentsLeft = 0;
+static FILE *m_ReplayFilePtr = NULL;
+
+/* TRUE if the segment was the one being written when it was opened, its header is not final */
+static BOOL m_ReadingCurrent = FALSE;
+
+static UINT32 m_BlockCount = 0;
+static UINT32 m_BlockNumber = 0;
+
+/* Binary search for the first block ending at or after m_StartSec */
+static UINT32 m_SeekLow = 0;
+static UINT32 m_SeekHigh = 0;
+
+/* Block being unpacked; a full message can leave it part way through */
+static DAN_Block_Struct m_ReplayBlock;
+static BOOL m_BlockLoaded = FALSE;
+static UINT16 m_BlockSampleIndex = 0;
+
+/* Message being built, the same layout as a pool buffer */
+static RTDMStream_str *m_Message = NULL;
+static UINT16 m_MessageSamples = 0;
+static UINT32 m_MessageBytes = 0;
+static RTDM_Struct m_LastSample;
+
+/* Set once the range is exhausted, the replay ends after the message being sent */
+static BOOL m_LastMessage = FALSE;
+
+/* Pacing of replay messages */
+static UINT32 m_BytesPerSec = REPLAY_DEFAULT_BYTES_PER_SEC;
+static UINT32 m_LastSendMs = 0;
+static UINT32 m_HoldMs = 0;
+
+/* Previous RTDMReplayRequest, a replay starts on the rising edge */
+static UINT8 m_PreviousRequest = 0;
+
+static UINT32 m_SampleCount = 0;
+static UINT32 m_MessageCount = 0;
+
+/*******************************************************************************************
+ *
+ *   Procedure Name : InitializeReplay
+ *
+ *   Functional Description : Allocate the message the replay is built in, sized like a
+ *   stream buffer
+ *
+ *   Parameters : rtdmXmlData
+ *
+ *   Returned :  None
+ *
+ ******************************************************************************************/
+void InitializeReplay (RtdmXmlStr *rtdmXmlData)
+{
+    m_ReplayState = REPLAY_IDLE;
+    m_DestinationCount = rtdmXmlData->destination_count;
+
+    m_BytesPerSec = REPLAY_DEFAULT_BYTES_PER_SEC;
+    if (rtdmXmlData->replayBytesPerSec != 0)
+    {
+        m_BytesPerSec = rtdmXmlData->replayBytesPerSec;
+    }
+
+    m_Message = (RTDMStream_str *) calloc (
+                    sizeof(UINT16) + STREAM_HEADER_SIZE + STREAM_HEADER_EXT_SIZE
+                                    + rtdmXmlData->bufferSize,
+                    sizeof(UINT8));
+
+    if (m_Message == NULL)
+    {
+        printf ("Replay buffer allocation failed\n");
+    }
+}
+
+/*******************************************************************************************
+ *
+ *   Procedure Name : RequestReplay
+ *
+ *   Functional Description : Start replaying the samples logged from startSec to endSec,
+ *   both inclusive. Only one replay runs at a time.
+ *
+ *   Parameters : startSec, endSec - POSIX seconds, destinationMask - bit 0 is the primary
+ *                destination, 0 for the primary only
+ *
+ *   Returned :  TRUE if the replay was started
+ *
+ ******************************************************************************************/
+BOOL RequestReplay (UINT32 startSec, UINT32 endSec, UINT16 destinationMask)
+{
+    if ((m_ReplayState != REPLAY_IDLE) || (m_Message == NULL) || (endSec < startSec))
+    {
+        return FALSE;
+    }
+
+    if (destinationMask == 0)
+    {
+        destinationMask = PRIMARY_DESTINATION;
+    }
+
+    /* Only destinations that exist */
+    destinationMask &= (UINT16) ((1 << m_DestinationCount) - 1);
+    if (destinationMask == 0)
+    {
+        return FALSE;
+    }
+
+    m_StartSec = startSec;
+    m_EndSec = endSec;
+    m_DestinationMask = destinationMask;
+
+    /* Oldest segment first, the one being written last */
+    m_ReplayIndex = GetOldestDanFileIndex ();
+    m_SegmentsLeft = ((GetCurrentDanFileIndex () + GetDanFileCount () - m_ReplayIndex)
+                    % GetDanFileCount ()) + 1;
+
+    m_MessageSamples = 0;
+    m_MessageBytes = 0;
+    m_LastMessage = FALSE;
+    m_SampleCount = 0;
+    m_MessageCount = 0;
+
+    m_ReplayState = REPLAY_OPEN_SEGMENT;
+
+    printf ("Replay %lu - %lu started\n", (unsigned long) startSec, (unsigned long) endSec);
+
+    return TRUE;
+}
+
+/*******************************************************************************************
+ *
+ *   Procedure Name : ServiceReplay
+ *
+ *   Functional Description : Perform one bounded step of the replay in progress. Called every
+ *   50 msec cycle after the backlog has been serviced.
+ *
+ *   Parameters : interface, networkAvailable, rtdmXmlData
+ *
+ *   Returned :  None
+ *
+ ******************************************************************************************/
+void ServiceReplay (TYPE_RTDM_STREAM_IF *interface, BOOL networkAvailable,
+                RtdmXmlStr *rtdmXmlData)
+{
+    if (interface->RTDMReplayRequest && !m_PreviousRequest)
+    {
+        if (!RequestReplay (interface->RTDMReplayStart_S, interface->RTDMReplayEnd_S,
+                        interface->RTDMReplayDestination))
+        {
+            printf ("Replay request refused\n");
+        }
+    }
+    m_PreviousRequest = interface->RTDMReplayRequest;
+
+    switch (m_ReplayState)
+    {
+        case REPLAY_IDLE:
+            break;
+
+        case REPLAY_OPEN_SEGMENT:
+            OpenSegment ();
+            break;
+
+        case REPLAY_SEEK:
+            SeekRange ();
+            break;
+
+        case REPLAY_READ_DATA:
+            ReadSegmentData (rtdmXmlData);
+            break;
+
+        case REPLAY_SEND:
+            SendMessage (interface, networkAvailable, rtdmXmlData);
+            break;
+
+        default:
+            m_ReplayState = REPLAY_IDLE;
+            break;
+    }
+
+    interface->RTDMReplayState = (UINT8) m_ReplayState;
+    interface->RTDMReplaySampleCount = m_SampleCount;
+    interface->RTDMReplayMessageCount = m_MessageCount;
+}
+
+/* Open the segment at m_ReplayIndex and decide whether it can hold part of the range */
+static void OpenSegment (void)
+{
+    const DAN_Catalog_Entry_Struct *entry = NULL;
+    DAN_Header_Struct danHeader;
+    UINT32 headerCrc = 0;
+
+    if (m_SegmentsLeft == 0)
+    {
+        EndOfRange ();
+        return;
+    }
+
+    /* The catalog rules out empty segments and closed ones outside the range unopened */
+    entry = GetDanCatalogEntry (m_ReplayIndex);
+    if ((m_ReplayIndex != GetCurrentDanFileIndex ())
+                    && ((entry->State != DAN_SEGMENT_CLOSED) || (entry->LastTimeStamp_S < m_StartSec)
+                                    || (entry->FirstTimeStamp_S > m_EndSec)))
+    {
+        NextSegment ();
+        return;
+    }
+
+    if (os_io_fopen ((char *) GetDanFileName (m_ReplayIndex), "rb", &m_ReplayFilePtr) == ERROR)
+    {
+        /* Ring has not wrapped yet */
+        m_ReplayFilePtr = NULL;
+        NextSegment ();
+        return;
+    }
+
+    if ((fread (&danHeader, 1, sizeof(danHeader), m_ReplayFilePtr) != sizeof(danHeader))
+                    || (memcmp (danHeader.Delimiter, "DSEG", sizeof(danHeader.Delimiter)) != 0)
+                    || (danHeader.Header_Version != DAN_HEADER_VERSION))
+    {
+        NextSegment ();
+        return;
+    }
+
+    m_ReadingCurrent = (m_ReplayIndex == GetCurrentDanFileIndex ());
+
+    if (m_ReadingCurrent)
+    {
+        /* Header is written when the segment closes, the blocks on disk so far are used */
+        m_BlockCount = CurrentBlockCount ();
+    }
+    else
+    {
+        headerCrc = crc32 (0, ((unsigned char*) &danHeader.Header_Version),
+                        (sizeof(DAN_Header_Struct) - DAN_HEADER_CHECKSUM_ADJUST));
+
+        /* A corrupt header is reported by the scrubber, its times can not be trusted */
+        if ((headerCrc != danHeader.Header_Checksum)
+                        || (danHeader.LastTimeStamp_S < m_StartSec)
+                        || (danHeader.FirstTimeStamp_S > m_EndSec))
+        {
+            NextSegment ();
+            return;
+        }
+
+        m_BlockCount = danHeader.Num_Blocks;
+    }
+
+    m_SeekLow = 0;
+    m_SeekHigh = m_BlockCount;
+    m_BlockLoaded = FALSE;
+
+    if (!m_ReadingCurrent)
+    {
+        SearchSegmentIndex (&danHeader);
+    }
+    m_ReplayState = REPLAY_SEEK;
+}
+
+/*******************************************************************************************
+ *
+ *   Procedure Name : SearchSegmentIndex
+ *
+ *   Functional Description : Narrow the block search with the index written after the last
+ *   block of a closed segment. The index is read once from start to end (about 6 KB for an
+ *   hour), which leaves at most DAN_INDEX_INTERVAL_BLOCKS blocks for SeekRange() instead of a
+ *   search over the whole segment. A segment without an index, or one failing its CRC, is
+ *   searched in full.
+ *
+ *   Parameters : danHeader - finalized header of the segment
+ *
+ *   Returned :  None
+ *
+ ******************************************************************************************/
+static void SearchSegmentIndex (const DAN_Header_Struct *danHeader)
+{
+    DAN_Index_Header_Struct indexHeader;
+    DAN_Index_Entry_Struct entry[REPLAY_INDEX_CHUNK];
+    UINT32 indexCrc = 0;
+    UINT32 entriesLeft = 0;
+    UINT32 numRead = 0;
+    UINT32 low = 0;
+    UINT32 high = m_BlockCount;
+    UINT32 i = 0;
+
+    fseek (m_ReplayFilePtr,
+                    sizeof(DAN_Header_Struct) + (danHeader->Num_Blocks * sizeof(DAN_Block_Struct)),
+                    SEEK_SET);
+
+    if ((fread (&indexHeader, 1, sizeof(indexHeader), m_ReplayFilePtr) != sizeof(indexHeader))
+                    || (memcmp (indexHeader.Delimiter, "DIDX", sizeof(indexHeader.Delimiter)) != 0)
+                    || (indexHeader.Header_Version != DAN_INDEX_VERSION)
+                    || (indexHeader.Header_Size != sizeof(DAN_Index_Header_Struct))
+                    || (indexHeader.Entry_Size != sizeof(DAN_Index_Entry_Struct))
+                    || (indexHeader.Num_Entries > danHeader->Num_Blocks))
+    {
+        return;
+    }
+
+    indexCrc = crc32_fast (0, ((unsigned char*) &indexHeader.Header_Version),
+                    (sizeof(DAN_Index_Header_Struct) - DAN_INDEX_CHECKSUM_ADJUST));
+
+    entriesLeft = indexHeader.Num_Entries;
+    while (entriesLeft > 0)
+    {
+        numRead = (entriesLeft < REPLAY_INDEX_CHUNK) ? entriesLeft : REPLAY_INDEX_CHUNK;
+        if (fread (entry, sizeof(DAN_Index_Entry_Struct), numRead, m_ReplayFilePtr) != numRead)
+        {
+            return;
+        }
+        indexCrc = crc32_fast (indexCrc, (unsigned char*) entry,
+                        (numRead * sizeof(DAN_Index_Entry_Struct)));
+        entriesLeft -= numRead;
+
+        /* Blocks before an entry that starts ahead of the range all end before it; the first
+         * entry at or after the start bounds the search from above */
+        for (i = 0; i < numRead; i++)
+        {
+            if (entry[i].Sequence >= m_BlockCount)
+            {
+                return;
+            }
+            if (entry[i].TimeStamp_S < m_StartSec)
+            {
+                low = entry[i].Sequence;
+            }
+            else if (high == m_BlockCount)
+            {
+                high = entry[i].Sequence;
+            }
+        }
+    }
+
+    if ((indexCrc == indexHeader.Index_Checksum) && (low <= high))
+    {
+        m_SeekLow = low;
+        m_SeekHigh = high;
+    }
+}
+
+/* A few steps of the binary search for the first block that ends at or after m_StartSec */
+static void SeekRange (void)
+{
+    UINT16 blocksRead = 0;
+    UINT32 middle = 0;
+    BOOL badBlock = FALSE;
+    RTDM_Struct *lastSample = NULL;
+
+    while ((blocksRead < REPLAY_BLOCKS_PER_CYCLE) && (m_SeekLow < m_SeekHigh))
+    {
+        middle = m_SeekLow + ((m_SeekHigh - m_SeekLow) / 2);
+        blocksRead++;
+
+        /* A bad block breaks the search, read on from the low end and skip bad blocks there */
+        if (!ReadReplayBlock (middle) || (m_ReplayBlock.Header.Num_Samples == 0))
+        {
+            badBlock = TRUE;
+            break;
+        }
+
+        lastSample = &m_ReplayBlock.Sample[m_ReplayBlock.Header.Num_Samples - 1];
+
+        if (lastSample->TimeStamp.seconds >= m_StartSec)
+        {
+            m_SeekHigh = middle;
+        }
+        else
+        {
+            m_SeekLow = middle + 1;
+        }
+    }
+
+    if ((m_SeekLow >= m_SeekHigh) || badBlock)
+    {
+        m_BlockNumber = m_SeekLow;
+        m_BlockLoaded = FALSE;
+        m_ReplayState = REPLAY_READ_DATA;
+    }
+}
+
+/* Unpack the next blocks into the message, bounded by the per cycle read budget */
+static void ReadSegmentData (RtdmXmlStr *rtdmXmlData)
+{
+    UINT16 blocksRead = 0;
+    RTDM_Struct *sample = NULL;
+
+    /* The logger wrapped around onto this segment, what is left of it is newer than the range */
+    if (!m_ReadingCurrent && (m_ReplayIndex == GetCurrentDanFileIndex ()))
+    {
+        EndOfRange ();
+        return;
+    }
+
+    while (blocksRead < REPLAY_BLOCKS_PER_CYCLE)
+    {
+        if (!m_BlockLoaded)
+        {
+            /* The segment being written grows while it is replayed */
+            if (m_ReadingCurrent && (m_BlockNumber >= m_BlockCount))
+            {
+                m_BlockCount = CurrentBlockCount ();
+            }
+
+            if (m_BlockNumber >= m_BlockCount)
+            {
+                NextSegment ();
+                return;
+            }
+
+            blocksRead++;
+            if (!ReadReplayBlock (m_BlockNumber))
+            {
+                m_BlockNumber++;
+                continue;
+            }
+
+            m_BlockLoaded = TRUE;
+            m_BlockSampleIndex = 0;
+        }
+
+        while (m_BlockSampleIndex < m_ReplayBlock.Header.Num_Samples)
+        {
+            sample = &m_ReplayBlock.Sample[m_BlockSampleIndex];
+
+            if (sample->TimeStamp.seconds > m_EndSec)
+            {
+                EndOfRange ();
+                return;
+            }
+
+            m_BlockSampleIndex++;
+
+            if (sample->TimeStamp.seconds < m_StartSec)
+            {
+                continue;
+            }
+
+            /* Same placement as a live sample in OutputStream() */
+            memcpy (&m_Message->IBufferArray[m_MessageSamples * rtdmXmlData->sample_size], sample,
+                            sizeof(RTDM_Struct));
+            memcpy (&m_LastSample, sample, sizeof(RTDM_Struct));
+            m_MessageSamples++;
+            m_MessageBytes += rtdmXmlData->sample_size;
+
+            if (m_MessageSamples >= rtdmXmlData->max_main_buffer_count)
+            {
+                m_ReplayState = REPLAY_SEND;
+                return;
+            }
+        }
+
+        m_BlockLoaded = FALSE;
+        m_BlockNumber++;
+    }
+}
+
+/* Hand the finished message to the shaper once the low priority lane is free */
+static void SendMessage (TYPE_RTDM_STREAM_IF *interface, BOOL networkAvailable,
+                RtdmXmlStr *rtdmXmlData)
+{
+    StreamBufferStr *buffer = NULL;
+    UINT32 messageSize = 0;
+
+    if (!LaneIsFree (interface, networkAvailable))
+    {
+        return;
+    }
+
+    buffer = AcquireStreamBuffer ();
+    if (buffer == NULL)
+    {
+        return;
+    }
+
+    messageSize = BuildReplayMessage (interface, rtdmXmlData);
+
+    memcpy (buffer->Stream, m_Message, messageSize);
+    buffer->SampleCount = m_MessageSamples;
+    buffer->ByteCount = m_MessageBytes;
+
+    /* A failed send to the primary destination goes to the backlog like a live message */
+    ShapeStreamForSend (buffer, messageSize, m_DestinationMask);
+
+    m_SampleCount += m_MessageSamples;
+    m_MessageCount++;
+
+    m_LastSendMs = NowMsecs ();
+    m_HoldMs = (messageSize * 1000UL) / m_BytesPerSec;
+
+    m_MessageSamples = 0;
+    m_MessageBytes = 0;
+
+    if (m_LastMessage)
+    {
+        printf ("Replay %lu - %lu complete, %lu samples\n", (unsigned long) m_StartSec,
+                        (unsigned long) m_EndSec, (unsigned long) m_SampleCount);
+        m_ReplayState = REPLAY_IDLE;
+    }
+    else
+    {
+        m_ReplayState = REPLAY_READ_DATA;
+    }
+}
+
+/* Replay only uses what live data, and the backlog of live data, leave unused */
+static BOOL LaneIsFree (TYPE_RTDM_STREAM_IF *interface, BOOL networkAvailable)
+{
+    if (!networkAvailable || (interface->RTDMSendQueueDepth != 0)
+                    || (interface->RTDMShaperQueueDepth != 0)
+                    || (interface->RTDMBacklogRam != 0) || (interface->RTDMBacklogDisk != 0)
+                    || (GetFreeStreamBufferCount () <= REPLAY_SPARE_BUFFERS))
+    {
+        return FALSE;
+    }
+
+    return ((NowMsecs () - m_LastSendMs) >= m_HoldMs);
+}
+
+/* Fill in the header in front of the samples already in m_Message, returns the message size */
+static UINT32 BuildReplayMessage (TYPE_RTDM_STREAM_IF *interface, RtdmXmlStr *rtdmXmlData)
+{
+    STRM_Header_Struct header;
+    STRM_Header_Ext_Struct headerExt;
+
+    memset (&header, 0, sizeof(header));
+
+    memcpy (header.Delimiter, "STRM", sizeof(header.Delimiter));
+    header.Endiannes = BIG_ENDIAN;
+    header.Header_Size = sizeof(header) + sizeof(headerExt);
+    header.Header_Version = STREAM_HEADER_VERSION;
+
+    memcpy (header.Consist_ID, interface->VNC_CarData_X_ConsistID, sizeof(header.Consist_ID));
+    memcpy (header.Car_ID, interface->VNC_CarData_X_CarID, sizeof(header.Car_ID));
+    memcpy (header.Device_ID, interface->VNC_CarData_X_DeviceID, sizeof(header.Device_ID));
+
+    header.Data_Record_ID = rtdmXmlData->DataRecorderCfgID;
+    header.Data_Record_Version = rtdmXmlData->DataRecorderCfgVersion;
+
+    /* The live message holding the last sample would have been sent at about this time */
+    header.TimeStamp_S = m_LastSample.TimeStamp.seconds;
+    header.TimeStamp_mS = m_LastSample.TimeStamp.msecs;
+    header.TimeStamp_accuracy = m_LastSample.TimeStamp.accuracy;
+
+    header.Sample_Size_for_header = m_MessageBytes + SAMPLE_SIZE_ADJUSTMENT;
+    header.Num_Samples = m_MessageSamples;
+
+    /* Same coverage as the live stream, see OutputStream() */
+    header.Sample_Checksum = crc32 (0, (unsigned char *) &header.Num_Samples,
+                    sizeof(header.Num_Samples));
+    header.Sample_Checksum = crc32 (header.Sample_Checksum, &m_Message->IBufferArray[0],
+                    m_MessageBytes);
+
+    headerExt.Ext_Version = STREAM_HEADER_EXT_VERSION;
+    headerExt.Ext_Size = sizeof(headerExt);
+    headerExt.Stream_Sequence = STREAM_SEQUENCE_REPLAY;
+
+    header.Header_Checksum = crc32 (0, ((unsigned char*) &header.Header_Version),
+                    (sizeof(header) - STREAM_HEADER_CHECKSUM_ADJUST));
+    header.Header_Checksum = crc32 (header.Header_Checksum, (unsigned char*) &headerExt,
+                    sizeof(headerExt));
+
+    memcpy (m_Message->header, &header, sizeof(header));
+    memcpy (m_Message->headerExt, &headerExt, sizeof(headerExt));
+    m_Message->IBufferSize = m_MessageBytes + sizeof(UINT16);
+
+    return sizeof(UINT16) + STREAM_HEADER_SIZE + STREAM_HEADER_EXT_SIZE + m_MessageBytes;
+}
+
+/* Close the segment and move on to the next newer one */
+static void NextSegment (void)
+{
+    if (m_ReplayFilePtr != NULL)
+    {
+        os_io_fclose(m_ReplayFilePtr);
+        m_ReplayFilePtr = NULL;
+    }
+
+    m_ReplayIndex = (m_ReplayIndex + 1) % GetDanFileCount ();
+    m_SegmentsLeft--;
+    m_ReplayState = REPLAY_OPEN_SEGMENT;
+}
+
+/* No more samples in the range, send what has been packed and finish */
+static void EndOfRange (void)
+{
+    if (m_ReplayFilePtr != NULL)
+    {
+        os_io_fclose(m_ReplayFilePtr);
+        m_ReplayFilePtr = NULL;
+    }
+
+    if (m_MessageSamples != 0)
+    {
+        m_LastMessage = TRUE;
+        m_ReplayState = REPLAY_SEND;
+        return;
+    }
+
+    printf ("Replay %lu - %lu complete, %lu samples\n", (unsigned long) m_StartSec,
+                    (unsigned long) m_EndSec, (unsigned long) m_SampleCount);
+    m_ReplayState = REPLAY_IDLE;
+}
+
+/* Whole blocks on disk in the segment being written; a block still being written is ignored */
+static UINT32 CurrentBlockCount (void)
+{
+    INT32 fileSize = 0;
+
+    fseek (m_ReplayFilePtr, 0L, SEEK_END);
+    fileSize = ftell (m_ReplayFilePtr);
+
+    if (fileSize <= (INT32) sizeof(DAN_Header_Struct))
+    {
+        return 0;
+    }
+
+    return (fileSize - sizeof(DAN_Header_Struct)) / sizeof(DAN_Block_Struct);
+}
+
+/* Read the block at blockNumber into m_ReplayBlock and verify its framing and CRC */
+static BOOL ReadReplayBlock (UINT32 blockNumber)
+{
+    UINT32 blockCrc = 0;
+
+    fseek (m_ReplayFilePtr, sizeof(DAN_Header_Struct) + (blockNumber * sizeof(DAN_Block_Struct)),
+    SEEK_SET);
+
+    if (fread (&m_ReplayBlock, 1, sizeof(m_ReplayBlock), m_ReplayFilePtr)
+                    != sizeof(m_ReplayBlock))
+    {
+        return FALSE;
+    }
+
+    if ((memcmp (m_ReplayBlock.Header.Delimiter, "DBLK", sizeof(m_ReplayBlock.Header.Delimiter))
+                    != 0) || (m_ReplayBlock.Header.Block_Size != sizeof(DAN_Block_Struct))
+                    || (m_ReplayBlock.Header.Sequence != blockNumber)
+                    || (m_ReplayBlock.Header.Num_Samples > DAN_BLOCK_SAMPLES))
+    {
+        return FALSE;
+    }
+
+    blockCrc = crc32_fast (0, ((unsigned char*) &m_ReplayBlock.Header.Sequence),
+                    (sizeof(DAN_Block_Struct) - DAN_BLOCK_CHECKSUM_ADJUST));
+
+    return (blockCrc == m_ReplayBlock.Header.Block_Checksum);
+}
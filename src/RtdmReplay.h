@@ -0,0 +1,45 @@
+/*
+ * RtdmReplay.h
+ *
+ *  Interface of RtdmReplay.c: replay of a time range from the data log ring as stream messages.
+ */
+
+#ifndef RTDMREPLAY_H_
+#define RTDMREPLAY_H_
+
+/*******************************************************************
+ *
+ *     C  O  N  S  T  A  N  T  S
+ *
+ *******************************************************************/
+
+/*******************************************************************
+ *
+ *     E  N  U  M  S
+ *
+ *******************************************************************/
+
+/*******************************************************************
+ *
+ *    S  T  R  U  C  T  S
+ *
+ *******************************************************************/
+
+/*******************************************************************
+ *
+ *    E  X  T  E  R  N      V  A  R  I  A  B  L  E  S
+ *
+ *******************************************************************/
+
+/*******************************************************************
+ *
+ *    E  X  T  E  R  N      F  U  N  C  T  I  O  N  S
+ *
+ *******************************************************************/
+
+void InitializeReplay (RtdmXmlStr *rtdmXmlData);
+BOOL RequestReplay (UINT32 startSec, UINT32 endSec, UINT16 destinationMask);
+void ServiceReplay (TYPE_RTDM_STREAM_IF *interface, BOOL networkAvailable,
+                RtdmXmlStr *rtdmXmlData);
+
+#endif /* RTDMREPLAY_H_ */
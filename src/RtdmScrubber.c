@@ -0,0 +1,386 @@
+/****************************************************************************************************************
+ * PROJECT    : BART
+ *
+ * MODULE     : RtdmScrubber.c
+ *
+ * DESCRIPTON : 	Background integrity check of the closed data log segments (1.dan ... N.dan).
+ *
+ *	The scrubber is serviced once per 50 msec cycle from RTDM_Stream(). Each call performs at most one
+ *	step of work and never reads more than SCRUB_BYTES_PER_CYCLE bytes, so its cost per cycle is bounded
+ *	by the read budget rather than by the segment size. The time spent in the last call and the worst
+ *	case seen are published on the interface (RTDMScrubTimeUs / RTDMScrubMaxTimeUs).
+ *
+ *	For every closed segment the DSEG header CRC is checked first, then the DBLK blocks are read as
+ *	many whole blocks per call as fit in the read budget, and the framing and CRC of each block are
+ *	verified. Results are written to DanScrubStatus.txt after each segment. While any segment is
+ *	known to be corrupt DAN_CRC_FAIL is reported to Check_Fault().
+ *
+ *	The segment the data logger will write next is skipped since it is about to be overwritten.
+ *
+ * FUNCTIONS:
+ *	void InitializeScrubber (TYPE_RTDM_STREAM_IF *interface)
+ *	void ServiceScrubber (TYPE_RTDM_STREAM_IF *interface, UINT16 *errorCode)
+ *
+ * OUTPUTS:
+ *	RTDMScrubSegment - Ring segment currently being verified
+ *	RTDMScrubCorrupt - Number of corrupt ring segments found
+ *	RTDMScrubTimeUs - Time spent by the scrubber in the last cycle
+ *	RTDMScrubMaxTimeUs - Worst case time spent by the scrubber in a cycle
+ *
+ **********************************************************************************************************************/
+
+#ifndef TEST_ON_PC
+#include "rts_api.h"
+#else
+#include "MyTypes.h"
+#include "MyFuncs.h"
+#endif
+
+#include <string.h>
+#include <stdlib.h>
+
+#include "RTDM_Stream_ext.h"
+#include "RtdmStream.h"
+#include "RtdmDataLog.h"
+#include "RtdmScrubber.h"
+
+/*******************************************************************
+ *
+ *     C  O  N  S  T  A  N  T  S
+ *
+ *******************************************************************/
+/* Maximum number of bytes read from a segment per 50 msec cycle (80 KB/sec) */
+#define SCRUB_BYTES_PER_CYCLE       (4 * 1024)
+
+/* Whole blocks are verified, at least one per call */
+#define SCRUB_BLOCKS_PER_CYCLE      ((SCRUB_BYTES_PER_CYCLE / sizeof(DAN_Block_Struct)) > 0 ? \
+                                     (SCRUB_BYTES_PER_CYCLE / sizeof(DAN_Block_Struct)) : 1)
+
+/* Idle time between two complete passes over the ring */
+#define SCRUB_PASS_INTERVAL_SEC     (10 * 60)
+
+/* Results of the last pass, one line per segment */
+#define SCRUB_STATUS_FILE           "DanScrubStatus.txt"
+
+/* Upper bound on the ring size, must be >= GetDanFileCount() */
+#define SCRUB_MAX_SEGMENTS          32
+
+/*******************************************************************
+ *
+ *     E  N  U  M  S
+ *
+ *******************************************************************/
+typedef enum
+{
+    SCRUB_IDLE, SCRUB_OPEN_SEGMENT, SCRUB_READ_DATA
+} ScrubState;
+
+typedef enum
+{
+    SEGMENT_NOT_CHECKED, SEGMENT_OK, SEGMENT_MISSING, SEGMENT_UNKNOWN_FORMAT, SEGMENT_CORRUPT
+} SegmentStatus;
+
+/*******************************************************************
+ *
+ *    S  T  R  U  C  T  S
+ *
+ *******************************************************************/
+
+/*******************************************************************
+ *
+ *    S  T  A  T  I  C      V  A  R  I  A  B  L  E  S
+ *
+ *******************************************************************/
+static ScrubState m_ScrubState = SCRUB_IDLE;
+static UINT16 m_ScrubIndex = 0;
+static FILE *m_ScrubFilePtr = NULL;
+
+/* Next block of the segment to verify */
+static UINT32 m_ScrubBlockNumber = 0;
+static DAN_Header_Struct m_ScrubHeader;
+
+/* Segment the data logger will write next, used to notice a segment being rewritten */
+static UINT16 m_LoggerIndex = 0;
+
+/* Time the last pass finished; 0 forces a pass on start up */
+static UINT32 m_PassCompleteTimeSec = 0;
+
+static UINT8 m_SegmentStatus[SCRUB_MAX_SEGMENTS];
+static UINT32 m_SegmentCheckedTimeSec[SCRUB_MAX_SEGMENTS];
+
+static DAN_Block_Struct m_ScrubBlock;
+
+static const char *m_StatusText[] =
+{ "NOT_CHECKED", "OK", "MISSING", "UNKNOWN_FORMAT", "CORRUPT" };
+
+/*******************************************************************
+ *
+ *    S  T  A  T  I  C      F  U  N  C  T  I  O  N  S
+ *
+ *******************************************************************/
+static void OpenSegment (UINT32 nowSec);
+static void ReadSegmentData (UINT32 nowSec);
+static BOOL VerifyBlock (DAN_Block_Struct *block, UINT32 blockNumber);
+static void FinishSegment (SegmentStatus status, UINT32 nowSec);
+static void WriteStatusFile (void);
+static UINT16 CorruptSegmentCount (void);
+
+void InitializeScrubber (TYPE_RTDM_STREAM_IF *interface)
+{
+    memset (m_SegmentStatus, SEGMENT_NOT_CHECKED, sizeof(m_SegmentStatus));
+    memset (m_SegmentCheckedTimeSec, 0, sizeof(m_SegmentCheckedTimeSec));
+
+    m_ScrubState = SCRUB_IDLE;
+    m_ScrubIndex = 0;
+    m_PassCompleteTimeSec = 0;
+    m_LoggerIndex = GetCurrentDanFileIndex ();
+
+    interface->RTDMScrubSegment = 0;
+    interface->RTDMScrubCorrupt = 0;
+    interface->RTDMScrubTimeUs = 0;
+    interface->RTDMScrubMaxTimeUs = 0;
+}
+
+/*******************************************************************************************
+ *
+ *   Procedure Name : ServiceScrubber
+ *
+ *   Functional Description : Perform one bounded step of the ring integrity check. Called
+ *   every 50 msec cycle after the data log has been processed.
+ *
+ *   Parameters : interface, errorCode - set to DAN_CRC_FAIL while a corrupt segment is known
+ *                and no other error is pending
+ *
+ *   Returned :  None
+ *
+ ******************************************************************************************/
+void ServiceScrubber (TYPE_RTDM_STREAM_IF *interface, UINT16 *errorCode)
+{
+    OS_STR_TIME_POSIX startTime;
+    OS_STR_TIME_POSIX endTime;
+    UINT32 elapsedUs = 0;
+
+    os_c_get (&startTime);
+
+    /* The logger moved on, so the segment it just wrote holds new, unchecked data */
+    if (m_LoggerIndex != GetCurrentDanFileIndex ())
+    {
+        if (m_LoggerIndex < SCRUB_MAX_SEGMENTS)
+        {
+            m_SegmentStatus[m_LoggerIndex] = SEGMENT_NOT_CHECKED;
+        }
+        m_LoggerIndex = GetCurrentDanFileIndex ();
+    }
+
+    switch (m_ScrubState)
+    {
+        case SCRUB_IDLE:
+            if ((m_PassCompleteTimeSec == 0)
+                            || ((startTime.sec - m_PassCompleteTimeSec) >= SCRUB_PASS_INTERVAL_SEC))
+            {
+                m_ScrubIndex = 0;
+                m_ScrubState = SCRUB_OPEN_SEGMENT;
+            }
+            break;
+
+        case SCRUB_OPEN_SEGMENT:
+            OpenSegment (startTime.sec);
+            break;
+
+        case SCRUB_READ_DATA:
+            ReadSegmentData (startTime.sec);
+            break;
+
+        default:
+            m_ScrubState = SCRUB_IDLE;
+            break;
+    }
+
+    os_c_get (&endTime);
+
+    elapsedUs = ElapsedUsecs (&startTime, &endTime);
+
+    interface->RTDMScrubSegment = m_ScrubIndex;
+    interface->RTDMScrubCorrupt = CorruptSegmentCount ();
+    interface->RTDMScrubTimeUs = elapsedUs;
+    if (elapsedUs > interface->RTDMScrubMaxTimeUs)
+    {
+        interface->RTDMScrubMaxTimeUs = elapsedUs;
+    }
+
+    if ((interface->RTDMScrubCorrupt != 0) && (*errorCode == NO_ERROR))
+    {
+        *errorCode = DAN_CRC_FAIL;
+    }
+}
+
+/* Open the segment at m_ScrubIndex and verify its header */
+static void OpenSegment (UINT32 nowSec)
+{
+    const char *fileName = NULL;
+    UINT32 headerCrc = 0;
+
+    /* End of the ring, pass is complete */
+    if (m_ScrubIndex >= GetDanFileCount () || m_ScrubIndex >= SCRUB_MAX_SEGMENTS)
+    {
+        WriteStatusFile ();
+        m_PassCompleteTimeSec = nowSec;
+        m_ScrubState = SCRUB_IDLE;
+        return;
+    }
+
+    /* Segment is the next one to be written, it is not closed */
+    if (m_ScrubIndex == GetCurrentDanFileIndex ())
+    {
+        m_ScrubIndex++;
+        return;
+    }
+
+    fileName = GetDanFileName (m_ScrubIndex);
+
+    if (os_io_fopen ((char *) fileName, "rb", &m_ScrubFilePtr) == ERROR)
+    {
+        /* Ring has not wrapped yet */
+        FinishSegment (SEGMENT_MISSING, nowSec);
+        return;
+    }
+
+    if (fread (&m_ScrubHeader, 1, sizeof(m_ScrubHeader), m_ScrubFilePtr)
+                    != sizeof(m_ScrubHeader))
+    {
+        FinishSegment (SEGMENT_CORRUPT, nowSec);
+        return;
+    }
+
+    /* Written before block framing was introduced, nothing to verify against */
+    if ((memcmp (m_ScrubHeader.Delimiter, "DSEG", sizeof(m_ScrubHeader.Delimiter)) != 0)
+                    || (m_ScrubHeader.Header_Version != DAN_HEADER_VERSION))
+    {
+        FinishSegment (SEGMENT_UNKNOWN_FORMAT, nowSec);
+        return;
+    }
+
+    headerCrc = crc32 (0, ((unsigned char*) &m_ScrubHeader.Header_Version),
+                    (sizeof(DAN_Header_Struct) - DAN_HEADER_CHECKSUM_ADJUST));
+
+    if ((headerCrc != m_ScrubHeader.Header_Checksum)
+                    || (m_ScrubHeader.Header_Size != sizeof(DAN_Header_Struct))
+                    || (m_ScrubHeader.Block_Size != sizeof(DAN_Block_Struct)))
+    {
+        FinishSegment (SEGMENT_CORRUPT, nowSec);
+        return;
+    }
+
+    m_ScrubBlockNumber = 0;
+    m_ScrubState = SCRUB_READ_DATA;
+}
+
+/* Verify the next blocks of the segment, bounded by the per cycle read budget */
+static void ReadSegmentData (UINT32 nowSec)
+{
+    UINT16 blocksRead = 0;
+
+    /* The logger caught up with the segment, abandon it until the next pass */
+    if (m_ScrubIndex == GetCurrentDanFileIndex ())
+    {
+        FinishSegment (SEGMENT_NOT_CHECKED, nowSec);
+        return;
+    }
+
+    while ((blocksRead < SCRUB_BLOCKS_PER_CYCLE)
+                    && (m_ScrubBlockNumber < m_ScrubHeader.Num_Blocks))
+    {
+        /* A short read means the segment is shorter than its header claims */
+        if ((fread (&m_ScrubBlock, 1, sizeof(m_ScrubBlock), m_ScrubFilePtr)
+                        != sizeof(m_ScrubBlock))
+                        || !VerifyBlock (&m_ScrubBlock, m_ScrubBlockNumber))
+        {
+            printf ("SCRUB: %s block %lu is bad\n", GetDanFileName (m_ScrubIndex),
+                            (unsigned long) m_ScrubBlockNumber);
+            FinishSegment (SEGMENT_CORRUPT, nowSec);
+            return;
+        }
+
+        m_ScrubBlockNumber++;
+        blocksRead++;
+    }
+
+    if (m_ScrubBlockNumber >= m_ScrubHeader.Num_Blocks)
+    {
+        FinishSegment (SEGMENT_OK, nowSec);
+    }
+}
+
+/* Check the framing and CRC of a block read from position blockNumber */
+static BOOL VerifyBlock (DAN_Block_Struct *block, UINT32 blockNumber)
+{
+    UINT32 blockCrc = 0;
+
+    if ((memcmp (block->Header.Delimiter, "DBLK", sizeof(block->Header.Delimiter)) != 0)
+                    || (block->Header.Block_Size != sizeof(DAN_Block_Struct))
+                    || (block->Header.Sequence != blockNumber))
+    {
+        return FALSE;
+    }
+
+    blockCrc = crc32_fast (0, ((unsigned char*) &block->Header.Sequence),
+                    (sizeof(DAN_Block_Struct) - DAN_BLOCK_CHECKSUM_ADJUST));
+
+    return (blockCrc == block->Header.Block_Checksum);
+}
+
+/* Record the result for the current segment and move on to the next one */
+static void FinishSegment (SegmentStatus status, UINT32 nowSec)
+{
+    if (m_ScrubFilePtr != NULL)
+    {
+        os_io_fclose(m_ScrubFilePtr);
+        m_ScrubFilePtr = NULL;
+    }
+
+    m_SegmentStatus[m_ScrubIndex] = status;
+    m_SegmentCheckedTimeSec[m_ScrubIndex] = nowSec;
+
+    if (status == SEGMENT_CORRUPT)
+    {
+        printf ("SCRUB: %s is corrupt\n", GetDanFileName (m_ScrubIndex));
+    }
+
+    WriteStatusFile ();
+
+    m_ScrubIndex++;
+    m_ScrubState = SCRUB_OPEN_SEGMENT;
+}
+
+static void WriteStatusFile (void)
+{
+    FILE *p_file = NULL;
+    UINT16 i = 0;
+
+    if (os_io_fopen (SCRUB_STATUS_FILE, "wb+", &p_file) != ERROR)
+    {
+        for (i = 0; (i < GetDanFileCount ()) && (i < SCRUB_MAX_SEGMENTS); i++)
+        {
+            fprintf (p_file, "%s %s %lu\n", GetDanFileName (i),
+                            m_StatusText[m_SegmentStatus[i]],
+                            (unsigned long) m_SegmentCheckedTimeSec[i]);
+        }
+        os_io_fclose(p_file);
+    }
+}
+
+static UINT16 CorruptSegmentCount (void)
+{
+    UINT16 i = 0;
+    UINT16 count = 0;
+
+    for (i = 0; i < SCRUB_MAX_SEGMENTS; i++)
+    {
+        if (m_SegmentStatus[i] == SEGMENT_CORRUPT)
+        {
+            count++;
+        }
+    }
+
+    return count;
+}
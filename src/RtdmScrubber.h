@@ -0,0 +1,43 @@
+/*
+ * RtdmScrubber.h
+ *
+ *  Interface of RtdmScrubber.c: background integrity check of the closed data log segments.
+ */
+
+#ifndef RTDMSCRUBBER_H_
+#define RTDMSCRUBBER_H_
+
+/*******************************************************************
+ *
+ *     C  O  N  S  T  A  N  T  S
+ *
+ *******************************************************************/
+
+/*******************************************************************
+ *
+ *     E  N  U  M  S
+ *
+ *******************************************************************/
+
+/*******************************************************************
+ *
+ *    S  T  R  U  C  T  S
+ *
+ *******************************************************************/
+
+/*******************************************************************
+ *
+ *    E  X  T  E  R  N      V  A  R  I  A  B  L  E  S
+ *
+ *******************************************************************/
+
+/*******************************************************************
+ *
+ *    E  X  T  E  R  N      F  U  N  C  T  I  O  N  S
+ *
+ *******************************************************************/
+
+void InitializeScrubber (TYPE_RTDM_STREAM_IF *interface);
+void ServiceScrubber (TYPE_RTDM_STREAM_IF *interface, UINT16 *errorCode);
+
+#endif /* RTDMSCRUBBER_H_ */
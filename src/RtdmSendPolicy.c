@@ -0,0 +1,247 @@
+/****************************************************************************************************************
+ * PROJECT    : BART
+ *
+ * MODULE     : RtdmSendPolicy.c
+ *
+ * DESCRIPTON : 	Adaptive choice of when a stream buffer is sent.
+ *
+ *	With a fixed maxTimeBeforeSendMs an idle train sends many small messages that are mostly header,
+ *	and a busy train holds samples longer than needed. When both optional OutputStreamCfg attributes
+ *	sendIntervalMinMs and sendIntervalMaxMs are set, the time limit is replaced by an interval chosen
+ *	every cycle from:
+ *	   R - sample bytes per second, averaged over the last messages
+ *	   H - bytes every message costs on the wire whatever it holds: IBufferSize, the STRM header and
+ *	       extension, and SEND_POLICY_TRANSPORT_BYTES for the transport headers
+ *	   L - time from the buffer being finished to it being sent: the shaper wait (RTDMShaperDelayMs)
+ *	       plus the sender latency (RTDMSendLatencyUs), averaged
+ *
+ *	The interval is the shortest that keeps the overhead H / (H + R * interval) at or below
+ *	SEND_POLICY_OVERHEAD_PERMILLE, so waiting longer would save little, limited to
+ *	[sendIntervalMinMs, sendIntervalMaxMs - L] so the oldest sample reaches the MDS no later than
+ *	sendIntervalMaxMs after it was taken. The age is that of the first sample in the buffer; an empty
+ *	buffer is sent every sendIntervalMaxMs. A full buffer and maxBytesBeforeSend still send at once.
+ *
+ *	Unlike maxTimeBeforeSendMs, which is compared in seconds, both bounds are in milliseconds.
+ *
+ * FUNCTIONS:
+ *	void InitializeSendPolicy (RtdmXmlStr *rtdmXmlData)
+ *	BOOL SendPolicyEnabled (void)
+ *	BOOL SendIntervalElapsed (TYPE_RTDM_STREAM_IF *interface, StreamBufferStr *buffer,
+ *	                RTDMTimeStr *currentTime)
+ *	void SendPolicyFlushed (StreamBufferStr *buffer, RTDMTimeStr *currentTime)
+ *
+ * OUTPUTS:
+ *	RTDMSendIntervalMs - Send interval in use
+ *	RTDMSampleBytesPerSec - Average rate sample bytes are produced
+ *
+ **********************************************************************************************************************/
+
+#ifndef TEST_ON_PC
+#include "rts_api.h"
+#else
+#include "MyTypes.h"
+#include "MyFuncs.h"
+#endif
+
+#include <string.h>
+
+#include "RTDM_Stream_ext.h"
+#include "RtdmStream.h"
+#include "RtdmBufferPool.h"
+#include "RtdmSendPolicy.h"
+
+/*******************************************************************
+ *
+ *     C  O  N  S  T  A  N  T  S
+ *
+ *******************************************************************/
+/* Target share of header bytes on the wire, 2 % */
+#define SEND_POLICY_OVERHEAD_PERMILLE   20
+
+/* IP, UDP and MD protocol headers per message, approximately */
+#define SEND_POLICY_TRANSPORT_BYTES     64
+
+/* Averages move 1/4 of the way to each new measurement */
+#define SEND_POLICY_AVERAGE_SHIFT       2
+
+/* Samples are taken every 50 msec */
+#define SAMPLES_PER_SEC                 20
+
+/*******************************************************************
+ *
+ *    S  T  A  T  I  C      F  U  N  C  T  I  O  N  S
+ *
+ *******************************************************************/
+static UINT32 ChooseInterval (void);
+static UINT32 TimeMsecs (RTDMTimeStr *time);
+
+/*******************************************************************
+ *
+ *    S  T  A  T  I  C      V  A  R  I  A  B  L  E  S
+ *
+ *******************************************************************/
+static BOOL m_PolicyEnabled = FALSE;
+
+/* Bounds from .xml [msec] */
+static UINT32 m_MinIntervalMs = 0;
+static UINT32 m_MaxIntervalMs = 0;
+
+/* Wire bytes per message besides the samples */
+static UINT32 m_OverheadBytes = 0;
+
+/* Averages */
+static UINT32 m_BytesPerSec = 0;
+static UINT32 m_LatencyMs = 0;
+
+static UINT32 m_IntervalMs = 0;
+
+/* Time the previous buffer was sent, 0 before the first */
+static UINT32 m_LastFlushMs = 0;
+
+/*******************************************************************************************
+ *
+ *   Procedure Name : InitializeSendPolicy
+ *
+ *   Functional Description : Enable the adaptive interval if both bounds are configured. The
+ *   byte rate starts at every sample holding every signal, the busiest case.
+ *
+ *   Parameters : rtdmXmlData
+ *
+ *   Returned :  None
+ *
+ ******************************************************************************************/
+void InitializeSendPolicy (RtdmXmlStr *rtdmXmlData)
+{
+    m_MinIntervalMs = rtdmXmlData->sendIntervalMinMs;
+    m_MaxIntervalMs = rtdmXmlData->sendIntervalMaxMs;
+
+    m_PolicyEnabled = (m_MinIntervalMs != 0) && (m_MaxIntervalMs >= m_MinIntervalMs);
+
+    if ((m_MinIntervalMs != 0) && !m_PolicyEnabled)
+    {
+        printf ("sendIntervalMaxMs is below sendIntervalMinMs, adaptive send interval off\n");
+    }
+
+    m_OverheadBytes = sizeof(UINT16) + STREAM_HEADER_SIZE + STREAM_HEADER_EXT_SIZE
+                    + SEND_POLICY_TRANSPORT_BYTES;
+
+    m_BytesPerSec = rtdmXmlData->sample_size * SAMPLES_PER_SEC;
+    m_LatencyMs = 0;
+    m_LastFlushMs = 0;
+    m_IntervalMs = ChooseInterval ();
+}
+
+BOOL SendPolicyEnabled (void)
+{
+    return m_PolicyEnabled;
+}
+
+/*******************************************************************************************
+ *
+ *   Procedure Name : SendIntervalElapsed
+ *
+ *   Functional Description : Called every cycle from OutputStream() in place of the
+ *   maxTimeBeforeSendMs check. Pick up the latest latency and choose the interval.
+ *
+ *   Parameters : interface, buffer - the buffer being filled, currentTime
+ *
+ *   Returned :  TRUE if the oldest sample in the buffer has waited the chosen interval
+ *
+ ******************************************************************************************/
+BOOL SendIntervalElapsed (TYPE_RTDM_STREAM_IF *interface, StreamBufferStr *buffer,
+                RTDMTimeStr *currentTime)
+{
+    const RTDM_Struct *firstSample = NULL;
+    UINT32 nowMs = TimeMsecs (currentTime);
+    UINT32 firstMs = 0;
+    UINT32 latencyMs = 0;
+    BOOL elapsed = FALSE;
+
+    latencyMs = interface->RTDMShaperDelayMs + (interface->RTDMSendLatencyUs / 1000);
+    m_LatencyMs = m_LatencyMs - (m_LatencyMs >> SEND_POLICY_AVERAGE_SHIFT)
+                    + (latencyMs >> SEND_POLICY_AVERAGE_SHIFT);
+
+    m_IntervalMs = ChooseInterval ();
+
+    if (buffer->SampleCount != 0)
+    {
+        firstSample = (const RTDM_Struct *) &buffer->Stream->IBufferArray[0];
+        firstMs = (firstSample->TimeStamp.seconds * 1000) + firstSample->TimeStamp.msecs;
+        elapsed = ((nowMs - firstMs) >= m_IntervalMs);
+    }
+    else if (m_LastFlushMs != 0)
+    {
+        /* Nothing to hold back, only keep the stream alive */
+        elapsed = ((nowMs - m_LastFlushMs) >= m_MaxIntervalMs);
+    }
+
+    interface->RTDMSendIntervalMs = m_IntervalMs;
+    interface->RTDMSampleBytesPerSec = m_BytesPerSec;
+
+    return elapsed;
+}
+
+/*******************************************************************************************
+ *
+ *   Procedure Name : SendPolicyFlushed
+ *
+ *   Functional Description : Called when a buffer is finished; fold its byte rate into the
+ *   average
+ *
+ *   Parameters : buffer - the buffer just finished, currentTime
+ *
+ *   Returned :  None
+ *
+ ******************************************************************************************/
+void SendPolicyFlushed (StreamBufferStr *buffer, RTDMTimeStr *currentTime)
+{
+    UINT32 nowMs = TimeMsecs (currentTime);
+    UINT32 elapsedMs = nowMs - m_LastFlushMs;
+    UINT32 bytesPerSec = 0;
+
+    if ((m_LastFlushMs != 0) && (elapsedMs != 0))
+    {
+        bytesPerSec = (buffer->ByteCount * 1000) / elapsedMs;
+        m_BytesPerSec = m_BytesPerSec - (m_BytesPerSec >> SEND_POLICY_AVERAGE_SHIFT)
+                        + (bytesPerSec >> SEND_POLICY_AVERAGE_SHIFT);
+    }
+
+    m_LastFlushMs = nowMs;
+}
+
+/* Shortest interval within the overhead target, clamped to the bounds */
+static UINT32 ChooseInterval (void)
+{
+    UINT32 intervalMs = m_MaxIntervalMs;
+    UINT32 upperMs = m_MinIntervalMs;
+
+    /* H / (H + R * T) <= p  gives  T >= H * (1 - p) / (p * R) */
+    if (m_BytesPerSec != 0)
+    {
+        intervalMs = (m_OverheadBytes * (1000 - SEND_POLICY_OVERHEAD_PERMILLE) * 1000)
+                        / (SEND_POLICY_OVERHEAD_PERMILLE * m_BytesPerSec);
+    }
+
+    /* Leave room for the time spent getting the message out */
+    if (m_MaxIntervalMs > (m_MinIntervalMs + m_LatencyMs))
+    {
+        upperMs = m_MaxIntervalMs - m_LatencyMs;
+    }
+
+    if (intervalMs > upperMs)
+    {
+        intervalMs = upperMs;
+    }
+    if (intervalMs < m_MinIntervalMs)
+    {
+        intervalMs = m_MinIntervalMs;
+    }
+
+    return intervalMs;
+}
+
+/* Wraps about every 49 days, only differences are used */
+static UINT32 TimeMsecs (RTDMTimeStr *time)
+{
+    return (time->seconds * 1000) + (time->nanoseconds / 1000000);
+}
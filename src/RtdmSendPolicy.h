@@ -0,0 +1,46 @@
+/*
+ * RtdmSendPolicy.h
+ *
+ *  Interface of RtdmSendPolicy.c: adaptive choice of when a stream buffer is sent.
+ */
+
+#ifndef RTDMSENDPOLICY_H_
+#define RTDMSENDPOLICY_H_
+
+/*******************************************************************
+ *
+ *     C  O  N  S  T  A  N  T  S
+ *
+ *******************************************************************/
+
+/*******************************************************************
+ *
+ *     E  N  U  M  S
+ *
+ *******************************************************************/
+
+/*******************************************************************
+ *
+ *    S  T  R  U  C  T  S
+ *
+ *******************************************************************/
+
+/*******************************************************************
+ *
+ *    E  X  T  E  R  N      V  A  R  I  A  B  L  E  S
+ *
+ *******************************************************************/
+
+/*******************************************************************
+ *
+ *    E  X  T  E  R  N      F  U  N  C  T  I  O  N  S
+ *
+ *******************************************************************/
+
+void InitializeSendPolicy (RtdmXmlStr *rtdmXmlData);
+BOOL SendPolicyEnabled (void);
+BOOL SendIntervalElapsed (TYPE_RTDM_STREAM_IF *interface, StreamBufferStr *buffer,
+                RTDMTimeStr *currentTime);
+void SendPolicyFlushed (StreamBufferStr *buffer, RTDMTimeStr *currentTime);
+
+#endif /* RTDMSENDPOLICY_H_ */
@@ -0,0 +1,412 @@
+/****************************************************************************************************************
+ * PROJECT    : BART
+ *
+ * MODULE     : RtdmSender.c
+ *
+ * DESCRIPTON : 	Sends completed stream buffers from a dedicated thread so the transport (MDComAPI_putMsgQ
+ *	on the target, see RtdmTransport.c) does not run inside the 50 msec cycle.
+ *
+ *	Every destination in the .xml file has its own transport channel, sender thread and pair of
+ *	single producer / single consumer queues:
+ *	   send queue - task to sender, buffers ready to go out
+ *	   done queue - sender to task, buffers the transport has finished with
+ *
+ *	A stream buffer is not copied per destination. It is queued to every destination and carries a
+ *	reference count; the last destination to hand it back through its done queue returns it to the
+ *	pool. A destination whose send queue already holds DESTINATION_QUEUE_LIMIT buffers is skipped for
+ *	that message, so a slow or stalled receiver can not hold up the others or exhaust the pool.
+ *
+ *	The sender threads only call the transport and record the result, latency and transport totals
+ *	for their own destination. Everything else - reference counts, releasing buffers to the pool,
+ *	RTDM_Send_Counter, error reporting and the statistics - is done by the task in ServiceSender(),
+ *	so the pool and the interface are only ever touched from one thread. If a thread can not be
+ *	started, that destination is sent synchronously from QueueStreamForSend() and still completes
+ *	through its done queue.
+ *
+ * FUNCTIONS:
+ *	void InitializeSender (RtdmXmlStr *rtdmXmlData)
+ *	UINT16 QueueStreamForSend (StreamBufferStr *buffer, UINT32 messageSize, UINT16 destinationMask)
+ *	void ServiceSender (TYPE_RTDM_STREAM_IF *interface, UINT16 *errorCode)
+ *
+ *	A message the primary destination (OutputStreamCfg, the MDS) refused or skipped is handed to the
+ *	backlog (RtdmBacklog.c). The other destinations are best effort.
+ *
+ * OUTPUTS:
+ *	RTDM_Send_Counter - Number of stream messages sent to the primary destination
+ *	RTDMSendQueueDepth - Buffers waiting in the primary send queue
+ *	RTDMSendQueueMax - Largest primary send queue depth seen
+ *	RTDMSendLatencyUs - Queued to sent time of the last primary message
+ *	RTDMSendMaxLatencyUs - Worst case queued to sent time, primary destination
+ *	RTDMTransportBytesPerSec - Bytes sent by the primary transport in the last second
+ *	RTDMTransportMsgsPerSec - Messages sent by the primary transport in the last second
+ *	RTDMTransportSendUs - Time spent in the primary transport for the last message
+ *	RTDMTransportMaxSendUs - Worst case time spent in the primary transport
+ *	RTDMDestinationCount - Number of destinations
+ *	RTDMDestinationDropCount - Messages skipped, all destinations
+ *
+ **********************************************************************************************************************/
+
+#ifndef TEST_ON_PC
+#include "global_mwt.h"
+#include "rts_api.h"
+#include "../include/iptcom.h"
+#else
+#include "MyTypes.h"
+#include "MyFuncs.h"
+#endif
+
+#include <string.h>
+#include <stdlib.h>
+
+#include "RTDM_Stream_ext.h"
+#include "RtdmStream.h"
+#include "RtdmBufferPool.h"
+#include "RtdmQueue.h"
+#include "RtdmSender.h"
+#include "RtdmBacklog.h"
+#include "RtdmTransport.h"
+
+/*******************************************************************
+ *
+ *     C  O  N  S  T  A  N  T  S
+ *
+ *******************************************************************/
+/* Sender thread polls the send queue at this interval when it is empty */
+#define SENDER_IDLE_MSECS           5
+
+/* Below the 50 msec task so a slow transport never delays sampling */
+#define SENDER_PRIORITY             20
+#define SENDER_STACK_SIZE           (16 * 1024)
+
+/* Buffers a destination may have outstanding before it is skipped */
+#define DESTINATION_QUEUE_LIMIT     2
+
+/* The primary destination, OutputStreamCfg */
+#define PRIMARY                     0
+
+/*******************************************************************
+ *
+ *    S  T  R  U  C  T  S
+ *
+ *******************************************************************/
+typedef struct
+{
+    TransportChannelStr Channel;
+    QueueStr SendQueue;
+    QueueStr DoneQueue;
+    BOOL ThreadRunning; /* otherwise send synchronously */
+    UINT16 Result[STREAM_BUFFER_COUNT]; /* NO_ERROR or SEND_MSG_FAILED per pool buffer, set by the sender */
+    UINT32 LatencyUs[STREAM_BUFFER_COUNT]; /* queued to sent per pool buffer, set by the sender [usec] */
+    TransportStatsStr Stats[STREAM_BUFFER_COUNT]; /* totals after the send per pool buffer, by the sender */
+    TransportStatsStr LastStats; /* totals of the latest buffer back through the done queue */
+    UINT32 SendCounter; /* messages sent */
+    UINT32 Drops; /* messages skipped because the send queue was full */
+    UINT32 QueueMax;
+    UINT32 MaxLatencyUs;
+} DestinationStr;
+
+/*******************************************************************
+ *
+ *    S  T  A  T  I  C      F  U  N  C  T  I  O  N  S
+ *
+ *******************************************************************/
+static void SenderThread0 (void);
+static void SenderThread1 (void);
+static void SenderThread2 (void);
+static void SenderThread3 (void);
+static void SenderLoop (DestinationStr *destination);
+static void SendStreamOverNetwork (DestinationStr *destination, StreamBufferStr *buffer);
+
+/*******************************************************************
+ *
+ *    S  T  A  T  I  C      V  A  R  I  A  B  L  E  S
+ *
+ *******************************************************************/
+static DestinationStr m_Destinations[MAX_DESTINATIONS];
+static UINT16 m_DestinationCount = 0;
+
+/* os_t_spawn() takes no argument, one entry point per destination */
+static void (* const m_SenderThreads[MAX_DESTINATIONS]) (void) =
+{ SenderThread0, SenderThread1, SenderThread2, SenderThread3 };
+
+/* Transport totals at the start of the current one second window, primary destination */
+static TransportStatsStr m_RateStartStats;
+static UINT32 m_RateStartSec = 0;
+
+/*******************************************************************************************
+ *
+ *   Procedure Name : InitializeSender
+ *
+ *   Functional Description : Open a channel for every destination, empty the queues and start
+ *   the sender threads
+ *
+ *   Parameters : rtdmXmlData
+ *
+ *   Returned :  None
+ *
+ ******************************************************************************************/
+void InitializeSender (RtdmXmlStr *rtdmXmlData)
+{
+    RtdmDestinationStr *config = NULL;
+    DestinationStr *destination = NULL;
+    char threadName[16];
+    UINT16 d = 0;
+
+    memset (m_Destinations, 0, sizeof(m_Destinations));
+
+    m_DestinationCount = rtdmXmlData->destination_count;
+    if ((m_DestinationCount == 0) || (m_DestinationCount > MAX_DESTINATIONS))
+    {
+        m_DestinationCount = 1;
+    }
+
+    for (d = 0; d < m_DestinationCount; d++)
+    {
+        config = &rtdmXmlData->destination[d];
+        destination = &m_Destinations[d];
+
+        if (OpenTransport (&destination->Channel, config->transportType,
+                        config->transportAddress, config->comId, config->uri,
+                        config->transportMtu) != NO_ERROR)
+        {
+            printf ("Destination %d transport %s could not be opened\n", d,
+                            GetTransportName (&destination->Channel));
+        }
+
+        QueueInitialize (&destination->SendQueue);
+        QueueInitialize (&destination->DoneQueue);
+
+        sprintf (threadName, "RtdmSend%d", d);
+        if (os_t_spawn (threadName, SENDER_PRIORITY, SENDER_STACK_SIZE, m_SenderThreads[d]) == OK)
+        {
+            destination->ThreadRunning = TRUE;
+        }
+        else
+        {
+            printf ("Sender thread %d not started, streams are sent synchronously\n", d);
+            destination->ThreadRunning = FALSE;
+        }
+    }
+
+    m_RateStartStats = m_Destinations[PRIMARY].LastStats;
+}
+
+/*******************************************************************************************
+ *
+ *   Procedure Name : QueueStreamForSend
+ *
+ *   Functional Description : Hand a finished stream buffer to the destinations in
+ *   destinationMask. The buffer belongs to the sender until the last of them has handed it
+ *   back through ServiceSender(). A destination whose queue is full is skipped; for the primary
+ *   destination the message goes to the backlog instead.
+ *
+ *   Parameters : buffer, messageSize - number of bytes of buffer->Stream to send,
+ *                destinationMask - bit 0 is the primary destination, ALL_DESTINATIONS for all
+ *
+ *   Returned :  NO_ERROR, or SEND_MSG_FAILED if no destination took the buffer (it is released)
+ *
+ ******************************************************************************************/
+UINT16 QueueStreamForSend (StreamBufferStr *buffer, UINT32 messageSize, UINT16 destinationMask)
+{
+    DestinationStr *destination = NULL;
+    UINT16 d = 0;
+
+    buffer->MessageSize = messageSize;
+    buffer->RefCount = 0;
+    os_c_get (&buffer->QueuedTime);
+
+    for (d = 0; d < m_DestinationCount; d++)
+    {
+        if ((destinationMask & (1 << d)) == 0)
+        {
+            continue;
+        }
+
+        destination = &m_Destinations[d];
+        destination->Result[buffer->Index] = NO_ERROR;
+        destination->LatencyUs[buffer->Index] = 0;
+
+        if (!destination->ThreadRunning)
+        {
+            SendStreamOverNetwork (destination, buffer);
+            buffer->RefCount++;
+            QueuePush (&destination->DoneQueue, buffer);
+            continue;
+        }
+
+        /* The count is only read back by this task, so it can be raised after the push */
+        if ((QueueDepth (&destination->SendQueue) >= DESTINATION_QUEUE_LIMIT)
+                        || !QueuePush (&destination->SendQueue, buffer))
+        {
+            destination->Drops++;
+            if (d == PRIMARY)
+            {
+                StoreBacklogMessage ((UINT8 *) buffer->Stream, messageSize);
+            }
+            continue;
+        }
+        buffer->RefCount++;
+
+        if (QueueDepth (&destination->SendQueue) > destination->QueueMax)
+        {
+            destination->QueueMax = QueueDepth (&destination->SendQueue);
+        }
+    }
+
+    if (buffer->RefCount == 0)
+    {
+        ReleaseStreamBuffer (buffer);
+        return SEND_MSG_FAILED;
+    }
+
+    return NO_ERROR;
+}
+
+/*******************************************************************************************
+ *
+ *   Procedure Name : ServiceSender
+ *
+ *   Functional Description : Called every cycle from RTDM_Stream(). Collect the buffers the
+ *   senders have finished with, return each to the pool when its last destination is done and
+ *   publish the send results.
+ *
+ *   Parameters : interface, errorCode - set to SEND_MSG_FAILED if a primary send failed and no
+ *                other error is pending
+ *
+ *   Returned :  None
+ *
+ ******************************************************************************************/
+void ServiceSender (TYPE_RTDM_STREAM_IF *interface, UINT16 *errorCode)
+{
+    DestinationStr *destination = NULL;
+    StreamBufferStr *buffer = NULL;
+    TransportStatsStr stats;
+    OS_STR_TIME_POSIX now;
+    UINT32 drops = 0;
+    UINT16 d = 0;
+
+    for (d = 0; d < m_DestinationCount; d++)
+    {
+        destination = &m_Destinations[d];
+
+        while ((buffer = (StreamBufferStr *) QueuePop (&destination->DoneQueue)) != NULL)
+        {
+            /* Buffers come back in the order they were sent, the last one has the latest totals */
+            destination->LastStats = destination->Stats[buffer->Index];
+
+            if (destination->Result[buffer->Index] == NO_ERROR)
+            {
+                destination->SendCounter++;
+            }
+            else if (d == PRIMARY)
+            {
+                /* Refused by the transport, keep it for a later attempt */
+                StoreBacklogMessage ((UINT8 *) buffer->Stream, buffer->MessageSize);
+
+                if (*errorCode == NO_ERROR)
+                {
+                    *errorCode = destination->Result[buffer->Index];
+                }
+            }
+
+            if (d == PRIMARY)
+            {
+                interface->RTDMSendLatencyUs = destination->LatencyUs[buffer->Index];
+            }
+            if (destination->LatencyUs[buffer->Index] > destination->MaxLatencyUs)
+            {
+                destination->MaxLatencyUs = destination->LatencyUs[buffer->Index];
+            }
+
+            buffer->RefCount--;
+            if (buffer->RefCount == 0)
+            {
+                ReleaseStreamBuffer (buffer);
+            }
+        }
+
+        drops += destination->Drops;
+    }
+
+    destination = &m_Destinations[PRIMARY];
+    interface->RTDM_Send_Counter = destination->SendCounter;
+    interface->RTDMSendQueueDepth = (UINT16) QueueDepth (&destination->SendQueue);
+    interface->RTDMSendQueueMax = (UINT16) destination->QueueMax;
+    interface->RTDMSendMaxLatencyUs = destination->MaxLatencyUs;
+    interface->RTDMDestinationCount = m_DestinationCount;
+    interface->RTDMDestinationDropCount = drops;
+
+    /* Transport rates over whole seconds, from totals taken by the sender right after a send */
+    stats = destination->LastStats;
+    os_c_get (&now);
+    if (now.sec != m_RateStartSec)
+    {
+        if (m_RateStartSec != 0)
+        {
+            interface->RTDMTransportBytesPerSec = (stats.Bytes - m_RateStartStats.Bytes)
+                            / (now.sec - m_RateStartSec);
+            interface->RTDMTransportMsgsPerSec = (stats.Messages - m_RateStartStats.Messages)
+                            / (now.sec - m_RateStartSec);
+        }
+        m_RateStartStats = stats;
+        m_RateStartSec = now.sec;
+    }
+    interface->RTDMTransportSendUs = stats.LastSendUs;
+    interface->RTDMTransportMaxSendUs = stats.MaxSendUs;
+}
+
+static void SenderThread0 (void)
+{
+    SenderLoop (&m_Destinations[0]);
+}
+
+static void SenderThread1 (void)
+{
+    SenderLoop (&m_Destinations[1]);
+}
+
+static void SenderThread2 (void)
+{
+    SenderLoop (&m_Destinations[2]);
+}
+
+static void SenderThread3 (void)
+{
+    SenderLoop (&m_Destinations[3]);
+}
+
+/* Sender thread body, never returns */
+static void SenderLoop (DestinationStr *destination)
+{
+    StreamBufferStr *buffer = NULL;
+
+    while (TRUE)
+    {
+        buffer = (StreamBufferStr *) QueuePop (&destination->SendQueue);
+        if (buffer == NULL)
+        {
+            os_t_delay (SENDER_IDLE_MSECS);
+            continue;
+        }
+
+        SendStreamOverNetwork (destination, buffer);
+
+        /* Can not fail, there are fewer buffers than queue slots */
+        QueuePush (&destination->DoneQueue, buffer);
+    }
+}
+
+static void SendStreamOverNetwork (DestinationStr *destination, StreamBufferStr *buffer)
+{
+    OS_STR_TIME_POSIX sentTime;
+
+    destination->Result[buffer->Index] = TransportSend (&destination->Channel,
+                    (const UINT8 *) buffer->Stream, buffer->MessageSize);
+
+    /* Read on the sending thread, so Bytes and Messages belong to the same send; the task gets
+     * the copy through the done queue */
+    GetTransportStats (&destination->Channel, &destination->Stats[buffer->Index]);
+
+    os_c_get (&sentTime);
+    destination->LatencyUs[buffer->Index] = ElapsedUsecs (&buffer->QueuedTime, &sentTime);
+}
@@ -0,0 +1,47 @@
+/*
+ * RtdmSender.h
+ *
+ *  Interface of RtdmSender.c: sender thread for completed stream buffers.
+ */
+
+#ifndef RTDMSENDER_H_
+#define RTDMSENDER_H_
+
+/*******************************************************************
+ *
+ *     C  O  N  S  T  A  N  T  S
+ *
+ *******************************************************************/
+/* destinationMask values for QueueStreamForSend() */
+#define PRIMARY_DESTINATION         0x0001
+#define ALL_DESTINATIONS            0xFFFF
+
+/*******************************************************************
+ *
+ *     E  N  U  M  S
+ *
+ *******************************************************************/
+
+/*******************************************************************
+ *
+ *    S  T  R  U  C  T  S
+ *
+ *******************************************************************/
+
+/*******************************************************************
+ *
+ *    E  X  T  E  R  N      V  A  R  I  A  B  L  E  S
+ *
+ *******************************************************************/
+
+/*******************************************************************
+ *
+ *    E  X  T  E  R  N      F  U  N  C  T  I  O  N  S
+ *
+ *******************************************************************/
+
+void InitializeSender (RtdmXmlStr *rtdmXmlData);
+UINT16 QueueStreamForSend (StreamBufferStr *buffer, UINT32 messageSize, UINT16 destinationMask);
+void ServiceSender (TYPE_RTDM_STREAM_IF *interface, UINT16 *errorCode);
+
+#endif /* RTDMSENDER_H_ */
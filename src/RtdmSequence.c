@@ -0,0 +1,155 @@
+/****************************************************************************************************************
+ * PROJECT    : BART
+ *
+ * MODULE     : RtdmSequence.c
+ *
+ * DESCRIPTON : 	Stream sequence number, carried in the STRM header extension (STRM_Header_Ext_Struct).
+ *
+ *	Every stream message built gets the next number, so a receiver can tell a lost message from an
+ *	idle period. The number survives a restart: it is kept in StreamSequence.dat, rewritten for every
+ *	message. The file holds two copies, written alternately and each with its own checksum, so a power
+ *	loss during a write leaves the other copy intact. On start up the higher valid copy is used.
+ *
+ *	Sequence numbers start at 1; 0 is never sent.
+ *
+ * FUNCTIONS:
+ *	void InitializeStreamSequence (void)
+ *	UINT32 NextStreamSequence (void)
+ *
+ **********************************************************************************************************************/
+
+#ifndef TEST_ON_PC
+#include "global_mwt.h"
+#include "rts_api.h"
+#else
+#include "MyTypes.h"
+#include "MyFuncs.h"
+#endif
+
+#include <stdio.h>
+#include <string.h>
+
+#include "RTDM_Stream_ext.h"
+#include "RtdmSequence.h"
+
+/*******************************************************************
+ *
+ *     C  O  N  S  T  A  N  T  S
+ *
+ *******************************************************************/
+#define SEQUENCE_FILE               "StreamSequence.dat"
+
+/*******************************************************************
+ *
+ *    S  T  R  U  C  T  S
+ *
+ *******************************************************************/
+typedef struct
+{
+    char Delimiter[4]; /* "SEQN" */
+    uint32_t Sequence __attribute__ ((packed));
+    uint32_t Checksum __attribute__ ((packed)); /* CRC-32 of Sequence */
+} SequenceRecordStr;
+
+/*******************************************************************
+ *
+ *    S  T  A  T  I  C      F  U  N  C  T  I  O  N  S
+ *
+ *******************************************************************/
+static BOOL RecordValid (const SequenceRecordStr *record);
+static void WriteRecord (void);
+
+/*******************************************************************
+ *
+ *    S  T  A  T  I  C      V  A  R  I  A  B  L  E  S
+ *
+ *******************************************************************/
+static FILE *m_SequenceFilePtr = NULL;
+
+/* Last number handed out */
+static UINT32 m_Sequence = 0;
+
+/*******************************************************************************************
+ *
+ *   Procedure Name : InitializeStreamSequence
+ *
+ *   Functional Description : Continue from the number stored before the restart, or from 0
+ *   if there is no valid copy
+ *
+ *   Parameters : None
+ *
+ *   Returned :  None
+ *
+ ******************************************************************************************/
+void InitializeStreamSequence (void)
+{
+    SequenceRecordStr record[2];
+
+    m_Sequence = 0;
+    memset (record, 0, sizeof(record));
+
+    if (os_io_fopen (SEQUENCE_FILE, "rb+", &m_SequenceFilePtr) != ERROR)
+    {
+        if (fread (record, 1, sizeof(record), m_SequenceFilePtr) == sizeof(record))
+        {
+            if (RecordValid (&record[0]))
+            {
+                m_Sequence = record[0].Sequence;
+            }
+            if (RecordValid (&record[1]) && (record[1].Sequence > m_Sequence))
+            {
+                m_Sequence = record[1].Sequence;
+            }
+        }
+        return;
+    }
+
+    if (os_io_fopen (SEQUENCE_FILE, "wb+", &m_SequenceFilePtr) == ERROR)
+    {
+        printf ("Stream sequence file could not be created, numbers restart after power up\n");
+        m_SequenceFilePtr = NULL;
+    }
+}
+
+/* Number for the next stream message, stored before it is returned */
+UINT32 NextStreamSequence (void)
+{
+    m_Sequence++;
+
+    /* 0 means no number, skip it on wrap around */
+    if (m_Sequence == 0)
+    {
+        m_Sequence = 1;
+    }
+
+    WriteRecord ();
+
+    return m_Sequence;
+}
+
+static BOOL RecordValid (const SequenceRecordStr *record)
+{
+    return (memcmp (record->Delimiter, "SEQN", sizeof(record->Delimiter)) == 0)
+                    && (record->Checksum
+                                    == crc32 (0, (const unsigned char *) &record->Sequence,
+                                                    sizeof(record->Sequence)));
+}
+
+/* Odd numbers go to the second copy, even numbers to the first */
+static void WriteRecord (void)
+{
+    SequenceRecordStr record;
+
+    if (m_SequenceFilePtr == NULL)
+    {
+        return;
+    }
+
+    memcpy (record.Delimiter, "SEQN", sizeof(record.Delimiter));
+    record.Sequence = m_Sequence;
+    record.Checksum = crc32 (0, (const unsigned char *) &record.Sequence, sizeof(record.Sequence));
+
+    fseek (m_SequenceFilePtr, (long) ((m_Sequence & 1) * sizeof(SequenceRecordStr)), SEEK_SET);
+    fwrite (&record, 1, sizeof(record), m_SequenceFilePtr);
+    fflush (m_SequenceFilePtr);
+}
@@ -0,0 +1,43 @@
+/*
+ * RtdmSequence.h
+ *
+ *  Interface of RtdmSequence.c: stream sequence number carried in the STRM header extension.
+ */
+
+#ifndef RTDMSEQUENCE_H_
+#define RTDMSEQUENCE_H_
+
+/*******************************************************************
+ *
+ *     C  O  N  S  T  A  N  T  S
+ *
+ *******************************************************************/
+
+/*******************************************************************
+ *
+ *     E  N  U  M  S
+ *
+ *******************************************************************/
+
+/*******************************************************************
+ *
+ *    S  T  R  U  C  T  S
+ *
+ *******************************************************************/
+
+/*******************************************************************
+ *
+ *    E  X  T  E  R  N      V  A  R  I  A  B  L  E  S
+ *
+ *******************************************************************/
+
+/*******************************************************************
+ *
+ *    E  X  T  E  R  N      F  U  N  C  T  I  O  N  S
+ *
+ *******************************************************************/
+
+void InitializeStreamSequence (void);
+UINT32 NextStreamSequence (void);
+
+#endif /* RTDMSEQUENCE_H_ */
@@ -0,0 +1,290 @@
+/****************************************************************************************************************
+ * PROJECT    : BART
+ *
+ * MODULE     : RtdmShaper.c
+ *
+ * DESCRIPTON : 	Token bucket shaper between the stream buffers and the sender.
+ *
+ *	Every car of a consist runs the same configuration from the same start, so their stream buffers
+ *	fill at the same moment and all cars put a full message on the train backbone together. The
+ *	shaper smooths this in two ways, both set with optional OutputStreamCfg attributes:
+ *	   shaperBytesPerSec - token bucket rate, a message is released once the bucket holds its size
+ *	   shaperBurstBytes  - bucket depth, defaults to bufferSize (one full message)
+ *	   shaperPhaseMs     - every message is held for (car number % SHAPER_PHASE_SLOTS) * shaperPhaseMs
+ *	                       so the cars of a consist send one after the other
+ *
+ *	The car number is taken from the digits of VNC_CarData_X_CarID. A message larger than the bucket
+ *	is released when the bucket is full and leaves it in debt, so any size eventually goes out.
+ *	With neither rate nor phase configured the shaper is bypassed.
+ *
+ *	Messages wait in arrival order while they hold their stream buffer, so a rate that is too low for
+ *	the configured stream shows up as dropped samples (RTDMStreamDropCount) once the pool runs out.
+ *	The shaper runs entirely in the 50 msec task.
+ *
+ * FUNCTIONS:
+ *	void InitializeShaper (RtdmXmlStr *rtdmXmlData)
+ *	UINT16 ShapeStreamForSend (StreamBufferStr *buffer, UINT32 messageSize, UINT16 destinationMask)
+ *	void ServiceShaper (TYPE_RTDM_STREAM_IF *interface, UINT16 *errorCode)
+ *
+ * OUTPUTS:
+ *	RTDMShaperQueueDepth - Messages waiting in the shaper
+ *	RTDMShaperDelayMs - Time the last released message waited in the shaper
+ *	RTDMShaperMaxDelayMs - Worst case time a message waited in the shaper
+ *	RTDMShaperPhaseMs - Hold time of this car
+ *
+ **********************************************************************************************************************/
+
+#ifndef TEST_ON_PC
+#include "global_mwt.h"
+#include "rts_api.h"
+#else
+#include "MyTypes.h"
+#include "MyFuncs.h"
+#endif
+
+#include <string.h>
+
+#include "RTDM_Stream_ext.h"
+#include "RtdmStream.h"
+#include "RtdmBufferPool.h"
+#include "RtdmQueue.h"
+#include "RtdmSender.h"
+#include "RtdmShaper.h"
+
+/*******************************************************************
+ *
+ *     C  O  N  S  T  A  N  T  S
+ *
+ *******************************************************************/
+/* Cars per consist the phase offsets are spread over */
+#define SHAPER_PHASE_SLOTS          10
+
+/* Refill is capped so a long gap between calls can not overflow the arithmetic */
+#define SHAPER_MAX_REFILL_MS        1000
+
+/*******************************************************************
+ *
+ *    S  T  A  T  I  C      F  U  N  C  T  I  O  N  S
+ *
+ *******************************************************************/
+static void RefillTokens (UINT32 nowMs);
+static UINT32 CarPhaseMs (TYPE_RTDM_STREAM_IF *interface);
+
+/*******************************************************************
+ *
+ *    S  T  A  T  I  C      V  A  R  I  A  B  L  E  S
+ *
+ *******************************************************************/
+/* Shaped messages in arrival order, only touched by the task */
+static QueueStr m_ShaperQueue;
+
+static BOOL m_ShaperEnabled = FALSE;
+
+/* Bytes per second and bucket depth from .xml */
+static UINT32 m_RateBytesPerSec = 0;
+static INT32 m_BurstBytes = 0;
+static UINT32 m_PhaseStepMs = 0;
+
+/* Bucket level; negative after a message larger than the bucket */
+static INT32 m_Tokens = 0;
+static UINT32 m_LastRefillMs = 0;
+
+/* Per pool buffer, indexed by StreamBufferStr.Index */
+static UINT32 m_MessageSize[STREAM_BUFFER_COUNT];
+static UINT16 m_DestinationMask[STREAM_BUFFER_COUNT];
+static UINT32 m_QueuedMs[STREAM_BUFFER_COUNT];
+
+static UINT32 m_MaxDelayMs = 0;
+
+/*******************************************************************************************
+ *
+ *   Procedure Name : InitializeShaper
+ *
+ *   Functional Description : Read the shaper settings, start with a full bucket
+ *
+ *   Parameters : rtdmXmlData
+ *
+ *   Returned :  None
+ *
+ ******************************************************************************************/
+void InitializeShaper (RtdmXmlStr *rtdmXmlData)
+{
+    QueueInitialize (&m_ShaperQueue);
+
+    m_RateBytesPerSec = rtdmXmlData->shaperBytesPerSec;
+    m_PhaseStepMs = rtdmXmlData->shaperPhaseMs;
+
+    m_BurstBytes = (INT32) rtdmXmlData->shaperBurstBytes;
+    if (m_BurstBytes <= 0)
+    {
+        m_BurstBytes = rtdmXmlData->bufferSize;
+    }
+
+    m_ShaperEnabled = (m_RateBytesPerSec != 0) || (m_PhaseStepMs != 0);
+
+    m_Tokens = m_BurstBytes;
+    m_LastRefillMs = NowMsecs ();
+    m_MaxDelayMs = 0;
+}
+
+/*******************************************************************************************
+ *
+ *   Procedure Name : ShapeStreamForSend
+ *
+ *   Functional Description : Queue a finished stream buffer behind the shaper. Same contract
+ *   as QueueStreamForSend(), which is called directly when the shaper is off.
+ *
+ *   Parameters : buffer, messageSize, destinationMask
+ *
+ *   Returned :  NO_ERROR or SEND_MSG_FAILED
+ *
+ ******************************************************************************************/
+UINT16 ShapeStreamForSend (StreamBufferStr *buffer, UINT32 messageSize, UINT16 destinationMask)
+{
+    if (!m_ShaperEnabled)
+    {
+        return QueueStreamForSend (buffer, messageSize, destinationMask);
+    }
+
+    m_MessageSize[buffer->Index] = messageSize;
+    m_DestinationMask[buffer->Index] = destinationMask;
+    m_QueuedMs[buffer->Index] = NowMsecs ();
+
+    /* Can not fail, there are fewer buffers than queue slots */
+    QueuePush (&m_ShaperQueue, buffer);
+
+    return NO_ERROR;
+}
+
+/*******************************************************************************************
+ *
+ *   Procedure Name : ServiceShaper
+ *
+ *   Functional Description : Called every cycle from RTDM_Stream() before ServiceSender().
+ *   Refill the bucket and release the messages that have waited their phase and are covered
+ *   by tokens.
+ *
+ *   Parameters : interface, errorCode - set if the sender refused a message and no other
+ *                error is pending
+ *
+ *   Returned :  None
+ *
+ ******************************************************************************************/
+void ServiceShaper (TYPE_RTDM_STREAM_IF *interface, UINT16 *errorCode)
+{
+    StreamBufferStr *buffer = NULL;
+    UINT32 nowMs = 0;
+    UINT32 phaseMs = 0;
+    UINT32 waitedMs = 0;
+    INT32 needed = 0;
+    UINT16 result = NO_ERROR;
+
+    phaseMs = CarPhaseMs (interface);
+    interface->RTDMShaperPhaseMs = phaseMs;
+
+    if (!m_ShaperEnabled)
+    {
+        return;
+    }
+
+    nowMs = NowMsecs ();
+    RefillTokens (nowMs);
+
+    while ((buffer = (StreamBufferStr *) QueuePeek (&m_ShaperQueue)) != NULL)
+    {
+        waitedMs = nowMs - m_QueuedMs[buffer->Index];
+        if (waitedMs < phaseMs)
+        {
+            break;
+        }
+
+        if (m_RateBytesPerSec != 0)
+        {
+            /* A message larger than the bucket needs a full bucket */
+            needed = (INT32) m_MessageSize[buffer->Index];
+            if (needed > m_BurstBytes)
+            {
+                needed = m_BurstBytes;
+            }
+
+            if (m_Tokens < needed)
+            {
+                break;
+            }
+
+            m_Tokens -= (INT32) m_MessageSize[buffer->Index];
+        }
+
+        QueuePop (&m_ShaperQueue);
+
+        interface->RTDMShaperDelayMs = waitedMs;
+        if (waitedMs > m_MaxDelayMs)
+        {
+            m_MaxDelayMs = waitedMs;
+        }
+
+        result = QueueStreamForSend (buffer, m_MessageSize[buffer->Index],
+                        m_DestinationMask[buffer->Index]);
+        if ((result != NO_ERROR) && (*errorCode == NO_ERROR))
+        {
+            *errorCode = result;
+        }
+    }
+
+    interface->RTDMShaperQueueDepth = (UINT16) QueueDepth (&m_ShaperQueue);
+    interface->RTDMShaperMaxDelayMs = m_MaxDelayMs;
+}
+
+/* Add the tokens earned since the last call, up to the bucket depth */
+static void RefillTokens (UINT32 nowMs)
+{
+    UINT32 elapsedMs = nowMs - m_LastRefillMs;
+    UINT32 earned = 0;
+
+    if (elapsedMs == 0)
+    {
+        return;
+    }
+    m_LastRefillMs = nowMs;
+
+    if (elapsedMs > SHAPER_MAX_REFILL_MS)
+    {
+        elapsedMs = SHAPER_MAX_REFILL_MS;
+    }
+
+    /* Split so rate * elapsed can not overflow 32 bits */
+    earned = ((m_RateBytesPerSec / 1000) * elapsedMs)
+                    + (((m_RateBytesPerSec % 1000) * elapsedMs) / 1000);
+
+    if ((INT32) earned >= (m_BurstBytes - m_Tokens))
+    {
+        m_Tokens = m_BurstBytes;
+    }
+    else
+    {
+        m_Tokens += (INT32) earned;
+    }
+}
+
+/* Hold time of this car, from the digits of the car ID (e.g. "A2531" is car 2531) */
+static UINT32 CarPhaseMs (TYPE_RTDM_STREAM_IF *interface)
+{
+    const char *carId = (const char *) interface->VNC_CarData_X_CarID;
+    UINT32 carNumber = 0;
+    UINT16 i = 0;
+
+    if (m_PhaseStepMs == 0)
+    {
+        return 0;
+    }
+
+    for (i = 0; (i < sizeof(interface->VNC_CarData_X_CarID)) && (carId[i] != '\0'); i++)
+    {
+        if ((carId[i] >= '0') && (carId[i] <= '9'))
+        {
+            carNumber = (carNumber * 10) + (UINT32) (carId[i] - '0');
+        }
+    }
+
+    return (carNumber % SHAPER_PHASE_SLOTS) * m_PhaseStepMs;
+}
@@ -0,0 +1,44 @@
+/*
+ * RtdmShaper.h
+ *
+ *  Interface of RtdmShaper.c: token bucket shaper between the stream buffers and the sender.
+ */
+
+#ifndef RTDMSHAPER_H_
+#define RTDMSHAPER_H_
+
+/*******************************************************************
+ *
+ *     C  O  N  S  T  A  N  T  S
+ *
+ *******************************************************************/
+
+/*******************************************************************
+ *
+ *     E  N  U  M  S
+ *
+ *******************************************************************/
+
+/*******************************************************************
+ *
+ *    S  T  R  U  C  T  S
+ *
+ *******************************************************************/
+
+/*******************************************************************
+ *
+ *    E  X  T  E  R  N      V  A  R  I  A  B  L  E  S
+ *
+ *******************************************************************/
+
+/*******************************************************************
+ *
+ *    E  X  T  E  R  N      F  U  N  C  T  I  O  N  S
+ *
+ *******************************************************************/
+
+void InitializeShaper (RtdmXmlStr *rtdmXmlData);
+UINT16 ShapeStreamForSend (StreamBufferStr *buffer, UINT32 messageSize, UINT16 destinationMask);
+void ServiceShaper (TYPE_RTDM_STREAM_IF *interface, UINT16 *errorCode);
+
+#endif /* RTDMSHAPER_H_ */
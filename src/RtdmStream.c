@@ -58,6 +58,7 @@
  *	void Populate_Stream_Header(UINT32)
  *	int Get_Time(UINT32*,UINT32*)
  *	UINT16 Check_Fault(UINT16)
+ *	INT32 GetSignalValue(const SignalStr*,UINT16)
  *
  * INPUTS:
  *	oPCU_I1
@@ -105,6 +106,16 @@
 #include "RTDM_Stream_ext.h"
 #include "RtdmStream.h"
 #include "Rtdmxml.h"
+#include "RtdmDataLog.h"
+#include "RtdmScrubber.h"
+#include "RtdmBufferPool.h"
+#include "RtdmSender.h"
+#include "RtdmBacklog.h"
+#include "RtdmShaper.h"
+#include "RtdmEvent.h"
+#include "RtdmSequence.h"
+#include "RtdmReplay.h"
+#include "RtdmSendPolicy.h"
 
 /*******************************************************************
  *
@@ -132,10 +143,11 @@
 /* global interface pointer */
 TYPE_RTDM_STREAM_IF *m_Interface1Ptr = NULL;
 
-RTDMStream_str *m_RtdmStreamPtr = NULL;
+/* Stream buffer currently being filled with samples, NULL if the pool was empty */
+static StreamBufferStr *m_StreamBuffer = NULL;
 
-/* # samples */
-static UINT16 m_SampleCount = 0;
+/* Samples discarded because no stream buffer was free */
+static UINT32 m_DroppedSampleCount = 0;
 
 /* Number of streams in RTDM.dan file */
 UINT32 RTDM_Stream_Counter = 0;
@@ -144,6 +156,9 @@ static SignalStr m_RtdmOldSample;
 static RTDM_Struct m_RtdmSampleArray;
 extern STRM_Header_Struct STRM_Header;
 
+/* Header extension of the message being built, follows STRM_Header */
+static STRM_Header_Ext_Struct m_StreamHeaderExt;
+
 /*******************************************************************
  *
  *    S  T  A  T  I  C      F  U  N  C  T  I  O  N  S
@@ -168,7 +183,6 @@ static UINT16 PopulateBufferWithChanges (UINT8 signalBuffer[],
 
 static int GetEpochTime (RTDMTimeStr* currentTime);
 static UINT16 Check_Fault (UINT16 error_code, RTDMTimeStr *currentTime);
-static UINT16 SendStreamOverNetwork (RtdmXmlStr* rtdmXmlData);
 
 /*******************************************************************************************
  *
@@ -189,13 +203,30 @@ void InitializeRtdmStream (RtdmXmlStr *rtdmXmlData)
 
     memset (&m_RtdmOldSample, 0, sizeof(SignalStr));
 
-    /* Allocate memory to store data according to buffer size from .xml file */
-    m_RtdmStreamPtr = (RTDMStream_str *) calloc (
-                    sizeof(UINT16) + STREAM_HEADER_SIZE
-                                    + rtdmXmlData->bufferSize, sizeof(UINT8));
+    /* Allocate all stream buffers according to buffer size from .xml file; nothing
+     * is allocated or freed after this point */
+    if (InitializeBufferPool (rtdmXmlData) != NO_ERROR)
+    {
+        printf ("Stream buffer pool allocation failed\n");
+    }
+
+    /* First buffer to fill */
+    m_StreamBuffer = AcquireStreamBuffer ();
+
+    InitializeSender (rtdmXmlData);
+
+    InitializeSendPolicy (rtdmXmlData);
+
+    InitializeShaper (rtdmXmlData);
+
+    InitializeEvents (rtdmXmlData);
 
-    /* size of buffer read from .xml file plus the size of the variable IBufferSize */
-    m_RtdmStreamPtr->IBufferSize = rtdmXmlData->bufferSize + sizeof(UINT16);
+    /* Stream sequence numbers continue from before the restart */
+    InitializeStreamSequence ();
+
+    InitializeBacklog (rtdmXmlData);
+
+    InitializeReplay (rtdmXmlData);
 
 }
 
@@ -246,11 +277,35 @@ void RTDM_Stream (TYPE_RTDM_STREAM_IF *interface, RtdmXmlStr *rtdmXmlData)
 
     networkAvailable = NetworkAvailable (interface, &errorCode);
 
+    /* Priority signal transitions go out now, ahead of the bulk stream */
+    ServiceEvents (interface, &newSignalData, networkAvailable, rtdmXmlData, &currentTime);
+
     OutputStream (interface, &newSignalData, networkAvailable, &errorCode,
                     rtdmXmlData, &currentTime);
 
+    /* Release shaped messages to the sender as tokens allow */
+    ServiceShaper (interface, &errorCode);
+
+    /* Collect buffers the sender thread has finished with */
+    ServiceSender (interface, &errorCode);
+
+    /* Forward stored messages once the network is back */
+    ServiceBacklog (interface, networkAvailable);
+
+    /* Re-send a requested time range from the data log on the low priority lane */
+    ServiceReplay (interface, networkAvailable, rtdmXmlData);
+
     ProcessDataLog (interface, &newSignalData, rtdmXmlData, &currentTime);
 
+    /* Low priority ring verification, bounded amount of work per cycle */
+    ServiceScrubber (interface, &errorCode);
+
+    /* A data recorder fault is logged when the stream has none of its own */
+    if ((errorCode == NO_ERROR) && (error_code_dan != NO_ERROR))
+    {
+        errorCode = error_code_dan;
+    }
+
     /* Fault Logging */
     result = Check_Fault (errorCode, &currentTime);
 
@@ -287,72 +342,130 @@ static void OutputStream (TYPE_RTDM_STREAM_IF *interface,
     UINT32 mainBufferOffset = 0;
     UINT32 timeDiffSec = 0;
     UINT32 samplesCRC = 0;
+    UINT32 messageSize = 0;
+    BOOL intervalElapsed = FALSE;
     static UINT32 previousSendTimeSec = 0;
 
-    /* IS "networkAvailable" NEEDED ?????????????????? */
-    if (!networkAvailable || !rtdmXmlData->OutputStream_enabled
-                    || (*errorCode != NO_ERROR))
+    /* Keep sampling without the network, finished messages go to the backlog */
+    if (!rtdmXmlData->OutputStream_enabled
+                    || ((*errorCode != NO_ERROR) && (*errorCode != NO_NETWORK)))
     {
         return;
     }
 
+    /* Pick up a buffer again if the pool was empty on a previous cycle */
+    if (m_StreamBuffer == NULL)
+    {
+        m_StreamBuffer = AcquireStreamBuffer ();
+    }
+
     /* Fill m_RtdmSampleArray with samples of data if data changed or the amount of time
      * between captures exceeds the allowed amount */
     if (PopulateSamples (rtdmXmlData, newSignalData, currentTime))
     {
-        /* where to place sample into main buffer */
-        /* i.e. (1 * 98) = iDataBuff[x] */
-        mainBufferOffset = (m_SampleCount * rtdmXmlData->sample_size);
+        if (m_StreamBuffer != NULL)
+        {
+            /* where to place sample into main buffer */
+            /* i.e. (1 * 98) = iDataBuff[x] */
+            mainBufferOffset = (m_StreamBuffer->SampleCount
+                            * rtdmXmlData->sample_size);
 
-        /* Copy current sample into main buffer */
-        memcpy (&m_RtdmStreamPtr->IBufferArray[mainBufferOffset],
-                        &m_RtdmSampleArray, sizeof(RTDM_Struct));
+            /* Copy current sample into main buffer */
+            memcpy (&m_StreamBuffer->Stream->IBufferArray[mainBufferOffset],
+                            &m_RtdmSampleArray, sizeof(RTDM_Struct));
 
-        m_SampleCount++;
+            m_StreamBuffer->SampleCount++;
+            m_StreamBuffer->ByteCount += rtdmXmlData->sample_size;
 
-        interface->RTDMSampleCount = m_SampleCount;
+            interface->RTDMSampleCount = m_StreamBuffer->SampleCount;
 
-        printf ("Sample Populated %d\n", m_SampleCount);
+            printf ("Sample Populated %d\n", m_StreamBuffer->SampleCount);
+        }
+        else
+        {
+            /* Every buffer is still in flight, the sample can not be streamed */
+            m_DroppedSampleCount++;
+            *errorCode = NO_STREAM_BUFFER;
+        }
 
     }
 
     /* Check if its time to stream the data */
     timeDiffSec = currentTime->seconds - previousSendTimeSec;
 
-    /* calculate if maxTimeBeforeSendMs has timed out or the buffer size is large enough to send */
-    if (((m_SampleCount >= rtdmXmlData->max_main_buffer_count)
-                    || (timeDiffSec >= rtdmXmlData->maxTimeBeforeSendMs))
+    /* The adaptive interval, when configured, takes the place of maxTimeBeforeSendMs */
+    if (SendPolicyEnabled () && (m_StreamBuffer != NULL))
+    {
+        intervalElapsed = SendIntervalElapsed (interface, m_StreamBuffer, currentTime);
+    }
+    else
+    {
+        intervalElapsed = (timeDiffSec >= rtdmXmlData->maxTimeBeforeSendMs);
+    }
+
+    /* calculate if the send interval has timed out, the buffer is full or the optional
+     * byte budget has been reached */
+    if ((m_StreamBuffer != NULL)
+                    && ((m_StreamBuffer->SampleCount
+                                    >= rtdmXmlData->max_main_buffer_count)
+                                    || intervalElapsed
+                                    || ((rtdmXmlData->maxBytesBeforeSend != 0)
+                                                    && (m_StreamBuffer->ByteCount
+                                                                    >= rtdmXmlData->maxBytesBeforeSend)))
                     && (previousSendTimeSec != 0))
     {
         /* calculate CRC for all samples, this needs done before we call Populate_Stream_Header */
-        STRM_Header.Num_Samples = m_SampleCount;
+        STRM_Header.Num_Samples = m_StreamBuffer->SampleCount;
         samplesCRC = 0;
         samplesCRC = crc32 (samplesCRC,
                         (unsigned char *) &STRM_Header.Num_Samples,
                         sizeof(STRM_Header.Num_Samples));
+        /* Only the bytes used by the samples, a partial buffer is not padded */
         samplesCRC = crc32 (samplesCRC,
-                        (unsigned char*) &m_RtdmStreamPtr->IBufferArray[0],
-                        (rtdmXmlData->max_main_buffer_count
-                                        * rtdmXmlData->sample_size));
+                        (unsigned char*) &m_StreamBuffer->Stream->IBufferArray[0],
+                        m_StreamBuffer->ByteCount);
 
         /* Time to construct main header */
         Populate_Stream_Header (samplesCRC, rtdmXmlData, currentTime);
 
         /* Copy temp stream header buffer to Main Stream buffer */
-        memcpy (m_RtdmStreamPtr->header, &STRM_Header, sizeof(STRM_Header));
+        memcpy (m_StreamBuffer->Stream->header, &STRM_Header,
+                        sizeof(STRM_Header));
+        memcpy (m_StreamBuffer->Stream->headerExt, &m_StreamHeaderExt,
+                        sizeof(m_StreamHeaderExt));
+
+        /* IBufferSize, header and the populated samples only */
+        m_StreamBuffer->Stream->IBufferSize = m_StreamBuffer->ByteCount
+                        + sizeof(UINT16);
+        messageSize = sizeof(UINT16) + STREAM_HEADER_SIZE
+                        + STREAM_HEADER_EXT_SIZE + m_StreamBuffer->ByteCount;
 
-        /* Time to send message */
-        *errorCode = SendStreamOverNetwork (rtdmXmlData);
+        SendPolicyFlushed (m_StreamBuffer, currentTime);
+
+        if (networkAvailable)
+        {
+            /* Time to send message; the buffer belongs to the sender until ServiceSender() releases it */
+            *errorCode = ShapeStreamForSend (m_StreamBuffer, messageSize, ALL_DESTINATIONS);
+        }
+        else
+        {
+            /* Hold the message, timestamps and all, until the network is back */
+            StoreBacklogMessage ((UINT8 *) m_StreamBuffer->Stream, messageSize);
+            ReleaseStreamBuffer (m_StreamBuffer);
+        }
 
         previousSendTimeSec = currentTime->seconds;
 
-        /* Reset the sample count */
-        m_SampleCount = 0;
+        /* Sampling continues in the next free buffer */
+        m_StreamBuffer = AcquireStreamBuffer ();
 
-        printf ("STREAM SENT %d\n", m_SampleCount);
+        printf ("STREAM SENT\n");
 
     }
 
+    interface->RTDMStreamBuffFree = GetFreeStreamBufferCount ();
+    interface->RTDMStreamDropCount = m_DroppedSampleCount;
+
     /* Save previousSendTimeSec always on the first call to this function */
     if (previousSendTimeSec == 0)
     {
@@ -445,7 +558,10 @@ static UINT16 PopulateSamples (RtdmXmlStr *rtdmXmlData,
     /* Always copy the new signals for the next comparison */
     memcpy (&m_RtdmOldSample, newSignalData, sizeof(SignalStr));
 
-    m_Interface1Ptr->RTDMSampleCount = m_SampleCount + 1;
+    if (m_StreamBuffer != NULL)
+    {
+        m_Interface1Ptr->RTDMSampleCount = m_StreamBuffer->SampleCount + 1;
+    }
 
     /*********************************** HEADER ****************************************************************/
     /* TimeStamp - Seconds */
@@ -651,6 +767,65 @@ static void PopulateSignalsWithNewSamples (SignalStr *newData,
     } /* end for */
 }
 
+/* Value of one signal widened to 32 bits, 0 for an unknown ID; the ID's are those of
+ * PopulateSignalsWithNewSamples() above and the two must be kept in step */
+INT32 GetSignalValue (const SignalStr *signals, UINT16 signalId)
+{
+    switch (signalId)
+    {
+        case 0:
+            return signals->Value_0;
+        case 1:
+            return signals->Value_1;
+        case 2:
+            return signals->Value_2;
+        case 3:
+            return signals->Value_3;
+        case 4:
+            return signals->Value_4;
+        case 5:
+            return signals->Value_5;
+        case 6:
+            return signals->Value_6;
+        case 7:
+            return signals->Value_7;
+        case 8:
+            return signals->Value_8;
+        case 9:
+            return (INT32) signals->Value_9;
+        case 10:
+            return signals->Value_10;
+        case 11:
+            return signals->Value_11;
+        case 12:
+            return signals->Value_12;
+        case 13:
+            return signals->Value_13;
+        case 14:
+            return signals->Value_14;
+        case 15:
+            return signals->Value_15;
+        case 16:
+            return signals->Value_16;
+        case 17:
+            return signals->Value_17;
+        case 18:
+            return signals->Value_18;
+        case 19:
+            return signals->Value_19;
+        case 20:
+            return signals->Value_20;
+        case 21:
+            return signals->Value_21;
+        case 22:
+            return signals->Value_22;
+        case 23:
+            return signals->Value_23;
+        default:
+            return 0;
+    }
+}
+
 static UINT16 PopulateBufferWithAllSignals (UINT8 signalBuffer[],
                 SignalStr *newSignalData)
 {
@@ -890,14 +1065,14 @@ static void Populate_Stream_Header (UINT32 samples_crc, RtdmXmlStr *rtdmXmlData,
     /* Endiannes - Always BIG */
     STRM_Header.Endiannes = BIG_ENDIAN;
 
-    /* Header size - Always 85 - STREAM_HEADER_SIZE */
-    STRM_Header.Header_Size = sizeof(STRM_Header);
+    /* Header size - 85 - STREAM_HEADER_SIZE, plus the extension */
+    STRM_Header.Header_Size = sizeof(STRM_Header) + sizeof(m_StreamHeaderExt);
 
     /* Header Checksum - CRC-32 */
     /* Checksum of the following content of the header */
     /* Below - need to calculate after filling array */
 
-    /* Header Version - Always 2 */
+    /* Header Version - 3, extension present */
     STRM_Header.Header_Version = STREAM_HEADER_VERSION;
 
     /* Consist ID */
@@ -949,20 +1124,28 @@ static void Populate_Stream_Header (UINT32 samples_crc, RtdmXmlStr *rtdmXmlData,
 
     /* Sample size - size of following content including this field */
     /* Add this field plus checksum and # samples to size */
-    STRM_Header.Sample_Size_for_header = ((rtdmXmlData->max_main_buffer_count
-                    * rtdmXmlData->sample_size) + SAMPLE_SIZE_ADJUSTMENT);
+    STRM_Header.Sample_Size_for_header = (m_StreamBuffer->ByteCount
+                    + SAMPLE_SIZE_ADJUSTMENT);
 
     /* Sample Checksum - Checksum of the following content CRC-32 */
     STRM_Header.Sample_Checksum = samples_crc;
 
     /* Number of Samples in current stream */
-    STRM_Header.Num_Samples = m_SampleCount;
+    STRM_Header.Num_Samples = m_StreamBuffer->SampleCount;
+
+    /* Header extension - stream sequence number */
+    m_StreamHeaderExt.Ext_Version = STREAM_HEADER_EXT_VERSION;
+    m_StreamHeaderExt.Ext_Size = sizeof(m_StreamHeaderExt);
+    m_StreamHeaderExt.Stream_Sequence = NextStreamSequence ();
 
     /* crc = 0 is flipped in crc.c to 0xFFFFFFFF */
+    /* Covers the header from Version on and the extension, which follows it in the message */
     stream_header_crc = 0;
     stream_header_crc = crc32 (stream_header_crc,
                     ((unsigned char*) &STRM_Header.Header_Version),
                     (sizeof(STRM_Header) - STREAM_HEADER_CHECKSUM_ADJUST));
+    stream_header_crc = crc32 (stream_header_crc,
+                    ((unsigned char*) &m_StreamHeaderExt), sizeof(m_StreamHeaderExt));
     STRM_Header.Header_Checksum = stream_header_crc;
 
 } /* End Populate_Stream_Header */
@@ -1080,48 +1263,6 @@ static UINT16 Check_Fault (UINT16 error_code, RTDMTimeStr *currentTime)
 
 } /* End Check_Fault */
 
-static UINT16 SendStreamOverNetwork (RtdmXmlStr* rtdmXmlData)
-{
-    UINT32 actual_buffer_size = 0;
-    UINT16 ipt_result = 0;
-    UINT16 errorCode = 0;
-
-    /* Number of streams sent out as Message Data */
-    static UINT32 MD_Send_Counter = 0;
-
-    /* This is the actual buffer size as calculated below */
-    actual_buffer_size = ((rtdmXmlData->max_main_buffer_count
-                    * rtdmXmlData->sample_size) + STREAM_HEADER_SIZE + 2);
-
-    /* Send message overriding of destination URI 800310000 - comId comes from .xml */
-    ipt_result = MDComAPI_putMsgQ (rtdmXmlData->comId, /* ComId */
-    (const char*) m_RtdmStreamPtr, /* Data buffer */
-    actual_buffer_size, /* Number of data to be send */
-    0, /* No queue for communication ipt_result */
-    0, /* No caller reference value */
-    0, /* Topo counter */
-    "grpRTDM.lCar.lCst", /* overriding of destination URI */
-    0); /* No overriding of source URI */
-    if (ipt_result != IPT_OK)
-    {
-        /* The sending couldn't be started. */
-        /* Error handling */
-        //TODO
-        errorCode = -1;
-        /* free the memory we used for the buffer */
-        free (m_RtdmStreamPtr);
-    }
-    else
-    {
-        /* Send OK */
-        MD_Send_Counter++;
-        m_Interface1Ptr->RTDM_Send_Counter = MD_Send_Counter;
-        /* Clear Error Code */
-        errorCode = NO_ERROR;
-    }
-    return errorCode;
-}
-
 /*********************************** TEST *************************************************************/
 /*********************************** TEST *************************************************************/
 
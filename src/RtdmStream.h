@@ -28,6 +28,12 @@
 
 #define MAX_PCU_SIGNALS                     24
 
+/* Size of string parameters read from the .xml file, terminator included */
+#define XML_STRING_SIZE                     64
+
+/* OutputStreamCfg plus up to 3 OutputDestination elements */
+#define MAX_DESTINATIONS                    4
+
 
 //DAS Autogenerated from MTPE
 typedef struct dataBlock_RTDM_Stream
@@ -41,6 +47,10 @@ typedef struct dataBlock_RTDM_Stream
     MWT_STRING VNC_CarData_X_DeviceID; /* input Device ID */
     MWT_BOOL VNC_CarData_S_WhoAmISts; /* input Who Am I Status */
     UINT8 RTDMDataLogStop; /* input Stop the RTDM Data Log */
+    UINT8 RTDMReplayRequest; /* input Rising edge starts a replay of the data log */
+    UINT32 RTDMReplayStart_S; /* input First second of the replay range */
+    UINT32 RTDMReplayEnd_S; /* input Last second of the replay range */
+    UINT16 RTDMReplayDestination; /* input Destinations of the replay, bit 0 = primary, 0 = primary */
     /* Group: OUTPUTS */ //DAS going to MTPE
     UINT8 RTDMDataLogState; /* output State of RTDM Data Log, RUN, STOP, RESTART, FULL */
     UINT16 RTDMMainBuffCount; /* output MD data stream message */
@@ -52,9 +62,49 @@ typedef struct dataBlock_RTDM_Stream
     UINT16 RTDMSendTime; /* output Max time before sending stream */
     UINT16 RTDMStreamError; /* output Error Code for Stream */
     UINT16 RTDMSampleCount; /* output Number of samples in stream */
+    UINT16 RTDMScrubSegment; /* output Data log segment being verified by the scrubber */
+    UINT16 RTDMScrubCorrupt; /* output Number of corrupt data log segments found */
+    UINT32 RTDMScrubTimeUs; /* output Time spent by the scrubber in the last cycle [usec] */
+    UINT32 RTDMScrubMaxTimeUs; /* output Worst case time spent by the scrubber in a cycle [usec] */
+    UINT16 RTDMStreamBuffFree; /* output Number of stream buffers not in use */
+    UINT32 RTDMStreamDropCount; /* output Samples dropped because no stream buffer was free */
+    UINT16 RTDMSendQueueDepth; /* output Stream buffers waiting for the sender thread */
+    UINT16 RTDMSendQueueMax; /* output Largest send queue depth seen */
+    UINT32 RTDMSendLatencyUs; /* output Queued to sent time of the last stream [usec] */
+    UINT32 RTDMSendMaxLatencyUs; /* output Worst case queued to sent time [usec] */
+    UINT16 RTDMBacklogRam; /* output Unsent stream messages held in RAM */
+    UINT32 RTDMBacklogDisk; /* output Unsent stream messages held in the disk queue */
+    UINT32 RTDMBacklogDropCount; /* output Stream messages lost because the backlog was full */
+    UINT32 RTDMTransportBytesPerSec; /* output Bytes sent by the transport in the last second */
+    UINT32 RTDMTransportMsgsPerSec; /* output Messages sent by the transport in the last second */
+    UINT32 RTDMTransportSendUs; /* output Time spent in the transport for the last message [usec] */
+    UINT32 RTDMTransportMaxSendUs; /* output Worst case time spent in the transport [usec] */
+    UINT16 RTDMDestinationCount; /* output Number of stream destinations */
+    UINT32 RTDMDestinationDropCount; /* output Messages skipped for a destination whose queue was full */
+    UINT16 RTDMShaperQueueDepth; /* output Messages waiting in the shaper */
+    UINT32 RTDMShaperDelayMs; /* output Time the last message waited in the shaper [msec] */
+    UINT32 RTDMShaperMaxDelayMs; /* output Worst case time a message waited in the shaper [msec] */
+    UINT32 RTDMShaperPhaseMs; /* output Shaper hold time of this car [msec] */
+    UINT32 RTDMEventCount; /* output Priority signal transitions sent as events */
+    UINT32 RTDMEventFailCount; /* output Event messages the transport refused */
+    UINT32 RTDMSendIntervalMs; /* output Adaptive send interval in use [msec] */
+    UINT32 RTDMSampleBytesPerSec; /* output Average rate sample bytes are produced */
+    UINT8 RTDMReplayState; /* output Data log replay IDLE, OPEN, SEEK, READ or SEND */
+    UINT32 RTDMReplaySampleCount; /* output Samples sent by the current or last replay */
+    UINT32 RTDMReplayMessageCount; /* output Stream messages sent by the current or last replay */
 } TYPE_RTDM_STREAM_IF;
 
 
+/* One receiver of the stream, from OutputStreamCfg or an OutputDestination element */
+typedef struct
+{
+    uint32_t comId;
+    char uri[XML_STRING_SIZE]; /* optional, IPTCom destination URI, default grpRTDM.lCar.lCst */
+    char transportType[XML_STRING_SIZE]; /* optional, IPTCOM (default), UDP, UNIX or FILE */
+    char transportAddress[XML_STRING_SIZE]; /* optional, destination for UDP, UNIX and FILE */
+    uint32_t transportMtu; /* optional, fragment UDP and UNIX messages to this size, 0 = off */
+} RtdmDestinationStr;
+
 /* Structure to contain all variables read from RTDM_config.xml file */
 typedef struct
 {
@@ -73,8 +123,20 @@ typedef struct
     uint32_t comId;
     uint16_t bufferSize;
     uint16_t maxTimeBeforeSendMs;
+    uint32_t maxBytesBeforeSend; /* optional, send early once this many sample bytes are used, 0 = off */
+    uint32_t sendIntervalMinMs; /* optional, lower bound of the adaptive send interval, 0 = off */
+    uint32_t sendIntervalMaxMs; /* optional, upper bound of the adaptive send interval [msec] */
+    uint32_t shaperBytesPerSec; /* optional, token bucket rate for stream sends, 0 = off */
+    uint32_t shaperBurstBytes; /* optional, token bucket depth, 0 = bufferSize */
+    uint32_t shaperPhaseMs; /* optional, per car hold time step, 0 = off */
+    uint32_t eventComId; /* optional, comId of event messages, 0 = comId */
+    char eventTransportAddress[XML_STRING_SIZE]; /* optional, events channel address, required for FILE */
+    uint32_t replayBytesPerSec; /* optional, pace of data log replays, 0 = default */
+    RtdmDestinationStr destination[MAX_DESTINATIONS]; /* [0] is OutputStreamCfg, the MDS */
+    uint16_t destination_count; /* number of destinations, at least 1 */
     uint16_t signal_id_num[MAX_PCU_SIGNALS]; /* unique ID number for each signal */
     int16_t signal_id_size[MAX_PCU_SIGNALS]; /* size in bytes of signal */
+    uint8_t signal_priority[MAX_PCU_SIGNALS]; /* optional, TRUE sends every transition as an event */
     int16_t sample_size; /* calculated size of sample including the sample header */
     uint16_t max_main_buffer_count; /* calculated size of main buffer (max number of samples) */
     uint16_t signal_count; /* number of signals */
@@ -85,6 +147,7 @@ typedef struct
 {
     uint16_t IBufferSize __attribute__ ((packed));
     uint8_t header[85] __attribute__ ((packed));
+    uint8_t headerExt[7]; /* STREAM_HEADER_EXT_SIZE */
     uint8_t IBufferArray[] __attribute__ ((packed));
 } RTDMStream_str;
 
@@ -0,0 +1,415 @@
+/****************************************************************************************************************
+ * PROJECT    : BART
+ *
+ * MODULE     : RtdmTransport.c
+ *
+ * DESCRIPTON : 	Transports used to send stream messages. Each destination in the .xml file (OutputStreamCfg
+ *	and any OutputDestination elements) opens its own channel, selected by the optional attributes
+ *	transportType and transportAddress.
+ *
+ *	   transportType   transportAddress        available
+ *	   IPTCOM          (not used)              always, default
+ *	   UDP             host:port               TEST_ON_PC Linux builds
+ *	   UNIX            socket path             TEST_ON_PC Linux builds
+ *	   FILE            file name               TEST_ON_PC builds
+ *
+ *	IPTCom sends through MDComAPI_putMsgQ to the destination uri (default "grpRTDM.lCar.lCst") with the
+ *	comId from the .xml file.
+ *	The UDP and UNIX backends send each stream message as one datagram so a local receiver can measure
+ *	the streaming path on a Linux bench without a train network. FILE appends every message to a
+ *	file as a sink.
+ *
+ *	With a transportMtu in the .xml file the UDP and UNIX backends split each message into fragments of
+ *	at most that many bytes (RtdmFragment.c), numbered with a per message sequence number. A receiver
+ *	puts them back together with the reassembler.
+ *
+ *	Every backend goes through TransportSend(), which keeps byte, message, failure and send time
+ *	totals per channel. The caller derives bytes/s and messages/s from them. All state lives in the
+ *	channel, so channels can be driven from different threads.
+ *
+ * FUNCTIONS:
+ *	UINT16 OpenTransport (TransportChannelStr *channel, const char *transportType,
+ *	                const char *transportAddress, UINT32 comId, const char *uri, UINT32 mtu)
+ *	void CloseTransport (TransportChannelStr *channel)
+ *	UINT16 TransportSend (TransportChannelStr *channel, const UINT8 *message, UINT32 messageSize)
+ *	const char *GetTransportName (const TransportChannelStr *channel)
+ *	void GetTransportStats (const TransportChannelStr *channel, TransportStatsStr *stats)
+ *
+ **********************************************************************************************************************/
+
+#ifndef TEST_ON_PC
+#include "global_mwt.h"
+#include "rts_api.h"
+#include "../include/iptcom.h"
+#else
+#include "MyTypes.h"
+#include "MyFuncs.h"
+#endif
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+
+#if defined(TEST_ON_PC) && !defined(_WIN32)
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#define SOCKET_TRANSPORTS   1
+#else
+#define SOCKET_TRANSPORTS   0
+#endif
+
+#include "RTDM_Stream_ext.h"
+#include "RtdmTransport.h"
+#include "RtdmFragment.h"
+
+/*******************************************************************
+ *
+ *    S  T  R  U  C  T  S
+ *
+ *******************************************************************/
+typedef struct
+{
+    char *name; /* transportType value in the .xml file */
+    UINT16 (*open) (TransportChannelStr *channel, const char *address);
+    UINT16 (*send) (TransportChannelStr *channel, const UINT8 *message, UINT32 messageSize);
+} TransportStr;
+
+/*******************************************************************
+ *
+ *    S  T  A  T  I  C      F  U  N  C  T  I  O  N  S
+ *
+ *******************************************************************/
+static UINT16 IptcomOpen (TransportChannelStr *channel, const char *address);
+static UINT16 IptcomSend (TransportChannelStr *channel, const UINT8 *message, UINT32 messageSize);
+#ifdef TEST_ON_PC
+static UINT16 FileOpen (TransportChannelStr *channel, const char *address);
+static UINT16 FileSend (TransportChannelStr *channel, const UINT8 *message, UINT32 messageSize);
+#endif
+#if SOCKET_TRANSPORTS
+static UINT16 UdpOpen (TransportChannelStr *channel, const char *address);
+static UINT16 UnixOpen (TransportChannelStr *channel, const char *address);
+static UINT16 SocketSend (TransportChannelStr *channel, const UINT8 *message, UINT32 messageSize);
+static UINT16 SocketSendDatagram (void *context, const UINT8 *datagram, UINT32 datagramSize);
+#endif
+
+/*******************************************************************
+ *
+ *    S  T  A  T  I  C      V  A  R  I  A  B  L  E  S
+ *
+ *******************************************************************/
+/* IPTCOM must stay first, it is the default */
+static const TransportStr m_Transports[] =
+{
+{ "IPTCOM", IptcomOpen, IptcomSend },
+#ifdef TEST_ON_PC
+{ "FILE", FileOpen, FileSend },
+#endif
+#if SOCKET_TRANSPORTS
+{ "UDP", UdpOpen, SocketSend },
+{ "UNIX", UnixOpen, SocketSend },
+#endif
+};
+
+/*******************************************************************************************
+ *
+ *   Procedure Name : OpenTransport
+ *
+ *   Functional Description : Set up a channel and open the backend named in the .xml file. An
+ *   empty or unknown name selects IPTCom. A channel that was opened before must be closed
+ *   with CloseTransport() first.
+ *
+ *   Parameters : channel, transportType, transportAddress, comId, uri - IPTCom destination,
+ *                kept by reference, mtu - 0 or FRAG_MIN_MTU to FRAG_MAX_MTU
+ *
+ *   Returned :  NO_ERROR or SEND_MSG_FAILED if the backend could not be opened
+ *
+ ******************************************************************************************/
+UINT16 OpenTransport (TransportChannelStr *channel, const char *transportType,
+                const char *transportAddress, UINT32 comId, const char *uri, UINT32 mtu)
+{
+    UINT16 i = 0;
+
+    memset (channel, 0, sizeof(TransportChannelStr));
+    channel->Socket = -1;
+    channel->ComId = comId;
+    channel->Uri = uri;
+
+    if (mtu != 0)
+    {
+        if ((mtu >= FRAG_MIN_MTU) && (mtu <= FRAG_MAX_MTU))
+        {
+            channel->FragmentBuffer = (UINT8 *) calloc (FRAG_MAX_MTU, sizeof(UINT8));
+            if (channel->FragmentBuffer != NULL)
+            {
+                channel->Mtu = mtu;
+            }
+        }
+        else
+        {
+            printf ("Transport MTU %lu out of range, messages are not fragmented\n",
+                            (unsigned long) mtu);
+        }
+    }
+
+    for (i = 0; i < (sizeof(m_Transports) / sizeof(TransportStr)); i++)
+    {
+        if (strcmp (transportType, m_Transports[i].name) == 0)
+        {
+            channel->Backend = i;
+        }
+    }
+
+    if ((transportType[0] != '\0') && (strcmp (transportType, GetTransportName (channel)) != 0))
+    {
+        printf ("Transport %s not available, using %s\n", transportType,
+                        GetTransportName (channel));
+    }
+
+    return m_Transports[channel->Backend].open (channel, transportAddress);
+}
+
+/* Release whatever the backend opened; the channel can then be opened again */
+void CloseTransport (TransportChannelStr *channel)
+{
+#ifdef TEST_ON_PC
+    if (channel->SinkFile != NULL)
+    {
+        os_io_fclose((FILE *) channel->SinkFile);
+        channel->SinkFile = NULL;
+    }
+#endif
+#if SOCKET_TRANSPORTS
+    if (channel->Socket >= 0)
+    {
+        close (channel->Socket);
+        channel->Socket = -1;
+    }
+#endif
+    if (channel->FragmentBuffer != NULL)
+    {
+        free (channel->FragmentBuffer);
+        channel->FragmentBuffer = NULL;
+    }
+    channel->Mtu = 0;
+}
+
+/*******************************************************************************************
+ *
+ *   Procedure Name : TransportSend
+ *
+ *   Functional Description : Send one complete stream message through the channel's backend
+ *   and update its totals. Only one thread may send on a channel.
+ *
+ *   Parameters : channel, message, messageSize
+ *
+ *   Returned :  NO_ERROR or SEND_MSG_FAILED
+ *
+ ******************************************************************************************/
+UINT16 TransportSend (TransportChannelStr *channel, const UINT8 *message, UINT32 messageSize)
+{
+    OS_STR_TIME_POSIX startTime;
+    OS_STR_TIME_POSIX endTime;
+    TransportStatsStr *stats = &channel->Stats;
+    UINT16 result = NO_ERROR;
+
+    os_c_get (&startTime);
+
+    result = m_Transports[channel->Backend].send (channel, message, messageSize);
+
+    os_c_get (&endTime);
+
+    stats->LastSendUs = ElapsedUsecs (&startTime, &endTime);
+    if (stats->LastSendUs > stats->MaxSendUs)
+    {
+        stats->MaxSendUs = stats->LastSendUs;
+    }
+
+    if (result == NO_ERROR)
+    {
+        stats->Bytes += messageSize;
+        stats->Messages++;
+    }
+    else
+    {
+        stats->Failures++;
+    }
+
+    return result;
+}
+
+const char *GetTransportName (const TransportChannelStr *channel)
+{
+    return m_Transports[channel->Backend].name;
+}
+
+/* Copy of the totals. Only the sending thread gets a consistent copy; any other thread may see
+ * fields from different sends and should take the copy from the sender instead. */
+void GetTransportStats (const TransportChannelStr *channel, TransportStatsStr *stats)
+{
+    *stats = channel->Stats;
+}
+
+static UINT16 IptcomOpen (TransportChannelStr *channel, const char *address)
+{
+    (void) channel;
+    (void) address;
+
+    /* IPTCom is brought up by the target before this task runs */
+    return NO_ERROR;
+}
+
+static UINT16 IptcomSend (TransportChannelStr *channel, const UINT8 *message, UINT32 messageSize)
+{
+    UINT16 ipt_result = 0;
+
+    /* Send message overriding of destination URI - comId and URI come from .xml */
+    ipt_result = MDComAPI_putMsgQ (channel->ComId, /* ComId */
+    (const char*) message, /* Data buffer */
+    messageSize, /* Number of data to be send */
+    0, /* No queue for communication ipt_result */
+    0, /* No caller reference value */
+    0, /* Topo counter */
+    channel->Uri, /* overriding of destination URI */
+    0); /* No overriding of source URI */
+    if (ipt_result != IPT_OK)
+    {
+        /* The sending couldn't be started. */
+        return SEND_MSG_FAILED;
+    }
+
+    return NO_ERROR;
+}
+
+#ifdef TEST_ON_PC
+static UINT16 FileOpen (TransportChannelStr *channel, const char *address)
+{
+    FILE *filePtr = NULL;
+
+    if (os_io_fopen ((char *) address, "wb", &filePtr) == ERROR)
+    {
+        printf ("Transport file %s could not be opened\n", address);
+        return SEND_MSG_FAILED;
+    }
+
+    channel->SinkFile = filePtr;
+
+    return NO_ERROR;
+}
+
+static UINT16 FileSend (TransportChannelStr *channel, const UINT8 *message, UINT32 messageSize)
+{
+    if ((channel->SinkFile == NULL)
+                    || (fwrite (message, 1, messageSize, (FILE *) channel->SinkFile) != messageSize))
+    {
+        return SEND_MSG_FAILED;
+    }
+
+    /* A message is sent once it is in the file, not in the stdio buffer; the channel is never
+     * closed, so nothing may be left behind at exit */
+    if (fflush ((FILE *) channel->SinkFile) != 0)
+    {
+        return SEND_MSG_FAILED;
+    }
+
+    return NO_ERROR;
+}
+#endif
+
+#if SOCKET_TRANSPORTS
+/* address is host:port, e.g. 127.0.0.1:20550 */
+static UINT16 UdpOpen (TransportChannelStr *channel, const char *address)
+{
+    struct sockaddr_in *udpAddress = (struct sockaddr_in *) channel->SocketAddress;
+    char host[64];
+    unsigned int port = 0;
+    int sendBufferSize = 1024 * 1024;
+
+    memset (host, 0, sizeof(host));
+    if ((sscanf (address, "%63[^:]:%u", host, &port) != 2) || (port == 0) || (port > 0xFFFF))
+    {
+        printf ("Transport UDP address %s is not host:port\n", address);
+        return SEND_MSG_FAILED;
+    }
+
+    udpAddress->sin_family = AF_INET;
+    udpAddress->sin_port = htons ((unsigned short) port);
+    if (inet_pton (AF_INET, host, &udpAddress->sin_addr) != 1)
+    {
+        printf ("Transport UDP host %s is not an IPv4 address\n", host);
+        return SEND_MSG_FAILED;
+    }
+
+    channel->Socket = socket (AF_INET, SOCK_DGRAM, 0);
+    if (channel->Socket < 0)
+    {
+        return SEND_MSG_FAILED;
+    }
+
+    /* A full 60,000 byte stream message must fit */
+    setsockopt (channel->Socket, SOL_SOCKET, SO_SNDBUF, &sendBufferSize, sizeof(sendBufferSize));
+
+    channel->SocketAddressLength = sizeof(struct sockaddr_in);
+
+    return NO_ERROR;
+}
+
+/* address is the path of the receiver's datagram socket */
+static UINT16 UnixOpen (TransportChannelStr *channel, const char *address)
+{
+    struct sockaddr_un *unixAddress = (struct sockaddr_un *) channel->SocketAddress;
+    int sendBufferSize = 1024 * 1024;
+
+    if ((address[0] == '\0') || (strlen (address) >= sizeof(unixAddress->sun_path)))
+    {
+        printf ("Transport UNIX path %s is not valid\n", address);
+        return SEND_MSG_FAILED;
+    }
+
+    unixAddress->sun_family = AF_UNIX;
+    strcpy (unixAddress->sun_path, address);
+
+    channel->Socket = socket (AF_UNIX, SOCK_DGRAM, 0);
+    if (channel->Socket < 0)
+    {
+        return SEND_MSG_FAILED;
+    }
+
+    setsockopt (channel->Socket, SOL_SOCKET, SO_SNDBUF, &sendBufferSize, sizeof(sendBufferSize));
+
+    channel->SocketAddressLength = sizeof(struct sockaddr_un);
+
+    return NO_ERROR;
+}
+
+static UINT16 SocketSend (TransportChannelStr *channel, const UINT8 *message, UINT32 messageSize)
+{
+    if (channel->Mtu != 0)
+    {
+        channel->MessageSequence++;
+        return FragmentMessage (message, messageSize, channel->MessageSequence, channel->Mtu,
+                        channel->FragmentBuffer, SocketSendDatagram, channel);
+    }
+
+    return SocketSendDatagram (channel, message, messageSize);
+}
+
+/* FragmentSendFunc, context is the channel */
+static UINT16 SocketSendDatagram (void *context, const UINT8 *datagram, UINT32 datagramSize)
+{
+    TransportChannelStr *channel = (TransportChannelStr *) context;
+
+    if ((channel->Socket < 0)
+                    || (sendto (channel->Socket, datagram, datagramSize, 0,
+                                    (struct sockaddr *) channel->SocketAddress,
+                                    channel->SocketAddressLength) != (ssize_t) datagramSize))
+    {
+        return SEND_MSG_FAILED;
+    }
+
+    return NO_ERROR;
+}
+#endif
@@ -0,0 +1,75 @@
+/*
+ * RtdmTransport.h
+ *
+ *  Interface of RtdmTransport.c: transports used to send stream messages.
+ */
+
+#ifndef RTDMTRANSPORT_H_
+#define RTDMTRANSPORT_H_
+
+/*******************************************************************
+ *
+ *     C  O  N  S  T  A  N  T  S
+ *
+ *******************************************************************/
+
+/*******************************************************************
+ *
+ *     E  N  U  M  S
+ *
+ *******************************************************************/
+
+/*******************************************************************
+ *
+ *    S  T  R  U  C  T  S
+ *
+ *******************************************************************/
+/* Running totals kept by TransportSend(), written only by the sending thread */
+typedef struct
+{
+    UINT32 Bytes; /* bytes accepted by the backend */
+    UINT32 Messages; /* messages accepted by the backend */
+    UINT32 Failures; /* messages the backend refused */
+    UINT32 LastSendUs; /* time spent in the backend for the last message [usec] */
+    UINT32 MaxSendUs; /* worst case time spent in the backend [usec] */
+} TransportStatsStr;
+
+/* Room for the largest socket address a backend uses (struct sockaddr_un) */
+#define TRANSPORT_ADDRESS_SIZE      128
+
+/* One open destination; a channel may only be sent on from one thread at a time */
+typedef struct
+{
+    UINT16 Backend; /* index of the selected backend */
+    UINT32 ComId; /* IPTCom comId */
+    const char *Uri; /* IPTCom destination URI */
+    UINT32 Mtu; /* largest datagram for the socket backends, 0 sends each message whole */
+    UINT32 MessageSequence; /* numbers the fragmented messages */
+    UINT8 *FragmentBuffer; /* FRAG_MAX_MTU bytes, allocated when Mtu is set */
+    TransportStatsStr Stats;
+    void *SinkFile; /* FILE backend */
+    int Socket; /* UDP and UNIX backends */
+    UINT8 SocketAddress[TRANSPORT_ADDRESS_SIZE];
+    UINT32 SocketAddressLength;
+} TransportChannelStr;
+
+/*******************************************************************
+ *
+ *    E  X  T  E  R  N      V  A  R  I  A  B  L  E  S
+ *
+ *******************************************************************/
+
+/*******************************************************************
+ *
+ *    E  X  T  E  R  N      F  U  N  C  T  I  O  N  S
+ *
+ *******************************************************************/
+
+UINT16 OpenTransport (TransportChannelStr *channel, const char *transportType,
+                const char *transportAddress, UINT32 comId, const char *uri, UINT32 mtu);
+void CloseTransport (TransportChannelStr *channel);
+UINT16 TransportSend (TransportChannelStr *channel, const UINT8 *message, UINT32 messageSize);
+const char *GetTransportName (const TransportChannelStr *channel);
+void GetTransportStats (const TransportChannelStr *channel, TransportStatsStr *stats);
+
+#endif /* RTDMTRANSPORT_H_ */
@@ -30,8 +30,15 @@
  *	comId
  *	bufferSize
  *	maxTimeBeforeSendMs
+ *	maxBytesBeforeSend (optional)
+ *	sendIntervalMinMs, sendIntervalMaxMs (optional)
+ *	shaperBytesPerSec, shaperBurstBytes, shaperPhaseMs (optional)
+ *	eventComId, eventTransportAddress (optional)
+ *	replayBytesPerSec (optional)
+ *	OutputStreamCfg / OutputDestination - comId, uri, transportType, transportAddress, transportMtu
  *	Signal id[]
  *	dataType[]
+ *	priority[] (optional)
  *	signal_dataType
  *	sample_size
  *
@@ -62,6 +69,9 @@
 /* Main Header Size */
 #define SAMPLE_HEADER_SIZE      9
 
+/* IPTCom destination URI when a destination does not give one */
+#define DEFAULT_DESTINATION_URI "grpRTDM.lCar.lCst"
+
 /* XML file on VCUC */
 #define RTDM_XML_FILE           "RTDMConfiguration_PCU.xml"
 
@@ -134,6 +144,31 @@ NO_BUFFERSIZE },
 { "maxTimeBeforeSendMs", INTEGER_DTYPE, &RtdmXmlData.maxTimeBeforeSendMs,
 NO_MAX_TIME_BEFORE_SEND },
 
+/* Optional, NO_ERROR if missing */
+{ "maxBytesBeforeSend", U32_DTYPE, &RtdmXmlData.maxBytesBeforeSend,
+NO_ERROR },
+
+{ "sendIntervalMinMs", U32_DTYPE, &RtdmXmlData.sendIntervalMinMs,
+NO_ERROR },
+
+{ "sendIntervalMaxMs", U32_DTYPE, &RtdmXmlData.sendIntervalMaxMs,
+NO_ERROR },
+
+{ "shaperBytesPerSec", U32_DTYPE, &RtdmXmlData.shaperBytesPerSec,
+NO_ERROR },
+
+{ "shaperBurstBytes", U32_DTYPE, &RtdmXmlData.shaperBurstBytes,
+NO_ERROR },
+
+{ "shaperPhaseMs", U32_DTYPE, &RtdmXmlData.shaperPhaseMs,
+NO_ERROR },
+
+{ "eventComId", U32_DTYPE, &RtdmXmlData.eventComId,
+NO_ERROR },
+
+{ "replayBytesPerSec", U32_DTYPE, &RtdmXmlData.replayBytesPerSec,
+NO_ERROR },
+
 };
 
 /*******************************************************************
@@ -146,6 +181,9 @@ static int OpenXMLConfigurationFile (char **configFileXMLBufferPtr);
 static int OpenFileTrackerFile (void);
 static UINT16 ProcessXmlFileParams (char *pStringLocation1, int index);
 static int FindSignals (char* pStringLocation1);
+static void FindDestinations (char* pStringLocation1);
+static void ReadDestination (char *element, RtdmDestinationStr *destination);
+static BOOL GetXmlAttribute (const char *element, const char *name, char *value);
 
 
 UINT16 InitializeXML(TYPE_RTDM_STREAM_IF *interface, RtdmXmlStr *rtdmXmlData)
@@ -270,6 +308,9 @@ static int ReadXmlFile (void)
             return (NO_BUFFERSIZE);
         }
 
+        /* OutputStreamCfg and any extra OutputDestination elements */
+        FindDestinations (pStringLocation1);
+
         /***********************************************************************************************************************/
         /* start loop for finding signal Id's */
         /* This section determines which PCU variable are included in the stream sample and data recorder */
@@ -362,6 +403,7 @@ static UINT16 ProcessXmlFileParams (char *pStringLocation1, int index)
 
     UINT16 errorCode = NO_ERROR;
     char tempArray[10];
+    unsigned long u32Value = 0;
 
     char *pStringLocation2 = strstr (pStringLocation1,
                     m_XmlConfigReader[index].subString);
@@ -380,8 +422,9 @@ static UINT16 ProcessXmlFileParams (char *pStringLocation1, int index)
                 break;
 
             case U32_DTYPE:
-                sscanf (pStringLocation2, "%lu",
-                                (unsigned long *) m_XmlConfigReader[index].xmlData);
+                /* Scan into a long, the target is always 32 bits wide */
+                sscanf (pStringLocation2, "%lu", &u32Value);
+                *(uint32_t *) m_XmlConfigReader[index].xmlData = (uint32_t) u32Value;
                 break;
 
             case BOOLEAN_DTYPE:
@@ -445,6 +488,8 @@ static int FindSignals (char* pStringLocation1)
     int16_t dataType;
 
     char temp_array[5];
+    char priority[XML_STRING_SIZE];
+    char *pEnd = NULL;
 
     /***********************************************************************************************************************/
     /* start loop for finding signal Id's */
@@ -459,6 +504,19 @@ static int FindSignals (char* pStringLocation1)
         /* convert signal_id to a # and save as int */
         sscanf (pStringLocation1, "%u", &signalId);
         RtdmXmlData.signal_id_num[signal_count] = signalId;
+        /* optional priority="TRUE", only looked for inside this Signal element */
+        RtdmXmlData.signal_priority[signal_count] = FALSE;
+        pEnd = strchr (pStringLocation1, '>');
+        if (pEnd != NULL)
+        {
+            *pEnd = '\0';
+            if (GetXmlAttribute (pStringLocation1, " priority=\"", priority)
+                            && (strcmp (priority, "TRUE") == 0))
+            {
+                RtdmXmlData.signal_priority[signal_count] = TRUE;
+            }
+            *pEnd = '>';
+        }
         /* find dataType */
         pStringLocation1 = strstr (pStringLocation1, xml_dataType);
         /* move pointer to dataType */
@@ -571,4 +629,113 @@ void ReferenceOnly(void)
 }
 #endif
 
+/*******************************************************************************************
+ *
+ *   Procedure Name : FindDestinations
+ *
+ *   Functional Description : Destination 0 comes from OutputStreamCfg, destinations 1 .. N-1
+ *   from the OutputDestination elements, e.g.
+ *	<OutputDestination comId="800310016" uri="grpDiag.lCar.lCst" />
+ *	<OutputDestination comId="800310016" transportType="UDP" transportAddress="10.0.0.5:20550" />
+ *   Extra elements beyond MAX_DESTINATIONS are ignored.
+ *
+ *   Parameters : pStringLocation1 - text from DataRecorderCfg on
+ *
+ *   Returned :  None
+ *
+ ******************************************************************************************/
+static void FindDestinations (char* pStringLocation1)
+{
+    const char xml_output_stream[] = "<OutputStreamCfg";
+    const char xml_destination[] = "<OutputDestination";
+    char *pElement = NULL;
+
+    memset (RtdmXmlData.destination, 0, sizeof(RtdmXmlData.destination));
+
+    /* The stream always goes to the OutputStreamCfg destination */
+    RtdmXmlData.destination[0].comId = RtdmXmlData.comId;
+    pElement = strstr (pStringLocation1, xml_output_stream);
+    if (pElement != NULL)
+    {
+        ReadDestination (pElement, &RtdmXmlData.destination[0]);
+    }
+    else
+    {
+        strcpy (RtdmXmlData.destination[0].uri, DEFAULT_DESTINATION_URI);
+    }
+    RtdmXmlData.destination_count = 1;
+
+    pElement = pStringLocation1;
+    while (((pElement = strstr (pElement, xml_destination)) != NULL)
+                    && (RtdmXmlData.destination_count < MAX_DESTINATIONS))
+    {
+        ReadDestination (pElement, &RtdmXmlData.destination[RtdmXmlData.destination_count]);
+        RtdmXmlData.destination_count++;
+        pElement += strlen (xml_destination);
+    }
+
+    /* Found anywhere in DataRecorderCfg, as eventComId is */
+    RtdmXmlData.eventTransportAddress[0] = '\0';
+    GetXmlAttribute (pStringLocation1, " eventTransportAddress=\"",
+                    RtdmXmlData.eventTransportAddress);
+}
+
+/* Attributes of one element, only the text up to the end of the element is searched */
+static void ReadDestination (char *element, RtdmDestinationStr *destination)
+{
+    char value[XML_STRING_SIZE];
+    char *pEnd = NULL;
+    char saved = '\0';
+
+    pEnd = strchr (element, '>');
+    if (pEnd != NULL)
+    {
+        saved = *pEnd;
+        *pEnd = '\0';
+    }
+
+    if (GetXmlAttribute (element, " comId=\"", value))
+    {
+        destination->comId = (uint32_t) strtoul (value, NULL, 10);
+    }
+
+    if (!GetXmlAttribute (element, " uri=\"", destination->uri))
+    {
+        strcpy (destination->uri, DEFAULT_DESTINATION_URI);
+    }
+
+    GetXmlAttribute (element, " transportType=\"", destination->transportType);
+    GetXmlAttribute (element, " transportAddress=\"", destination->transportAddress);
+
+    if (GetXmlAttribute (element, " transportMtu=\"", value))
+    {
+        destination->transportMtu = (uint32_t) strtoul (value, NULL, 10);
+    }
+
+    if (pEnd != NULL)
+    {
+        *pEnd = saved;
+    }
+}
+
+/* Copy the quoted value following name (which ends with the opening quote), at most XML_STRING_SIZE */
+static BOOL GetXmlAttribute (const char *element, const char *name, char *value)
+{
+    const char *pString = strstr (element, name);
+    UINT16 i = 0;
 
+    if (pString == NULL)
+    {
+        return FALSE;
+    }
+
+    pString += strlen (name);
+    while ((i < (XML_STRING_SIZE - 1)) && (pString[i] != '"') && (pString[i] != '\0'))
+    {
+        value[i] = pString[i];
+        i++;
+    }
+    value[i] = '\0';
+
+    return TRUE;
+}
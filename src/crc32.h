@@ -36,6 +36,21 @@ unsigned crc32(
     const unsigned char *buf,
           int            len);
 
+unsigned crc32_slice4(
+          unsigned       crc,
+    const unsigned char *buf,
+          int            len);
+
+unsigned crc32_slice8(
+          unsigned       crc,
+    const unsigned char *buf,
+          int            len);
+
+unsigned crc32_fast(
+          unsigned       crc,
+    const unsigned char *buf,
+          int            len);
+
 
 #ifdef __cplusplus   /* to be compatible with C++ */
 }
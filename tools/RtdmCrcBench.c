@@ -0,0 +1,295 @@
+/****************************************************************************************************************
+ * PROJECT    : BART
+ *
+ * MODULE     : RtdmCrcBench.c
+ *
+ * DESCRIPTON : 	Off-board micro-benchmark of every CRC-32 kernel in src/crc32.c.
+ *
+ *	Each kernel is timed over the buffer sizes the recorder actually produces:
+ *	   85 bytes         - STRM header (STREAM_HEADER_SIZE)
+ *	   2,000 bytes      - minimum bufferSize accepted from the XML
+ *	   10,000 bytes     - typical stream buffer
+ *	   60,000 bytes     - maximum stream buffer
+ *	   hour segment     - one hour of data log blocks (3600 blocks of 20 samples)
+ *
+ *	Throughput is reported in GB/s and, on x86 hosts, in TSC cycles per byte. Before timing, every
+ *	kernel is checked against the zlib byte-at-a-time reference, crc32(), over all sizes, odd
+ *	lengths, unaligned start addresses and chained calls. Any mismatch fails the run (exit code 1).
+ *
+ * BUILD :
+ *	gcc -O2 -I../src RtdmCrcBench.c ../src/crc32.c -o RtdmCrcBench
+ *
+ * USAGE :
+ *	RtdmCrcBench [minimum seconds per measurement, default 0.2]
+ *
+ **********************************************************************************************************************/
+
+#define _POSIX_C_SOURCE 199309L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#if defined(__i386__) || defined(__x86_64__)
+#include <x86intrin.h>
+#define HAVE_TSC    1
+#else
+#define HAVE_TSC    0
+#endif
+
+#include "crc32.h"
+
+/*******************************************************************
+ *
+ *     C  O  N  S  T  A  N  T  S
+ *
+ *******************************************************************/
+/* Size of one data log sample (RTDM_Struct) and one framed block (DAN_Block_Struct) */
+#define SAMPLE_SIZE             98
+#define BLOCK_HEADER_SIZE       16
+#define BLOCK_SAMPLES           20
+#define BLOCK_SIZE              (BLOCK_HEADER_SIZE + (BLOCK_SAMPLES * SAMPLE_SIZE))
+
+/* One hour at 50 msec is 3600 blocks, plus the segment header */
+#define HOUR_SEGMENT_SIZE       (38 + (3600 * BLOCK_SIZE))
+
+/*******************************************************************
+ *
+ *    S  T  R  U  C  T  S
+ *
+ *******************************************************************/
+typedef unsigned (*CrcKernel) (unsigned crc, const unsigned char *buf, int len);
+
+typedef struct
+{
+    const char *name;
+    CrcKernel kernel;
+} CrcVariant;
+
+typedef struct
+{
+    const char *name;
+    int size;
+} BufferCase;
+
+/*******************************************************************
+ *
+ *    S  T  A  T  I  C      V  A  R  I  A  B  L  E  S
+ *
+ *******************************************************************/
+/* crc32 is the reference, it must stay first */
+static const CrcVariant m_Variants[] =
+{
+{ "crc32", crc32 },
+{ "crc32_slice4", crc32_slice4 },
+{ "crc32_slice8", crc32_slice8 },
+{ "crc32_fast", crc32_fast } };
+
+static const BufferCase m_Cases[] =
+{
+{ "STRM header", 85 },
+{ "min bufferSize", 2000 },
+{ "stream 10K", 10000 },
+{ "stream 60K", 60000 },
+{ "hour segment", HOUR_SEGMENT_SIZE } };
+
+#define NUM_VARIANTS    (sizeof(m_Variants) / sizeof(CrcVariant))
+#define NUM_CASES       (sizeof(m_Cases) / sizeof(BufferCase))
+
+/*******************************************************************
+ *
+ *    S  T  A  T  I  C      F  U  N  C  T  I  O  N  S
+ *
+ *******************************************************************/
+static int VerifyVariants (const unsigned char *buffer, int maxSize);
+static void MeasureVariant (const CrcVariant *variant, const unsigned char *buffer, int size,
+                double minSeconds, double *gbPerSec, double *cyclesPerByte);
+static double NowSeconds (void);
+
+int main (int argc, char *argv[])
+{
+    unsigned char *buffer = NULL;
+    double minSeconds = 0.2;
+    double gbPerSec = 0.0;
+    double cyclesPerByte = 0.0;
+    unsigned int c = 0;
+    unsigned int v = 0;
+    int i = 0;
+
+    if (argc > 1)
+    {
+        minSeconds = atof (argv[1]);
+    }
+
+    /* Extra bytes allow unaligned start addresses during verification */
+    buffer = (unsigned char *) malloc (HOUR_SEGMENT_SIZE + 16);
+    if (buffer == NULL)
+    {
+        printf ("Out of memory\n");
+        return 2;
+    }
+
+    /* Pseudo random content, fixed seed so runs are comparable */
+    srand (12345);
+    for (i = 0; i < HOUR_SEGMENT_SIZE + 16; i++)
+    {
+        buffer[i] = (unsigned char) rand ();
+    }
+
+    if (VerifyVariants (buffer, HOUR_SEGMENT_SIZE) != 0)
+    {
+        free (buffer);
+        return 1;
+    }
+
+    printf ("%-16s %-14s %12s %10s %12s\n", "buffer", "kernel", "bytes", "GB/s",
+                    HAVE_TSC ? "cycles/byte" : "");
+
+    for (c = 0; c < NUM_CASES; c++)
+    {
+        for (v = 0; v < NUM_VARIANTS; v++)
+        {
+            MeasureVariant (&m_Variants[v], buffer, m_Cases[c].size, minSeconds, &gbPerSec,
+                            &cyclesPerByte);
+
+            if (HAVE_TSC)
+            {
+                printf ("%-16s %-14s %12d %10.3f %12.3f\n", m_Cases[c].name, m_Variants[v].name,
+                                m_Cases[c].size, gbPerSec, cyclesPerByte);
+            }
+            else
+            {
+                printf ("%-16s %-14s %12d %10.3f\n", m_Cases[c].name, m_Variants[v].name,
+                                m_Cases[c].size, gbPerSec);
+            }
+        }
+    }
+
+    free (buffer);
+
+    return 0;
+}
+
+/* Compare every kernel against crc32(); returns the number of mismatches */
+static int VerifyVariants (const unsigned char *buffer, int maxSize)
+{
+    unsigned expected = 0;
+    unsigned actual = 0;
+    unsigned int c = 0;
+    unsigned int v = 0;
+    int offset = 0;
+    int len = 0;
+    int split = 0;
+    int errors = 0;
+
+    for (v = 1; v < NUM_VARIANTS; v++)
+    {
+        /* Short and odd lengths at every alignment exercise the tail handling */
+        for (offset = 0; offset < 8; offset++)
+        {
+            for (len = 0; len < 300; len++)
+            {
+                expected = crc32 (0, buffer + offset, len);
+                actual = m_Variants[v].kernel (0, buffer + offset, len);
+                if (actual != expected)
+                {
+                    printf ("MISMATCH %s offset %d len %d: %08x != %08x\n", m_Variants[v].name,
+                                    offset, len, actual, expected);
+                    errors++;
+                }
+            }
+        }
+
+        /* Recorder buffer sizes, whole and chained in two calls like the stream sample CRC */
+        for (c = 0; c < NUM_CASES; c++)
+        {
+            len = m_Cases[c].size;
+            if (len > maxSize)
+            {
+                len = maxSize;
+            }
+            split = len / 3;
+
+            expected = crc32 (0, buffer + 1, len);
+            actual = m_Variants[v].kernel (0, buffer + 1, len);
+            if (actual != expected)
+            {
+                printf ("MISMATCH %s %s: %08x != %08x\n", m_Variants[v].name, m_Cases[c].name,
+                                actual, expected);
+                errors++;
+            }
+
+            actual = m_Variants[v].kernel (m_Variants[v].kernel (0, buffer + 1, split),
+                            buffer + 1 + split, len - split);
+            if (actual != expected)
+            {
+                printf ("MISMATCH %s %s chained: %08x != %08x\n", m_Variants[v].name,
+                                m_Cases[c].name, actual, expected);
+                errors++;
+            }
+        }
+    }
+
+    /* Known answer for the reference itself */
+    if (crc32 (0, (const unsigned char *) "123456789", 9) != 0xcbf43926)
+    {
+        printf ("MISMATCH crc32 check value\n");
+        errors++;
+    }
+
+    if (errors != 0)
+    {
+        printf ("%d CRC mismatches, benchmark aborted\n", errors);
+    }
+
+    return errors;
+}
+
+/* Repeat the kernel until minSeconds have elapsed and report the best rate */
+static void MeasureVariant (const CrcVariant *variant, const unsigned char *buffer, int size,
+                double minSeconds, double *gbPerSec, double *cyclesPerByte)
+{
+    volatile unsigned sink = 0;
+    unsigned long long startCycles = 0;
+    unsigned long long cycles = 0;
+    double startTime = 0.0;
+    double elapsed = 0.0;
+    double bytes = 0.0;
+    long iterations = 0;
+
+    /* Warm up caches and the lazily built slicing tables */
+    sink = variant->kernel (0, buffer, size);
+
+    startTime = NowSeconds ();
+#if HAVE_TSC
+    startCycles = __rdtsc ();
+#endif
+
+    do
+    {
+        sink = variant->kernel (sink, buffer, size);
+        iterations++;
+        elapsed = NowSeconds () - startTime;
+    } while (elapsed < minSeconds);
+
+#if HAVE_TSC
+    cycles = __rdtsc () - startCycles;
+#endif
+
+    bytes = (double) size * (double) iterations;
+
+    *gbPerSec = bytes / elapsed / 1.0e9;
+    *cyclesPerByte = (double) cycles / bytes;
+
+    (void) startCycles;
+}
+
+static double NowSeconds (void)
+{
+    struct timespec now;
+
+    clock_gettime (CLOCK_MONOTONIC, &now);
+
+    return (double) now.tv_sec + ((double) now.tv_nsec / 1.0e9);
+}
@@ -0,0 +1,337 @@
+/****************************************************************************************************************
+ * PROJECT    : BART
+ *
+ * MODULE     : RtdmDanMap.c
+ *
+ * DESCRIPTON : 	Off-board reader that maps a .dan file instead of reading it, for the data log ring
+ *	segments (N.dan) and rtdm.dan.
+ *
+ *	OpenDanMap() maps the whole file read only and looks at nothing but its first four bytes. The
+ *	rest is worked out when a caller first needs it and remembered:
+ *	   GetDanMapHeader()     - segment header, Header_Checksum checked
+ *	   GetDanMapBlockCount() - Num_Blocks of a closed segment, the blocks the file holds otherwise
+ *	   GetDanMapBlock()      - framing, sequence and Block_Checksum of that block only
+ *	   GetDanMapConfig()     - the configuration text rtdm.dan starts with, up to "</RtdmCfg>"
+ *	   NextDanMapMessage()   - the next good STRM message of rtdm.dan, checked by the stream decoder
+ *	Pages the caller does not touch are never read from the disk. Nothing is copied: headers, blocks
+ *	and messages are handed out as pointers into the mapping, so several tools reading the same ring
+ *	share one copy in the page cache instead of each filling its own buffers with fread().
+ *
+ *	A pointer stays good until CloseDanMap(). The segment being written keeps growing; blocks
+ *	added after OpenDanMap() are not seen.
+ *
+ * FUNCTIONS:
+ *	UINT16 OpenDanMap (DanMapStr *map, const char *path)
+ *	void CloseDanMap (DanMapStr *map)
+ *	const DAN_Header_Struct *GetDanMapHeader (DanMapStr *map)
+ *	UINT32 GetDanMapBlockCount (DanMapStr *map)
+ *	const DAN_Block_Struct *GetDanMapBlock (DanMapStr *map, UINT32 blockNumber)
+ *	UINT32 DecodeDanMapBlock (DanMapStr *map, UINT32 blockNumber, StrmColumnsStr *columns)
+ *	const char *GetDanMapConfig (DanMapStr *map, UINT32 *size)
+ *	BOOL NextDanMapMessage (DanMapStr *map, UINT32 *offset, UINT16 options, StrmMessageStr *decoded)
+ *
+ **********************************************************************************************************************/
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "MyTypes.h"
+#include "RTDM_Stream_ext.h"
+#include "crc32.h"
+#include "RtdmDecoder.h"
+#include "RtdmDanMap.h"
+
+/*******************************************************************
+ *
+ *     C  O  N  S  T  A  N  T  S
+ *
+ *******************************************************************/
+/* End of the configuration at the head of rtdm.dan */
+#define CONFIG_END                  "</RtdmCfg>"
+
+/*******************************************************************
+ *
+ *    S  T  A  T  I  C      F  U  N  C  T  I  O  N  S
+ *
+ *******************************************************************/
+static BOOL CheckBlock (const DanMapStr *map, UINT32 blockNumber);
+
+/*******************************************************************************************
+ *
+ *   Procedure Name : OpenDanMap
+ *
+ *   Functional Description : Map a .dan file read only and tell a segment from a stream file
+ *
+ *   Parameters : map - filled in, path
+ *
+ *   Returned :  DANMAP_OK, DANMAP_NOT_FOUND, DANMAP_EMPTY or DANMAP_MAP_FAILED
+ *
+ ******************************************************************************************/
+UINT16 OpenDanMap (DanMapStr *map, const char *path)
+{
+    struct stat status;
+    void *data = NULL;
+    int fd = -1;
+
+    memset (map, 0, sizeof(DanMapStr));
+
+    fd = open (path, O_RDONLY);
+    if (fd < 0)
+    {
+        return DANMAP_NOT_FOUND;
+    }
+
+    if ((fstat (fd, &status) != 0) || (status.st_size == 0))
+    {
+        close (fd);
+        return DANMAP_EMPTY;
+    }
+
+    /* The mapping holds its own reference to the file */
+    data = mmap (NULL, (size_t) status.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close (fd);
+    if (data == MAP_FAILED)
+    {
+        return DANMAP_MAP_FAILED;
+    }
+
+    map->Data = (const UINT8 *) data;
+    map->Size = (UINT32) status.st_size;
+    map->Kind = DANMAP_STREAM;
+    if ((map->Size >= sizeof(DAN_Header_Struct)) && (memcmp (map->Data, "DSEG", 4) == 0))
+    {
+        map->Kind = DANMAP_SEGMENT;
+    }
+
+    return DANMAP_OK;
+}
+
+void CloseDanMap (DanMapStr *map)
+{
+    if (map->Data != NULL)
+    {
+        munmap ((void *) map->Data, map->Size);
+    }
+    free (map->BlockState);
+    memset (map, 0, sizeof(DanMapStr));
+}
+
+/* Header of a segment, NULL if the file is not one or its sizes do not match these blocks */
+const DAN_Header_Struct *GetDanMapHeader (DanMapStr *map)
+{
+    const DAN_Header_Struct *header = (const DAN_Header_Struct *) map->Data;
+    UINT32 headerCrc = 0;
+
+    if ((map->Kind != DANMAP_SEGMENT) || (header->Header_Version != DAN_HEADER_VERSION)
+                    || (header->Header_Size != sizeof(DAN_Header_Struct))
+                    || (header->Block_Size != sizeof(DAN_Block_Struct)))
+    {
+        return NULL;
+    }
+
+    if (!map->HeaderChecked)
+    {
+        map->HeaderChecked = TRUE;
+        map->NumBlocks = (map->Size - sizeof(DAN_Header_Struct)) / sizeof(DAN_Block_Struct);
+
+        /* The header of the segment being written is a placeholder, Num_Blocks 0 */
+        headerCrc = crc32 (0, ((const unsigned char*) &header->Header_Version),
+                        (sizeof(DAN_Header_Struct) - DAN_HEADER_CHECKSUM_ADJUST));
+        if ((headerCrc == header->Header_Checksum) && (header->Num_Blocks != 0)
+                        && (header->Num_Blocks <= map->NumBlocks))
+        {
+            /* A closed segment ends in its index (DAN_Index_Header_Struct), not in blocks */
+            map->Finalized = TRUE;
+            map->NumBlocks = header->Num_Blocks;
+        }
+    }
+
+    return header;
+}
+
+/* Blocks of a segment: Num_Blocks when closed, what the file holds while being written */
+UINT32 GetDanMapBlockCount (DanMapStr *map)
+{
+    if (GetDanMapHeader (map) == NULL)
+    {
+        return 0;
+    }
+
+    return map->NumBlocks;
+}
+
+/*******************************************************************************************
+ *
+ *   Procedure Name : GetDanMapBlock
+ *
+ *   Functional Description : A block in place, checked as ReadDanBlock() of RtdmDataLog.c does
+ *   the first time it is asked for
+ *
+ *   Parameters : map, blockNumber
+ *
+ *   Returned :  The block, NULL if it is beyond the end or fails its checks
+ *
+ ******************************************************************************************/
+const DAN_Block_Struct *GetDanMapBlock (DanMapStr *map, UINT32 blockNumber)
+{
+    if (blockNumber >= GetDanMapBlockCount (map))
+    {
+        return NULL;
+    }
+
+    if (map->BlockState == NULL)
+    {
+        map->BlockState = (UINT8 *) calloc (map->NumBlocks, 1);
+        if (map->BlockState == NULL)
+        {
+            return NULL;
+        }
+    }
+
+    if (map->BlockState[blockNumber] == DANMAP_BLOCK_UNKNOWN)
+    {
+        map->BlockState[blockNumber] = CheckBlock (map, blockNumber) ? DANMAP_BLOCK_GOOD :
+                        DANMAP_BLOCK_BAD;
+        map->BlocksChecked++;
+    }
+
+    if (map->BlockState[blockNumber] != DANMAP_BLOCK_GOOD)
+    {
+        return NULL;
+    }
+
+    return (const DAN_Block_Struct *) &map->Data[sizeof(DAN_Header_Struct)
+                    + (blockNumber * sizeof(DAN_Block_Struct))];
+}
+
+/* Append the samples of a good block to the columns, returns the rows appended */
+UINT32 DecodeDanMapBlock (DanMapStr *map, UINT32 blockNumber, StrmColumnsStr *columns)
+{
+    const DAN_Block_Struct *block = GetDanMapBlock (map, blockNumber);
+    StrmMessageStr samples;
+
+    if (block == NULL)
+    {
+        return 0;
+    }
+
+    memset (&samples, 0, sizeof(samples));
+    samples.Samples = (const UINT8 *) block->Sample;
+    samples.SampleCount = block->Header.Num_Samples;
+    samples.SampleBytes = samples.SampleCount * sizeof(RTDM_Struct);
+    samples.SampleStride = sizeof(RTDM_Struct);
+
+    return AppendSignalColumns (&samples, columns);
+}
+
+/* Configuration text at the head of rtdm.dan, not NUL terminated; NULL if there is none */
+const char *GetDanMapConfig (DanMapStr *map, UINT32 *size)
+{
+    const UINT8 *pEnd = NULL;
+
+    if (map->Kind != DANMAP_STREAM)
+    {
+        return NULL;
+    }
+
+    if (!map->ConfigChecked)
+    {
+        map->ConfigChecked = TRUE;
+        pEnd = (const UINT8 *) memmem (map->Data, map->Size, CONFIG_END, strlen (CONFIG_END));
+        if (pEnd != NULL)
+        {
+            map->ConfigSize = (UINT32) (pEnd - map->Data) + (UINT32) strlen (CONFIG_END);
+        }
+    }
+
+    if (map->ConfigSize == 0)
+    {
+        return NULL;
+    }
+
+    *size = map->ConfigSize;
+
+    return (const char *) map->Data;
+}
+
+/*******************************************************************************************
+ *
+ *   Procedure Name : NextDanMapMessage
+ *
+ *   Functional Description : The next STRM message of rtdm.dan at or after offset that the
+ *   stream decoder accepts. Whatever does not decode is stepped over and counted.
+ *
+ *   Parameters : map, offset - where to look, moved past the message found, options - of
+ *                DecodeStreamMessage(), decoded - filled in
+ *
+ *   Returned :  FALSE at the end of the file
+ *
+ ******************************************************************************************/
+BOOL NextDanMapMessage (DanMapStr *map, UINT32 *offset, UINT16 options, StrmMessageStr *decoded)
+{
+    const UINT8 *pFound = NULL;
+    UINT32 position = *offset;
+
+    if (map->Kind != DANMAP_STREAM)
+    {
+        return FALSE;
+    }
+
+    /* The decoder wants IBufferSize in front of the header; rtdm.dan always has bytes there */
+    if (position < DECODE_STRM_OFFSET)
+    {
+        position = DECODE_STRM_OFFSET;
+    }
+
+    while ((position + 4) <= map->Size)
+    {
+        pFound = (const UINT8 *) memmem (&map->Data[position], map->Size - position, "STRM", 4);
+        if (pFound == NULL)
+        {
+            break;
+        }
+        position = (UINT32) (pFound - map->Data);
+
+        if (DecodeStreamMessage (pFound - DECODE_STRM_OFFSET,
+                        map->Size - position + DECODE_STRM_OFFSET, options, decoded) == DECODE_OK)
+        {
+            *offset = position + decoded->Header->Header_Size + decoded->SampleBytes;
+            return TRUE;
+        }
+
+        map->MessagesRejected++;
+        position++;
+    }
+
+    *offset = map->Size;
+
+    return FALSE;
+}
+
+/* Framing, sequence and Block_Checksum, as ReadDanBlock() in RtdmDataLog.c */
+static BOOL CheckBlock (const DanMapStr *map, UINT32 blockNumber)
+{
+    const DAN_Block_Struct *block = (const DAN_Block_Struct *) &map->Data[sizeof(DAN_Header_Struct)
+                    + (blockNumber * sizeof(DAN_Block_Struct))];
+    UINT32 blockCrc = 0;
+
+    if ((memcmp (block->Header.Delimiter, "DBLK", sizeof(block->Header.Delimiter)) != 0)
+                    || (block->Header.Block_Size != sizeof(DAN_Block_Struct))
+                    || (block->Header.Sequence != blockNumber)
+                    || (block->Header.Num_Samples > DAN_BLOCK_SAMPLES))
+    {
+        return FALSE;
+    }
+
+    blockCrc = crc32_fast (0, ((const unsigned char*) &block->Header.Sequence),
+                    (sizeof(DAN_Block_Struct) - DAN_BLOCK_CHECKSUM_ADJUST));
+
+    return (blockCrc == block->Header.Block_Checksum);
+}
@@ -0,0 +1,82 @@
+/*
+ * RtdmDanMap.h
+ *
+ *  Interface of RtdmDanMap.c: memory-mapped reader of .dan files, off-board tools only.
+ */
+
+#ifndef RTDMDANMAP_H_
+#define RTDMDANMAP_H_
+
+/*******************************************************************
+ *
+ *     C  O  N  S  T  A  N  T  S
+ *
+ *******************************************************************/
+/* Kinds of mapped file */
+#define DANMAP_SEGMENT              0 /* N.dan, DAN_Header_Struct then blocks */
+#define DANMAP_STREAM               1 /* rtdm.dan, the configuration then STRM messages */
+
+/* Block states, checked at the first touch */
+#define DANMAP_BLOCK_UNKNOWN        0
+#define DANMAP_BLOCK_GOOD           1
+#define DANMAP_BLOCK_BAD            2
+
+/* Results of OpenDanMap() */
+#define DANMAP_OK                   0
+#define DANMAP_NOT_FOUND            1
+#define DANMAP_EMPTY                2
+#define DANMAP_MAP_FAILED           3
+
+/*******************************************************************
+ *
+ *     E  N  U  M  S
+ *
+ *******************************************************************/
+
+/*******************************************************************
+ *
+ *    S  T  R  U  C  T  S
+ *
+ *******************************************************************/
+/* A .dan file mapped read only; everything handed out points into the mapping */
+typedef struct
+{
+    const UINT8 *Data;
+    UINT32 Size;
+    UINT16 Kind; /* DANMAP_SEGMENT or DANMAP_STREAM */
+
+    /* Segment, worked out at the first call that needs it */
+    BOOL HeaderChecked;
+    BOOL Finalized; /* header checks out and gives Num_Blocks */
+    UINT32 NumBlocks;
+    UINT8 *BlockState; /* per block, allocated at the first touch */
+    UINT32 BlocksChecked;
+
+    /* Stream file */
+    BOOL ConfigChecked;
+    UINT32 ConfigSize; /* bytes of configuration text, "</RtdmCfg>" included */
+    UINT32 MessagesRejected; /* "STRM" found but the message failed its checks */
+} DanMapStr;
+
+/*******************************************************************
+ *
+ *    E  X  T  E  R  N      V  A  R  I  A  B  L  E  S
+ *
+ *******************************************************************/
+
+/*******************************************************************
+ *
+ *    E  X  T  E  R  N      F  U  N  C  T  I  O  N  S
+ *
+ *******************************************************************/
+
+UINT16 OpenDanMap (DanMapStr *map, const char *path);
+void CloseDanMap (DanMapStr *map);
+const DAN_Header_Struct *GetDanMapHeader (DanMapStr *map);
+UINT32 GetDanMapBlockCount (DanMapStr *map);
+const DAN_Block_Struct *GetDanMapBlock (DanMapStr *map, UINT32 blockNumber);
+UINT32 DecodeDanMapBlock (DanMapStr *map, UINT32 blockNumber, StrmColumnsStr *columns);
+const char *GetDanMapConfig (DanMapStr *map, UINT32 *size);
+BOOL NextDanMapMessage (DanMapStr *map, UINT32 *offset, UINT16 options, StrmMessageStr *decoded);
+
+#endif /* RTDMDANMAP_H_ */
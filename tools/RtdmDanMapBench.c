@@ -0,0 +1,694 @@
+/****************************************************************************************************************
+ * PROJECT    : BART
+ *
+ * MODULE     : RtdmDanMapBench.c
+ *
+ * DESCRIPTON : 	Off-board check and benchmark of the mapped .dan reader (RtdmDanMap.c) against the
+ *	stdio reads the tools and RtdmDataLog.c use.
+ *
+ *	Two files are written to the directory given: an hour long closed segment (3600 blocks, one of
+ *	them damaged) and an rtdm.dan of about 67 kB (the configuration, an RTDM header, then stream
+ *	messages). Every path below must return the same rows and values on the stdio and on the mapped
+ *	side before it is timed; the mapped segment must have checked only the blocks that were touched.
+ *	Any failure ends the run (exit code 1).
+ *
+ *	Three paths are timed, each opening and closing the file per run, in ms per run:
+ *	   scan    - every block of the segment checked and decoded: fread() of each block into a
+ *	             buffer against DecodeDanMapBlock() in place
+ *	   touch   - 12 blocks spread over the segment, as a query for a few instants: fseek() and
+ *	             fread() per block against the same blocks of the map
+ *	   stream  - rtdm.dan: fgets() with a 300 byte line until "</RtdmCfg>" as Write_RTDM() does,
+ *	             the rest read into a buffer and searched for STRM messages, against
+ *	             GetDanMapConfig() and NextDanMapMessage()
+ *	The files are in the page cache after the first run, as they are when several tools read the
+ *	same ring, so the times are of the copies and calls, not of the disk.
+ *
+ * BUILD :
+ *	gcc -O2 -DTEST_ON_PC -DTARGET_SIM_DLL -I../src RtdmDanMapBench.c RtdmDanMap.c RtdmDecoder.c
+ *	    ../src/crc32.c -fcommon -o RtdmDanMapBench
+ *
+ * USAGE :
+ *	RtdmDanMapBench [directory, default .] [minimum seconds per measurement, default 0.5]
+ *
+ **********************************************************************************************************************/
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "MyTypes.h"
+#include "RTDM_Stream_ext.h"
+#include "crc32.h"
+#include "RtdmDecoder.h"
+#include "RtdmDanMap.h"
+
+/*******************************************************************
+ *
+ *     C  O  N  S  T  A  N  T  S
+ *
+ *******************************************************************/
+/* An hour of the ring at one block per second */
+#define SEGMENT_BLOCKS          3600
+#define DAMAGED_BLOCK           1234
+#define TOUCH_BLOCKS            12
+
+/* rtdm.dan of about 67 kB */
+#define STREAM_MESSAGES         16
+#define MESSAGE_SAMPLES         40
+#define MESSAGE_HEADER_SIZE     (STREAM_HEADER_SIZE + STREAM_HEADER_EXT_SIZE)
+
+/* Line buffer of Write_RTDM() in RtdmDataLog.c */
+#define LINE_SIZE               300
+
+#define FIRST_SECOND            1476835200
+
+/* Paths */
+#define PATH_SCAN               0
+#define PATH_TOUCH              1
+#define PATH_STREAM             2
+#define NUM_PATHS               3
+
+/*******************************************************************
+ *
+ *    S  T  R  U  C  T  S
+ *
+ *******************************************************************/
+/* What a path returned, the same on both sides or the reader is wrong */
+typedef struct
+{
+    UINT32 Rows;
+    uint64_t Sum;
+} BenchResultStr;
+
+typedef BOOL (*BenchPathFunc) (const char *path, BenchResultStr *result);
+
+/*******************************************************************
+ *
+ *    S  T A  T  I  C      V  A  R  I  A  B  L  E  S
+ *
+ *******************************************************************/
+static char m_SegmentPath[256];
+static char m_StreamPath[256];
+static UINT32 m_StreamConfigSize;
+
+/* Columns for one block or message */
+static UINT32 m_TimeStampS[MESSAGE_SAMPLES];
+static UINT16 m_TimeStampMs[MESSAGE_SAMPLES];
+static INT32 m_Values[DECODE_SIGNAL_COUNT][MESSAGE_SAMPLES];
+static StrmColumnsStr m_Columns;
+
+/*******************************************************************
+ *
+ *    S  T  A  T  I  C      F  U  N  C  T  I  O  N  S
+ *
+ *******************************************************************/
+static BOOL WriteSegment (const char *path);
+static BOOL WriteStreamFile (const char *path);
+static void FillSample (RTDM_Struct *sample, UINT32 row);
+static void AddColumns (BenchResultStr *result);
+static UINT32 TouchedBlock (UINT16 i);
+static BOOL ScanStdio (const char *path, BenchResultStr *result);
+static BOOL ScanMap (const char *path, BenchResultStr *result);
+static BOOL TouchStdio (const char *path, BenchResultStr *result);
+static BOOL TouchMap (const char *path, BenchResultStr *result);
+static BOOL StreamStdio (const char *path, BenchResultStr *result);
+static BOOL StreamMap (const char *path, BenchResultStr *result);
+static BOOL ReadStdioBlock (FILE *p_file, UINT32 blockNumber, DAN_Block_Struct *block);
+static int VerifyPaths (void);
+static double Measure (BenchPathFunc function, const char *path, double minSeconds);
+static double NowSeconds (void);
+
+static const BenchPathFunc m_Stdio[NUM_PATHS] =
+{ ScanStdio, TouchStdio, StreamStdio };
+static const BenchPathFunc m_Map[NUM_PATHS] =
+{ ScanMap, TouchMap, StreamMap };
+
+int main (int argc, char *argv[])
+{
+    static const char *pathName[NUM_PATHS] =
+    { "scan", "touch", "stream" };
+    const char *directory = ".";
+    const char *path = NULL;
+    double minSeconds = 0.5;
+    double stdioMs = 0.0;
+    double mapMs = 0.0;
+    UINT16 i = 0;
+
+    if (argc > 1)
+    {
+        directory = argv[1];
+    }
+    if (argc > 2)
+    {
+        minSeconds = atof (argv[2]);
+    }
+
+    snprintf (m_SegmentPath, sizeof(m_SegmentPath), "%s/bench.dan", directory);
+    snprintf (m_StreamPath, sizeof(m_StreamPath), "%s/bench_rtdm.dan", directory);
+
+    if (!WriteSegment (m_SegmentPath) || !WriteStreamFile (m_StreamPath))
+    {
+        printf ("Could not write the bench files to %s\n", directory);
+        return 2;
+    }
+
+    m_Columns.TimeStamp_S = m_TimeStampS;
+    m_Columns.TimeStamp_mS = m_TimeStampMs;
+    for (i = 0; i < DECODE_SIGNAL_COUNT; i++)
+    {
+        m_Columns.Value[i] = m_Values[i];
+    }
+
+    if (VerifyPaths () != 0)
+    {
+        return 1;
+    }
+
+    printf ("segment %u blocks (%u bytes), rtdm.dan %u messages (%u bytes)\n", SEGMENT_BLOCKS,
+                    (unsigned int) (sizeof(DAN_Header_Struct) + (SEGMENT_BLOCKS * sizeof(DAN_Block_Struct))),
+                    STREAM_MESSAGES, (unsigned int) (m_StreamConfigSize + 1 + sizeof(RTDM_Header_Struct)
+                                    + (STREAM_MESSAGES * (MESSAGE_HEADER_SIZE
+                                                    + (MESSAGE_SAMPLES * sizeof(RTDM_Struct))))));
+    printf ("%-10s %12s %12s %8s\n", "path", "stdio ms", "map ms", "speedup");
+
+    for (i = 0; i < NUM_PATHS; i++)
+    {
+        path = (i == PATH_STREAM) ? m_StreamPath : m_SegmentPath;
+        stdioMs = Measure (m_Stdio[i], path, minSeconds);
+        mapMs = Measure (m_Map[i], path, minSeconds);
+        printf ("%-10s %12.3f %12.3f %7.2fx\n", pathName[i], stdioMs, mapMs, stdioMs / mapMs);
+    }
+
+    remove (m_SegmentPath);
+    remove (m_StreamPath);
+
+    return 0;
+}
+
+/* A closed segment as CloseDanSegment() leaves it, less the index, with one damaged block */
+static BOOL WriteSegment (const char *path)
+{
+    static DAN_Block_Struct block;
+    DAN_Header_Struct header;
+    FILE *p_file = fopen (path, "wb");
+    UINT32 b = 0;
+    UINT16 s = 0;
+
+    if (p_file == NULL)
+    {
+        return FALSE;
+    }
+
+    memset (&header, 0, sizeof(header));
+    memcpy (header.Delimiter, "DSEG", sizeof(header.Delimiter));
+    header.Endiannes = BIG_ENDIAN;
+    header.Header_Size = sizeof(DAN_Header_Struct);
+    header.Header_Version = DAN_HEADER_VERSION;
+    header.Num_Samples = SEGMENT_BLOCKS * DAN_BLOCK_SAMPLES;
+    header.FirstTimeStamp_S = FIRST_SECOND;
+    header.LastTimeStamp_S = FIRST_SECOND + SEGMENT_BLOCKS - 1;
+    header.LastTimeStamp_mS = 950;
+    header.Block_Size = sizeof(DAN_Block_Struct);
+    header.Num_Blocks = SEGMENT_BLOCKS;
+    header.Header_Checksum = crc32 (0, ((unsigned char*) &header.Header_Version),
+                    (sizeof(DAN_Header_Struct) - DAN_HEADER_CHECKSUM_ADJUST));
+    fwrite (&header, 1, sizeof(header), p_file);
+
+    for (b = 0; b < SEGMENT_BLOCKS; b++)
+    {
+        memset (&block, 0, sizeof(block));
+        memcpy (block.Header.Delimiter, "DBLK", sizeof(block.Header.Delimiter));
+        block.Header.Block_Size = sizeof(DAN_Block_Struct);
+        block.Header.Sequence = b;
+        block.Header.Num_Samples = DAN_BLOCK_SAMPLES;
+        for (s = 0; s < DAN_BLOCK_SAMPLES; s++)
+        {
+            FillSample (&block.Sample[s], (b * DAN_BLOCK_SAMPLES) + s);
+        }
+        block.Header.Block_Checksum = crc32_fast (0, ((unsigned char*) &block.Header.Sequence),
+                        (sizeof(DAN_Block_Struct) - DAN_BLOCK_CHECKSUM_ADJUST));
+        if (b == DAMAGED_BLOCK)
+        {
+            block.Sample[7].Signal.Value_2 ^= 1;
+        }
+        fwrite (&block, 1, sizeof(block), p_file);
+    }
+
+    return (fclose (p_file) == 0);
+}
+
+/* rtdm.dan as Write_RTDM() leaves it: the configuration, the RTDM header, the stream messages */
+static BOOL WriteStreamFile (const char *path)
+{
+    static UINT8 message[MESSAGE_HEADER_SIZE + (MESSAGE_SAMPLES * sizeof(RTDM_Struct))];
+    STRM_Header_Struct *header = (STRM_Header_Struct *) message;
+    STRM_Header_Ext_Struct *extension = (STRM_Header_Ext_Struct *) &message[sizeof(STRM_Header_Struct)];
+    UINT32 sampleBytes = MESSAGE_SAMPLES * sizeof(RTDM_Struct);
+    RTDM_Header_Struct rtdmHeader;
+    FILE *p_file = fopen (path, "wb");
+    long configSize = 0;
+    UINT32 m = 0;
+    UINT16 s = 0;
+
+    if (p_file == NULL)
+    {
+        return FALSE;
+    }
+
+    fprintf (p_file, "<?xml version=\"1.0\" encoding=\"utf-8\"?>\n<RtdmCfg>\n");
+    for (s = 0; s < DECODE_SIGNAL_COUNT; s++)
+    {
+        fprintf (p_file, "  <Signal id=\"%u\" name=\"oPCU_I1.PCU_I1.Analog801.Signal%02u\" "
+                        "friendlyName=\"Signal %u\" dataType=\"INT16\" scale=\"0.01\" unit=\"V\" "
+                        "nbDecimals=\"2\" />\n", s, s, s);
+    }
+    fprintf (p_file, "</RtdmCfg>");
+    configSize = ftell (p_file);
+    fprintf (p_file, "\n");
+    m_StreamConfigSize = (UINT32) configSize;
+
+    memset (&rtdmHeader, 0, sizeof(rtdmHeader));
+    memcpy (rtdmHeader.Delimiter, "RTDM", sizeof(rtdmHeader.Delimiter));
+    rtdmHeader.Header_Size = sizeof(RTDM_Header_Struct);
+    rtdmHeader.FirstTimeStamp_S = FIRST_SECOND;
+    rtdmHeader.Num_Streams = STREAM_MESSAGES;
+    fwrite (&rtdmHeader, 1, sizeof(rtdmHeader), p_file);
+
+    for (m = 0; m < STREAM_MESSAGES; m++)
+    {
+        memset (message, 0, MESSAGE_HEADER_SIZE);
+        for (s = 0; s < MESSAGE_SAMPLES; s++)
+        {
+            FillSample ((RTDM_Struct *) &message[MESSAGE_HEADER_SIZE + (s * sizeof(RTDM_Struct))],
+                            (m * MESSAGE_SAMPLES) + s);
+        }
+
+        memcpy (header->Delimiter, "STRM", sizeof(header->Delimiter));
+        header->Endiannes = BIG_ENDIAN;
+        header->Header_Size = MESSAGE_HEADER_SIZE;
+        header->Header_Version = STREAM_HEADER_VERSION;
+        memcpy (header->Car_ID, "R2_1234", 7);
+        header->TimeStamp_S = FIRST_SECOND + (((m + 1) * MESSAGE_SAMPLES) / 20);
+        header->Sample_Size_for_header = sampleBytes + SAMPLE_SIZE_ADJUSTMENT;
+        header->Num_Samples = MESSAGE_SAMPLES;
+        header->Sample_Checksum = crc32 (0, (unsigned char *) &header->Num_Samples,
+                        sizeof(header->Num_Samples));
+        header->Sample_Checksum = crc32 (header->Sample_Checksum, &message[MESSAGE_HEADER_SIZE],
+                        sampleBytes);
+
+        extension->Ext_Version = STREAM_HEADER_EXT_VERSION;
+        extension->Ext_Size = STREAM_HEADER_EXT_SIZE;
+        extension->Stream_Sequence = m;
+
+        header->Header_Checksum = crc32 (0, &message[STREAM_HEADER_CHECKSUM_ADJUST],
+                        MESSAGE_HEADER_SIZE - STREAM_HEADER_CHECKSUM_ADJUST);
+
+        fwrite (message, 1, sizeof(message), p_file);
+    }
+
+    return (fclose (p_file) == 0);
+}
+
+/* Sample 'row' of the file, 20 per second, every signal different */
+static void FillSample (RTDM_Struct *sample, UINT32 row)
+{
+    UINT8 *pValue = (UINT8 *) &sample->Signal;
+    UINT32 i = 0;
+
+    memset (sample, 0, sizeof(RTDM_Struct));
+    sample->TimeStamp.seconds = FIRST_SECOND + (row / 20);
+    sample->TimeStamp.msecs = (UINT16) ((row % 20) * 50);
+    sample->Count = DECODE_SIGNAL_COUNT;
+
+    for (i = 0; i < sizeof(SignalStr); i++)
+    {
+        pValue[i] = (UINT8) ((row * 31) + (i * 7));
+    }
+}
+
+/* Fold the rows decoded into m_Columns into the result */
+static void AddColumns (BenchResultStr *result)
+{
+    UINT32 r = 0;
+    UINT16 s = 0;
+
+    for (r = 0; r < m_Columns.Rows; r++)
+    {
+        result->Sum += m_TimeStampS[r] + m_TimeStampMs[r];
+        for (s = 0; s < DECODE_SIGNAL_COUNT; s++)
+        {
+            result->Sum += (UINT32) m_Values[s][r];
+        }
+    }
+    result->Rows += m_Columns.Rows;
+}
+
+/* The blocks a touch reads, spread over the segment */
+static UINT32 TouchedBlock (UINT16 i)
+{
+    return ((i * SEGMENT_BLOCKS) / TOUCH_BLOCKS) + 7;
+}
+
+/* Every block through a buffer, as BuildRollup() and RtdmQuery.c read them */
+static BOOL ScanStdio (const char *path, BenchResultStr *result)
+{
+    static DAN_Block_Struct block;
+    DAN_Header_Struct header;
+    StrmMessageStr samples;
+    FILE *p_file = fopen (path, "rb");
+    UINT32 b = 0;
+
+    if (p_file == NULL)
+    {
+        return FALSE;
+    }
+    if (fread (&header, 1, sizeof(header), p_file) != sizeof(header))
+    {
+        fclose (p_file);
+        return FALSE;
+    }
+
+    memset (&samples, 0, sizeof(samples));
+    samples.SampleStride = sizeof(RTDM_Struct);
+
+    for (b = 0; b < header.Num_Blocks; b++)
+    {
+        if (!ReadStdioBlock (p_file, b, &block))
+        {
+            continue;
+        }
+
+        samples.Samples = (const UINT8 *) block.Sample;
+        samples.SampleCount = block.Header.Num_Samples;
+        samples.SampleBytes = samples.SampleCount * sizeof(RTDM_Struct);
+        m_Columns.Capacity = DAN_BLOCK_SAMPLES;
+        m_Columns.Rows = 0;
+        AppendSignalColumns (&samples, &m_Columns);
+        AddColumns (result);
+    }
+
+    fclose (p_file);
+
+    return TRUE;
+}
+
+static BOOL ScanMap (const char *path, BenchResultStr *result)
+{
+    DanMapStr map;
+    UINT32 numBlocks = 0;
+    UINT32 b = 0;
+
+    if (OpenDanMap (&map, path) != DANMAP_OK)
+    {
+        return FALSE;
+    }
+
+    numBlocks = GetDanMapBlockCount (&map);
+    for (b = 0; b < numBlocks; b++)
+    {
+        m_Columns.Capacity = DAN_BLOCK_SAMPLES;
+        m_Columns.Rows = 0;
+        DecodeDanMapBlock (&map, b, &m_Columns);
+        AddColumns (result);
+    }
+
+    CloseDanMap (&map);
+
+    return TRUE;
+}
+
+/* A few blocks by position, the header checked first for Num_Blocks */
+static BOOL TouchStdio (const char *path, BenchResultStr *result)
+{
+    static DAN_Block_Struct block;
+    DAN_Header_Struct header;
+    StrmMessageStr samples;
+    FILE *p_file = fopen (path, "rb");
+    UINT32 headerCrc = 0;
+    UINT16 i = 0;
+
+    if (p_file == NULL)
+    {
+        return FALSE;
+    }
+    if (fread (&header, 1, sizeof(header), p_file) != sizeof(header))
+    {
+        fclose (p_file);
+        return FALSE;
+    }
+    headerCrc = crc32 (0, ((unsigned char*) &header.Header_Version),
+                    (sizeof(DAN_Header_Struct) - DAN_HEADER_CHECKSUM_ADJUST));
+    if (headerCrc != header.Header_Checksum)
+    {
+        fclose (p_file);
+        return FALSE;
+    }
+
+    memset (&samples, 0, sizeof(samples));
+    samples.SampleStride = sizeof(RTDM_Struct);
+
+    for (i = 0; i < TOUCH_BLOCKS; i++)
+    {
+        if ((TouchedBlock (i) >= header.Num_Blocks)
+                        || (fseek (p_file, (long) (sizeof(DAN_Header_Struct)
+                                        + (TouchedBlock (i) * sizeof(DAN_Block_Struct))), SEEK_SET) != 0)
+                        || !ReadStdioBlock (p_file, TouchedBlock (i), &block))
+        {
+            continue;
+        }
+
+        samples.Samples = (const UINT8 *) block.Sample;
+        samples.SampleCount = block.Header.Num_Samples;
+        samples.SampleBytes = samples.SampleCount * sizeof(RTDM_Struct);
+        m_Columns.Capacity = DAN_BLOCK_SAMPLES;
+        m_Columns.Rows = 0;
+        AppendSignalColumns (&samples, &m_Columns);
+        AddColumns (result);
+    }
+
+    fclose (p_file);
+
+    return TRUE;
+}
+
+static BOOL TouchMap (const char *path, BenchResultStr *result)
+{
+    DanMapStr map;
+    UINT16 i = 0;
+
+    if (OpenDanMap (&map, path) != DANMAP_OK)
+    {
+        return FALSE;
+    }
+
+    for (i = 0; i < TOUCH_BLOCKS; i++)
+    {
+        m_Columns.Capacity = DAN_BLOCK_SAMPLES;
+        m_Columns.Rows = 0;
+        DecodeDanMapBlock (&map, TouchedBlock (i), &m_Columns);
+        AddColumns (result);
+    }
+
+    /* Only the blocks asked for were looked at */
+    result->Rows += (map.BlocksChecked != TOUCH_BLOCKS);
+
+    CloseDanMap (&map);
+
+    return TRUE;
+}
+
+/* Lines up to the end of the configuration, then the messages out of a buffer */
+static BOOL StreamStdio (const char *path, BenchResultStr *result)
+{
+    char line[LINE_SIZE];
+    StrmMessageStr decoded;
+    FILE *p_file = fopen (path, "rb");
+    UINT8 *buffer = NULL;
+    long start = 0;
+    long end = 0;
+    UINT32 size = 0;
+    UINT32 offset = 0;
+    BOOL found = FALSE;
+
+    if (p_file == NULL)
+    {
+        return FALSE;
+    }
+
+    while (fgets (line, LINE_SIZE, p_file) != NULL)
+    {
+        if (strstr (line, "</RtdmCfg>") != NULL)
+        {
+            found = TRUE;
+            break;
+        }
+    }
+
+    start = ftell (p_file);
+    fseek (p_file, 0L, SEEK_END);
+    end = ftell (p_file);
+    fseek (p_file, start, SEEK_SET);
+
+    /* The decoder wants IBufferSize in front of a STRM header */
+    size = (UINT32) (end - start);
+    buffer = (UINT8 *) malloc (size + DECODE_STRM_OFFSET);
+    if (!found || (buffer == NULL)
+                    || (fread (&buffer[DECODE_STRM_OFFSET], 1, size, p_file) != size))
+    {
+        free (buffer);
+        fclose (p_file);
+        return FALSE;
+    }
+    fclose (p_file);
+
+    while ((offset + 4) <= size)
+    {
+        if (memcmp (&buffer[DECODE_STRM_OFFSET + offset], "STRM", 4) != 0)
+        {
+            offset++;
+            continue;
+        }
+
+        if (DecodeStreamMessage (&buffer[offset], size - offset + DECODE_STRM_OFFSET, 0, &decoded)
+                        != DECODE_OK)
+        {
+            offset++;
+            continue;
+        }
+
+        m_Columns.Capacity = MESSAGE_SAMPLES;
+        m_Columns.Rows = 0;
+        AppendSignalColumns (&decoded, &m_Columns);
+        AddColumns (result);
+        offset += decoded.Header->Header_Size + decoded.SampleBytes;
+    }
+
+    free (buffer);
+
+    return TRUE;
+}
+
+static BOOL StreamMap (const char *path, BenchResultStr *result)
+{
+    StrmMessageStr decoded;
+    DanMapStr map;
+    UINT32 configSize = 0;
+    UINT32 offset = 0;
+
+    if (OpenDanMap (&map, path) != DANMAP_OK)
+    {
+        return FALSE;
+    }
+
+    if (GetDanMapConfig (&map, &configSize) == NULL)
+    {
+        CloseDanMap (&map);
+        return FALSE;
+    }
+
+    offset = configSize;
+    while (NextDanMapMessage (&map, &offset, 0, &decoded))
+    {
+        m_Columns.Capacity = MESSAGE_SAMPLES;
+        m_Columns.Rows = 0;
+        AppendSignalColumns (&decoded, &m_Columns);
+        AddColumns (result);
+    }
+
+    /* The configuration ends where it was written */
+    result->Rows += (configSize != m_StreamConfigSize);
+
+    CloseDanMap (&map);
+
+    return TRUE;
+}
+
+/* Read the next block and check it as ReadDanBlock() in RtdmDataLog.c does */
+static BOOL ReadStdioBlock (FILE *p_file, UINT32 blockNumber, DAN_Block_Struct *block)
+{
+    UINT32 blockCrc = 0;
+
+    if (fread (block, 1, sizeof(DAN_Block_Struct), p_file) != sizeof(DAN_Block_Struct))
+    {
+        return FALSE;
+    }
+
+    blockCrc = crc32_fast (0, ((unsigned char*) &block->Header.Sequence),
+                    (sizeof(DAN_Block_Struct) - DAN_BLOCK_CHECKSUM_ADJUST));
+
+    return ((memcmp (block->Header.Delimiter, "DBLK", sizeof(block->Header.Delimiter)) == 0)
+                    && (block->Header.Block_Size == sizeof(DAN_Block_Struct))
+                    && (block->Header.Sequence == blockNumber)
+                    && (block->Header.Num_Samples <= DAN_BLOCK_SAMPLES)
+                    && (blockCrc == block->Header.Block_Checksum));
+}
+
+/* Both sides of every path return the expected rows and the same values; returns the failures */
+static int VerifyPaths (void)
+{
+    static const UINT32 expectedRows[NUM_PATHS] =
+    { (SEGMENT_BLOCKS - 1) * DAN_BLOCK_SAMPLES, TOUCH_BLOCKS * DAN_BLOCK_SAMPLES,
+                    STREAM_MESSAGES * MESSAGE_SAMPLES };
+    BenchResultStr stdioResult;
+    BenchResultStr mapResult;
+    const char *path = NULL;
+    int failures = 0;
+    UINT16 i = 0;
+
+    for (i = 0; i < NUM_PATHS; i++)
+    {
+        path = (i == PATH_STREAM) ? m_StreamPath : m_SegmentPath;
+        memset (&stdioResult, 0, sizeof(stdioResult));
+        memset (&mapResult, 0, sizeof(mapResult));
+
+        if (!m_Stdio[i] (path, &stdioResult) || !m_Map[i] (path, &mapResult)
+                        || (stdioResult.Rows != expectedRows[i]) || (mapResult.Rows != expectedRows[i])
+                        || (stdioResult.Sum != mapResult.Sum))
+        {
+            printf ("Path %u: stdio %u rows sum %llu, map %u rows sum %llu, expected %u rows\n", i,
+                            (unsigned int) stdioResult.Rows, (unsigned long long) stdioResult.Sum,
+                            (unsigned int) mapResult.Rows, (unsigned long long) mapResult.Sum,
+                            (unsigned int) expectedRows[i]);
+            failures++;
+        }
+    }
+
+    return failures;
+}
+
+/* Run one side of a path until minSeconds have elapsed, returns ms per run */
+static double Measure (BenchPathFunc function, const char *path, double minSeconds)
+{
+    BenchResultStr result;
+    double startTime = 0.0;
+    double elapsed = 0.0;
+    UINT32 runs = 0;
+
+    startTime = NowSeconds ();
+
+    do
+    {
+        memset (&result, 0, sizeof(result));
+        if (!function (path, &result))
+        {
+            printf ("%s could not be read\n", path);
+            exit (1);
+        }
+        runs++;
+        elapsed = NowSeconds () - startTime;
+    } while (elapsed < minSeconds);
+
+    return (elapsed * 1000.0) / runs;
+}
+
+static double NowSeconds (void)
+{
+    struct timespec now;
+
+    clock_gettime (CLOCK_MONOTONIC, &now);
+
+    return (double) now.tv_sec + ((double) now.tv_nsec / 1.0e9);
+}
@@ -0,0 +1,843 @@
+/****************************************************************************************************************
+ * PROJECT    : BART
+ *
+ * MODULE     : RtdmDecoder.c
+ *
+ * DESCRIPTON : 	Off-board decoder library for the messages OutputStream() and ServiceEvents() produce.
+ *
+ *	DecodeStreamMessage() takes a whole stream message as sent (IBufferSize, STRM header, header
+ *	extension, samples) and checks it in one pass over the header and one over the samples:
+ *	   - the "STRM" delimiter and that Header_Size and Sample_Size_for_header fit the message
+ *	   - Header_Checksum, from Header_Version to the end of Header_Size, so a header extension is
+ *	     covered as well
+ *	   - Sample_Checksum over Num_Samples and the sample bytes (can be skipped for trusted input)
+ *	Nothing is copied. The result points into the caller's message: the header, the extension when
+ *	Header_Version is 3 or later, and the samples. An extension larger than the fields known here is
+ *	skipped using Header_Size, so a newer recorder can still be read.
+ *
+ *	The samples are RTDM_Struct records laid end to end every SampleStride bytes; with fewer signals
+ *	in the .xml file than the full list the stride is shorter and the signals beyond it are not
+ *	present (StreamHasSignal()). GetStreamSample() returns a sample in place. AppendSignalColumns()
+ *	turns the samples of a message into one column per signal, each signal handled by its own loop
+ *	with the field offset and size fixed, so the work per byte stays small next to the CRC.
+ *
+ *	ReadUnitTable() collects the scale and unit of every Signal element of the configuration once,
+ *	from the .xml file or from the copy at the head of rtdm.dan. NextSignalElement() is the parser
+ *	behind it, for the tools that want the names and decimals as well. ConvertColumn() and
+ *	ConvertColumnFloat() then turn a column of raw values into engineering units (raw * scale) four
+ *	at a time with SSE2, or AVX when the compiler targets it, and one at a time elsewhere. Every
+ *	path converts to double before scaling, so the results are the same to the bit whichever is
+ *	used; IOdometer is unsigned and stays exact above 2^31.
+ *
+ *	DecodeEventMessage() does the same for EVNT messages (Event_Checksum). A priority signal
+ *	transition reaches the receiver twice, as an event and in the bulk stream. Both carry the
+ *	timestamp of the sample taken in the same cycle, so Car_ID + timestamp + Signal_ID identify it;
+ *	FirstSighting() returns TRUE only the first time a key is offered and the other copy is dropped.
+ *	The filter remembers DEDUP_BUCKETS * DEDUP_WAYS keys, the oldest are forgotten first.
+ *
+ *	Fields are read in the byte order of the host, which must be that of the recorder.
+ *
+ * FUNCTIONS:
+ *	UINT16 DecodeStreamMessage (const UINT8 *message, UINT32 messageSize, UINT16 options,
+ *	                StrmMessageStr *decoded)
+ *	const RTDM_Struct *GetStreamSample (const StrmMessageStr *decoded, UINT16 index)
+ *	BOOL StreamHasSignal (const StrmMessageStr *decoded, UINT16 signalId)
+ *	UINT32 AppendSignalColumns (const StrmMessageStr *decoded, StrmColumnsStr *columns)
+ *	UINT16 ReadUnitTable (const char *config, UINT32 size, UnitTableStr *table)
+ *	const char *NextSignalElement (const char *text, const char *limit, SignalElementStr *signal)
+ *	void ConvertColumn (const UnitTableStr *table, UINT16 signalId, const INT32 *raw, UINT32 rows,
+ *	                double *value)
+ *	void ConvertColumnFloat (const UnitTableStr *table, UINT16 signalId, const INT32 *raw,
+ *	                UINT32 rows, float *value)
+ *	UINT16 DecodeEventMessage (const UINT8 *message, UINT32 messageSize, EvntMessageStr *decoded)
+ *	void InitializeEventDedup (EventDedupStr *dedup)
+ *	BOOL FirstSighting (EventDedupStr *dedup, const UINT8 carId[16], UINT32 timeStampS,
+ *	                UINT16 timeStampMs, UINT16 signalId)
+ *	const char *DecodeResultText (UINT16 result)
+ *
+ **********************************************************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <string.h>
+#if defined(__AVX__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "MyTypes.h"
+#include "RTDM_Stream_ext.h"
+#include "crc32.h"
+#include "RtdmDecoder.h"
+
+/*******************************************************************
+ *
+ *     C  O  N  S  T  A  N  T  S
+ *
+ *******************************************************************/
+/* TimeStamp and Count in front of the signals of every sample */
+#define SAMPLE_PREFIX_SIZE          offsetof(RTDM_Struct, Signal)
+
+/* rtdm.dan goes on in binary after its configuration */
+#define CONFIG_END                  "</RtdmCfg>"
+
+#define XML_ELEMENT_SIZE            1024
+#define XML_VALUE_SIZE              128
+
+/* Added to a UINT32 read back as a negative INT32 */
+#define UINT32_WRAP                 4294967296.0
+
+/*******************************************************************
+ *
+ *     E  N  U  M  S
+ *
+ *******************************************************************/
+typedef enum
+{
+    FIELD_INT32, FIELD_UINT32, FIELD_INT16, FIELD_UINT16, FIELD_UINT8
+} FieldType;
+
+/*******************************************************************
+ *
+ *    S  T  R  U  C  T  S
+ *
+ *******************************************************************/
+/* Where the value of a signal sits in a sample */
+typedef struct
+{
+    UINT16 Offset;
+    UINT16 Size;
+    FieldType Type;
+} SignalFieldStr;
+
+/*******************************************************************
+ *
+ *    S  T  A  T  I  C      V  A  R  I  A  B  L  E  S
+ *
+ *******************************************************************/
+#define SIGNAL_FIELD(value, type) \
+    { offsetof(RTDM_Struct, Signal.value), sizeof(((RTDM_Struct *) 0)->Signal.value), type }
+
+/* Indexed by signal ID */
+static const SignalFieldStr m_SignalFields[DECODE_SIGNAL_COUNT] =
+{
+SIGNAL_FIELD(Value_0, FIELD_INT32),
+SIGNAL_FIELD(Value_1, FIELD_INT16),
+SIGNAL_FIELD(Value_2, FIELD_INT16),
+SIGNAL_FIELD(Value_3, FIELD_INT16),
+SIGNAL_FIELD(Value_4, FIELD_INT16),
+SIGNAL_FIELD(Value_5, FIELD_INT16),
+SIGNAL_FIELD(Value_6, FIELD_INT16),
+SIGNAL_FIELD(Value_7, FIELD_INT16),
+SIGNAL_FIELD(Value_8, FIELD_INT32),
+SIGNAL_FIELD(Value_9, FIELD_UINT32),
+SIGNAL_FIELD(Value_10, FIELD_UINT8),
+SIGNAL_FIELD(Value_11, FIELD_UINT8),
+SIGNAL_FIELD(Value_12, FIELD_UINT8),
+SIGNAL_FIELD(Value_13, FIELD_UINT8),
+SIGNAL_FIELD(Value_14, FIELD_UINT8),
+SIGNAL_FIELD(Value_15, FIELD_UINT8),
+SIGNAL_FIELD(Value_16, FIELD_UINT8),
+SIGNAL_FIELD(Value_17, FIELD_UINT8),
+SIGNAL_FIELD(Value_18, FIELD_UINT8),
+SIGNAL_FIELD(Value_19, FIELD_UINT8),
+SIGNAL_FIELD(Value_20, FIELD_UINT8),
+SIGNAL_FIELD(Value_21, FIELD_UINT8),
+SIGNAL_FIELD(Value_22, FIELD_UINT8),
+SIGNAL_FIELD(Value_23, FIELD_UINT16) };
+
+static const char *m_ResultText[] =
+{ "OK", "TOO_SHORT", "UNKNOWN", "BAD_HEADER", "HEADER_CRC", "SAMPLE_CRC" };
+
+/*******************************************************************
+ *
+ *    S  T  A  T  I  C      F  U  N  C  T  I  O  N  S
+ *
+ *******************************************************************/
+static void ExtractColumn (const UINT8 *samples, UINT32 stride, UINT32 count,
+                const SignalFieldStr *field, INT32 *column);
+static const char *FindText (const char *text, const char *limit, const char *pattern);
+static BOOL GetAttribute (const char *element, const char *name, char *value);
+static void CopyValue (char *field, size_t size, const char *value);
+static UINT32 HashKey (const UINT8 carId[16], UINT32 timeStampS, UINT16 timeStampMs,
+                UINT16 signalId);
+
+/*******************************************************************************************
+ *
+ *   Procedure Name : DecodeStreamMessage
+ *
+ *   Functional Description : Validate a stream message and locate its parts in place
+ *
+ *   Parameters : message - starts with IBufferSize, messageSize, options -
+ *                DECODE_SKIP_SAMPLE_CRC or 0, decoded - filled in on DECODE_OK
+ *
+ *   Returned :  DECODE_OK or the first check that failed
+ *
+ ******************************************************************************************/
+UINT16 DecodeStreamMessage (const UINT8 *message, UINT32 messageSize, UINT16 options,
+                StrmMessageStr *decoded)
+{
+    const STRM_Header_Struct *header = NULL;
+    const STRM_Header_Ext_Struct *extension = NULL;
+    const UINT8 *samples = NULL;
+    UINT32 sampleBytes = 0;
+    UINT32 checksum = 0;
+
+    if (messageSize < (DECODE_STRM_OFFSET + sizeof(STRM_Header_Struct)))
+    {
+        return DECODE_TOO_SHORT;
+    }
+
+    header = (const STRM_Header_Struct *) &message[DECODE_STRM_OFFSET];
+
+    if (memcmp (header->Delimiter, "STRM", sizeof(header->Delimiter)) != 0)
+    {
+        return DECODE_UNKNOWN;
+    }
+
+    if (header->Header_Size < sizeof(STRM_Header_Struct))
+    {
+        return DECODE_BAD_HEADER;
+    }
+
+    if ((UINT32) (DECODE_STRM_OFFSET + header->Header_Size) > messageSize)
+    {
+        return DECODE_TOO_SHORT;
+    }
+
+    checksum = crc32_fast (0, &message[DECODE_STRM_OFFSET + STREAM_HEADER_CHECKSUM_ADJUST],
+                    header->Header_Size - STREAM_HEADER_CHECKSUM_ADJUST);
+    if (checksum != header->Header_Checksum)
+    {
+        return DECODE_HEADER_CRC;
+    }
+
+    /* Version 3 on: the extension fills the header beyond the base fields */
+    if ((header->Header_Version >= 3)
+                    && (header->Header_Size >= (sizeof(STRM_Header_Struct) + STREAM_HEADER_EXT_SIZE)))
+    {
+        extension = (const STRM_Header_Ext_Struct *) &message[DECODE_STRM_OFFSET
+                        + sizeof(STRM_Header_Struct)];
+
+        if ((extension->Ext_Size < STREAM_HEADER_EXT_SIZE)
+                        || (extension->Ext_Size > (header->Header_Size - sizeof(STRM_Header_Struct))))
+        {
+            return DECODE_BAD_HEADER;
+        }
+    }
+
+    if (header->Sample_Size_for_header < SAMPLE_SIZE_ADJUSTMENT)
+    {
+        return DECODE_BAD_HEADER;
+    }
+
+    sampleBytes = header->Sample_Size_for_header - SAMPLE_SIZE_ADJUSTMENT;
+    samples = &message[DECODE_STRM_OFFSET + header->Header_Size];
+
+    if ((DECODE_STRM_OFFSET + header->Header_Size + sampleBytes) > messageSize)
+    {
+        return DECODE_TOO_SHORT;
+    }
+
+    /* Every sample has the same size and holds at least its timestamp and count */
+    if (header->Num_Samples == 0)
+    {
+        if (sampleBytes != 0)
+        {
+            return DECODE_BAD_HEADER;
+        }
+    }
+    else if (((sampleBytes % header->Num_Samples) != 0)
+                    || ((sampleBytes / header->Num_Samples) < SAMPLE_PREFIX_SIZE)
+                    || ((sampleBytes / header->Num_Samples) > sizeof(RTDM_Struct)))
+    {
+        return DECODE_BAD_HEADER;
+    }
+
+    if ((options & DECODE_SKIP_SAMPLE_CRC) == 0)
+    {
+        checksum = crc32_fast (0, (const unsigned char *) &header->Num_Samples,
+                        sizeof(header->Num_Samples));
+        checksum = crc32_fast (checksum, samples, sampleBytes);
+        if (checksum != header->Sample_Checksum)
+        {
+            return DECODE_SAMPLE_CRC;
+        }
+    }
+
+    decoded->Header = header;
+    decoded->Extension = extension;
+    decoded->Sequence = (extension != NULL) ? extension->Stream_Sequence : 0;
+    decoded->Samples = samples;
+    decoded->SampleBytes = sampleBytes;
+    decoded->SampleCount = header->Num_Samples;
+    decoded->SampleStride = (header->Num_Samples != 0) ? (sampleBytes / header->Num_Samples) : 0;
+
+    return DECODE_OK;
+}
+
+/* Sample in place; only the signals StreamHasSignal() reports are valid */
+const RTDM_Struct *GetStreamSample (const StrmMessageStr *decoded, UINT16 index)
+{
+    if (index >= decoded->SampleCount)
+    {
+        return NULL;
+    }
+
+    return (const RTDM_Struct *) &decoded->Samples[index * decoded->SampleStride];
+}
+
+/* TRUE if the value of the signal lies within the sample stride */
+BOOL StreamHasSignal (const StrmMessageStr *decoded, UINT16 signalId)
+{
+    if (signalId >= DECODE_SIGNAL_COUNT)
+    {
+        return FALSE;
+    }
+
+    return ((UINT32) (m_SignalFields[signalId].Offset + m_SignalFields[signalId].Size)
+                    <= decoded->SampleStride);
+}
+
+/*******************************************************************************************
+ *
+ *   Procedure Name : AppendSignalColumns
+ *
+ *   Functional Description : Append the samples of a decoded message to the columns. A
+ *   column for a signal the message does not hold is filled with 0.
+ *
+ *   Parameters : decoded, columns - rows are added after columns->Rows
+ *
+ *   Returned :  Rows appended, less than SampleCount if the columns ran out of room
+ *
+ ******************************************************************************************/
+UINT32 AppendSignalColumns (const StrmMessageStr *decoded, StrmColumnsStr *columns)
+{
+    const RTDM_Struct *sample = NULL;
+    UINT32 count = decoded->SampleCount;
+    UINT32 row = columns->Rows;
+    UINT32 stride = decoded->SampleStride;
+    UINT32 i = 0;
+    UINT16 s = 0;
+
+    if (count > (columns->Capacity - row))
+    {
+        count = columns->Capacity - row;
+    }
+
+    for (i = 0; i < count; i++)
+    {
+        sample = (const RTDM_Struct *) &decoded->Samples[i * stride];
+        columns->TimeStamp_S[row + i] = sample->TimeStamp.seconds;
+    }
+
+    if (columns->TimeStamp_mS != NULL)
+    {
+        for (i = 0; i < count; i++)
+        {
+            sample = (const RTDM_Struct *) &decoded->Samples[i * stride];
+            columns->TimeStamp_mS[row + i] = sample->TimeStamp.msecs;
+        }
+    }
+
+    for (s = 0; s < DECODE_SIGNAL_COUNT; s++)
+    {
+        if (columns->Value[s] == NULL)
+        {
+            continue;
+        }
+
+        if (StreamHasSignal (decoded, s))
+        {
+            ExtractColumn (decoded->Samples, stride, count, &m_SignalFields[s],
+                            &columns->Value[s][row]);
+        }
+        else
+        {
+            memset (&columns->Value[s][row], 0, count * sizeof(INT32));
+        }
+    }
+
+    columns->Rows += count;
+
+    return count;
+}
+
+/* One signal of every sample, the field type is fixed for the whole loop */
+static void ExtractColumn (const UINT8 *samples, UINT32 stride, UINT32 count,
+                const SignalFieldStr *field, INT32 *column)
+{
+    const UINT8 *p = samples + field->Offset;
+    UINT32 i = 0;
+    INT32 s32 = 0;
+    UINT32 u32 = 0;
+    INT16 s16 = 0;
+    UINT16 u16 = 0;
+
+    switch (field->Type)
+    {
+        case FIELD_INT32:
+            for (i = 0; i < count; i++, p += stride)
+            {
+                memcpy (&s32, p, sizeof(s32));
+                column[i] = s32;
+            }
+            break;
+
+        case FIELD_UINT32:
+            for (i = 0; i < count; i++, p += stride)
+            {
+                memcpy (&u32, p, sizeof(u32));
+                column[i] = (INT32) u32;
+            }
+            break;
+
+        case FIELD_INT16:
+            for (i = 0; i < count; i++, p += stride)
+            {
+                memcpy (&s16, p, sizeof(s16));
+                column[i] = s16;
+            }
+            break;
+
+        case FIELD_UINT16:
+            for (i = 0; i < count; i++, p += stride)
+            {
+                memcpy (&u16, p, sizeof(u16));
+                column[i] = u16;
+            }
+            break;
+
+        case FIELD_UINT8:
+            for (i = 0; i < count; i++, p += stride)
+            {
+                column[i] = *p;
+            }
+            break;
+
+        default:
+            break;
+    }
+}
+
+/*******************************************************************************************
+ *
+ *   Procedure Name : ReadUnitTable
+ *
+ *   Functional Description : Collect the scale (1 if missing) and unit of every Signal
+ *   element of the configuration. The text does not have to be NUL terminated and ends at
+ *   "</RtdmCfg>" if that comes first, so the head of rtdm.dan can be passed as it is.
+ *
+ *   Parameters : config - configuration text, size - bytes of it, table - filled in
+ *
+ *   Returned :  Number of signals found
+ *
+ ******************************************************************************************/
+UINT16 ReadUnitTable (const char *config, UINT32 size, UnitTableStr *table)
+{
+    SignalElementStr element;
+    UnitConversionStr *signal = NULL;
+    const char *pString = config;
+    const char *pLimit = config + size;
+    UINT16 s = 0;
+
+    memset (table, 0, sizeof(UnitTableStr));
+    for (s = 0; s < DECODE_SIGNAL_COUNT; s++)
+    {
+        table->Signal[s].Scale = 1.0;
+        table->Signal[s].Unsigned = (m_SignalFields[s].Type == FIELD_UINT32);
+    }
+
+    pString = FindText (config, pLimit, CONFIG_END);
+    if (pString != NULL)
+    {
+        pLimit = pString;
+    }
+
+    pString = config;
+    while ((pString = NextSignalElement (pString, pLimit, &element)) != NULL)
+    {
+        signal = &table->Signal[element.Id];
+        if (!signal->Present)
+        {
+            signal->Present = TRUE;
+            table->NumSignals++;
+        }
+
+        signal->Scale = element.Scale;
+        if (element.Unit[0] != '\0')
+        {
+            memcpy (signal->Unit, element.Unit, sizeof(signal->Unit));
+        }
+    }
+
+    return table->NumSignals;
+}
+
+/*******************************************************************************************
+ *
+ *   Procedure Name : NextSignalElement
+ *
+ *   Functional Description : The next Signal element of the configuration with an id of
+ *   0 .. DECODE_SIGNAL_COUNT - 1; the others are stepped over. The text does not have to be
+ *   NUL terminated. Values too long for the fields are cut short.
+ *
+ *   Parameters : text - where to look, limit - end of the text, signal - filled in
+ *
+ *   Returned :  Where to look for the one after, NULL if there is none
+ *
+ ******************************************************************************************/
+const char *NextSignalElement (const char *text, const char *limit, SignalElementStr *signal)
+{
+    char element[XML_ELEMENT_SIZE];
+    char value[XML_VALUE_SIZE];
+    const char *pString = text;
+    const char *pEnd = NULL;
+
+    while ((pString = FindText (pString, limit, "<Signal ")) != NULL)
+    {
+        pEnd = (const char *) memchr (pString, '>', (size_t) (limit - pString));
+        if ((pEnd == NULL) || ((size_t) (pEnd - pString) >= sizeof(element)))
+        {
+            return NULL;
+        }
+        memcpy (element, pString, (size_t) (pEnd - pString));
+        element[pEnd - pString] = '\0';
+        pString = pEnd;
+
+        if (!GetAttribute (element, "id", value) || (atoi (value) < 0)
+                        || (atoi (value) >= DECODE_SIGNAL_COUNT))
+        {
+            continue;
+        }
+
+        memset (signal, 0, sizeof(SignalElementStr));
+        signal->Id = (UINT16) atoi (value);
+        signal->Scale = 1.0;
+
+        if (GetAttribute (element, "name", value))
+        {
+            CopyValue (signal->Name, sizeof(signal->Name), value);
+        }
+        if (GetAttribute (element, "friendlyName", value))
+        {
+            CopyValue (signal->FriendlyName, sizeof(signal->FriendlyName), value);
+        }
+        if (GetAttribute (element, "unit", value))
+        {
+            CopyValue (signal->Unit, sizeof(signal->Unit), value);
+        }
+        if (GetAttribute (element, "scale", value) && (atof (value) != 0.0))
+        {
+            signal->Scale = atof (value);
+        }
+        if (GetAttribute (element, "nbDecimals", value) && (atoi (value) > 0))
+        {
+            signal->Decimals = (UINT16) atoi (value);
+        }
+
+        return pString;
+    }
+
+    return NULL;
+}
+
+/*******************************************************************************************
+ *
+ *   Procedure Name : ConvertColumn
+ *
+ *   Functional Description : Engineering values of a column of raw values, raw * Scale of
+ *   the signal. The vector loops handle four rows at a time, the rest one at a time.
+ *
+ *   Parameters : table - from ReadUnitTable(), signalId, raw - column from
+ *                AppendSignalColumns(), rows, value - rows doubles
+ *
+ *   Returned :  None
+ *
+ ******************************************************************************************/
+void ConvertColumn (const UnitTableStr *table, UINT16 signalId, const INT32 *raw, UINT32 rows,
+                double *value)
+{
+    const UnitConversionStr *signal = &table->Signal[signalId];
+    UINT32 i = 0;
+#if defined(__AVX__)
+    const __m256d scale = _mm256_set1_pd (signal->Scale);
+    const __m256d wrap = _mm256_set1_pd (signal->Unsigned ? UINT32_WRAP : 0.0);
+    const __m256d zero = _mm256_setzero_pd ();
+    __m256d v;
+
+    for (; (i + 4) <= rows; i += 4)
+    {
+        v = _mm256_cvtepi32_pd (_mm_loadu_si128 ((const __m128i *) &raw[i]));
+        v = _mm256_add_pd (v, _mm256_and_pd (_mm256_cmp_pd (v, zero, _CMP_LT_OQ), wrap));
+        _mm256_storeu_pd (&value[i], _mm256_mul_pd (v, scale));
+    }
+#elif defined(__SSE2__)
+    const __m128d scale = _mm_set1_pd (signal->Scale);
+    const __m128d wrap = _mm_set1_pd (signal->Unsigned ? UINT32_WRAP : 0.0);
+    const __m128d zero = _mm_setzero_pd ();
+    __m128i r;
+    __m128d low;
+    __m128d high;
+
+    for (; (i + 4) <= rows; i += 4)
+    {
+        r = _mm_loadu_si128 ((const __m128i *) &raw[i]);
+        low = _mm_cvtepi32_pd (r);
+        high = _mm_cvtepi32_pd (_mm_unpackhi_epi64 (r, r));
+        low = _mm_add_pd (low, _mm_and_pd (_mm_cmplt_pd (low, zero), wrap));
+        high = _mm_add_pd (high, _mm_and_pd (_mm_cmplt_pd (high, zero), wrap));
+        _mm_storeu_pd (&value[i], _mm_mul_pd (low, scale));
+        _mm_storeu_pd (&value[i + 2], _mm_mul_pd (high, scale));
+    }
+#endif
+
+    for (; i < rows; i++)
+    {
+        value[i] = (signal->Unsigned ? (double) (UINT32) raw[i] : (double) raw[i]) * signal->Scale;
+    }
+}
+
+/* As ConvertColumn(), rounded to float after scaling so large raw values are not cut first */
+void ConvertColumnFloat (const UnitTableStr *table, UINT16 signalId, const INT32 *raw,
+                UINT32 rows, float *value)
+{
+    const UnitConversionStr *signal = &table->Signal[signalId];
+    UINT32 i = 0;
+#if defined(__AVX__)
+    const __m256d scale = _mm256_set1_pd (signal->Scale);
+    const __m256d wrap = _mm256_set1_pd (signal->Unsigned ? UINT32_WRAP : 0.0);
+    const __m256d zero = _mm256_setzero_pd ();
+    __m256d v;
+
+    for (; (i + 4) <= rows; i += 4)
+    {
+        v = _mm256_cvtepi32_pd (_mm_loadu_si128 ((const __m128i *) &raw[i]));
+        v = _mm256_add_pd (v, _mm256_and_pd (_mm256_cmp_pd (v, zero, _CMP_LT_OQ), wrap));
+        _mm_storeu_ps (&value[i], _mm256_cvtpd_ps (_mm256_mul_pd (v, scale)));
+    }
+#elif defined(__SSE2__)
+    const __m128d scale = _mm_set1_pd (signal->Scale);
+    const __m128d wrap = _mm_set1_pd (signal->Unsigned ? UINT32_WRAP : 0.0);
+    const __m128d zero = _mm_setzero_pd ();
+    __m128i r;
+    __m128d low;
+    __m128d high;
+
+    for (; (i + 4) <= rows; i += 4)
+    {
+        r = _mm_loadu_si128 ((const __m128i *) &raw[i]);
+        low = _mm_cvtepi32_pd (r);
+        high = _mm_cvtepi32_pd (_mm_unpackhi_epi64 (r, r));
+        low = _mm_add_pd (low, _mm_and_pd (_mm_cmplt_pd (low, zero), wrap));
+        high = _mm_add_pd (high, _mm_and_pd (_mm_cmplt_pd (high, zero), wrap));
+        _mm_storeu_ps (&value[i], _mm_movelh_ps (_mm_cvtpd_ps (_mm_mul_pd (low, scale)),
+                        _mm_cvtpd_ps (_mm_mul_pd (high, scale))));
+    }
+#endif
+
+    for (; i < rows; i++)
+    {
+        value[i] = (float) ((signal->Unsigned ? (double) (UINT32) raw[i] : (double) raw[i])
+                        * signal->Scale);
+    }
+}
+
+/*******************************************************************************************
+ *
+ *   Procedure Name : DecodeEventMessage
+ *
+ *   Functional Description : Validate an event message and locate its records in place
+ *
+ *   Parameters : message - starts with the "EVNT" delimiter, messageSize, decoded - filled in
+ *                on DECODE_OK
+ *
+ *   Returned :  DECODE_OK or the first check that failed
+ *
+ ******************************************************************************************/
+UINT16 DecodeEventMessage (const UINT8 *message, UINT32 messageSize, EvntMessageStr *decoded)
+{
+    const EVNT_Header_Struct *header = (const EVNT_Header_Struct *) message;
+    UINT32 size = 0;
+
+    if (messageSize < sizeof(EVNT_Header_Struct))
+    {
+        return DECODE_TOO_SHORT;
+    }
+
+    if (memcmp (header->Delimiter, "EVNT", sizeof(header->Delimiter)) != 0)
+    {
+        return DECODE_UNKNOWN;
+    }
+
+    if (header->Header_Size < sizeof(EVNT_Header_Struct))
+    {
+        return DECODE_BAD_HEADER;
+    }
+
+    size = header->Header_Size + (header->Num_Events * sizeof(EVNT_Record_Struct));
+    if (size > messageSize)
+    {
+        return DECODE_TOO_SHORT;
+    }
+
+    /* Header from Version on and the records */
+    if (crc32_fast (0, &message[EVNT_HEADER_CHECKSUM_ADJUST], size - EVNT_HEADER_CHECKSUM_ADJUST)
+                    != header->Event_Checksum)
+    {
+        return DECODE_HEADER_CRC;
+    }
+
+    decoded->Header = header;
+    decoded->Records = (const EVNT_Record_Struct *) &message[header->Header_Size];
+    decoded->EventCount = header->Num_Events;
+
+    return DECODE_OK;
+}
+
+void InitializeEventDedup (EventDedupStr *dedup)
+{
+    memset (dedup, 0, sizeof(EventDedupStr));
+}
+
+/*******************************************************************************************
+ *
+ *   Procedure Name : FirstSighting
+ *
+ *   Functional Description : Duplicate filter for priority signal transitions seen both as
+ *   an event and in the stream
+ *
+ *   Parameters : dedup, carId - Car_ID of the message, timeStampS / timeStampMs - the event
+ *                header timestamp or the stream sample timestamp, signalId
+ *
+ *   Returned :  TRUE the first time the key is offered, FALSE for the copy
+ *
+ ******************************************************************************************/
+BOOL FirstSighting (EventDedupStr *dedup, const UINT8 carId[16], UINT32 timeStampS,
+                UINT16 timeStampMs, UINT16 signalId)
+{
+    DedupEntryStr *bucket = NULL;
+    DedupEntryStr *oldest = NULL;
+    UINT16 w = 0;
+
+    bucket = dedup->Entry[HashKey (carId, timeStampS, timeStampMs, signalId) & (DEDUP_BUCKETS - 1)];
+    oldest = &bucket[0];
+
+    for (w = 0; w < DEDUP_WAYS; w++)
+    {
+        if ((bucket[w].Age != 0) && (bucket[w].TimeStamp_S == timeStampS)
+                        && (bucket[w].TimeStamp_mS == timeStampMs)
+                        && (bucket[w].SignalId == signalId)
+                        && (memcmp (bucket[w].CarId, carId, sizeof(bucket[w].CarId)) == 0))
+        {
+            return FALSE;
+        }
+
+        if (bucket[w].Age < oldest->Age)
+        {
+            oldest = &bucket[w];
+        }
+    }
+
+    dedup->Insertions++;
+
+    memcpy (oldest->CarId, carId, sizeof(oldest->CarId));
+    oldest->TimeStamp_S = timeStampS;
+    oldest->TimeStamp_mS = timeStampMs;
+    oldest->SignalId = signalId;
+    oldest->Age = dedup->Insertions;
+
+    return TRUE;
+}
+
+const char *DecodeResultText (UINT16 result)
+{
+    if (result >= (sizeof(m_ResultText) / sizeof(m_ResultText[0])))
+    {
+        return "?";
+    }
+
+    return m_ResultText[result];
+}
+
+/* FNV-1a over the key */
+static UINT32 HashKey (const UINT8 carId[16], UINT32 timeStampS, UINT16 timeStampMs,
+                UINT16 signalId)
+{
+    UINT32 hash = 2166136261UL;
+    UINT16 i = 0;
+
+    for (i = 0; i < 16; i++)
+    {
+        hash = (hash ^ carId[i]) * 16777619UL;
+    }
+
+    hash = (hash ^ timeStampS) * 16777619UL;
+    hash = (hash ^ timeStampMs) * 16777619UL;
+    hash = (hash ^ signalId) * 16777619UL;
+
+    return hash;
+}
+
+/* First pattern in text before limit, NULL if none */
+static const char *FindText (const char *text, const char *limit, const char *pattern)
+{
+    size_t length = strlen (pattern);
+    const char *p = text;
+
+    while ((size_t) (limit - p) >= length)
+    {
+        p = (const char *) memchr (p, pattern[0], (size_t) (limit - p) - length + 1);
+        if (p == NULL)
+        {
+            return NULL;
+        }
+        if (memcmp (p, pattern, length) == 0)
+        {
+            return p;
+        }
+        p++;
+    }
+
+    return NULL;
+}
+
+/* Value of name="..." within one element; a leading space keeps "name" from matching "friendlyName" */
+static BOOL GetAttribute (const char *element, const char *name, char *value)
+{
+    char pattern[XML_VALUE_SIZE];
+    const char *pString = NULL;
+    UINT16 i = 0;
+
+    snprintf (pattern, sizeof(pattern), " %s=\"", name);
+    pString = strstr (element, pattern);
+    if (pString == NULL)
+    {
+        return FALSE;
+    }
+
+    pString += strlen (pattern);
+    while ((i < (XML_VALUE_SIZE - 1)) && (pString[i] != '"') && (pString[i] != '\0'))
+    {
+        value[i] = pString[i];
+        i++;
+    }
+    value[i] = '\0';
+
+    return TRUE;
+}
+
+/* As much of value as fits in the field, always NUL terminated */
+static void CopyValue (char *field, size_t size, const char *value)
+{
+    size_t length = strlen (value);
+
+    if (length >= size)
+    {
+        length = size - 1;
+    }
+    memcpy (field, value, length);
+    field[length] = '\0';
+}
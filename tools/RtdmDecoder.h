@@ -0,0 +1,158 @@
+/*
+ * RtdmDecoder.h
+ *
+ *  Interface of RtdmDecoder.c: off-board decoder library for stream and event messages.
+ */
+
+#ifndef RTDMDECODER_H_
+#define RTDMDECODER_H_
+
+/*******************************************************************
+ *
+ *     C  O  N  S  T  A  N  T  S
+ *
+ *******************************************************************/
+/* Signal ID's 0 .. 23, fixed by SignalStr */
+#define DECODE_SIGNAL_COUNT         24
+
+/* The STRM header follows IBufferSize */
+#define DECODE_STRM_OFFSET          2
+
+/* Longest unit kept from the configuration */
+#define DECODE_UNIT_SIZE            16
+
+/* Longest name kept from the configuration */
+#define DECODE_NAME_SIZE            128
+
+/* Options of DecodeStreamMessage() */
+#define DECODE_SKIP_SAMPLE_CRC      0x0001
+
+/* Results of DecodeStreamMessage() and DecodeEventMessage() */
+#define DECODE_OK                   0
+#define DECODE_TOO_SHORT            1 /* message ends before the header or samples it describes */
+#define DECODE_UNKNOWN              2 /* not a STRM / EVNT message */
+#define DECODE_BAD_HEADER           3 /* sizes in the header do not add up */
+#define DECODE_HEADER_CRC           4
+#define DECODE_SAMPLE_CRC           5
+
+/* Event transitions remembered by the duplicate filter, DEDUP_WAYS per bucket, a power of 2 */
+#define DEDUP_BUCKETS               1024
+#define DEDUP_WAYS                  4
+
+/*******************************************************************
+ *
+ *     E  N  U  M  S
+ *
+ *******************************************************************/
+
+/*******************************************************************
+ *
+ *    S  T  R  U  C  T  S
+ *
+ *******************************************************************/
+/* A validated stream message; every pointer is into the caller's message, nothing is copied */
+typedef struct
+{
+    const STRM_Header_Struct *Header;
+    const STRM_Header_Ext_Struct *Extension; /* NULL before Header_Version 3 */
+    UINT32 Sequence; /* Stream_Sequence, 0 without an extension or when replayed */
+    const UINT8 *Samples; /* first sample */
+    UINT32 SampleBytes; /* bytes of all samples */
+    UINT32 SampleStride; /* bytes from one sample to the next */
+    UINT16 SampleCount;
+} StrmMessageStr;
+
+/* Caller owned columns, one row per sample; rows are appended until Capacity */
+typedef struct
+{
+    UINT32 Capacity;
+    UINT32 Rows;
+    UINT32 *TimeStamp_S;
+    UINT16 *TimeStamp_mS; /* NULL to skip */
+    INT32 *Value[DECODE_SIGNAL_COUNT]; /* by signal ID, NULL to skip; IOdometer (9) is unsigned */
+} StrmColumnsStr;
+
+/* Raw to engineering units of one signal, from its Signal element in the configuration */
+typedef struct
+{
+    BOOL Present; /* the configuration has the signal */
+    BOOL Unsigned; /* a UINT32 carried in an INT32 column (IOdometer) */
+    double Scale; /* engineering value = raw * Scale, 1 if not given */
+    char Unit[DECODE_UNIT_SIZE];
+} UnitConversionStr;
+
+/* Built once by ReadUnitTable(), then used for every column */
+typedef struct
+{
+    UnitConversionStr Signal[DECODE_SIGNAL_COUNT]; /* by signal ID */
+    UINT16 NumSignals;
+} UnitTableStr;
+
+/* A Signal element of the configuration, as NextSignalElement() reads it */
+typedef struct
+{
+    UINT16 Id; /* value Id of SignalStr */
+    char Name[DECODE_NAME_SIZE]; /* as written, e.g. oPCU_I1.PCU_I1.Analog801.ICarSpeed */
+    char FriendlyName[DECODE_NAME_SIZE]; /* empty if not given */
+    char Unit[DECODE_UNIT_SIZE];
+    double Scale; /* 1 if not given */
+    UINT16 Decimals; /* 0 if not given */
+} SignalElementStr;
+
+/* A validated event message, pointers into the caller's message */
+typedef struct
+{
+    const EVNT_Header_Struct *Header;
+    const EVNT_Record_Struct *Records;
+    UINT16 EventCount;
+} EvntMessageStr;
+
+typedef struct
+{
+    UINT8 CarId[16];
+    UINT32 TimeStamp_S;
+    UINT16 TimeStamp_mS;
+    UINT16 SignalId;
+    UINT32 Age; /* insertion order, the oldest way of a bucket is replaced */
+} DedupEntryStr;
+
+/* Transitions seen so far, keyed by Car_ID + timestamp + Signal_ID */
+typedef struct
+{
+    DedupEntryStr Entry[DEDUP_BUCKETS][DEDUP_WAYS];
+    UINT32 Insertions;
+} EventDedupStr;
+
+/*******************************************************************
+ *
+ *    E  X  T  E  R  N      V  A  R  I  A  B  L  E  S
+ *
+ *******************************************************************/
+
+/*******************************************************************
+ *
+ *    E  X  T  E  R  N      F  U  N  C  T  I  O  N  S
+ *
+ *******************************************************************/
+
+UINT16 DecodeStreamMessage (const UINT8 *message, UINT32 messageSize, UINT16 options,
+                StrmMessageStr *decoded);
+const RTDM_Struct *GetStreamSample (const StrmMessageStr *decoded, UINT16 index);
+BOOL StreamHasSignal (const StrmMessageStr *decoded, UINT16 signalId);
+UINT32 AppendSignalColumns (const StrmMessageStr *decoded, StrmColumnsStr *columns);
+
+UINT16 ReadUnitTable (const char *config, UINT32 size, UnitTableStr *table);
+const char *NextSignalElement (const char *text, const char *limit, SignalElementStr *signal);
+void ConvertColumn (const UnitTableStr *table, UINT16 signalId, const INT32 *raw, UINT32 rows,
+                double *value);
+void ConvertColumnFloat (const UnitTableStr *table, UINT16 signalId, const INT32 *raw,
+                UINT32 rows, float *value);
+
+UINT16 DecodeEventMessage (const UINT8 *message, UINT32 messageSize, EvntMessageStr *decoded);
+void InitializeEventDedup (EventDedupStr *dedup);
+BOOL FirstSighting (EventDedupStr *dedup, const UINT8 carId[16], UINT32 timeStampS,
+                UINT16 timeStampMs, UINT16 signalId);
+
+const char *DecodeResultText (UINT16 result);
+
+#endif /* RTDMDECODER_H_ */
@@ -0,0 +1,615 @@
+/****************************************************************************************************************
+ * PROJECT    : BART
+ *
+ * MODULE     : RtdmDecoderBench.c
+ *
+ * DESCRIPTON : 	Off-board check and benchmark of the stream decoder library (RtdmDecoder.c).
+ *
+ *	A set of stream messages is built the way OutputStream() builds them: 60,000 byte buffers of full
+ *	samples (every signal, 98 bytes), header version 3 with the extension, both checksums. Before
+ *	timing, the decoder must return every value that was put in, report a damaged header, damaged
+ *	samples and a short message, read a version 2 header and a longer future extension, and drop the
+ *	stream copy of an event transition. Any failure ends the run (exit code 1).
+ *
+ *	Three paths are then timed over the same messages, in GB/s of message bytes:
+ *	   validate  - DecodeStreamMessage() with both checksums
+ *	   columns   - DecodeStreamMessage() without the sample checksum, then AppendSignalColumns()
+ *	   full      - both checksums and the columns, what an analysis tool does per message
+ *	The full path is compared against the 1 GB/s per core target.
+ *
+ *	The engineering unit conversion (ReadUnitTable(), ConvertColumn(), ConvertColumnFloat()) is
+ *	checked against a plain scalar loop first: the scale and unit of a configuration followed by
+ *	binary data like the head of rtdm.dan, every signal of a message to the bit, IOdometer above
+ *	2^31 and every tail length. Both are then timed over the 24 columns of one message, in millions
+ *	of values per second, to double and to float. The scalar loop is built without GCC's
+ *	vectorizer so that it stays the one-value-at-a-time baseline; add -mavx to time the AVX loop.
+ *
+ * BUILD :
+ *	gcc -O2 -DTEST_ON_PC -DTARGET_SIM_DLL -I../src RtdmDecoderBench.c RtdmDecoder.c ../src/crc32.c
+ *	    -fcommon -o RtdmDecoderBench
+ *
+ * USAGE :
+ *	RtdmDecoderBench [minimum seconds per measurement, default 0.5]
+ *
+ **********************************************************************************************************************/
+
+#define _POSIX_C_SOURCE 199309L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "MyTypes.h"
+#include "RTDM_Stream_ext.h"
+#include "crc32.h"
+#include "RtdmDecoder.h"
+
+/*******************************************************************
+ *
+ *     C  O  N  S  T  A  N  T  S
+ *
+ *******************************************************************/
+/* bufferSize 60,000 holds (60,000 / 98) - 2 samples, see RtdmXml.c */
+#define BUFFER_SIZE             60000
+#define SAMPLES_PER_MESSAGE     ((BUFFER_SIZE / sizeof(RTDM_Struct)) - 2)
+
+/* About 4 MB of messages, more than the caches hold on most hosts */
+#define NUM_MESSAGES            64
+
+#define MESSAGE_SIZE            (DECODE_STRM_OFFSET + STREAM_HEADER_SIZE + STREAM_HEADER_EXT_SIZE \
+                                    + BUFFER_SIZE)
+
+#define TARGET_GB_PER_SEC       1.0
+
+/*******************************************************************
+ *
+ *    S  T  A  T  I  C      V  A  R  I  A  B  L  E  S
+ *
+ *******************************************************************/
+static UINT8 *m_Messages[NUM_MESSAGES];
+static UINT32 m_MessageSize[NUM_MESSAGES];
+
+/* Columns for one message */
+static UINT32 m_TimeStampS[SAMPLES_PER_MESSAGE];
+static UINT16 m_TimeStampMs[SAMPLES_PER_MESSAGE];
+static INT32 m_Values[DECODE_SIGNAL_COUNT][SAMPLES_PER_MESSAGE];
+static StrmColumnsStr m_Columns;
+
+static EventDedupStr m_Dedup;
+
+/* A configuration as it heads rtdm.dan, binary data after </RtdmCfg> */
+static const char m_Config[] =
+                "<RtdmCfg>\n"
+                "  <Signal id=\"2\" name=\"oPCU_I1.PCU_I1.Analog801.ICarSpeed\" dataType=\"UINT16\" "
+                "scale=\"0.01\" unit=\"mph\" nbDecimals=\"2\" />\n"
+                "  <Signal id=\"4\" name=\"oPCU_I1.PCU_I1.Analog801.IDcLinkVoltage\" dataType=\"INT16\" "
+                "scale=\"0.1\" unit=\"V\" nbDecimals=\"1\" />\n"
+                "  <Signal id=\"9\" name=\"oPCU_I1.PCU_I1.Analog801.IOdometer\" dataType=\"UINT32\" "
+                "scale=\"0.005\" unit=\"mi\" nbDecimals=\"3\" />\n"
+                "  <Signal id=\"12\" name=\"oPCU_I1.PCU_I1.Discrete801.CRunRelayCmd\" />\n"
+                "</RtdmCfg>\n"
+                "RTDM\0\x01<Signal id=\"5\" scale=\"9\" />";
+
+static UnitTableStr m_Units;
+static double m_Engineering[DECODE_SIGNAL_COUNT][SAMPLES_PER_MESSAGE];
+static float m_EngineeringFloat[DECODE_SIGNAL_COUNT][SAMPLES_PER_MESSAGE];
+
+/*******************************************************************
+ *
+ *    S  T  A  T  I  C      F  U  N  C  T  I  O  N  S
+ *
+ *******************************************************************/
+static UINT32 BuildMessage (UINT8 *message, UINT32 firstSecond, UINT16 headerVersion,
+                UINT16 extSize);
+static void FillSample (RTDM_Struct *sample, UINT32 second, UINT16 msecs);
+static INT32 ExpectedValue (UINT32 second, UINT16 msecs, UINT16 signalId);
+static int VerifyDecoder (void);
+static double Measure (int path, double minSeconds);
+static int VerifyUnits (void);
+static void ConvertScalar (const UnitConversionStr *signal, const INT32 *raw, UINT32 rows,
+                double *value);
+static void ConvertScalarFloat (const UnitConversionStr *signal, const INT32 *raw, UINT32 rows,
+                float *value);
+static double MeasureUnits (int path, double minSeconds);
+static double NowSeconds (void);
+
+int main (int argc, char *argv[])
+{
+    static const char *pathName[] =
+    { "validate", "columns", "full" };
+    static const char *unitPathName[] =
+    { "double", "float" };
+    double minSeconds = 0.5;
+    double gbPerSec[3];
+    double scalar = 0.0;
+    double vector = 0.0;
+    UINT16 i = 0;
+    int path = 0;
+
+    if (argc > 1)
+    {
+        minSeconds = atof (argv[1]);
+    }
+
+    for (i = 0; i < NUM_MESSAGES; i++)
+    {
+        m_Messages[i] = (UINT8 *) malloc (MESSAGE_SIZE + 16);
+        if (m_Messages[i] == NULL)
+        {
+            printf ("Out of memory\n");
+            return 2;
+        }
+        m_MessageSize[i] = BuildMessage (m_Messages[i], 1000000 + (i * 31), STREAM_HEADER_VERSION,
+                        STREAM_HEADER_EXT_SIZE);
+    }
+
+    m_Columns.Capacity = SAMPLES_PER_MESSAGE;
+    m_Columns.TimeStamp_S = m_TimeStampS;
+    m_Columns.TimeStamp_mS = m_TimeStampMs;
+    for (i = 0; i < DECODE_SIGNAL_COUNT; i++)
+    {
+        m_Columns.Value[i] = m_Values[i];
+    }
+
+    if ((VerifyDecoder () != 0) || (VerifyUnits () != 0))
+    {
+        return 1;
+    }
+
+    printf ("%u messages of %u bytes, %u samples each\n", NUM_MESSAGES,
+                    (unsigned int) m_MessageSize[0], (unsigned int) SAMPLES_PER_MESSAGE);
+    printf ("%-10s %10s\n", "path", "GB/s");
+
+    for (path = 0; path < 3; path++)
+    {
+        gbPerSec[path] = Measure (path, minSeconds);
+        printf ("%-10s %10.3f\n", pathName[path], gbPerSec[path]);
+    }
+
+    printf ("target %.1f GB/s per core: %s\n", TARGET_GB_PER_SEC,
+                    (gbPerSec[2] >= TARGET_GB_PER_SEC) ? "met" : "NOT met");
+
+    printf ("\nunit conversion, %u values per pass\n",
+                    (unsigned int) (DECODE_SIGNAL_COUNT * SAMPLES_PER_MESSAGE));
+    printf ("%-10s %12s %12s %8s\n", "to", "scalar Mv/s", "vector Mv/s", "speedup");
+
+    for (path = 0; path < 2; path++)
+    {
+        scalar = MeasureUnits (path * 2, minSeconds);
+        vector = MeasureUnits ((path * 2) + 1, minSeconds);
+        printf ("%-10s %12.1f %12.1f %7.2fx\n", unitPathName[path], scalar, vector,
+                        vector / scalar);
+    }
+
+    return 0;
+}
+
+/* A stream message like OutputStream() builds, returns its size */
+static UINT32 BuildMessage (UINT8 *message, UINT32 firstSecond, UINT16 headerVersion,
+                UINT16 extSize)
+{
+    STRM_Header_Struct *header = (STRM_Header_Struct *) &message[DECODE_STRM_OFFSET];
+    STRM_Header_Ext_Struct *extension = (STRM_Header_Ext_Struct *) &message[DECODE_STRM_OFFSET
+                    + sizeof(STRM_Header_Struct)];
+    UINT16 headerSize = sizeof(STRM_Header_Struct) + extSize;
+    UINT32 sampleBytes = SAMPLES_PER_MESSAGE * sizeof(RTDM_Struct);
+    RTDM_Struct *sample = NULL;
+    UINT32 i = 0;
+
+    memset (message, 0, DECODE_STRM_OFFSET + headerSize);
+
+    for (i = 0; i < SAMPLES_PER_MESSAGE; i++)
+    {
+        sample = (RTDM_Struct *) &message[DECODE_STRM_OFFSET + headerSize
+                        + (i * sizeof(RTDM_Struct))];
+        FillSample (sample, firstSecond + (i / 20), (UINT16) ((i % 20) * 50));
+    }
+
+    memcpy (header->Delimiter, "STRM", sizeof(header->Delimiter));
+    header->Endiannes = BIG_ENDIAN;
+    header->Header_Size = headerSize;
+    header->Header_Version = headerVersion;
+    memcpy (header->Car_ID, "R2_1234", 7);
+    header->TimeStamp_S = firstSecond + (SAMPLES_PER_MESSAGE / 20);
+    header->Sample_Size_for_header = sampleBytes + SAMPLE_SIZE_ADJUSTMENT;
+    header->Num_Samples = SAMPLES_PER_MESSAGE;
+
+    header->Sample_Checksum = crc32 (0, (unsigned char *) &header->Num_Samples,
+                    sizeof(header->Num_Samples));
+    header->Sample_Checksum = crc32 (header->Sample_Checksum,
+                    &message[DECODE_STRM_OFFSET + headerSize], sampleBytes);
+
+    if (extSize != 0)
+    {
+        extension->Ext_Version = STREAM_HEADER_EXT_VERSION;
+        extension->Ext_Size = extSize;
+        extension->Stream_Sequence = firstSecond;
+    }
+
+    header->Header_Checksum = crc32 (0, &message[DECODE_STRM_OFFSET + STREAM_HEADER_CHECKSUM_ADJUST],
+                    headerSize - STREAM_HEADER_CHECKSUM_ADJUST);
+
+    *(UINT16 *) message = sampleBytes + sizeof(UINT16);
+
+    return DECODE_STRM_OFFSET + headerSize + sampleBytes;
+}
+
+static void FillSample (RTDM_Struct *sample, UINT32 second, UINT16 msecs)
+{
+    SignalStr *s = &sample->Signal;
+
+    sample->TimeStamp.seconds = second;
+    sample->TimeStamp.msecs = msecs;
+    sample->TimeStamp.accuracy = 0;
+    sample->Count = DECODE_SIGNAL_COUNT;
+
+    s->ID_0 = 0;   s->Value_0 = ExpectedValue (second, msecs, 0);
+    s->ID_1 = 1;   s->Value_1 = ExpectedValue (second, msecs, 1);
+    s->ID_2 = 2;   s->Value_2 = ExpectedValue (second, msecs, 2);
+    s->ID_3 = 3;   s->Value_3 = ExpectedValue (second, msecs, 3);
+    s->ID_4 = 4;   s->Value_4 = ExpectedValue (second, msecs, 4);
+    s->ID_5 = 5;   s->Value_5 = ExpectedValue (second, msecs, 5);
+    s->ID_6 = 6;   s->Value_6 = ExpectedValue (second, msecs, 6);
+    s->ID_7 = 7;   s->Value_7 = ExpectedValue (second, msecs, 7);
+    s->ID_8 = 8;   s->Value_8 = ExpectedValue (second, msecs, 8);
+    s->ID_9 = 9;   s->Value_9 = ExpectedValue (second, msecs, 9);
+    s->ID_10 = 10; s->Value_10 = ExpectedValue (second, msecs, 10);
+    s->ID_11 = 11; s->Value_11 = ExpectedValue (second, msecs, 11);
+    s->ID_12 = 12; s->Value_12 = ExpectedValue (second, msecs, 12);
+    s->ID_13 = 13; s->Value_13 = ExpectedValue (second, msecs, 13);
+    s->ID_14 = 14; s->Value_14 = ExpectedValue (second, msecs, 14);
+    s->ID_15 = 15; s->Value_15 = ExpectedValue (second, msecs, 15);
+    s->ID_16 = 16; s->Value_16 = ExpectedValue (second, msecs, 16);
+    s->ID_17 = 17; s->Value_17 = ExpectedValue (second, msecs, 17);
+    s->ID_18 = 18; s->Value_18 = ExpectedValue (second, msecs, 18);
+    s->ID_19 = 19; s->Value_19 = ExpectedValue (second, msecs, 19);
+    s->ID_20 = 20; s->Value_20 = ExpectedValue (second, msecs, 20);
+    s->ID_21 = 21; s->Value_21 = ExpectedValue (second, msecs, 21);
+    s->ID_22 = 22; s->Value_22 = ExpectedValue (second, msecs, 22);
+    s->ID_23 = 23; s->Value_23 = ExpectedValue (second, msecs, 23);
+}
+
+/* Deterministic value that fits the field of every signal, negative where the field is signed */
+static INT32 ExpectedValue (UINT32 second, UINT16 msecs, UINT16 signalId)
+{
+    INT32 seed = (INT32) (((second * 1000) + msecs) * (signalId + 7U));
+
+    switch (signalId)
+    {
+        case 0:
+        case 8:
+            return seed - 500000;
+        case 9:
+            return seed & 0x7FFFFFFF;
+        case 23:
+            return seed & 0xFFFF;
+        default:
+            if (signalId >= 10)
+            {
+                return seed & 0xFF;
+            }
+            return (INT16) (seed & 0xFFFF);
+    }
+}
+
+/* Correctness before speed; returns the number of failures */
+static int VerifyDecoder (void)
+{
+    static UINT8 copy[MESSAGE_SIZE + 16];
+    EvntMessageStr event;
+    EVNT_Header_Struct *eventHeader = NULL;
+    EVNT_Record_Struct *record = NULL;
+    UINT8 eventMessage[sizeof(EVNT_Header_Struct) + sizeof(EVNT_Record_Struct)];
+    StrmMessageStr decoded;
+    const RTDM_Struct *sample = NULL;
+    UINT32 size = 0;
+    UINT32 i = 0;
+    UINT16 s = 0;
+    UINT16 result = 0;
+    int errors = 0;
+
+    /* Every value of one message */
+    result = DecodeStreamMessage (m_Messages[3], m_MessageSize[3], 0, &decoded);
+    if ((result != DECODE_OK) || (decoded.Extension == NULL)
+                    || (decoded.Sequence != 1000000 + (3 * 31))
+                    || (decoded.SampleCount != SAMPLES_PER_MESSAGE))
+    {
+        printf ("FAIL decode: %s\n", DecodeResultText (result));
+        return 1;
+    }
+
+    m_Columns.Rows = 0;
+    AppendSignalColumns (&decoded, &m_Columns);
+    for (i = 0; i < SAMPLES_PER_MESSAGE; i++)
+    {
+        sample = GetStreamSample (&decoded, (UINT16) i);
+        if ((m_TimeStampS[i] != sample->TimeStamp.seconds)
+                        || (m_TimeStampMs[i] != sample->TimeStamp.msecs))
+        {
+            printf ("FAIL timestamp row %lu\n", (unsigned long) i);
+            errors++;
+        }
+        for (s = 0; s < DECODE_SIGNAL_COUNT; s++)
+        {
+            if (m_Values[s][i] != ExpectedValue (m_TimeStampS[i], m_TimeStampMs[i], s))
+            {
+                printf ("FAIL signal %u row %lu: %ld != %ld\n", s, (unsigned long) i,
+                                (long) m_Values[s][i],
+                                (long) ExpectedValue (m_TimeStampS[i], m_TimeStampMs[i], s));
+                errors++;
+            }
+        }
+    }
+
+    /* Damage */
+    memcpy (copy, m_Messages[0], m_MessageSize[0]);
+    copy[DECODE_STRM_OFFSET + 40] ^= 1;
+    if (DecodeStreamMessage (copy, m_MessageSize[0], 0, &decoded) != DECODE_HEADER_CRC)
+    {
+        printf ("FAIL damaged header not found\n");
+        errors++;
+    }
+
+    memcpy (copy, m_Messages[0], m_MessageSize[0]);
+    copy[m_MessageSize[0] - 100] ^= 1;
+    if (DecodeStreamMessage (copy, m_MessageSize[0], 0, &decoded) != DECODE_SAMPLE_CRC)
+    {
+        printf ("FAIL damaged sample not found\n");
+        errors++;
+    }
+    if (DecodeStreamMessage (copy, m_MessageSize[0], DECODE_SKIP_SAMPLE_CRC, &decoded) != DECODE_OK)
+    {
+        printf ("FAIL skipping the sample checksum\n");
+        errors++;
+    }
+
+    if (DecodeStreamMessage (m_Messages[0], m_MessageSize[0] - 1, 0, &decoded) != DECODE_TOO_SHORT)
+    {
+        printf ("FAIL short message accepted\n");
+        errors++;
+    }
+
+    /* Version 2, no extension */
+    size = BuildMessage (copy, 5000, 2, 0);
+    if ((DecodeStreamMessage (copy, size, 0, &decoded) != DECODE_OK) || (decoded.Extension != NULL)
+                    || (GetStreamSample (&decoded, 0)->TimeStamp.seconds != 5000))
+    {
+        printf ("FAIL version 2 header\n");
+        errors++;
+    }
+
+    /* A future extension 4 bytes longer, the samples follow it */
+    size = BuildMessage (copy, 6000, STREAM_HEADER_VERSION, STREAM_HEADER_EXT_SIZE + 4);
+    if ((DecodeStreamMessage (copy, size, 0, &decoded) != DECODE_OK)
+                    || (decoded.Sequence != 6000)
+                    || (GetStreamSample (&decoded, 1)->TimeStamp.msecs != 50))
+    {
+        printf ("FAIL longer extension\n");
+        errors++;
+    }
+
+    /* The event copy of a transition is kept, the stream copy with the same key dropped */
+    memset (eventMessage, 0, sizeof(eventMessage));
+    eventHeader = (EVNT_Header_Struct *) eventMessage;
+    record = (EVNT_Record_Struct *) &eventMessage[sizeof(EVNT_Header_Struct)];
+    memcpy (eventHeader->Delimiter, "EVNT", sizeof(eventHeader->Delimiter));
+    eventHeader->Header_Size = sizeof(EVNT_Header_Struct);
+    eventHeader->Header_Version = EVNT_HEADER_VERSION;
+    memcpy (eventHeader->Car_ID, "R2_1234", 7);
+    eventHeader->TimeStamp_S = 1000000;
+    eventHeader->TimeStamp_mS = 100;
+    eventHeader->Num_Events = 1;
+    record->Signal_ID = 22;
+    record->Previous_Value = 0;
+    record->Value = 1;
+    eventHeader->Event_Checksum = crc32 (0, &eventMessage[EVNT_HEADER_CHECKSUM_ADJUST],
+                    sizeof(eventMessage) - EVNT_HEADER_CHECKSUM_ADJUST);
+
+    InitializeEventDedup (&m_Dedup);
+    result = DecodeEventMessage (eventMessage, sizeof(eventMessage), &event);
+    if ((result != DECODE_OK) || (event.EventCount != 1)
+                    || !FirstSighting (&m_Dedup, event.Header->Car_ID, event.Header->TimeStamp_S,
+                                    event.Header->TimeStamp_mS, event.Records[0].Signal_ID)
+                    || FirstSighting (&m_Dedup, event.Header->Car_ID, 1000000, 100, 22)
+                    || !FirstSighting (&m_Dedup, event.Header->Car_ID, 1000000, 150, 22))
+    {
+        printf ("FAIL event decode or duplicate filter\n");
+        errors++;
+    }
+
+    eventMessage[sizeof(eventMessage) - 1] ^= 1;
+    if (DecodeEventMessage (eventMessage, sizeof(eventMessage), &event) != DECODE_HEADER_CRC)
+    {
+        printf ("FAIL damaged event not found\n");
+        errors++;
+    }
+
+    if (errors != 0)
+    {
+        printf ("%d decoder failures, benchmark aborted\n", errors);
+    }
+
+    return errors;
+}
+
+/* The conversion against the scalar loops, to the bit; returns the number of failures */
+static int VerifyUnits (void)
+{
+    static const INT32 odometer[7] =
+    { 0, 1, 0x7FFFFFFF, (INT32) 0x80000000UL, (INT32) 0xFFFFFFFFUL, (INT32) 0x80000001UL, 12345 };
+    double value[SAMPLES_PER_MESSAGE];
+    double expected[SAMPLES_PER_MESSAGE];
+    float valueFloat[SAMPLES_PER_MESSAGE];
+    float expectedFloat[SAMPLES_PER_MESSAGE];
+    UINT32 rows = 0;
+    UINT16 s = 0;
+    int errors = 0;
+
+    if ((ReadUnitTable (m_Config, sizeof(m_Config) - 1, &m_Units) != 4)
+                    || (m_Units.Signal[2].Scale != 0.01) || (strcmp (m_Units.Signal[2].Unit, "mph") != 0)
+                    || !m_Units.Signal[9].Unsigned || m_Units.Signal[8].Unsigned
+                    || !m_Units.Signal[12].Present || (m_Units.Signal[12].Scale != 1.0)
+                    || m_Units.Signal[5].Present || (m_Units.Signal[5].Scale != 1.0))
+    {
+        printf ("FAIL unit table\n");
+        return 1;
+    }
+
+    /* Every signal, raw values from the message decoded by VerifyDecoder() */
+    for (s = 0; s < DECODE_SIGNAL_COUNT; s++)
+    {
+        ConvertColumn (&m_Units, s, m_Values[s], SAMPLES_PER_MESSAGE, value);
+        ConvertScalar (&m_Units.Signal[s], m_Values[s], SAMPLES_PER_MESSAGE, expected);
+        ConvertColumnFloat (&m_Units, s, m_Values[s], SAMPLES_PER_MESSAGE, valueFloat);
+        ConvertScalarFloat (&m_Units.Signal[s], m_Values[s], SAMPLES_PER_MESSAGE, expectedFloat);
+        if ((memcmp (value, expected, sizeof(value)) != 0)
+                        || (memcmp (valueFloat, expectedFloat, sizeof(valueFloat)) != 0))
+        {
+            printf ("FAIL conversion of signal %u\n", s);
+            errors++;
+        }
+    }
+
+    /* Unsigned above 2^31, and every length so each tail is taken */
+    for (rows = 0; rows <= 7; rows++)
+    {
+        memset (value, 0, sizeof(value));
+        ConvertColumn (&m_Units, 9, odometer, rows, value);
+        ConvertScalar (&m_Units.Signal[9], odometer, 7, expected);
+        memset (&expected[rows], 0, (7 - rows) * sizeof(double));
+        if (memcmp (value, expected, 7 * sizeof(double)) != 0)
+        {
+            printf ("FAIL IOdometer conversion of %u rows\n", (unsigned int) rows);
+            errors++;
+        }
+    }
+    if (value[4] != (4294967295.0 * 0.005))
+    {
+        printf ("FAIL IOdometer 0xFFFFFFFF is %f\n", value[4]);
+        errors++;
+    }
+
+    if (errors != 0)
+    {
+        printf ("%d conversion failures, benchmark aborted\n", errors);
+    }
+
+    return errors;
+}
+
+/* The baseline, one value at a time; GCC would otherwise vectorize it at -O3 */
+__attribute__ ((optimize ("no-tree-vectorize")))
+static void ConvertScalar (const UnitConversionStr *signal, const INT32 *raw, UINT32 rows,
+                double *value)
+{
+    UINT32 i = 0;
+
+    for (i = 0; i < rows; i++)
+    {
+        value[i] = (signal->Unsigned ? (double) (UINT32) raw[i] : (double) raw[i]) * signal->Scale;
+    }
+}
+
+__attribute__ ((optimize ("no-tree-vectorize")))
+static void ConvertScalarFloat (const UnitConversionStr *signal, const INT32 *raw, UINT32 rows,
+                float *value)
+{
+    UINT32 i = 0;
+
+    for (i = 0; i < rows; i++)
+    {
+        value[i] = (float) ((signal->Unsigned ? (double) (UINT32) raw[i] : (double) raw[i])
+                        * signal->Scale);
+    }
+}
+
+/* Convert the 24 columns of one message until minSeconds have elapsed, returns millions of
+ * values per second. Paths: 0 scalar double, 1 vector double, 2 scalar float, 3 vector float */
+static double MeasureUnits (int path, double minSeconds)
+{
+    double startTime = 0.0;
+    double elapsed = 0.0;
+    double values = 0.0;
+    UINT16 s = 0;
+
+    startTime = NowSeconds ();
+
+    do
+    {
+        for (s = 0; s < DECODE_SIGNAL_COUNT; s++)
+        {
+            switch (path)
+            {
+                case 0:
+                    ConvertScalar (&m_Units.Signal[s], m_Values[s], SAMPLES_PER_MESSAGE,
+                                    m_Engineering[s]);
+                    break;
+                case 1:
+                    ConvertColumn (&m_Units, s, m_Values[s], SAMPLES_PER_MESSAGE, m_Engineering[s]);
+                    break;
+                case 2:
+                    ConvertScalarFloat (&m_Units.Signal[s], m_Values[s], SAMPLES_PER_MESSAGE,
+                                    m_EngineeringFloat[s]);
+                    break;
+                default:
+                    ConvertColumnFloat (&m_Units, s, m_Values[s], SAMPLES_PER_MESSAGE,
+                                    m_EngineeringFloat[s]);
+                    break;
+            }
+        }
+        values += DECODE_SIGNAL_COUNT * SAMPLES_PER_MESSAGE;
+        elapsed = NowSeconds () - startTime;
+    } while (elapsed < minSeconds);
+
+    return values / elapsed / 1.0e6;
+}
+
+/* Run one path over all messages until minSeconds have elapsed, returns GB/s */
+static double Measure (int path, double minSeconds)
+{
+    StrmMessageStr decoded;
+    volatile UINT32 sink = 0;
+    double startTime = 0.0;
+    double elapsed = 0.0;
+    double bytes = 0.0;
+    UINT16 options = (path == 1) ? DECODE_SKIP_SAMPLE_CRC : 0;
+    UINT16 i = 0;
+
+    startTime = NowSeconds ();
+
+    do
+    {
+        for (i = 0; i < NUM_MESSAGES; i++)
+        {
+            if (DecodeStreamMessage (m_Messages[i], m_MessageSize[i], options, &decoded)
+                            != DECODE_OK)
+            {
+                printf ("Message %u did not decode\n", i);
+                exit (1);
+            }
+
+            if (path != 0)
+            {
+                m_Columns.Rows = 0;
+                sink += AppendSignalColumns (&decoded, &m_Columns);
+            }
+
+            bytes += m_MessageSize[i];
+        }
+        elapsed = NowSeconds () - startTime;
+    } while (elapsed < minSeconds);
+
+    (void) sink;
+
+    return bytes / elapsed / 1.0e9;
+}
+
+static double NowSeconds (void)
+{
+    struct timespec now;
+
+    clock_gettime (CLOCK_MONOTONIC, &now);
+
+    return (double) now.tv_sec + ((double) now.tv_nsec / 1.0e9);
+}
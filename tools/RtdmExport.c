@@ -0,0 +1,1260 @@
+/****************************************************************************************************************
+ * PROJECT    : BART
+ *
+ * MODULE     : RtdmExport.c
+ *
+ * DESCRIPTON : 	Off-board exporter of the data log ring segments (N.dan) and rtdm.dan to CSV or a compact
+ *	columnar binary file.
+ *
+ *	The work is done on a pool of worker threads in two parallel phases with a short serial merge in
+ *	between:
+ *	   decode - one job per file. A segment is mapped (RtdmDanMap.c), every block is checked
+ *	            (delimiter, sequence, Block_Checksum) and its samples turned into columns; the block
+ *	            count of a segment without a closed header comes from the file size, so the segment
+ *	            still being written is included. In rtdm.dan every
+ *	            STRM message is found by its delimiter and validated with the stream decoder
+ *	            (RtdmDecoder.c, both checksums), whatever precedes the first one (XML, RTDM header)
+ *	            is skipped. A file whose samples are out of time order is sorted.
+ *	   merge  - the files are merged by sample time. The ring and rtdm.dan hold copies of the same
+ *	            samples, a sample with the timestamp of the one before is dropped.
+ *	   format - the merged rows are split into chunks, one job each, formatted in memory and written
+ *	            in order by the main thread.
+ *	Decoding scales with the cores up to the number of files, formatting with the cores.
+ *
+ *	The signals, their names, units, scale and number of decimals come from the Signal elements of
+ *	the .xml configuration; signal id N is value N of the sample (SignalStr) and has its size.
+ *
+ *	CSV: one row per sample, "time" (epoch seconds with msecs) then a column "friendlyName [unit]" per
+ *	signal holding value * scale with nbDecimals decimals.
+ *
+ *	Columnar (COL): an EXPORT_Header_Struct, Num_Columns EXPORT_Column_Struct describing the signals,
+ *	then whole columns one after the other: TimeStamp_S (UINT32 per row), TimeStamp_mS (UINT16 per
+ *	row), then each signal at its size in SignalStr (1, 2 or 4 bytes per row). Values are stored as
+ *	recorded, a reader multiplies by Scale, so nothing is lost and a row costs what it did on board.
+ *
+ *	Engineering (ENG): the columnar layout with "RENG" as delimiter and every signal a double
+ *	(Value_Size 8) already in engineering units, Scale 1. The scale of each signal is taken from the
+ *	configuration rtdm.dan starts with, the one the recorder ran with, or from config.xml when there
+ *	is no rtdm.dan; the format jobs convert their rows with ConvertColumn() (RtdmDecoder.c, SIMD).
+ *
+ *	Times per phase and rows/s are printed at the end.
+ *
+ * BUILD :
+ *	gcc -O2 -DTEST_ON_PC -DTARGET_SIM_DLL -I../src RtdmExport.c RtdmDanMap.c RtdmDecoder.c
+ *	    ../src/crc32.c -fcommon -lpthread -lm -o RtdmExport
+ *
+ * USAGE :
+ *	RtdmExport config.xml CSV|COL|ENG output [threads, default 0 = every core] [directory, default .]
+ *	e.g. RtdmExport RTDMConfiguration_PCU.xml CSV day.csv 8 /media/datalog
+ *
+ **********************************************************************************************************************/
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "MyTypes.h"
+#include "RTDM_Stream_ext.h"
+#include "crc32.h"
+#include "RtdmDecoder.h"
+#include "RtdmDanMap.h"
+
+/*******************************************************************
+ *
+ *     C  O  N  S  T  A  N  T  S
+ *
+ *******************************************************************/
+/* The data log ring, as named in RtdmDataLog.c, and rtdm.dan */
+#define EXPORT_RING_FILES       25
+#define EXPORT_MAX_FILES        (EXPORT_RING_FILES + 1)
+
+#define EXPORT_MAX_THREADS      64
+
+/* Format jobs per thread, so a slow chunk does not leave the others idle */
+#define CHUNKS_PER_THREAD       4
+
+/* Rows gathered for one ConvertColumn() call in ENG, fits the first level cache */
+#define CONVERT_ROWS            1024
+
+/* Longest formatted value: sign, 10 digits, point, decimals, separator */
+#define CSV_VALUE_SIZE          24
+
+#define EXPORT_HEADER_VERSION   1
+
+/* Export Header Checksum does not include the first 11 bytes, starts at Version, covers the columns */
+#define EXPORT_HEADER_CHECKSUM_ADJUST   11
+
+/*******************************************************************
+ *
+ *     E  N  U  M  S
+ *
+ *******************************************************************/
+typedef enum
+{
+    OUTPUT_CSV, OUTPUT_COLUMNS, OUTPUT_ENGINEERING
+} OutputType;
+
+/*******************************************************************
+ *
+ *    S  T  R  U  C  T  S
+ *
+ *******************************************************************/
+/* Header of the columnar file */
+typedef struct
+{
+    char Delimiter[4]; /* "RCOL" */
+    uint8_t Endiannes;
+    uint16_t Header_Size __attribute__ ((packed)); /* this header and the column descriptions */
+    uint32_t Header_Checksum __attribute__ ((packed));
+    uint8_t Header_Version;
+    uint32_t Num_Rows __attribute__ ((packed));
+    uint16_t Num_Columns __attribute__ ((packed)); /* signals, the two time columns not counted */
+    uint32_t FirstTimeStamp_S __attribute__ ((packed));
+    uint16_t FirstTimeStamp_mS __attribute__ ((packed));
+    uint32_t LastTimeStamp_S __attribute__ ((packed));
+    uint16_t LastTimeStamp_mS __attribute__ ((packed));
+} EXPORT_Header_Struct;
+
+/* One signal column of the columnar file */
+typedef struct
+{
+    uint16_t Signal_ID __attribute__ ((packed));
+    uint8_t Value_Size; /* 1, 2 or 4 bytes per row; 8, a double, in ENG */
+    uint8_t Value_Signed;
+    double Scale __attribute__ ((packed)); /* engineering value = stored value * Scale */
+    uint8_t Decimals;
+    char Name[48];
+    char Unit[16];
+} EXPORT_Column_Struct;
+
+/* A signal of the .xml configuration */
+typedef struct
+{
+    UINT16 Id;
+    char Name[48];
+    char Unit[16];
+    double Scale;
+    UINT16 Decimals;
+    UINT16 Size;
+    BOOL Signed;
+    INT32 Power; /* 10 ^ Decimals */
+} ExportSignalStr;
+
+/* The samples of one file, in time order once decoded */
+typedef struct
+{
+    char Path[512];
+    UINT32 Rows;
+    UINT32 *TimeStamp_S;
+    UINT16 *TimeStamp_mS;
+    INT32 *Value[DECODE_SIGNAL_COUNT];
+    UINT32 Units; /* blocks or messages accepted */
+    UINT32 Rejected; /* blocks or messages failing their checks */
+    BOOL Sorted; /* had to be sorted */
+    BOOL Found;
+} ExportFileStr;
+
+/* A range of merged rows */
+typedef struct
+{
+    UINT32 First;
+    UINT32 Count;
+    char *Text; /* CSV */
+    size_t TextSize;
+} ExportChunkStr;
+
+/* Work handed to the pool */
+typedef void (*ExportJobFunc) (void *argument);
+
+typedef struct
+{
+    pthread_t Thread[EXPORT_MAX_THREADS];
+    int NumThreads;
+    pthread_mutex_t Lock;
+    pthread_cond_t Wake;
+    pthread_cond_t Done;
+    ExportJobFunc Function;
+    void **Argument;
+    int NumJobs;
+    int NextJob;
+    int Finished;
+    BOOL Quit;
+} ExportPoolStr;
+
+/*******************************************************************
+ *
+ *    S  T  A  T  I  C      V  A  R  I  A  B  L  E  S
+ *
+ *******************************************************************/
+static ExportSignalStr m_Signal[DECODE_SIGNAL_COUNT];
+static UINT16 m_NumSignals = 0;
+
+static ExportFileStr m_File[EXPORT_MAX_FILES];
+static int m_NumFiles = 0;
+
+/* Merged order: file and row of each output row */
+static UINT8 *m_MergeFile = NULL;
+static UINT32 *m_MergeRow = NULL;
+static UINT32 m_MergeRows = 0;
+
+/* Columnar output, filled by the format jobs */
+static UINT32 *m_OutTimeS = NULL;
+static UINT16 *m_OutTimeMs = NULL;
+static UINT8 *m_OutValue[DECODE_SIGNAL_COUNT];
+
+/* Bytes of each value as carried in SignalStr, indexed by signal ID. This is what is stored, the
+ * dataType in the .xml does not always agree (IRateRequest). IDs 0 .. 8 are signed. */
+static const UINT16 m_ValueSize[DECODE_SIGNAL_COUNT] =
+{ 4, 2, 2, 2, 2, 2, 2, 2, 4, 4, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 2 };
+
+static OutputType m_Output = OUTPUT_CSV;
+
+/* Scales for ENG, parsed once */
+static UnitTableStr m_Units;
+
+static ExportPoolStr m_Pool;
+
+/*******************************************************************
+ *
+ *    S  T  A  T  I  C      F  U  N  C  T  I  O  N  S
+ *
+ *******************************************************************/
+static int ReadConfiguration (const char *fileName);
+static BOOL ReadEmbeddedConfiguration (const char *path);
+static UINT8 *ReadWholeFile (const char *path, UINT32 *size);
+static BOOL AllocateFile (ExportFileStr *file, UINT32 rows);
+static void DecodeFile (void *argument);
+static void DecodeSegment (ExportFileStr *file, DanMapStr *map);
+static void DecodeStreamFile (ExportFileStr *file, DanMapStr *map);
+static void SortFile (ExportFileStr *file);
+static int MergeFiles (void);
+static void FormatChunk (void *argument);
+static char *FormatValue (char *text, INT32 raw, const ExportSignalStr *signal);
+static int WriteCsv (FILE *out, ExportChunkStr *chunk, int numChunks);
+static int WriteColumns (FILE *out);
+
+static void StartPool (int numThreads);
+static void RunJobs (ExportJobFunc function, void **argument, int numJobs);
+static void StopPool (void);
+static void *PoolThread (void *argument);
+
+static double NowSeconds (void);
+
+int main (int argc, char *argv[])
+{
+    static ExportChunkStr chunk[EXPORT_MAX_THREADS * CHUNKS_PER_THREAD];
+    void *argument[EXPORT_MAX_THREADS * CHUNKS_PER_THREAD];
+    const char *directory = ".";
+    FILE *out = NULL;
+    double start = 0.0;
+    double decoded = 0.0;
+    double merged = 0.0;
+    double formatted = 0.0;
+    double written = 0.0;
+    UINT32 chunkRows = 0;
+    UINT32 samples = 0;
+    int numThreads = 0;
+    int numChunks = 0;
+    int result = 0;
+    int i = 0;
+
+    if (argc < 4)
+    {
+        printf ("usage: %s config.xml CSV|COL|ENG output [threads] [directory]\n", argv[0]);
+        return 2;
+    }
+    if (strcmp (argv[2], "COL") == 0)
+    {
+        m_Output = OUTPUT_COLUMNS;
+    }
+    else if (strcmp (argv[2], "ENG") == 0)
+    {
+        m_Output = OUTPUT_ENGINEERING;
+    }
+    else if (strcmp (argv[2], "CSV") != 0)
+    {
+        printf ("Output %s is not CSV, COL or ENG\n", argv[2]);
+        return 2;
+    }
+    if (argc > 4)
+    {
+        numThreads = atoi (argv[4]);
+    }
+    if (argc > 5)
+    {
+        directory = argv[5];
+    }
+
+    if (numThreads <= 0)
+    {
+        numThreads = (int) sysconf (_SC_NPROCESSORS_ONLN);
+    }
+    if (numThreads < 1)
+    {
+        numThreads = 1;
+    }
+    if (numThreads > EXPORT_MAX_THREADS)
+    {
+        numThreads = EXPORT_MAX_THREADS;
+    }
+
+    if (ReadConfiguration (argv[1]) != 0)
+    {
+        return 1;
+    }
+
+    /* The ring, then rtdm.dan */
+    for (i = 0; i < EXPORT_RING_FILES; i++)
+    {
+        snprintf (m_File[i].Path, sizeof(m_File[i].Path), "%s/%d.dan", directory, i + 1);
+    }
+    snprintf (m_File[i].Path, sizeof(m_File[i].Path), "%s/%s", directory, RTDM_DATA_FILE);
+    m_NumFiles = EXPORT_MAX_FILES;
+
+    if (m_Output == OUTPUT_ENGINEERING)
+    {
+        printf ("units from %s\n",
+                        ReadEmbeddedConfiguration (m_File[EXPORT_RING_FILES].Path) ?
+                                        m_File[EXPORT_RING_FILES].Path : argv[1]);
+    }
+
+    start = NowSeconds ();
+    StartPool (numThreads);
+
+    for (i = 0; i < m_NumFiles; i++)
+    {
+        argument[i] = &m_File[i];
+    }
+    RunJobs (DecodeFile, argument, m_NumFiles);
+    decoded = NowSeconds ();
+
+    for (i = 0; i < m_NumFiles; i++)
+    {
+        if (m_File[i].Found)
+        {
+            printf ("%-24s %8u samples, %6u accepted, %4u rejected%s\n", m_File[i].Path,
+                            (unsigned int) m_File[i].Rows, (unsigned int) m_File[i].Units,
+                            (unsigned int) m_File[i].Rejected, m_File[i].Sorted ? ", sorted" : "");
+            samples += m_File[i].Rows;
+        }
+    }
+
+    if (MergeFiles () != 0)
+    {
+        StopPool ();
+        return 1;
+    }
+    merged = NowSeconds ();
+
+    /* Even chunks of merged rows */
+    numChunks = numThreads * CHUNKS_PER_THREAD;
+    chunkRows = (m_MergeRows + numChunks - 1) / numChunks;
+    for (i = 0; i < numChunks; i++)
+    {
+        chunk[i].First = i * chunkRows;
+        chunk[i].Count = 0;
+        if (chunk[i].First < m_MergeRows)
+        {
+            chunk[i].Count = m_MergeRows - chunk[i].First;
+            if (chunk[i].Count > chunkRows)
+            {
+                chunk[i].Count = chunkRows;
+            }
+        }
+        argument[i] = &chunk[i];
+    }
+    RunJobs (FormatChunk, argument, numChunks);
+    formatted = NowSeconds ();
+
+    StopPool ();
+
+    out = fopen (argv[3], "wb");
+    if (out == NULL)
+    {
+        printf ("%s could not be created\n", argv[3]);
+        return 1;
+    }
+    if (m_Output == OUTPUT_CSV)
+    {
+        result = WriteCsv (out, chunk, numChunks);
+    }
+    else
+    {
+        result = WriteColumns (out);
+    }
+    if (fclose (out) != 0)
+    {
+        result = -1;
+    }
+    written = NowSeconds ();
+
+    if (result != 0)
+    {
+        printf ("%s could not be written\n", argv[3]);
+        return 1;
+    }
+
+    printf ("%u samples, %u rows after merge, %u signals, %d threads\n", (unsigned int) samples,
+                    (unsigned int) m_MergeRows, m_NumSignals, numThreads);
+    printf ("decode %.3f s, merge %.3f s, format %.3f s, write %.3f s, total %.3f s, "
+                    "%.0f rows/s\n", decoded - start, merged - decoded, formatted - merged,
+                    written - formatted, written - start,
+                    m_MergeRows / (((written - start) > 0.0) ? (written - start) : 1.0));
+
+    return 0;
+}
+
+/*******************************************************************************************
+ *
+ *   Procedure Name : ReadConfiguration
+ *
+ *   Functional Description : Collect the Signal elements of the .xml configuration: id,
+ *   friendlyName (name if missing), scale (1 if missing), unit and nbDecimals
+ *
+ *   Parameters : fileName
+ *
+ *   Returned :  0, -1 if the file holds no usable signal
+ *
+ ******************************************************************************************/
+static int ReadConfiguration (const char *fileName)
+{
+    SignalElementStr element;
+    ExportSignalStr *signal = NULL;
+    UINT32 size = 0;
+    char *xml = (char *) ReadWholeFile (fileName, &size);
+    const char *pString = xml;
+    UINT16 i = 0;
+
+    if (xml == NULL)
+    {
+        printf ("%s could not be read\n", fileName);
+        return -1;
+    }
+
+    while ((m_NumSignals < DECODE_SIGNAL_COUNT)
+                    && ((pString = NextSignalElement (pString, xml + size, &element)) != NULL))
+    {
+        signal = &m_Signal[m_NumSignals];
+        memset (signal, 0, sizeof(ExportSignalStr));
+        signal->Id = element.Id;
+
+        snprintf (signal->Name, sizeof(signal->Name), "%.*s", (int) sizeof(signal->Name) - 1,
+                        (element.FriendlyName[0] != '\0') ? element.FriendlyName : element.Name);
+        snprintf (signal->Unit, sizeof(signal->Unit), "%.*s", (int) sizeof(signal->Unit) - 1,
+                        element.Unit);
+        signal->Scale = element.Scale;
+
+        signal->Decimals = element.Decimals;
+        if (signal->Decimals > 6)
+        {
+            signal->Decimals = 6;
+        }
+        signal->Power = 1;
+        for (i = 0; i < signal->Decimals; i++)
+        {
+            signal->Power *= 10;
+        }
+
+        signal->Size = m_ValueSize[signal->Id];
+        signal->Signed = (signal->Id <= 8);
+
+        m_NumSignals++;
+    }
+
+    ReadUnitTable (xml, size, &m_Units);
+
+    free (xml);
+
+    if (m_NumSignals == 0)
+    {
+        printf ("%s has no Signal elements\n", fileName);
+        return -1;
+    }
+
+    return 0;
+}
+
+/* Unit table from the configuration rtdm.dan starts with; FALSE, and the table of config.xml
+ * kept, if there is no rtdm.dan or it holds no Signal element */
+static BOOL ReadEmbeddedConfiguration (const char *path)
+{
+    UnitTableStr units;
+    DanMapStr map;
+    const char *config = NULL;
+    UINT32 size = 0;
+    BOOL found = FALSE;
+
+    if (OpenDanMap (&map, path) != DANMAP_OK)
+    {
+        return FALSE;
+    }
+
+    config = GetDanMapConfig (&map, &size);
+    if ((config != NULL) && (ReadUnitTable (config, size, &units) != 0))
+    {
+        m_Units = units;
+        found = TRUE;
+    }
+
+    CloseDanMap (&map);
+
+    return found;
+}
+
+/* The .xml in memory, NUL terminated; NULL if missing */
+static UINT8 *ReadWholeFile (const char *path, UINT32 *size)
+{
+    FILE *p_file = fopen (path, "rb");
+    UINT8 *buffer = NULL;
+    long fileSize = 0;
+
+    if (p_file == NULL)
+    {
+        return NULL;
+    }
+
+    fseek (p_file, 0L, SEEK_END);
+    fileSize = ftell (p_file);
+    fseek (p_file, 0L, SEEK_SET);
+
+    if (fileSize >= 0)
+    {
+        buffer = (UINT8 *) malloc ((size_t) fileSize + 1);
+    }
+    if ((buffer != NULL) && (fread (buffer, 1, (size_t) fileSize, p_file) != (size_t) fileSize))
+    {
+        free (buffer);
+        buffer = NULL;
+    }
+    fclose (p_file);
+
+    if (buffer == NULL)
+    {
+        return NULL;
+    }
+
+    buffer[fileSize] = '\0';
+    *size = (UINT32) fileSize;
+
+    return buffer;
+}
+
+/* Columns for the configured signals only */
+static BOOL AllocateFile (ExportFileStr *file, UINT32 rows)
+{
+    UINT16 i = 0;
+
+    file->TimeStamp_S = (UINT32 *) malloc ((rows + 1) * sizeof(UINT32));
+    file->TimeStamp_mS = (UINT16 *) malloc ((rows + 1) * sizeof(UINT16));
+    if ((file->TimeStamp_S == NULL) || (file->TimeStamp_mS == NULL))
+    {
+        return FALSE;
+    }
+
+    for (i = 0; i < m_NumSignals; i++)
+    {
+        file->Value[m_Signal[i].Id] = (INT32 *) malloc ((rows + 1) * sizeof(INT32));
+        if (file->Value[m_Signal[i].Id] == NULL)
+        {
+            return FALSE;
+        }
+    }
+
+    return TRUE;
+}
+
+/*******************************************************************************************
+ *
+ *   Procedure Name : DecodeFile
+ *
+ *   Functional Description : Decode job: one ring segment or rtdm.dan into columns in time
+ *   order. A file that is missing is skipped.
+ *
+ *   Parameters : argument - ExportFileStr
+ *
+ *   Returned :  None
+ *
+ ******************************************************************************************/
+static void DecodeFile (void *argument)
+{
+    ExportFileStr *file = (ExportFileStr *) argument;
+    DanMapStr map;
+    UINT32 i = 0;
+
+    /* Mapped, not read: the jobs decode straight out of the page cache */
+    if (OpenDanMap (&map, file->Path) != DANMAP_OK)
+    {
+        return;
+    }
+    file->Found = TRUE;
+
+    if (map.Kind == DANMAP_SEGMENT)
+    {
+        DecodeSegment (file, &map);
+    }
+    else
+    {
+        DecodeStreamFile (file, &map);
+    }
+
+    CloseDanMap (&map);
+
+    /* Segments are written in time order, rtdm.dan may have been restarted */
+    for (i = 1; i < file->Rows; i++)
+    {
+        if ((file->TimeStamp_S[i] < file->TimeStamp_S[i - 1])
+                        || ((file->TimeStamp_S[i] == file->TimeStamp_S[i - 1])
+                                        && (file->TimeStamp_mS[i] < file->TimeStamp_mS[i - 1])))
+        {
+            SortFile (file);
+            break;
+        }
+    }
+}
+
+/* Blocks of a data log segment, see WriteDanBlock() in RtdmDataLog.c */
+static void DecodeSegment (ExportFileStr *file, DanMapStr *map)
+{
+    StrmColumnsStr columns;
+    UINT32 numBlocks = 0;
+    UINT32 b = 0;
+    UINT16 s = 0;
+
+    if (GetDanMapHeader (map) == NULL)
+    {
+        file->Rejected++;
+        return;
+    }
+
+    numBlocks = GetDanMapBlockCount (map);
+    if (!AllocateFile (file, numBlocks * DAN_BLOCK_SAMPLES))
+    {
+        printf ("Out of memory for %s\n", file->Path);
+        return;
+    }
+
+    memset (&columns, 0, sizeof(columns));
+    columns.Capacity = numBlocks * DAN_BLOCK_SAMPLES;
+    columns.TimeStamp_S = file->TimeStamp_S;
+    columns.TimeStamp_mS = file->TimeStamp_mS;
+    for (s = 0; s < DECODE_SIGNAL_COUNT; s++)
+    {
+        columns.Value[s] = file->Value[s];
+    }
+
+    for (b = 0; b < numBlocks; b++)
+    {
+        if (GetDanMapBlock (map, b) == NULL)
+        {
+            file->Rejected++;
+            continue;
+        }
+
+        DecodeDanMapBlock (map, b, &columns);
+        file->Units++;
+    }
+
+    file->Rows = columns.Rows;
+}
+
+/* STRM messages wherever they are in the file, the first pass only counts samples */
+static void DecodeStreamFile (ExportFileStr *file, DanMapStr *map)
+{
+    StrmMessageStr decoded;
+    StrmColumnsStr columns;
+    UINT32 totalSamples = 0;
+    UINT32 offset = 0;
+    UINT16 s = 0;
+
+    memset (&columns, 0, sizeof(columns));
+
+    offset = 0;
+    while (NextDanMapMessage (map, &offset, 0, &decoded))
+    {
+        totalSamples += decoded.SampleCount;
+        file->Units++;
+    }
+    file->Rejected += map->MessagesRejected;
+
+    if (!AllocateFile (file, totalSamples))
+    {
+        printf ("Out of memory for %s\n", file->Path);
+        return;
+    }
+    columns.Capacity = totalSamples;
+    columns.TimeStamp_S = file->TimeStamp_S;
+    columns.TimeStamp_mS = file->TimeStamp_mS;
+    for (s = 0; s < DECODE_SIGNAL_COUNT; s++)
+    {
+        columns.Value[s] = file->Value[s];
+    }
+
+    /* The sample CRCs were checked by the first pass */
+    offset = 0;
+    while (NextDanMapMessage (map, &offset, DECODE_SKIP_SAMPLE_CRC, &decoded))
+    {
+        AppendSignalColumns (&decoded, &columns);
+    }
+
+    file->Rows = columns.Rows;
+}
+
+/* Put the rows of a file in time order */
+static int CompareRows (const void *a, const void *b, void *context)
+{
+    const ExportFileStr *file = (const ExportFileStr *) context;
+    UINT32 rowA = *(const UINT32 *) a;
+    UINT32 rowB = *(const UINT32 *) b;
+
+    if (file->TimeStamp_S[rowA] != file->TimeStamp_S[rowB])
+    {
+        return (file->TimeStamp_S[rowA] < file->TimeStamp_S[rowB]) ? -1 : 1;
+    }
+    if (file->TimeStamp_mS[rowA] != file->TimeStamp_mS[rowB])
+    {
+        return (file->TimeStamp_mS[rowA] < file->TimeStamp_mS[rowB]) ? -1 : 1;
+    }
+
+    /* Stable */
+    return (rowA < rowB) ? -1 : (rowA > rowB);
+}
+
+static void SortFile (ExportFileStr *file)
+{
+    UINT32 *order = (UINT32 *) malloc (file->Rows * sizeof(UINT32));
+    INT32 *copy = (INT32 *) malloc (file->Rows * sizeof(INT32));
+    UINT32 i = 0;
+    UINT16 s = 0;
+
+    if ((order == NULL) || (copy == NULL))
+    {
+        free (order);
+        free (copy);
+        return;
+    }
+
+    for (i = 0; i < file->Rows; i++)
+    {
+        order[i] = i;
+    }
+    qsort_r (order, file->Rows, sizeof(UINT32), CompareRows, file);
+
+    /* The time columns last, the comparison needs them */
+    for (s = 0; s < DECODE_SIGNAL_COUNT; s++)
+    {
+        if (file->Value[s] != NULL)
+        {
+            for (i = 0; i < file->Rows; i++)
+            {
+                copy[i] = file->Value[s][order[i]];
+            }
+            memcpy (file->Value[s], copy, file->Rows * sizeof(INT32));
+        }
+    }
+    for (i = 0; i < file->Rows; i++)
+    {
+        copy[i] = (INT32) file->TimeStamp_mS[order[i]];
+    }
+    for (i = 0; i < file->Rows; i++)
+    {
+        file->TimeStamp_mS[i] = (UINT16) copy[i];
+    }
+    for (i = 0; i < file->Rows; i++)
+    {
+        copy[i] = (INT32) file->TimeStamp_S[order[i]];
+    }
+    for (i = 0; i < file->Rows; i++)
+    {
+        file->TimeStamp_S[i] = (UINT32) copy[i];
+    }
+
+    file->Sorted = TRUE;
+    free (order);
+    free (copy);
+}
+
+/*******************************************************************************************
+ *
+ *   Procedure Name : MergeFiles
+ *
+ *   Functional Description : Merge the files by sample time into m_MergeFile / m_MergeRow.
+ *   Only the order is built here, the values are copied by the format jobs. A row with the
+ *   timestamp of the row before is the copy of a sample held in both the ring and rtdm.dan.
+ *
+ *   Parameters : None
+ *
+ *   Returned :  0, -1 out of memory
+ *
+ ******************************************************************************************/
+static int MergeFiles (void)
+{
+    unsigned long long headTime[EXPORT_MAX_FILES];
+    unsigned long long lastTime = 0;
+    UINT32 head[EXPORT_MAX_FILES];
+    UINT32 total = 0;
+    BOOL first = TRUE;
+    int best = 0;
+    int i = 0;
+
+    for (i = 0; i < m_NumFiles; i++)
+    {
+        total += m_File[i].Rows;
+        head[i] = 0;
+        if (m_File[i].Rows != 0)
+        {
+            headTime[i] = (m_File[i].TimeStamp_S[0] * 1000ULL) + m_File[i].TimeStamp_mS[0];
+        }
+    }
+
+    m_MergeFile = (UINT8 *) malloc (total + 1);
+    m_MergeRow = (UINT32 *) malloc ((total + 1) * sizeof(UINT32));
+    if ((m_MergeFile == NULL) || (m_MergeRow == NULL))
+    {
+        printf ("Out of memory for %u rows\n", (unsigned int) total);
+        return -1;
+    }
+
+    for (;;)
+    {
+        best = -1;
+        for (i = 0; i < m_NumFiles; i++)
+        {
+            if ((head[i] < m_File[i].Rows) && ((best < 0) || (headTime[i] < headTime[best])))
+            {
+                best = i;
+            }
+        }
+        if (best < 0)
+        {
+            break;
+        }
+
+        if (first || (headTime[best] != lastTime))
+        {
+            m_MergeFile[m_MergeRows] = (UINT8) best;
+            m_MergeRow[m_MergeRows] = head[best];
+            m_MergeRows++;
+            lastTime = headTime[best];
+            first = FALSE;
+        }
+
+        head[best]++;
+        if (head[best] < m_File[best].Rows)
+        {
+            headTime[best] = (m_File[best].TimeStamp_S[head[best]] * 1000ULL)
+                            + m_File[best].TimeStamp_mS[head[best]];
+        }
+    }
+
+    if (m_Output != OUTPUT_CSV)
+    {
+        m_OutTimeS = (UINT32 *) malloc ((m_MergeRows + 1) * sizeof(UINT32));
+        m_OutTimeMs = (UINT16 *) malloc ((m_MergeRows + 1) * sizeof(UINT16));
+        if ((m_OutTimeS == NULL) || (m_OutTimeMs == NULL))
+        {
+            return -1;
+        }
+        for (i = 0; i < m_NumSignals; i++)
+        {
+            m_OutValue[i] = (UINT8 *) malloc ((m_MergeRows + 1)
+                            * ((m_Output == OUTPUT_ENGINEERING) ? sizeof(double) : m_Signal[i].Size));
+            if (m_OutValue[i] == NULL)
+            {
+                return -1;
+            }
+        }
+    }
+
+    return 0;
+}
+
+/*******************************************************************************************
+ *
+ *   Procedure Name : FormatChunk
+ *
+ *   Functional Description : Format job: CSV text of a range of merged rows, their values
+ *   copied into the output columns at their stored size, or converted to engineering units
+ *
+ *   Parameters : argument - ExportChunkStr
+ *
+ *   Returned :  None
+ *
+ ******************************************************************************************/
+static void FormatChunk (void *argument)
+{
+    ExportChunkStr *chunk = (ExportChunkStr *) argument;
+    const ExportFileStr *file = NULL;
+    char *text = NULL;
+    UINT32 row = 0;
+    UINT32 r = 0;
+    UINT32 out = 0;
+    INT32 raw = 0;
+    INT32 gather[CONVERT_ROWS];
+    UINT32 first = 0;
+    UINT32 count = 0;
+    UINT16 i = 0;
+
+    if (m_Output != OUTPUT_CSV)
+    {
+        for (r = 0; r < chunk->Count; r++)
+        {
+            out = chunk->First + r;
+            file = &m_File[m_MergeFile[out]];
+            row = m_MergeRow[out];
+            m_OutTimeS[out] = file->TimeStamp_S[row];
+            m_OutTimeMs[out] = file->TimeStamp_mS[row];
+        }
+
+        /* The raw values of a signal gathered side by side, then converted all at once */
+        if (m_Output == OUTPUT_ENGINEERING)
+        {
+            for (i = 0; i < m_NumSignals; i++)
+            {
+                for (first = 0; first < chunk->Count; first += count)
+                {
+                    count = chunk->Count - first;
+                    if (count > CONVERT_ROWS)
+                    {
+                        count = CONVERT_ROWS;
+                    }
+                    for (r = 0; r < count; r++)
+                    {
+                        out = chunk->First + first + r;
+                        gather[r] = m_File[m_MergeFile[out]].Value[m_Signal[i].Id][m_MergeRow[out]];
+                    }
+                    ConvertColumn (&m_Units, m_Signal[i].Id, gather, count,
+                                    &((double *) m_OutValue[i])[chunk->First + first]);
+                }
+            }
+            return;
+        }
+
+        /* Column by column, the size is fixed for the whole loop */
+        for (i = 0; i < m_NumSignals; i++)
+        {
+            for (r = 0; r < chunk->Count; r++)
+            {
+                out = chunk->First + r;
+                raw = m_File[m_MergeFile[out]].Value[m_Signal[i].Id][m_MergeRow[out]];
+                switch (m_Signal[i].Size)
+                {
+                    case 4:
+                        memcpy (&m_OutValue[i][out * 4], &raw, 4);
+                        break;
+                    case 2:
+                        *(INT16 *) &m_OutValue[i][out * 2] = (INT16) raw;
+                        break;
+                    default:
+                        m_OutValue[i][out] = (UINT8) raw;
+                        break;
+                }
+            }
+        }
+        return;
+    }
+
+    chunk->Text = (char *) malloc (((size_t) chunk->Count * (CSV_VALUE_SIZE * (m_NumSignals + 1)))
+                    + 1);
+    if (chunk->Text == NULL)
+    {
+        return;
+    }
+
+    text = chunk->Text;
+    for (r = 0; r < chunk->Count; r++)
+    {
+        out = chunk->First + r;
+        file = &m_File[m_MergeFile[out]];
+        row = m_MergeRow[out];
+
+        text += sprintf (text, "%u.%03u", (unsigned int) file->TimeStamp_S[row],
+                        (unsigned int) file->TimeStamp_mS[row]);
+        for (i = 0; i < m_NumSignals; i++)
+        {
+            *text++ = ',';
+            text = FormatValue (text, file->Value[m_Signal[i].Id][row], &m_Signal[i]);
+        }
+        *text++ = '\n';
+    }
+
+    chunk->TextSize = (size_t) (text - chunk->Text);
+}
+
+/* raw * Scale with Decimals decimals, rounded, without printf */
+static char *FormatValue (char *text, INT32 raw, const ExportSignalStr *signal)
+{
+    char digits[24];
+    double scaled = 0.0;
+    long long fixed = 0;
+    unsigned long long magnitude = 0;
+    int numDigits = 0;
+
+    /* A UINT32 signal is carried in an INT32 column */
+    if (!signal->Signed && (signal->Size == 4))
+    {
+        scaled = (double) (UINT32) raw;
+    }
+    else
+    {
+        scaled = (double) raw;
+    }
+    scaled *= signal->Scale * signal->Power;
+    fixed = llround (scaled);
+
+    if (fixed < 0)
+    {
+        *text++ = '-';
+        magnitude = (unsigned long long) (-fixed);
+    }
+    else
+    {
+        magnitude = (unsigned long long) fixed;
+    }
+
+    do
+    {
+        digits[numDigits++] = (char) ('0' + (magnitude % 10));
+        magnitude /= 10;
+    }
+    while ((magnitude != 0) || (numDigits <= signal->Decimals));
+
+    while (numDigits > 0)
+    {
+        if (numDigits == signal->Decimals)
+        {
+            *text++ = '.';
+        }
+        *text++ = digits[--numDigits];
+    }
+
+    return text;
+}
+
+static int WriteCsv (FILE *out, ExportChunkStr *chunk, int numChunks)
+{
+    UINT16 i = 0;
+    int c = 0;
+
+    fprintf (out, "time");
+    for (i = 0; i < m_NumSignals; i++)
+    {
+        if (m_Signal[i].Unit[0] != '\0')
+        {
+            fprintf (out, ",%s [%s]", m_Signal[i].Name, m_Signal[i].Unit);
+        }
+        else
+        {
+            fprintf (out, ",%s", m_Signal[i].Name);
+        }
+    }
+    fprintf (out, "\n");
+
+    for (c = 0; c < numChunks; c++)
+    {
+        if ((chunk[c].Count != 0) && (chunk[c].Text == NULL))
+        {
+            return -1;
+        }
+        if (fwrite (chunk[c].Text, 1, chunk[c].TextSize, out) != chunk[c].TextSize)
+        {
+            return -1;
+        }
+        free (chunk[c].Text);
+    }
+
+    return 0;
+}
+
+/* Header, column descriptions, then the columns */
+static int WriteColumns (FILE *out)
+{
+    EXPORT_Header_Struct header;
+    EXPORT_Column_Struct column[DECODE_SIGNAL_COUNT];
+    UINT32 checksum = 0;
+    UINT16 i = 0;
+
+    memset (&header, 0, sizeof(header));
+    memset (column, 0, sizeof(column));
+
+    memcpy (header.Delimiter, (m_Output == OUTPUT_ENGINEERING) ? "RENG" : "RCOL",
+                    sizeof(header.Delimiter));
+    header.Endiannes = BIG_ENDIAN;
+    header.Header_Size = sizeof(EXPORT_Header_Struct) + (m_NumSignals * sizeof(EXPORT_Column_Struct));
+    header.Header_Version = EXPORT_HEADER_VERSION;
+    header.Num_Rows = m_MergeRows;
+    header.Num_Columns = m_NumSignals;
+    if (m_MergeRows != 0)
+    {
+        header.FirstTimeStamp_S = m_OutTimeS[0];
+        header.FirstTimeStamp_mS = m_OutTimeMs[0];
+        header.LastTimeStamp_S = m_OutTimeS[m_MergeRows - 1];
+        header.LastTimeStamp_mS = m_OutTimeMs[m_MergeRows - 1];
+    }
+
+    for (i = 0; i < m_NumSignals; i++)
+    {
+        column[i].Signal_ID = m_Signal[i].Id;
+        column[i].Value_Size = (uint8_t) m_Signal[i].Size;
+        column[i].Value_Signed = (uint8_t) m_Signal[i].Signed;
+        column[i].Scale = m_Signal[i].Scale;
+        if (m_Output == OUTPUT_ENGINEERING)
+        {
+            column[i].Value_Size = sizeof(double);
+            column[i].Value_Signed = 1;
+            column[i].Scale = 1.0;
+        }
+        column[i].Decimals = (uint8_t) m_Signal[i].Decimals;
+        memcpy (column[i].Name, m_Signal[i].Name, sizeof(column[i].Name));
+        memcpy (column[i].Unit, m_Signal[i].Unit, sizeof(column[i].Unit));
+    }
+
+    /* crc = 0 is flipped in crc.c to 0xFFFFFFFF */
+    checksum = crc32 (0, (unsigned char *) &header.Header_Version,
+                    sizeof(header) - EXPORT_HEADER_CHECKSUM_ADJUST);
+    header.Header_Checksum = crc32 (checksum, (unsigned char *) column,
+                    m_NumSignals * sizeof(EXPORT_Column_Struct));
+
+    if ((fwrite (&header, 1, sizeof(header), out) != sizeof(header))
+                    || (fwrite (column, sizeof(EXPORT_Column_Struct), m_NumSignals, out) != m_NumSignals)
+                    || (fwrite (m_OutTimeS, sizeof(UINT32), m_MergeRows, out) != m_MergeRows)
+                    || (fwrite (m_OutTimeMs, sizeof(UINT16), m_MergeRows, out) != m_MergeRows))
+    {
+        return -1;
+    }
+
+    for (i = 0; i < m_NumSignals; i++)
+    {
+        if (fwrite (m_OutValue[i], column[i].Value_Size, m_MergeRows, out) != m_MergeRows)
+        {
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+/*******************************************************************************************
+ *
+ *   Procedure Name : StartPool / RunJobs / StopPool
+ *
+ *   Functional Description : A fixed set of worker threads. RunJobs() hands out the jobs in
+ *   order, one at a time to whichever worker is free, and returns when all have finished.
+ *
+ ******************************************************************************************/
+static void StartPool (int numThreads)
+{
+    int i = 0;
+
+    memset (&m_Pool, 0, sizeof(m_Pool));
+    pthread_mutex_init (&m_Pool.Lock, NULL);
+    pthread_cond_init (&m_Pool.Wake, NULL);
+    pthread_cond_init (&m_Pool.Done, NULL);
+
+    for (i = 0; i < numThreads; i++)
+    {
+        if (pthread_create (&m_Pool.Thread[i], NULL, PoolThread, NULL) != 0)
+        {
+            break;
+        }
+        m_Pool.NumThreads++;
+    }
+}
+
+static void RunJobs (ExportJobFunc function, void **argument, int numJobs)
+{
+    int i = 0;
+
+    /* Without a worker the jobs run here */
+    if (m_Pool.NumThreads == 0)
+    {
+        for (i = 0; i < numJobs; i++)
+        {
+            function (argument[i]);
+        }
+        return;
+    }
+
+    pthread_mutex_lock (&m_Pool.Lock);
+    m_Pool.Function = function;
+    m_Pool.Argument = argument;
+    m_Pool.NumJobs = numJobs;
+    m_Pool.NextJob = 0;
+    m_Pool.Finished = 0;
+    pthread_cond_broadcast (&m_Pool.Wake);
+
+    while (m_Pool.Finished < numJobs)
+    {
+        pthread_cond_wait (&m_Pool.Done, &m_Pool.Lock);
+    }
+    m_Pool.NumJobs = 0;
+    pthread_mutex_unlock (&m_Pool.Lock);
+}
+
+static void StopPool (void)
+{
+    int i = 0;
+
+    pthread_mutex_lock (&m_Pool.Lock);
+    m_Pool.Quit = TRUE;
+    pthread_cond_broadcast (&m_Pool.Wake);
+    pthread_mutex_unlock (&m_Pool.Lock);
+
+    for (i = 0; i < m_Pool.NumThreads; i++)
+    {
+        pthread_join (m_Pool.Thread[i], NULL);
+    }
+    m_Pool.NumThreads = 0;
+}
+
+static void *PoolThread (void *argument)
+{
+    ExportJobFunc function = NULL;
+    void *jobArgument = NULL;
+
+    (void) argument;
+
+    pthread_mutex_lock (&m_Pool.Lock);
+    for (;;)
+    {
+        while (!m_Pool.Quit && (m_Pool.NextJob >= m_Pool.NumJobs))
+        {
+            pthread_cond_wait (&m_Pool.Wake, &m_Pool.Lock);
+        }
+        if (m_Pool.Quit)
+        {
+            break;
+        }
+
+        function = m_Pool.Function;
+        jobArgument = m_Pool.Argument[m_Pool.NextJob];
+        m_Pool.NextJob++;
+
+        pthread_mutex_unlock (&m_Pool.Lock);
+        function (jobArgument);
+        pthread_mutex_lock (&m_Pool.Lock);
+
+        m_Pool.Finished++;
+        if (m_Pool.Finished == m_Pool.NumJobs)
+        {
+            pthread_cond_signal (&m_Pool.Done);
+        }
+    }
+    pthread_mutex_unlock (&m_Pool.Lock);
+
+    return NULL;
+}
+
+static double NowSeconds (void)
+{
+    struct timespec now;
+
+    clock_gettime (CLOCK_MONOTONIC, &now);
+
+    return now.tv_sec + (now.tv_nsec / 1.0e9);
+}
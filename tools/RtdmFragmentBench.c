@@ -0,0 +1,335 @@
+/****************************************************************************************************************
+ * PROJECT    : BART
+ *
+ * MODULE     : RtdmFragmentBench.c
+ *
+ * DESCRIPTON : 	Loss benchmark of the stream fragmenter and reassembler (src/RtdmFragment.c) over UDP
+ *	loopback.
+ *
+ *	Full size stream messages (60,094 bytes) are fragmented at the given MTU and sent to a receiver
+ *	thread on 127.0.0.1 that reassembles them. Between the fragmenter and the socket, fragments are
+ *	dropped with the injected loss probability and held back one place (sent after the next fragment)
+ *	with the reorder probability. The sender keeps a bounded number of fragments in flight so the kernel
+ *	does not add losses of its own. Every delivered message is compared byte for byte with what was sent.
+ *
+ *	For each loss rate the run reports the message delivery rate next to the (1 - p)^n expected without
+ *	retransmission, the reassembler's timeout, eviction and duplicate counts, and the delivered payload
+ *	throughput.
+ *
+ * BUILD :
+ *	gcc -O2 -DTEST_ON_PC -DTARGET_SIM_DLL -I../src RtdmFragmentBench.c ../src/RtdmFragment.c
+ *	    ../src/crc32.c -fcommon -lpthread -lm -o RtdmFragmentBench
+ *
+ * USAGE :
+ *	RtdmFragmentBench [mtu, default 1400] [messages per loss rate, default 500] [reorder, default 0.05]
+ *
+ **********************************************************************************************************************/
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
+#include <sched.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include "MyTypes.h"
+#include "RTDM_Stream_ext.h"
+#include "RtdmFragment.h"
+
+/*******************************************************************
+ *
+ *     C  O  N  S  T  A  N  T  S
+ *
+ *******************************************************************/
+/* IBufferSize (2) + STRM header (85) + header extension (7) + 60,000 byte buffer */
+#define MESSAGE_SIZE            60094
+
+#define BENCH_PORT              20560
+
+/* Fragments allowed in flight between sender and receiver */
+#define FLIGHT_WINDOW           512
+
+#define REASSEMBLY_TIMEOUT_MS   100
+
+/*******************************************************************
+ *
+ *    S  T  A  T  I  C      V  A  R  I  A  B  L  E  S
+ *
+ *******************************************************************/
+static const double m_LossRates[] =
+{ 0.0, 0.0001, 0.001, 0.01, 0.05 };
+
+#define NUM_LOSS_RATES  (sizeof(m_LossRates) / sizeof(double))
+
+static int m_SendSocket = -1;
+static int m_ReceiveSocket = -1;
+static struct sockaddr_in m_Address;
+
+/* Injection state, sender side */
+static double m_LossRate = 0.0;
+static double m_ReorderRate = 0.0;
+static UINT8 m_HeldFragment[FRAG_MAX_MTU];
+static UINT32 m_HeldSize = 0;
+static unsigned long m_Dropped = 0;
+static unsigned long m_Reordered = 0;
+
+/* Fragments handed to the socket, and fragments seen by the receiver */
+static volatile unsigned long m_Sent = 0;
+static volatile unsigned long m_Received = 0;
+
+static volatile int m_Stop = 0;
+static ReassemblerStr m_Reassembler;
+static unsigned long m_Delivered = 0;
+static unsigned long m_Mismatched = 0;
+
+/* Fragment being built by FragmentMessage() */
+static UINT8 m_FragmentBuffer[FRAG_MAX_MTU];
+
+/*******************************************************************
+ *
+ *    S  T  A  T  I  C      F  U  N  C  T  I  O  N  S
+ *
+ *******************************************************************/
+static UINT16 InjectingSend (void *context, const UINT8 *fragment, UINT32 fragmentSize);
+static void RawSend (const UINT8 *fragment, UINT32 fragmentSize);
+static void *ReceiverThread (void *arg);
+static void FillMessage (UINT8 *message, UINT32 sequence);
+static UINT32 NowMs (void);
+static double NowSeconds (void);
+
+int main (int argc, char *argv[])
+{
+    UINT8 *message = NULL;
+    pthread_t thread;
+    unsigned int mtu = 1400;
+    unsigned int messages = 500;
+    unsigned int fragments = 0;
+    unsigned int i = 0;
+    unsigned int r = 0;
+    int receiveBufferSize = 16 * 1024 * 1024;
+    struct timeval timeout;
+    double start = 0.0;
+    double elapsed = 0.0;
+    UINT32 sequence = 0;
+
+    if (argc > 1)
+    {
+        mtu = (unsigned int) atoi (argv[1]);
+    }
+    if (argc > 2)
+    {
+        messages = (unsigned int) atoi (argv[2]);
+    }
+    m_ReorderRate = (argc > 3) ? atof (argv[3]) : 0.05;
+
+    if ((mtu < FRAG_MIN_MTU) || (mtu > FRAG_MAX_MTU))
+    {
+        printf ("mtu must be %d to %d\n", FRAG_MIN_MTU, FRAG_MAX_MTU);
+        return 2;
+    }
+
+    fragments = (MESSAGE_SIZE + (mtu - sizeof(FRAG_Header_Struct)) - 1)
+                    / (mtu - sizeof(FRAG_Header_Struct));
+
+    memset (&m_Address, 0, sizeof(m_Address));
+    m_Address.sin_family = AF_INET;
+    m_Address.sin_port = htons (BENCH_PORT);
+    m_Address.sin_addr.s_addr = htonl (INADDR_LOOPBACK);
+
+    m_ReceiveSocket = socket (AF_INET, SOCK_DGRAM, 0);
+    setsockopt (m_ReceiveSocket, SOL_SOCKET, SO_RCVBUF, &receiveBufferSize,
+                    sizeof(receiveBufferSize));
+    timeout.tv_sec = 0;
+    timeout.tv_usec = 20000;
+    setsockopt (m_ReceiveSocket, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    if (bind (m_ReceiveSocket, (struct sockaddr *) &m_Address, sizeof(m_Address)) != 0)
+    {
+        perror ("bind");
+        return 1;
+    }
+    m_SendSocket = socket (AF_INET, SOCK_DGRAM, 0);
+
+    message = (UINT8 *) malloc (MESSAGE_SIZE);
+    srand (12345);
+
+    printf ("MTU %u, %u fragments per message, %u byte fragment header, %u messages per rate, reorder %.3f\n",
+                    mtu, fragments, (unsigned int) sizeof(FRAG_Header_Struct), messages, m_ReorderRate);
+    printf ("%8s %10s %10s %10s %9s %9s %9s %10s %10s\n", "loss", "delivered", "expected",
+                    "dropped", "reorder", "timeout", "evicted", "dup", "MB/s");
+
+    for (r = 0; r < NUM_LOSS_RATES; r++)
+    {
+        m_LossRate = m_LossRates[r];
+        m_Dropped = 0;
+        m_Reordered = 0;
+        m_Delivered = 0;
+        m_Mismatched = 0;
+        m_Sent = 0;
+        m_Received = 0;
+        m_Stop = 0;
+        InitializeReassembler (&m_Reassembler, MESSAGE_SIZE, REASSEMBLY_TIMEOUT_MS);
+
+        pthread_create (&thread, NULL, ReceiverThread, NULL);
+
+        start = NowSeconds ();
+        for (i = 0; i < messages; i++)
+        {
+            sequence++;
+            FillMessage (message, sequence);
+            FragmentMessage (message, MESSAGE_SIZE, sequence, mtu, m_FragmentBuffer, InjectingSend,
+                            NULL);
+        }
+
+        /* A fragment still held back goes out last */
+        if (m_HeldSize != 0)
+        {
+            RawSend (m_HeldFragment, m_HeldSize);
+            m_HeldSize = 0;
+        }
+
+        /* Wait for the receiver to catch up, then let the rest time out */
+        while (m_Received < m_Sent)
+        {
+            sched_yield ();
+        }
+        elapsed = NowSeconds () - start;
+        m_Stop = 1;
+        pthread_join (thread, NULL);
+        ExpireReassembly (&m_Reassembler, NowMs () + REASSEMBLY_TIMEOUT_MS + 1);
+
+        printf ("%8.4f %9.2f%% %9.2f%% %10lu %9lu %9u %9u %10u %10.1f%s\n", m_LossRate,
+                        (100.0 * m_Delivered) / messages,
+                        100.0 * pow (1.0 - m_LossRate, fragments), m_Dropped, m_Reordered,
+                        (unsigned int) m_Reassembler.TimedOut, (unsigned int) m_Reassembler.Evicted,
+                        (unsigned int) m_Reassembler.Duplicates,
+                        ((double) m_Delivered * MESSAGE_SIZE) / elapsed / 1.0e6,
+                        m_Mismatched ? "  CONTENT MISMATCH" : "");
+
+        for (i = 0; i < REASSEMBLY_SLOTS; i++)
+        {
+            free (m_Reassembler.Slot[i].Message);
+        }
+    }
+
+    free (message);
+    close (m_SendSocket);
+    close (m_ReceiveSocket);
+
+    return 0;
+}
+
+/* FragmentSendFunc with loss and reorder injection */
+static UINT16 InjectingSend (void *context, const UINT8 *fragment, UINT32 fragmentSize)
+{
+    (void) context;
+
+    if (((double) rand () / RAND_MAX) < m_LossRate)
+    {
+        m_Dropped++;
+        return NO_ERROR;
+    }
+
+    if ((m_HeldSize == 0) && (((double) rand () / RAND_MAX) < m_ReorderRate))
+    {
+        memcpy (m_HeldFragment, fragment, fragmentSize);
+        m_HeldSize = fragmentSize;
+        m_Reordered++;
+        return NO_ERROR;
+    }
+
+    RawSend (fragment, fragmentSize);
+
+    if (m_HeldSize != 0)
+    {
+        RawSend (m_HeldFragment, m_HeldSize);
+        m_HeldSize = 0;
+    }
+
+    return NO_ERROR;
+}
+
+static void RawSend (const UINT8 *fragment, UINT32 fragmentSize)
+{
+    while ((m_Sent - m_Received) >= FLIGHT_WINDOW)
+    {
+        sched_yield ();
+    }
+
+    sendto (m_SendSocket, fragment, fragmentSize, 0, (struct sockaddr *) &m_Address,
+                    sizeof(m_Address));
+    m_Sent++;
+}
+
+static void *ReceiverThread (void *arg)
+{
+    static UINT8 datagram[FRAG_MAX_MTU];
+    static UINT8 expected[MESSAGE_SIZE];
+    const UINT8 *message = NULL;
+    UINT32 messageSize = 0;
+    ssize_t length = 0;
+
+    (void) arg;
+
+    while (!m_Stop)
+    {
+        length = recv (m_ReceiveSocket, datagram, sizeof(datagram), 0);
+        if (length <= 0)
+        {
+            continue;
+        }
+
+        if (ReassembleFragment (&m_Reassembler, datagram, (UINT32) length, NowMs (), &message,
+                        &messageSize) == FRAG_COMPLETE)
+        {
+            m_Delivered++;
+
+            /* Sequence number is in the first 4 bytes of the test message */
+            FillMessage (expected, *(const UINT32 *) message);
+            if ((messageSize != MESSAGE_SIZE) || (memcmp (message, expected, MESSAGE_SIZE) != 0))
+            {
+                m_Mismatched++;
+            }
+        }
+
+        m_Received++;
+    }
+
+    return NULL;
+}
+
+/* Content that differs per message, starting with the sequence number */
+static void FillMessage (UINT8 *message, UINT32 sequence)
+{
+    UINT32 i = 0;
+
+    memcpy (message, &sequence, sizeof(sequence));
+    for (i = sizeof(sequence); i < MESSAGE_SIZE; i++)
+    {
+        message[i] = (UINT8) (sequence * 31 + i);
+    }
+}
+
+static UINT32 NowMs (void)
+{
+    struct timespec now;
+
+    clock_gettime (CLOCK_MONOTONIC, &now);
+
+    return (UINT32) ((now.tv_sec * 1000UL) + (now.tv_nsec / 1000000UL));
+}
+
+static double NowSeconds (void)
+{
+    struct timespec now;
+
+    clock_gettime (CLOCK_MONOTONIC, &now);
+
+    return (double) now.tv_sec + ((double) now.tv_nsec / 1.0e9);
+}
@@ -0,0 +1,1126 @@
+/****************************************************************************************************************
+ * PROJECT    : BART
+ *
+ * MODULE     : RtdmIngest.c
+ *
+ * DESCRIPTON : 	Off-board stand-in for the MDS ingest side, for load tests with many recorders on the UDP
+ *	and UNIX stand-in transports (src/RtdmTransport.c).
+ *
+ *	One thread waits on all bound sockets with epoll and drains each readable socket with recvmmsg,
+ *	RECV_BATCH datagrams per call. Fragments (transportMtu) are put back together per sending address.
+ *	Every STRM message is validated with the stream decoder (RtdmDecoder.c, both checksums) and
+ *	demultiplexed by Consist_ID / Car_ID / Device_ID into one archive per car:
+ *
+ *	   <output directory>/<Consist_ID>_<Car_ID>_<Device_ID>/rtdm.dan
+ *
+ *	laid out like the on-board RTDM_DATA_FILE: an RTDM_Header_Struct (first and last stream timestamp,
+ *	Num_Streams, checksum) followed by each STRM header, extension and samples as received. An archive
+ *	left by an earlier run is continued when its header checks out. Messages are collected per car
+ *	and written with one pwrite when INGEST_BATCH_BYTES would be exceeded or the oldest has waited
+ *	INGEST_FLUSH_MS, the header is then rewritten in place. EVNT messages are validated and counted,
+ *	they are not part of rtdm.dan.
+ *
+ *	Received messages/s and MB/s, archive writes and rejected messages are reported at the given
+ *	interval and as a sustained rate over the whole run at the end.
+ *
+ *	With a load of N cars, a generator thread plays N recorders on the same addresses, each with its
+ *	own socket, IDs and Stream_Sequence, sending messages of the given number of full samples (98
+ *	bytes) as fast as the transport takes them or at the given total rate. A UNIX socket blocks the
+ *	sender when the receiver falls behind, so it measures what the ingest sustains; UDP drops instead,
+ *	which shows as sent minus received.
+ *
+ *	epoll is used rather than io_uring, the receive path is one recvmmsg per RECV_BATCH datagrams and
+ *	needs no kernel or library beyond glibc.
+ *
+ * BUILD :
+ *	gcc -O2 -DTEST_ON_PC -DTARGET_SIM_DLL -I../src RtdmIngest.c RtdmDecoder.c ../src/RtdmFragment.c
+ *	    ../src/crc32.c -fcommon -lpthread -o RtdmIngest
+ *
+ * USAGE :
+ *	RtdmIngest UDP|UNIX address[,address...] directory [report seconds, default 10]
+ *	    [run seconds, default 0 = forever] [load cars, default 0] [samples per message, default 102]
+ *	    [load messages/s, default 0 = as fast as possible]
+ *	e.g. RtdmIngest UNIX /tmp/ingest.sock /tmp/mds 5 30 300
+ *
+ **********************************************************************************************************************/
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <time.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include "MyTypes.h"
+#include "RTDM_Stream_ext.h"
+#include "crc32.h"
+#include "RtdmFragment.h"
+#include "RtdmDecoder.h"
+
+/*******************************************************************
+ *
+ *     C  O  N  S  T  A  N  T  S
+ *
+ *******************************************************************/
+/* IBufferSize (2) + STRM header (85) + header extension (7) + 60,000 byte buffer */
+#define MAX_MESSAGE_SIZE        60094
+
+/* Largest datagram either transport delivers */
+#define MAX_DATAGRAM_SIZE       65536
+
+#define REASSEMBLY_TIMEOUT_MS   1000
+
+#define INGEST_MAX_SOCKETS      8
+
+/* Datagrams taken per recvmmsg, and calls per readable socket before the others get a turn */
+#define RECV_BATCH              32
+#define RECV_CALLS_PER_EVENT    8
+
+/* Cars archived at the same time, hash buckets a power of 2 */
+#define INGEST_MAX_CARS         512
+#define INGEST_CAR_BUCKETS      1024
+
+/* Per car batch; written when the next message does not fit or the oldest has waited long enough */
+#define INGEST_BATCH_BYTES      (256 * 1024)
+#define INGEST_FLUSH_MS         1000
+
+/* Sending addresses that fragment, each has its own reassembler */
+#define INGEST_MAX_SOURCES      256
+
+/* Consist_ID + Car_ID + Device_ID */
+#define CAR_KEY_SIZE            48
+
+/* Sample time of the simulated recorders */
+#define LOAD_FIRST_SECOND       1000000
+
+/*******************************************************************
+ *
+ *    S  T  R  U  C  T  S
+ *
+ *******************************************************************/
+/* One archive */
+typedef struct CarArchive
+{
+    UINT8 Key[CAR_KEY_SIZE];
+    char Name[64];
+    int Fd;
+    RTDM_Header_Struct Header;
+    UINT32 FileSize; /* where the next batch goes */
+    UINT8 *Batch;
+    UINT32 BatchBytes;
+    UINT32 BatchFirstMs; /* arrival of the oldest message in the batch */
+    UINT32 Messages;
+    UINT32 Rejected; /* header good, samples damaged */
+    struct CarArchive *Next;
+} CarArchiveStr;
+
+/* A sending address and its reassembler */
+typedef struct
+{
+    struct sockaddr_storage Address;
+    socklen_t AddressSize;
+    ReassemblerStr Reassembler;
+} SourceStr;
+
+/* One simulated recorder */
+typedef struct
+{
+    int Sock;
+    UINT8 *Message;
+    UINT32 MessageSize;
+    UINT32 Sequence;
+} LoadCarStr;
+
+/*******************************************************************
+ *
+ *    S  T  A  T  I  C      V  A  R  I  A  B  L  E  S
+ *
+ *******************************************************************/
+static int m_Socket[INGEST_MAX_SOCKETS];
+static struct sockaddr_storage m_Address[INGEST_MAX_SOCKETS];
+static socklen_t m_AddressSize[INGEST_MAX_SOCKETS];
+static int m_NumSockets = 0;
+static BOOL m_Unix = FALSE;
+
+static const char *m_Directory = NULL;
+
+static CarArchiveStr *m_CarBucket[INGEST_CAR_BUCKETS];
+static CarArchiveStr *m_Car[INGEST_MAX_CARS];
+static int m_NumCars = 0;
+
+static SourceStr *m_Source[INGEST_MAX_SOURCES];
+static int m_NumSources = 0;
+
+/* Totals since the start */
+static unsigned long long m_Messages = 0;
+static unsigned long long m_MessageBytes = 0;
+static unsigned long long m_Datagrams = 0;
+static unsigned long long m_Writes = 0;
+static unsigned long long m_WriteBytes = 0;
+static unsigned long m_Events = 0;
+static unsigned long m_Rejected[DECODE_SAMPLE_CRC + 1];
+static unsigned long m_NoRoom = 0;
+static unsigned long m_WriteFailed = 0;
+static unsigned long m_FragmentsDropped = 0;
+
+/* Load generator */
+static LoadCarStr *m_LoadCar = NULL;
+static int m_LoadCars = 0;
+static UINT32 m_LoadSamples = 102;
+static UINT32 m_LoadRate = 0;
+static volatile unsigned long long m_LoadSent = 0;
+static volatile unsigned long m_LoadFailed = 0;
+
+static volatile int m_Stop = 0;
+
+/*******************************************************************
+ *
+ *    S  T  A  T  I  C      F  U  N  C  T  I  O  N  S
+ *
+ *******************************************************************/
+static int OpenSockets (const char *type, const char *addressList);
+static int ParseAddress (const char *address, struct sockaddr_storage *storage, socklen_t *size);
+static void ReceiveDatagrams (int sock);
+static void HandleDatagram (const UINT8 *datagram, UINT32 length,
+                const struct sockaddr_storage *from, socklen_t fromSize, UINT32 nowMs);
+static void HandleMessage (const UINT8 *message, UINT32 messageSize, UINT32 nowMs);
+static CarArchiveStr *FindCar (const STRM_Header_Struct *header);
+static CarArchiveStr *OpenCar (const UINT8 key[CAR_KEY_SIZE], UINT32 hash);
+static void AppendCar (CarArchiveStr *car, const STRM_Header_Struct *header, const UINT8 *bytes,
+                UINT32 size, UINT32 nowMs);
+static void FlushCar (CarArchiveStr *car);
+static void FlushAged (UINT32 nowMs);
+static SourceStr *FindSource (const struct sockaddr_storage *from, socklen_t fromSize);
+static void AppendIdName (char *name, const UINT8 *id);
+static UINT32 HashKey (const UINT8 *key);
+
+static int StartLoad (void);
+static UINT32 BuildLoadMessage (UINT8 *message, int carIndex);
+static void *LoadThread (void *arg);
+
+static void Report (unsigned long long messages, unsigned long long bytes, double seconds,
+                const char *label);
+static void StopHandler (int signal);
+static UINT32 NowMs (void);
+static double NowSeconds (void);
+
+int main (int argc, char *argv[])
+{
+    struct epoll_event event;
+    struct epoll_event ready[INGEST_MAX_SOCKETS];
+    pthread_t loadThread;
+    int reportSeconds = 10;
+    int runSeconds = 0;
+    double start = 0.0;
+    double lastReport = 0.0;
+    double now = 0.0;
+    unsigned long long lastMessages = 0;
+    unsigned long long lastBytes = 0;
+    int epollFd = -1;
+    int numReady = 0;
+    int i = 0;
+
+    if (argc < 4)
+    {
+        printf ("usage: %s UDP|UNIX address[,address...] directory [report seconds] [run seconds] "
+                        "[load cars] [samples per message] [load messages/s]\n", argv[0]);
+        return 2;
+    }
+    m_Directory = argv[3];
+    if (argc > 4)
+    {
+        reportSeconds = atoi (argv[4]);
+    }
+    if (argc > 5)
+    {
+        runSeconds = atoi (argv[5]);
+    }
+    if (argc > 6)
+    {
+        m_LoadCars = atoi (argv[6]);
+    }
+    if (argc > 7)
+    {
+        m_LoadSamples = (UINT32) atoi (argv[7]);
+    }
+    if (argc > 8)
+    {
+        m_LoadRate = (UINT32) atoi (argv[8]);
+    }
+
+    if ((m_LoadSamples == 0)
+                    || ((m_LoadSamples * sizeof(RTDM_Struct))
+                                    > (MAX_MESSAGE_SIZE - DECODE_STRM_OFFSET - STREAM_HEADER_SIZE
+                                                    - STREAM_HEADER_EXT_SIZE)))
+    {
+        printf ("Samples per message must be 1 .. %u\n",
+                        (unsigned int) ((MAX_MESSAGE_SIZE - DECODE_STRM_OFFSET - STREAM_HEADER_SIZE
+                                        - STREAM_HEADER_EXT_SIZE) / sizeof(RTDM_Struct)));
+        return 2;
+    }
+
+    if ((mkdir (m_Directory, 0755) != 0) && (errno != EEXIST))
+    {
+        printf ("Directory %s could not be created\n", m_Directory);
+        return 1;
+    }
+
+    if (OpenSockets (argv[1], argv[2]) != 0)
+    {
+        return 1;
+    }
+
+    epollFd = epoll_create1 (0);
+    if (epollFd < 0)
+    {
+        perror ("epoll_create1");
+        return 1;
+    }
+    for (i = 0; i < m_NumSockets; i++)
+    {
+        memset (&event, 0, sizeof(event));
+        event.events = EPOLLIN;
+        event.data.fd = m_Socket[i];
+        epoll_ctl (epollFd, EPOLL_CTL_ADD, m_Socket[i], &event);
+    }
+
+    signal (SIGINT, StopHandler);
+    signal (SIGTERM, StopHandler);
+    signal (SIGPIPE, SIG_IGN);
+
+    if (m_LoadCars > 0)
+    {
+        if (StartLoad () != 0)
+        {
+            return 1;
+        }
+        pthread_create (&loadThread, NULL, LoadThread, NULL);
+    }
+
+    start = NowSeconds ();
+    lastReport = start;
+
+    while (!m_Stop)
+    {
+        numReady = epoll_wait (epollFd, ready, INGEST_MAX_SOCKETS, 100);
+        for (i = 0; i < numReady; i++)
+        {
+            ReceiveDatagrams (ready[i].data.fd);
+        }
+
+        for (i = 0; i < m_NumSources; i++)
+        {
+            ExpireReassembly (&m_Source[i]->Reassembler, NowMs ());
+        }
+        FlushAged (NowMs ());
+
+        now = NowSeconds ();
+        if ((reportSeconds > 0) && ((now - lastReport) >= reportSeconds))
+        {
+            Report (m_Messages - lastMessages, m_MessageBytes - lastBytes, now - lastReport,
+                            "interval");
+            lastMessages = m_Messages;
+            lastBytes = m_MessageBytes;
+            lastReport = now;
+        }
+
+        if ((runSeconds > 0) && ((now - start) >= runSeconds))
+        {
+            break;
+        }
+    }
+
+    /* Let the generator stop before the last datagrams are taken */
+    m_Stop = 1;
+    if (m_LoadCars > 0)
+    {
+        pthread_join (loadThread, NULL);
+        for (i = 0; i < m_NumSockets; i++)
+        {
+            ReceiveDatagrams (m_Socket[i]);
+        }
+    }
+
+    for (i = 0; i < m_NumCars; i++)
+    {
+        FlushCar (m_Car[i]);
+        close (m_Car[i]->Fd);
+    }
+
+    Report (m_Messages, m_MessageBytes, NowSeconds () - start, "sustained");
+
+    for (i = 0; i < m_NumSockets; i++)
+    {
+        close (m_Socket[i]);
+        if (m_Unix)
+        {
+            unlink (((struct sockaddr_un *) &m_Address[i])->sun_path);
+        }
+    }
+    close (epollFd);
+
+    return 0;
+}
+
+/* Bind one non-blocking socket per address in the comma separated list */
+static int OpenSockets (const char *type, const char *addressList)
+{
+    char list[512];
+    char *address = NULL;
+    char *savePtr = NULL;
+    int bufferSize = 16 * 1024 * 1024;
+    int sock = -1;
+
+    if (strcmp (type, "UNIX") == 0)
+    {
+        m_Unix = TRUE;
+    }
+    else if (strcmp (type, "UDP") != 0)
+    {
+        printf ("Transport %s is not UDP or UNIX\n", type);
+        return -1;
+    }
+
+    strncpy (list, addressList, sizeof(list) - 1);
+    list[sizeof(list) - 1] = '\0';
+
+    for (address = strtok_r (list, ",", &savePtr); address != NULL;
+                    address = strtok_r (NULL, ",", &savePtr))
+    {
+        if (m_NumSockets >= INGEST_MAX_SOCKETS)
+        {
+            printf ("Only %d addresses are taken\n", INGEST_MAX_SOCKETS);
+            break;
+        }
+        if (ParseAddress (address, &m_Address[m_NumSockets], &m_AddressSize[m_NumSockets]) != 0)
+        {
+            return -1;
+        }
+        if (m_Unix)
+        {
+            unlink (address);
+        }
+
+        sock = socket (m_Unix ? AF_UNIX : AF_INET, SOCK_DGRAM | SOCK_NONBLOCK, 0);
+        if ((sock < 0)
+                        || (bind (sock, (struct sockaddr *) &m_Address[m_NumSockets],
+                                        m_AddressSize[m_NumSockets]) != 0))
+        {
+            printf ("%s %s could not be bound\n", type, address);
+            return -1;
+        }
+
+        /* Room for a burst from every car while archives are written */
+        setsockopt (sock, SOL_SOCKET, SO_RCVBUF, &bufferSize, sizeof(bufferSize));
+
+        m_Socket[m_NumSockets] = sock;
+        m_NumSockets++;
+    }
+
+    return (m_NumSockets > 0) ? 0 : -1;
+}
+
+static int ParseAddress (const char *address, struct sockaddr_storage *storage, socklen_t *size)
+{
+    struct sockaddr_in *udpAddress = (struct sockaddr_in *) storage;
+    struct sockaddr_un *unixAddress = (struct sockaddr_un *) storage;
+    char host[64];
+    unsigned int port = 0;
+
+    memset (storage, 0, sizeof(struct sockaddr_storage));
+
+    if (m_Unix)
+    {
+        if (strlen (address) >= sizeof(unixAddress->sun_path))
+        {
+            printf ("UNIX path %s is too long\n", address);
+            return -1;
+        }
+        unixAddress->sun_family = AF_UNIX;
+        strcpy (unixAddress->sun_path, address);
+        *size = sizeof(struct sockaddr_un);
+        return 0;
+    }
+
+    memset (host, 0, sizeof(host));
+    if ((sscanf (address, "%63[^:]:%u", host, &port) != 2)
+                    || (inet_pton (AF_INET, host, &udpAddress->sin_addr) != 1))
+    {
+        printf ("UDP address %s is not host:port\n", address);
+        return -1;
+    }
+    udpAddress->sin_family = AF_INET;
+    udpAddress->sin_port = htons ((unsigned short) port);
+    *size = sizeof(struct sockaddr_in);
+
+    return 0;
+}
+
+/*******************************************************************************************
+ *
+ *   Procedure Name : ReceiveDatagrams
+ *
+ *   Functional Description : Drain a readable socket, RECV_BATCH datagrams per recvmmsg call,
+ *   at most RECV_CALLS_PER_EVENT calls so one busy socket cannot hold up the others
+ *
+ *   Parameters : sock
+ *
+ *   Returned :  None
+ *
+ ******************************************************************************************/
+static void ReceiveDatagrams (int sock)
+{
+    static UINT8 datagram[RECV_BATCH][MAX_DATAGRAM_SIZE];
+    static struct mmsghdr header[RECV_BATCH];
+    static struct iovec vector[RECV_BATCH];
+    static struct sockaddr_storage from[RECV_BATCH];
+    UINT32 nowMs = 0;
+    int calls = 0;
+    int received = 0;
+    int i = 0;
+
+    for (calls = 0; calls < RECV_CALLS_PER_EVENT; calls++)
+    {
+        for (i = 0; i < RECV_BATCH; i++)
+        {
+            vector[i].iov_base = datagram[i];
+            vector[i].iov_len = MAX_DATAGRAM_SIZE;
+            memset (&header[i], 0, sizeof(header[i]));
+            header[i].msg_hdr.msg_iov = &vector[i];
+            header[i].msg_hdr.msg_iovlen = 1;
+            header[i].msg_hdr.msg_name = &from[i];
+            header[i].msg_hdr.msg_namelen = sizeof(from[i]);
+        }
+
+        received = recvmmsg (sock, header, RECV_BATCH, MSG_DONTWAIT, NULL);
+        if (received <= 0)
+        {
+            break;
+        }
+
+        nowMs = NowMs ();
+        m_Datagrams += (unsigned long long) received;
+
+        for (i = 0; i < received; i++)
+        {
+            HandleDatagram (datagram[i], header[i].msg_len, &from[i], header[i].msg_hdr.msg_namelen,
+                            nowMs);
+        }
+
+        if (received < RECV_BATCH)
+        {
+            break;
+        }
+    }
+}
+
+/* A whole message or a fragment of one */
+static void HandleDatagram (const UINT8 *datagram, UINT32 length,
+                const struct sockaddr_storage *from, socklen_t fromSize, UINT32 nowMs)
+{
+    SourceStr *source = NULL;
+    const UINT8 *message = NULL;
+    UINT32 messageSize = 0;
+
+    if ((length >= 4) && (memcmp (datagram, "FRAG", 4) == 0))
+    {
+        source = FindSource (from, fromSize);
+        if (source == NULL)
+        {
+            m_FragmentsDropped++;
+            return;
+        }
+        if (ReassembleFragment (&source->Reassembler, datagram, length, nowMs, &message,
+                        &messageSize) == FRAG_COMPLETE)
+        {
+            HandleMessage (message, messageSize, nowMs);
+        }
+        return;
+    }
+
+    HandleMessage (datagram, length, nowMs);
+}
+
+/*******************************************************************************************
+ *
+ *   Procedure Name : HandleMessage
+ *
+ *   Functional Description : Validate one message and add a stream message to the batch of
+ *   its car. The IBufferSize in front of the STRM header is not archived, rtdm.dan holds the
+ *   header, extension and samples.
+ *
+ *   Parameters : message, messageSize, nowMs - arrival
+ *
+ *   Returned :  None
+ *
+ ******************************************************************************************/
+static void HandleMessage (const UINT8 *message, UINT32 messageSize, UINT32 nowMs)
+{
+    StrmMessageStr decoded;
+    EvntMessageStr event;
+    CarArchiveStr *car = NULL;
+    UINT16 result = DECODE_OK;
+
+    if ((messageSize >= 4) && (memcmp (message, "EVNT", 4) == 0))
+    {
+        result = DecodeEventMessage (message, messageSize, &event);
+        if (result == DECODE_OK)
+        {
+            m_Events += event.EventCount;
+        }
+        else
+        {
+            m_Rejected[result]++;
+        }
+        return;
+    }
+
+    result = DecodeStreamMessage (message, messageSize, 0, &decoded);
+
+    /* The header is good, the archive of the car can still count the damaged message */
+    if (result == DECODE_SAMPLE_CRC)
+    {
+        car = FindCar ((const STRM_Header_Struct *) &message[DECODE_STRM_OFFSET]);
+        if (car != NULL)
+        {
+            car->Rejected++;
+        }
+    }
+    if (result != DECODE_OK)
+    {
+        m_Rejected[result]++;
+        return;
+    }
+
+    car = FindCar (decoded.Header);
+    if (car == NULL)
+    {
+        m_NoRoom++;
+        return;
+    }
+
+    AppendCar (car, decoded.Header, &message[DECODE_STRM_OFFSET],
+                    decoded.Header->Header_Size + decoded.SampleBytes, nowMs);
+
+    m_Messages++;
+    m_MessageBytes += messageSize;
+}
+
+/* Archive of the car, opened on its first message; NULL when INGEST_MAX_CARS are open */
+static CarArchiveStr *FindCar (const STRM_Header_Struct *header)
+{
+    UINT8 key[CAR_KEY_SIZE];
+    CarArchiveStr *car = NULL;
+    UINT32 hash = 0;
+
+    memcpy (&key[0], header->Consist_ID, sizeof(header->Consist_ID));
+    memcpy (&key[16], header->Car_ID, sizeof(header->Car_ID));
+    memcpy (&key[32], header->Device_ID, sizeof(header->Device_ID));
+
+    hash = HashKey (key);
+
+    for (car = m_CarBucket[hash & (INGEST_CAR_BUCKETS - 1)]; car != NULL; car = car->Next)
+    {
+        if (memcmp (car->Key, key, CAR_KEY_SIZE) == 0)
+        {
+            return car;
+        }
+    }
+
+    return OpenCar (key, hash);
+}
+
+/*******************************************************************************************
+ *
+ *   Procedure Name : OpenCar
+ *
+ *   Functional Description : Create the directory and rtdm.dan of a car seen for the first
+ *   time. An existing archive whose RTDM header checks out is continued at its end, anything
+ *   else is started over.
+ *
+ *   Parameters : key - Consist_ID, Car_ID, Device_ID; hash - of the key
+ *
+ *   Returned :  the archive, NULL if there is no room or it could not be opened
+ *
+ ******************************************************************************************/
+static CarArchiveStr *OpenCar (const UINT8 key[CAR_KEY_SIZE], UINT32 hash)
+{
+    CarArchiveStr *car = NULL;
+    char path[512];
+    struct stat status;
+    UINT32 headerCrc = 0;
+    BOOL resumed = FALSE;
+
+    if (m_NumCars >= INGEST_MAX_CARS)
+    {
+        return NULL;
+    }
+
+    car = (CarArchiveStr *) calloc (1, sizeof(CarArchiveStr));
+    if (car != NULL)
+    {
+        car->Batch = (UINT8 *) malloc (INGEST_BATCH_BYTES);
+    }
+    if ((car == NULL) || (car->Batch == NULL))
+    {
+        printf ("Out of memory for car %d\n", m_NumCars);
+        free (car);
+        return NULL;
+    }
+
+    memcpy (car->Key, key, CAR_KEY_SIZE);
+    AppendIdName (car->Name, &key[0]);
+    strcat (car->Name, "_");
+    AppendIdName (car->Name, &key[16]);
+    strcat (car->Name, "_");
+    AppendIdName (car->Name, &key[32]);
+
+    snprintf (path, sizeof(path), "%s/%s", m_Directory, car->Name);
+    mkdir (path, 0755);
+    snprintf (path, sizeof(path), "%s/%s/%s", m_Directory, car->Name, RTDM_DATA_FILE);
+
+    car->Fd = open (path, O_RDWR | O_CREAT, 0644);
+    if (car->Fd < 0)
+    {
+        printf ("%s could not be opened\n", path);
+        free (car->Batch);
+        free (car);
+        return NULL;
+    }
+
+    /* Continue an earlier run */
+    if ((fstat (car->Fd, &status) == 0) && (status.st_size >= (off_t) sizeof(RTDM_Header_Struct))
+                    && (pread (car->Fd, &car->Header, sizeof(car->Header), 0)
+                                    == (ssize_t) sizeof(car->Header))
+                    && (memcmp (car->Header.Delimiter, "RTDM", sizeof(car->Header.Delimiter)) == 0)
+                    && (memcmp (car->Header.Car_ID, &key[16], sizeof(car->Header.Car_ID)) == 0))
+    {
+        headerCrc = crc32 (0, (unsigned char *) &car->Header.Header_Version,
+                        sizeof(RTDM_Header_Struct) - RTDM_HEADER_CHECKSUM_ADJUST);
+        resumed = (headerCrc == car->Header.Header_Checksum);
+    }
+
+    if (resumed)
+    {
+        car->FileSize = (UINT32) status.st_size;
+    }
+    else
+    {
+        if (ftruncate (car->Fd, 0) != 0)
+        {
+            m_WriteFailed++;
+        }
+        memset (&car->Header, 0, sizeof(car->Header));
+        memcpy (car->Header.Delimiter, "RTDM", sizeof(car->Header.Delimiter));
+        car->Header.Endiannes = BIG_ENDIAN;
+        car->Header.Header_Size = sizeof(RTDM_Header_Struct);
+        car->Header.Header_Version = RTDM_HEADER_VERSION;
+        memcpy (car->Header.Consist_ID, &key[0], sizeof(car->Header.Consist_ID));
+        memcpy (car->Header.Car_ID, &key[16], sizeof(car->Header.Car_ID));
+        memcpy (car->Header.Device_ID, &key[32], sizeof(car->Header.Device_ID));
+        car->FileSize = sizeof(RTDM_Header_Struct);
+    }
+
+    car->Next = m_CarBucket[hash & (INGEST_CAR_BUCKETS - 1)];
+    m_CarBucket[hash & (INGEST_CAR_BUCKETS - 1)] = car;
+    m_Car[m_NumCars] = car;
+    m_NumCars++;
+
+    return car;
+}
+
+/* Add a message to the batch of its car, writing the batch first if it would overflow */
+static void AppendCar (CarArchiveStr *car, const STRM_Header_Struct *header, const UINT8 *bytes,
+                UINT32 size, UINT32 nowMs)
+{
+    if ((car->BatchBytes + size) > INGEST_BATCH_BYTES)
+    {
+        FlushCar (car);
+    }
+
+    if (car->BatchBytes == 0)
+    {
+        car->BatchFirstMs = nowMs;
+    }
+
+    memcpy (&car->Batch[car->BatchBytes], bytes, size);
+    car->BatchBytes += size;
+
+    if (car->Header.Num_Streams == 0)
+    {
+        car->Header.Data_Record_ID = header->Data_Record_ID;
+        car->Header.Data_Record_Version = header->Data_Record_Version;
+        car->Header.FirstTimeStamp_S = header->TimeStamp_S;
+        car->Header.FirstTimeStamp_mS = header->TimeStamp_mS;
+    }
+    car->Header.LastTimeStamp_S = header->TimeStamp_S;
+    car->Header.LastTimeStamp_mS = header->TimeStamp_mS;
+    car->Header.Num_Streams++;
+    car->Messages++;
+}
+
+/* Write the batch at the end of the archive, then the updated header at its start */
+static void FlushCar (CarArchiveStr *car)
+{
+    if (car->BatchBytes == 0)
+    {
+        return;
+    }
+
+    if (pwrite (car->Fd, car->Batch, car->BatchBytes, car->FileSize)
+                    != (ssize_t) car->BatchBytes)
+    {
+        m_WriteFailed++;
+        car->BatchBytes = 0;
+        return;
+    }
+    car->FileSize += car->BatchBytes;
+    m_WriteBytes += car->BatchBytes;
+    car->BatchBytes = 0;
+
+    car->Header.Header_Checksum = crc32 (0, (unsigned char *) &car->Header.Header_Version,
+                    sizeof(RTDM_Header_Struct) - RTDM_HEADER_CHECKSUM_ADJUST);
+    if (pwrite (car->Fd, &car->Header, sizeof(car->Header), 0) != (ssize_t) sizeof(car->Header))
+    {
+        m_WriteFailed++;
+    }
+
+    m_Writes += 2;
+}
+
+/* Batches of quiet cars are not held back longer than INGEST_FLUSH_MS */
+static void FlushAged (UINT32 nowMs)
+{
+    int i = 0;
+
+    for (i = 0; i < m_NumCars; i++)
+    {
+        if ((m_Car[i]->BatchBytes != 0) && ((nowMs - m_Car[i]->BatchFirstMs) >= INGEST_FLUSH_MS))
+        {
+            FlushCar (m_Car[i]);
+        }
+    }
+}
+
+/* Reassembler of a sending address, created on its first fragment */
+static SourceStr *FindSource (const struct sockaddr_storage *from, socklen_t fromSize)
+{
+    SourceStr *source = NULL;
+    int i = 0;
+
+    for (i = 0; i < m_NumSources; i++)
+    {
+        if ((m_Source[i]->AddressSize == fromSize)
+                        && (memcmp (&m_Source[i]->Address, from, fromSize) == 0))
+        {
+            return m_Source[i];
+        }
+    }
+
+    if (m_NumSources >= INGEST_MAX_SOURCES)
+    {
+        return NULL;
+    }
+
+    source = (SourceStr *) calloc (1, sizeof(SourceStr));
+    if ((source == NULL)
+                    || (InitializeReassembler (&source->Reassembler, MAX_MESSAGE_SIZE,
+                                    REASSEMBLY_TIMEOUT_MS) != NO_ERROR))
+    {
+        free (source);
+        return NULL;
+    }
+    memcpy (&source->Address, from, fromSize);
+    source->AddressSize = fromSize;
+
+    m_Source[m_NumSources] = source;
+    m_NumSources++;
+
+    return source;
+}
+
+/* A 16 byte ID as part of a file name: letters, digits, '-' and '.' kept, the rest '_' */
+static void AppendIdName (char *name, const UINT8 *id)
+{
+    char *end = name + strlen (name);
+    UINT16 i = 0;
+
+    for (i = 0; (i < 16) && (id[i] != 0); i++)
+    {
+        if (((id[i] >= 'a') && (id[i] <= 'z')) || ((id[i] >= 'A') && (id[i] <= 'Z'))
+                        || ((id[i] >= '0') && (id[i] <= '9')) || (id[i] == '-')
+                        || ((id[i] == '.') && (i != 0)))
+        {
+            *end = (char) id[i];
+        }
+        else
+        {
+            *end = '_';
+        }
+        end++;
+    }
+
+    /* Empty ID */
+    if (i == 0)
+    {
+        *end++ = '-';
+    }
+
+    *end = '\0';
+}
+
+/* FNV-1a */
+static UINT32 HashKey (const UINT8 *key)
+{
+    UINT32 hash = 2166136261U;
+    UINT16 i = 0;
+
+    for (i = 0; i < CAR_KEY_SIZE; i++)
+    {
+        hash = (hash ^ key[i]) * 16777619U;
+    }
+
+    return hash;
+}
+
+/*******************************************************************************************
+ *
+ *   Procedure Name : StartLoad
+ *
+ *   Functional Description : Build one message per simulated recorder and connect its socket
+ *   to one of the bound addresses, spreading the cars over them
+ *
+ *   Parameters : None
+ *
+ *   Returned :  0, -1 if a socket could not be made
+ *
+ ******************************************************************************************/
+static int StartLoad (void)
+{
+    struct sockaddr_un self;
+    int bufferSize = 1024 * 1024;
+    int i = 0;
+
+    m_LoadCar = (LoadCarStr *) calloc ((size_t) m_LoadCars, sizeof(LoadCarStr));
+    if (m_LoadCar == NULL)
+    {
+        printf ("Out of memory for %d cars\n", m_LoadCars);
+        return -1;
+    }
+
+    for (i = 0; i < m_LoadCars; i++)
+    {
+        m_LoadCar[i].Message = (UINT8 *) malloc (MAX_MESSAGE_SIZE);
+        m_LoadCar[i].Sock = socket (m_Unix ? AF_UNIX : AF_INET, SOCK_DGRAM, 0);
+        if ((m_LoadCar[i].Message == NULL) || (m_LoadCar[i].Sock < 0))
+        {
+            printf ("Simulated car %d could not be set up\n", i);
+            return -1;
+        }
+
+        /* Autobind to an abstract name so each car has its own sending address */
+        if (m_Unix)
+        {
+            memset (&self, 0, sizeof(self));
+            self.sun_family = AF_UNIX;
+            bind (m_LoadCar[i].Sock, (struct sockaddr *) &self, sizeof(sa_family_t));
+        }
+
+        setsockopt (m_LoadCar[i].Sock, SOL_SOCKET, SO_SNDBUF, &bufferSize, sizeof(bufferSize));
+
+        if (connect (m_LoadCar[i].Sock, (struct sockaddr *) &m_Address[i % m_NumSockets],
+                        m_AddressSize[i % m_NumSockets]) != 0)
+        {
+            printf ("Simulated car %d could not connect\n", i);
+            return -1;
+        }
+
+        m_LoadCar[i].Sequence = 1;
+        m_LoadCar[i].MessageSize = BuildLoadMessage (m_LoadCar[i].Message, i);
+    }
+
+    printf ("%d simulated cars, %u byte messages, %u samples each\n", m_LoadCars,
+                    (unsigned int) m_LoadCar[0].MessageSize, (unsigned int) m_LoadSamples);
+
+    return 0;
+}
+
+/* A stream message of full samples, as OutputStream() builds it, for simulated car carIndex */
+static UINT32 BuildLoadMessage (UINT8 *message, int carIndex)
+{
+    STRM_Header_Struct *header = (STRM_Header_Struct *) &message[DECODE_STRM_OFFSET];
+    STRM_Header_Ext_Struct *extension = (STRM_Header_Ext_Struct *) &message[DECODE_STRM_OFFSET
+                    + sizeof(STRM_Header_Struct)];
+    UINT16 headerSize = STREAM_HEADER_SIZE + STREAM_HEADER_EXT_SIZE;
+    UINT32 sampleBytes = m_LoadSamples * sizeof(RTDM_Struct);
+    RTDM_Struct *sample = NULL;
+    char id[17];
+    UINT32 i = 0;
+
+    memset (message, 0, DECODE_STRM_OFFSET + headerSize + sampleBytes);
+
+    for (i = 0; i < m_LoadSamples; i++)
+    {
+        sample = (RTDM_Struct *) &message[DECODE_STRM_OFFSET + headerSize
+                        + (i * sizeof(RTDM_Struct))];
+        sample->TimeStamp.seconds = LOAD_FIRST_SECOND + (i / 20);
+        sample->TimeStamp.msecs = (UINT16) ((i % 20) * 50);
+        sample->Count = DECODE_SIGNAL_COUNT;
+        sample->Signal.ID_9 = 9;
+        sample->Signal.Value_9 = (UINT32) (carIndex * 1000) + i;
+        sample->Signal.ID_23 = 23;
+        sample->Signal.Value_23 = (UINT16) (i % 800);
+    }
+
+    memcpy (header->Delimiter, "STRM", sizeof(header->Delimiter));
+    header->Endiannes = BIG_ENDIAN;
+    header->Header_Size = headerSize;
+    header->Header_Version = STREAM_HEADER_VERSION;
+
+    /* Cars of 4 in a consist, one PCU each */
+    snprintf (id, sizeof(id), "C%04d", carIndex / 4);
+    memcpy (header->Consist_ID, id, strlen (id));
+    snprintf (id, sizeof(id), "R2_%05d", carIndex);
+    memcpy (header->Car_ID, id, strlen (id));
+    memcpy (header->Device_ID, "PCU", 3);
+
+    header->Sample_Size_for_header = sampleBytes + SAMPLE_SIZE_ADJUSTMENT;
+    header->Num_Samples = m_LoadSamples;
+    header->Sample_Checksum = crc32 (0, (unsigned char *) &header->Num_Samples,
+                    sizeof(header->Num_Samples));
+    header->Sample_Checksum = crc32 (header->Sample_Checksum,
+                    &message[DECODE_STRM_OFFSET + headerSize], sampleBytes);
+
+    extension->Ext_Version = STREAM_HEADER_EXT_VERSION;
+    extension->Ext_Size = STREAM_HEADER_EXT_SIZE;
+
+    *(UINT16 *) message = (UINT16) (sampleBytes + sizeof(UINT16));
+
+    return DECODE_STRM_OFFSET + headerSize + sampleBytes;
+}
+
+/*******************************************************************************************
+ *
+ *   Procedure Name : LoadThread
+ *
+ *   Functional Description : Send a message from every simulated car in turn until stopped.
+ *   Only the sequence and header timestamp change between messages of a car, so just the
+ *   header checksum is recomputed. With a rate the sweep is paced every 10 msec.
+ *
+ *   Parameters : arg - not used
+ *
+ *   Returned :  NULL
+ *
+ ******************************************************************************************/
+static void *LoadThread (void *arg)
+{
+    STRM_Header_Struct *header = NULL;
+    STRM_Header_Ext_Struct *extension = NULL;
+    LoadCarStr *car = NULL;
+    struct timespec pause;
+    double start = NowSeconds ();
+    double elapsed = 0.0;
+    int i = 0;
+
+    (void) arg;
+
+    while (!m_Stop)
+    {
+        if (m_LoadRate != 0)
+        {
+            elapsed = NowSeconds () - start;
+            if ((double) m_LoadSent >= (elapsed * m_LoadRate))
+            {
+                pause.tv_sec = 0;
+                pause.tv_nsec = 10000000;
+                nanosleep (&pause, NULL);
+                continue;
+            }
+        }
+
+        car = &m_LoadCar[i];
+        header = (STRM_Header_Struct *) &car->Message[DECODE_STRM_OFFSET];
+        extension = (STRM_Header_Ext_Struct *) &car->Message[DECODE_STRM_OFFSET
+                        + sizeof(STRM_Header_Struct)];
+
+        header->TimeStamp_S = LOAD_FIRST_SECOND + car->Sequence;
+        extension->Stream_Sequence = car->Sequence;
+        header->Header_Checksum = crc32 (0, &car->Message[DECODE_STRM_OFFSET
+                        + STREAM_HEADER_CHECKSUM_ADJUST],
+                        header->Header_Size - STREAM_HEADER_CHECKSUM_ADJUST);
+
+        if (send (car->Sock, car->Message, car->MessageSize, 0) == (ssize_t) car->MessageSize)
+        {
+            car->Sequence++;
+            m_LoadSent++;
+        }
+        else if (!m_Stop)
+        {
+            m_LoadFailed++;
+        }
+
+        i = (i + 1) % m_LoadCars;
+    }
+
+    return NULL;
+}
+
+static void Report (unsigned long long messages, unsigned long long bytes, double seconds,
+                const char *label)
+{
+    if (seconds <= 0.0)
+    {
+        seconds = 1.0;
+    }
+
+    printf ("\n%s %.1f s: %.0f messages/s, %.2f MB/s\n", label, seconds, messages / seconds,
+                    (bytes / seconds) / 1.0e6);
+    printf ("total: %llu messages in %llu datagrams, %d cars, %llu writes (%.1f KB each), "
+                    "%lu events\n", m_Messages, m_Datagrams, m_NumCars, m_Writes,
+                    (m_Writes != 0) ? ((2.0 * m_WriteBytes) / m_Writes) / 1024.0 : 0.0, m_Events);
+    printf ("rejected: %lu short, %lu unknown, %lu bad header, %lu header CRC, %lu sample CRC, "
+                    "%lu no room, %lu fragments, %lu write errors\n", m_Rejected[DECODE_TOO_SHORT],
+                    m_Rejected[DECODE_UNKNOWN], m_Rejected[DECODE_BAD_HEADER],
+                    m_Rejected[DECODE_HEADER_CRC], m_Rejected[DECODE_SAMPLE_CRC], m_NoRoom,
+                    m_FragmentsDropped, m_WriteFailed);
+    if (m_LoadCars > 0)
+    {
+        printf ("load: %llu sent, %lu send errors\n", m_LoadSent, m_LoadFailed);
+    }
+    fflush (stdout);
+}
+
+static void StopHandler (int signal)
+{
+    (void) signal;
+    m_Stop = 1;
+}
+
+static UINT32 NowMs (void)
+{
+    struct timespec now;
+
+    clock_gettime (CLOCK_MONOTONIC, &now);
+
+    return (UINT32) ((now.tv_sec * 1000) + (now.tv_nsec / 1000000));
+}
+
+static double NowSeconds (void)
+{
+    struct timespec now;
+
+    clock_gettime (CLOCK_MONOTONIC, &now);
+
+    return now.tv_sec + (now.tv_nsec / 1.0e9);
+}
@@ -0,0 +1,1106 @@
+/****************************************************************************************************************
+ * PROJECT    : BART
+ *
+ * MODULE     : RtdmQuery.c
+ *
+ * DESCRIPTON : 	Off-board query engine for signal values over a time window of the data log ring
+ *	(N.dan segments, RtdmDataLog.c).
+ *
+ *	OpenQuery() reads the Signal elements of the .xml configuration, to turn names into signal IDs,
+ *	and takes the time range of every closed segment from the data log catalog (DanCatalog.bin).
+ *	Without a catalog the time range of every segment is worked out without reading its samples:
+ *	   closed segment - FirstTimeStamp / LastTimeStamp of its finalized header
+ *	   open segment   - the one after the segment named in DanFileTracker.txt, or any segment whose
+ *	                    header does not check out; the header is a placeholder, so the first good
+ *	                    block from the start and the last good block from the end are read
+ *
+ *	RunQuery() visits the segments overlapping the window in time order and skips the rest. Blocks
+ *	are fixed size (DAN_Block_Struct) and in time order within a segment, so the first block of the
+ *	window is found by a binary search of seeks, narrowed first by the index after the last block of
+ *	a closed segment (DAN_Index_Header_Struct) when there is one. Blocks are then read forward until
+ *	one starts after the window. Only the requested signals are taken out of each block, and every
+ *	sample in the window is handed to the caller's row function. A block failing its checks is
+ *	counted and skipped.
+ *
+ *	Predicates (AddQueryPredicate) keep only the samples where every one holds, e.g.
+ *	IDcLinkVoltage < 600 V. The zone map file of a closed segment (N.zon, DAN_Zone_Header_Struct)
+ *	holds the smallest and largest value of every signal over the whole segment and over each
+ *	block, so a segment or block where a predicate can not hold is passed over without reading it.
+ *
+ * FUNCTIONS:
+ *	UINT16 OpenQuery (QueryStr *query, const char *xmlFileName, const char *directory)
+ *	INT16 FindQuerySignal (const QueryStr *query, const char *name)
+ *	UINT16 AddQueryColumn (QueryStr *query, const char *name)
+ *	UINT16 AddQueryPredicate (QueryStr *query, const char *name, UINT16 op, double value)
+ *	BOOL GetRingTimeRange (const QueryStr *query, UINT32 *firstS, UINT32 *lastS)
+ *	UINT16 RunQuery (QueryStr *query, UINT32 startS, UINT16 startMs, UINT32 endS, UINT16 endMs,
+ *	                QueryRowFunc rowFunction, void *context)
+ *	const char *QueryResultText (UINT16 result)
+ *
+ **********************************************************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "MyTypes.h"
+#include "RTDM_Stream_ext.h"
+#include "crc32.h"
+#include "RtdmDecoder.h"
+#include "RtdmQuery.h"
+
+/*******************************************************************
+ *
+ *     C  O  N  S  T  A  N  T  S
+ *
+ *******************************************************************/
+/* Signal IDs of the 8 bit discretes, the only ones with Any_Set in a zone map */
+#define FIRST_DISCRETE_ID           10
+#define LAST_DISCRETE_ID            22
+
+/* Names as written by RtdmDataLog.c */
+#define DAN_TRACKER_FILE            "DanFileTracker.txt"
+#define DAN_CATALOG_FILE            "DanCatalog.bin"
+
+/*******************************************************************
+ *
+ *    S  T  A  T  I  C      V  A  R  I  A  B  L  E  S
+ *
+ *******************************************************************/
+static const char *m_ResultText[] =
+{ "OK", "NO_CONFIG", "NO_SIGNAL", "TOO_MANY_COLUMNS", "BAD_RANGE", "TOO_MANY_PREDICATES",
+  "BAD_PREDICATE" };
+
+/*******************************************************************
+ *
+ *    S  T  A  T  I  C      F  U  N  C  T  I  O  N  S
+ *
+ *******************************************************************/
+static UINT16 ReadSignals (QueryStr *query, const char *xmlFileName);
+static BOOL ReadCatalog (QueryStr *query);
+static INT16 ReadTracker (const QueryStr *query);
+static void ScanSegment (QuerySegmentStr *segment);
+static void QuerySegment (QueryStr *query, const QuerySegmentStr *segment,
+                unsigned long long startMs, unsigned long long endMs, QueryRowFunc rowFunction,
+                void *context);
+static void SearchIndex (FILE *p_file, const QuerySegmentStr *segment,
+                unsigned long long startMs, UINT32 *low, UINT32 *high);
+static BOOL ReadZoneHeader (const QuerySegmentStr *segment, FILE **p_file,
+                DAN_Zone_Header_Struct *zoneHeader);
+static DAN_Zone_Record_Struct *ReadZoneRecords (const QuerySegmentStr *segment);
+static BOOL ZoneCanMatch (const QueryStr *query, const DAN_Zone_Struct *zone);
+static BOOL RowMatches (const QueryStr *query, INT32 values[][DAN_BLOCK_SAMPLES], UINT16 row);
+static BOOL ReadBlock (FILE *p_file, UINT32 blockNumber, DAN_Block_Struct *block);
+static unsigned long long SampleMs (const RTDM_Struct *sample);
+
+/*******************************************************************************************
+ *
+ *   Procedure Name : OpenQuery
+ *
+ *   Functional Description : Read the signal names and the time range of every segment
+ *
+ *   Parameters : query, xmlFileName, directory - holding the ring and DanFileTracker.txt
+ *
+ *   Returned :  QUERY_OK or QUERY_NO_CONFIG
+ *
+ ******************************************************************************************/
+UINT16 OpenQuery (QueryStr *query, const char *xmlFileName, const char *directory)
+{
+    INT16 openIndex = -1;
+    UINT16 i = 0;
+
+    memset (query, 0, sizeof(QueryStr));
+    strncpy (query->Directory, directory, sizeof(query->Directory) - 1);
+
+    if (ReadSignals (query, xmlFileName) != QUERY_OK)
+    {
+        return QUERY_NO_CONFIG;
+    }
+
+    for (i = 0; i < QUERY_RING_FILES; i++)
+    {
+        snprintf (query->Segment[i].Path, sizeof(query->Segment[i].Path), "%s/%u.dan", directory,
+                        (unsigned int) (i + 1));
+    }
+
+    /* Closed segments are taken from the catalog unopened, only the open one is read */
+    if (ReadCatalog (query))
+    {
+        return QUERY_OK;
+    }
+
+    /* The tracker names the last segment closed, the next one is being written */
+    openIndex = ReadTracker (query);
+    if (openIndex >= 0)
+    {
+        openIndex = (INT16) ((openIndex + 1) % QUERY_RING_FILES);
+    }
+
+    for (i = 0; i < QUERY_RING_FILES; i++)
+    {
+        query->Segment[i].Open = (i == openIndex);
+        ScanSegment (&query->Segment[i]);
+    }
+
+    return QUERY_OK;
+}
+
+/* Index into Signal[] of a name, friendlyName or full name; -1 if unknown */
+INT16 FindQuerySignal (const QueryStr *query, const char *name)
+{
+    UINT16 i = 0;
+
+    for (i = 0; i < query->NumSignals; i++)
+    {
+        if ((strcmp (query->Signal[i].Name, name) == 0)
+                        || (strcmp (query->Signal[i].FriendlyName, name) == 0))
+        {
+            return (INT16) i;
+        }
+    }
+
+    return -1;
+}
+
+/* Request a signal; columns are returned in the order they are added */
+UINT16 AddQueryColumn (QueryStr *query, const char *name)
+{
+    INT16 index = FindQuerySignal (query, name);
+
+    if (index < 0)
+    {
+        return QUERY_NO_SIGNAL;
+    }
+    if (query->NumColumns >= DECODE_SIGNAL_COUNT)
+    {
+        return QUERY_TOO_MANY_COLUMNS;
+    }
+
+    query->Column[query->NumColumns] = (UINT16) index;
+    query->NumColumns++;
+
+    return QUERY_OK;
+}
+
+/* Keep only samples where signal op value holds, value in engineering units (a raw mask for
+ * QUERY_ANY_BITS) */
+UINT16 AddQueryPredicate (QueryStr *query, const char *name, UINT16 op, double value)
+{
+    INT16 index = FindQuerySignal (query, name);
+    QueryPredicateStr *predicate = NULL;
+
+    if (index < 0)
+    {
+        return QUERY_NO_SIGNAL;
+    }
+    if (op > QUERY_ANY_BITS)
+    {
+        return QUERY_BAD_PREDICATE;
+    }
+    if (query->NumPredicates >= QUERY_MAX_PREDICATES)
+    {
+        return QUERY_TOO_MANY_PREDICATES;
+    }
+
+    predicate = &query->Predicate[query->NumPredicates];
+    predicate->Signal = (UINT16) index;
+    predicate->Operator = op;
+    predicate->Value = value;
+
+    /* Compared against raw values, a negative scale turns the comparison around */
+    if (op != QUERY_ANY_BITS)
+    {
+        predicate->Value = value / query->Signal[index].Scale;
+        if (query->Signal[index].Scale < 0.0)
+        {
+            if (op == QUERY_LESS)
+            {
+                predicate->Operator = QUERY_GREATER;
+            }
+            else if (op == QUERY_LESS_EQUAL)
+            {
+                predicate->Operator = QUERY_GREATER_EQUAL;
+            }
+            else if (op == QUERY_GREATER)
+            {
+                predicate->Operator = QUERY_LESS;
+            }
+            else if (op == QUERY_GREATER_EQUAL)
+            {
+                predicate->Operator = QUERY_LESS_EQUAL;
+            }
+        }
+    }
+
+    query->NumPredicates++;
+
+    return QUERY_OK;
+}
+
+/* Oldest and newest second held in the ring, FALSE if the ring is empty */
+BOOL GetRingTimeRange (const QueryStr *query, UINT32 *firstS, UINT32 *lastS)
+{
+    BOOL found = FALSE;
+    UINT16 i = 0;
+
+    for (i = 0; i < QUERY_RING_FILES; i++)
+    {
+        if (!query->Segment[i].Present)
+        {
+            continue;
+        }
+        if (!found || (query->Segment[i].FirstTimeStamp_S < *firstS))
+        {
+            *firstS = query->Segment[i].FirstTimeStamp_S;
+        }
+        if (!found || (query->Segment[i].LastTimeStamp_S > *lastS))
+        {
+            *lastS = query->Segment[i].LastTimeStamp_S;
+        }
+        found = TRUE;
+    }
+
+    return found;
+}
+
+/*******************************************************************************************
+ *
+ *   Procedure Name : RunQuery
+ *
+ *   Functional Description : Hand every sample from start to end (both included) to the row
+ *   function, in time order, with the requested columns
+ *
+ *   Parameters : query, startS, startMs, endS, endMs, rowFunction, context - passed on
+ *
+ *   Returned :  QUERY_OK or QUERY_BAD_RANGE
+ *
+ ******************************************************************************************/
+UINT16 RunQuery (QueryStr *query, UINT32 startS, UINT16 startMs, UINT32 endS, UINT16 endMs,
+                QueryRowFunc rowFunction, void *context)
+{
+    unsigned long long startTime = (startS * 1000ULL) + startMs;
+    unsigned long long endTime = (endS * 1000ULL) + endMs;
+    unsigned long long firstTime = 0;
+    unsigned long long lastTime = 0;
+    const QuerySegmentStr *segment = NULL;
+    DAN_Zone_Header_Struct zoneHeader;
+    FILE *p_file = NULL;
+    UINT16 order[QUERY_RING_FILES];
+    UINT16 numPresent = 0;
+    UINT16 i = 0;
+    UINT16 j = 0;
+
+    if (endTime < startTime)
+    {
+        return QUERY_BAD_RANGE;
+    }
+
+    query->SegmentsRead = 0;
+    query->SegmentsSkipped = 0;
+    query->BlocksRead = 0;
+    query->IndexesUsed = 0;
+    query->SegmentsPruned = 0;
+    query->BlocksRejected = 0;
+    query->BlocksPruned = 0;
+    query->Rows = 0;
+
+    /* Oldest first, which also takes care of the ring wrapping */
+    for (i = 0; i < QUERY_RING_FILES; i++)
+    {
+        if (!query->Segment[i].Present)
+        {
+            continue;
+        }
+        j = numPresent;
+        while ((j > 0) && (query->Segment[order[j - 1]].FirstTimeStamp_S
+                        > query->Segment[i].FirstTimeStamp_S))
+        {
+            order[j] = order[j - 1];
+            j--;
+        }
+        order[j] = i;
+        numPresent++;
+    }
+
+    for (i = 0; i < numPresent; i++)
+    {
+        segment = &query->Segment[order[i]];
+        firstTime = (segment->FirstTimeStamp_S * 1000ULL) + segment->FirstTimeStamp_mS;
+        lastTime = (segment->LastTimeStamp_S * 1000ULL) + segment->LastTimeStamp_mS;
+
+        if ((lastTime < startTime) || (firstTime > endTime))
+        {
+            query->SegmentsSkipped++;
+            continue;
+        }
+
+        if ((query->NumPredicates != 0) && ReadZoneHeader (segment, &p_file, &zoneHeader))
+        {
+            fclose (p_file);
+            if (!ZoneCanMatch (query, &zoneHeader.Zone))
+            {
+                query->SegmentsPruned++;
+                continue;
+            }
+        }
+
+        query->SegmentsRead++;
+        QuerySegment (query, segment, startTime, endTime, rowFunction, context);
+    }
+
+    return QUERY_OK;
+}
+
+const char *QueryResultText (UINT16 result)
+{
+    if (result >= (sizeof(m_ResultText) / sizeof(m_ResultText[0])))
+    {
+        return "?";
+    }
+
+    return m_ResultText[result];
+}
+
+/* Signal elements of the .xml: id, name, friendlyName, unit, scale, nbDecimals */
+static UINT16 ReadSignals (QueryStr *query, const char *xmlFileName)
+{
+    SignalElementStr element;
+    QuerySignalStr *signal = NULL;
+    FILE *p_file = fopen (xmlFileName, "rb");
+    char *xml = NULL;
+    const char *pString = NULL;
+    const char *pLast = NULL;
+    long fileSize = 0;
+
+    if (p_file == NULL)
+    {
+        return QUERY_NO_CONFIG;
+    }
+
+    fseek (p_file, 0L, SEEK_END);
+    fileSize = ftell (p_file);
+    fseek (p_file, 0L, SEEK_SET);
+
+    xml = (char *) calloc ((size_t) fileSize + 1, 1);
+    if ((xml == NULL) || (fread (xml, 1, (size_t) fileSize, p_file) != (size_t) fileSize))
+    {
+        free (xml);
+        fclose (p_file);
+        return QUERY_NO_CONFIG;
+    }
+    fclose (p_file);
+
+    pString = xml;
+    while ((query->NumSignals < DECODE_SIGNAL_COUNT)
+                    && ((pString = NextSignalElement (pString, xml + fileSize, &element)) != NULL))
+    {
+        signal = &query->Signal[query->NumSignals];
+        memset (signal, 0, sizeof(QuerySignalStr));
+        signal->Id = element.Id;
+        signal->Scale = element.Scale;
+        signal->Decimals = element.Decimals;
+
+        /* oPCU_I1.PCU_I1.Analog801.ICarSpeed is asked for as ICarSpeed */
+        pLast = strrchr (element.Name, '.');
+        snprintf (signal->Name, sizeof(signal->Name), "%.*s", (int) sizeof(signal->Name) - 1,
+                        (pLast != NULL) ? (pLast + 1) : element.Name);
+        snprintf (signal->FriendlyName, sizeof(signal->FriendlyName), "%.*s",
+                        (int) sizeof(signal->FriendlyName) - 1, element.FriendlyName);
+        snprintf (signal->Unit, sizeof(signal->Unit), "%.*s", (int) sizeof(signal->Unit) - 1,
+                        element.Unit);
+
+        query->NumSignals++;
+    }
+
+    free (xml);
+
+    return (query->NumSignals != 0) ? QUERY_OK : QUERY_NO_CONFIG;
+}
+
+/*******************************************************************************************
+ *
+ *   Procedure Name : ReadCatalog
+ *
+ *   Functional Description : Describe the segments from the newest good copy of the data log
+ *   catalog (DAN_Catalog_Struct, written by RtdmDataLog.c), opening only the one being written
+ *
+ *   Parameters : query - Segment[].Path set
+ *
+ *   Returned :  FALSE if there is no good copy, the segments are then scanned
+ *
+ ******************************************************************************************/
+static BOOL ReadCatalog (QueryStr *query)
+{
+    DAN_Catalog_Struct copy;
+    DAN_Catalog_Struct catalog;
+    const DAN_Catalog_Entry_Struct *entry = NULL;
+    QuerySegmentStr *segment = NULL;
+    char path[QUERY_PATH_SIZE + 32];
+    FILE *p_file = NULL;
+    UINT32 catalogCrc = 0;
+    UINT16 copyIndex = 0;
+    UINT16 i = 0;
+    BOOL found = FALSE;
+
+    snprintf (path, sizeof(path), "%s/%s", query->Directory, DAN_CATALOG_FILE);
+    p_file = fopen (path, "rb");
+    if (p_file == NULL)
+    {
+        return FALSE;
+    }
+
+    for (copyIndex = 0; copyIndex < 2; copyIndex++)
+    {
+        if (fread (&copy, 1, sizeof(copy), p_file) != sizeof(copy))
+        {
+            break;
+        }
+
+        catalogCrc = crc32 (0, ((unsigned char*) &copy.Header.Header_Version),
+                        (sizeof(DAN_Catalog_Struct) - DAN_CATALOG_CHECKSUM_ADJUST));
+
+        if ((memcmp (copy.Header.Delimiter, "DCAT", sizeof(copy.Header.Delimiter)) == 0)
+                        && (copy.Header.Header_Version == DAN_CATALOG_VERSION)
+                        && (catalogCrc == copy.Header.Catalog_Checksum)
+                        && (copy.Header.Num_Entries == QUERY_RING_FILES)
+                        && (!found
+                                        || (copy.Header.Catalog_Sequence
+                                                        > catalog.Header.Catalog_Sequence)))
+        {
+            memcpy (&catalog, &copy, sizeof(catalog));
+            found = TRUE;
+        }
+    }
+
+    fclose (p_file);
+
+    if (!found)
+    {
+        return FALSE;
+    }
+
+    for (i = 0; i < QUERY_RING_FILES; i++)
+    {
+        entry = &catalog.Entry[i];
+        segment = &query->Segment[i];
+
+        if (entry->State == DAN_SEGMENT_OPEN)
+        {
+            segment->Open = TRUE;
+            ScanSegment (segment);
+        }
+        else if ((entry->State == DAN_SEGMENT_CLOSED) && (entry->Codec == DAN_CODEC_BLOCKS))
+        {
+            segment->Present = TRUE;
+            segment->Finalized = TRUE;
+            segment->Checksum = entry->Segment_Checksum;
+            segment->NumBlocks = entry->Num_Blocks;
+            segment->FirstTimeStamp_S = entry->FirstTimeStamp_S;
+            segment->FirstTimeStamp_mS = entry->FirstTimeStamp_mS;
+            segment->LastTimeStamp_S = entry->LastTimeStamp_S;
+            segment->LastTimeStamp_mS = entry->LastTimeStamp_mS;
+        }
+    }
+
+    query->Catalog = TRUE;
+
+    return TRUE;
+}
+
+/* Ring index of the segment named in DanFileTracker.txt, -1 if there is none */
+static INT16 ReadTracker (const QueryStr *query)
+{
+    char path[QUERY_PATH_SIZE + 32];
+    char name[16];
+    FILE *p_file = NULL;
+    int number = 0;
+
+    snprintf (path, sizeof(path), "%s/%s", query->Directory, DAN_TRACKER_FILE);
+    p_file = fopen (path, "rb");
+    if (p_file == NULL)
+    {
+        return -1;
+    }
+
+    memset (name, 0, sizeof(name));
+    if (fgets (name, sizeof(name), p_file) == NULL)
+    {
+        name[0] = '\0';
+    }
+    fclose (p_file);
+
+    /* "N.dan" */
+    number = atoi (name);
+    if ((number < 1) || (number > QUERY_RING_FILES))
+    {
+        return -1;
+    }
+
+    return (INT16) (number - 1);
+}
+
+/*******************************************************************************************
+ *
+ *   Procedure Name : ScanSegment
+ *
+ *   Functional Description : Time range and block count of a segment. A closed segment is
+ *   described by its header alone; for the open one, or a header that does not check out, the
+ *   first and last good blocks are read, stepping over damaged ones as RecoverDanSegment() does.
+ *
+ *   Parameters : segment - Path and Open set
+ *
+ *   Returned :  None
+ *
+ ******************************************************************************************/
+static void ScanSegment (QuerySegmentStr *segment)
+{
+    DAN_Header_Struct header;
+    DAN_Block_Struct block;
+    FILE *p_file = fopen (segment->Path, "rb");
+    long fileSize = 0;
+    UINT32 fileBlocks = 0;
+    UINT32 headerCrc = 0;
+    UINT32 first = 0;
+    UINT32 last = 0;
+
+    segment->Present = FALSE;
+    if (p_file == NULL)
+    {
+        return;
+    }
+
+    if ((fread (&header, 1, sizeof(header), p_file) != sizeof(header))
+                    || (memcmp (header.Delimiter, "DSEG", sizeof(header.Delimiter)) != 0)
+                    || (header.Header_Version != DAN_HEADER_VERSION))
+    {
+        fclose (p_file);
+        return;
+    }
+
+    fseek (p_file, 0L, SEEK_END);
+    fileSize = ftell (p_file);
+    if (fileSize > (long) sizeof(DAN_Header_Struct))
+    {
+        fileBlocks = (UINT32) ((fileSize - sizeof(DAN_Header_Struct)) / sizeof(DAN_Block_Struct));
+    }
+
+    headerCrc = crc32 (0, ((unsigned char*) &header.Header_Version),
+                    (sizeof(DAN_Header_Struct) - DAN_HEADER_CHECKSUM_ADJUST));
+
+    if (!segment->Open && (headerCrc == header.Header_Checksum) && (header.Num_Blocks != 0)
+                    && (header.Num_Blocks <= fileBlocks))
+    {
+        segment->Finalized = TRUE;
+        segment->Checksum = header.Header_Checksum;
+        segment->NumBlocks = header.Num_Blocks;
+        segment->FirstTimeStamp_S = header.FirstTimeStamp_S;
+        segment->FirstTimeStamp_mS = header.FirstTimeStamp_mS;
+        segment->LastTimeStamp_S = header.LastTimeStamp_S;
+        segment->LastTimeStamp_mS = header.LastTimeStamp_mS;
+        segment->Present = TRUE;
+        fclose (p_file);
+        return;
+    }
+
+    segment->NumBlocks = fileBlocks;
+
+    for (first = 0; first < fileBlocks; first++)
+    {
+        if (ReadBlock (p_file, first, &block) && (block.Header.Num_Samples != 0))
+        {
+            segment->FirstTimeStamp_S = block.Sample[0].TimeStamp.seconds;
+            segment->FirstTimeStamp_mS = block.Sample[0].TimeStamp.msecs;
+            break;
+        }
+    }
+
+    for (last = fileBlocks; last > first; last--)
+    {
+        if (ReadBlock (p_file, last - 1, &block) && (block.Header.Num_Samples != 0))
+        {
+            segment->LastTimeStamp_S = block.Sample[block.Header.Num_Samples - 1].TimeStamp.seconds;
+            segment->LastTimeStamp_mS = block.Sample[block.Header.Num_Samples - 1].TimeStamp.msecs;
+            segment->Present = TRUE;
+            break;
+        }
+    }
+
+    fclose (p_file);
+}
+
+/*******************************************************************************************
+ *
+ *   Procedure Name : QuerySegment
+ *
+ *   Functional Description : Binary search for the first block ending at or after the start,
+ *   then read forward until a block starts after the end
+ *
+ *   Parameters : query, segment, startMs, endMs, rowFunction, context
+ *
+ *   Returned :  None
+ *
+ ******************************************************************************************/
+static void QuerySegment (QueryStr *query, const QuerySegmentStr *segment,
+                unsigned long long startMs, unsigned long long endMs, QueryRowFunc rowFunction,
+                void *context)
+{
+    static UINT32 timeS[DAN_BLOCK_SAMPLES];
+    static UINT16 timeMs[DAN_BLOCK_SAMPLES];
+    static INT32 values[DECODE_SIGNAL_COUNT][DAN_BLOCK_SAMPLES];
+    DAN_Block_Struct block;
+    StrmMessageStr samples;
+    StrmColumnsStr columns;
+    INT32 row[DECODE_SIGNAL_COUNT];
+    unsigned long long sampleMs = 0;
+    DAN_Zone_Record_Struct *zones = NULL;
+    const DAN_Zone_Record_Struct *zone = NULL;
+    FILE *p_file = fopen (segment->Path, "rb");
+    UINT32 low = 0;
+    UINT32 high = segment->NumBlocks;
+    UINT32 middle = 0;
+    UINT32 b = 0;
+    UINT16 c = 0;
+    UINT16 r = 0;
+
+    if (p_file == NULL)
+    {
+        return;
+    }
+
+    if (segment->Finalized)
+    {
+        SearchIndex (p_file, segment, startMs, &low, &high);
+        if ((low != 0) || (high != segment->NumBlocks))
+        {
+            query->IndexesUsed++;
+        }
+    }
+
+    while (low < high)
+    {
+        middle = low + ((high - low) / 2);
+
+        /* A damaged block tells nothing, the nearest good one after it is used */
+        for (b = middle; b < high; b++)
+        {
+            query->BlocksRead++;
+            if (ReadBlock (p_file, b, &block) && (block.Header.Num_Samples != 0))
+            {
+                break;
+            }
+        }
+
+        if (b >= high)
+        {
+            high = middle;
+        }
+        else if (SampleMs (&block.Sample[block.Header.Num_Samples - 1]) < startMs)
+        {
+            low = b + 1;
+        }
+        else
+        {
+            high = middle;
+        }
+    }
+
+    memset (&columns, 0, sizeof(columns));
+    columns.TimeStamp_S = timeS;
+    columns.TimeStamp_mS = timeMs;
+    for (c = 0; c < query->NumColumns; c++)
+    {
+        columns.Value[query->Signal[query->Column[c]].Id] =
+                        values[query->Signal[query->Column[c]].Id];
+    }
+    for (c = 0; c < query->NumPredicates; c++)
+    {
+        columns.Value[query->Signal[query->Predicate[c].Signal].Id] =
+                        values[query->Signal[query->Predicate[c].Signal].Id];
+    }
+
+    memset (&samples, 0, sizeof(samples));
+    samples.SampleStride = sizeof(RTDM_Struct);
+
+    if ((query->NumPredicates != 0) && segment->Finalized)
+    {
+        zones = ReadZoneRecords (segment);
+    }
+
+    for (b = low; b < segment->NumBlocks; b++)
+    {
+        /* A record that does not check out says nothing, the block is read */
+        if (zones != NULL)
+        {
+            zone = &zones[b];
+            if ((zone->Sequence == b)
+                            && (zone->Record_Checksum
+                                            == crc32_fast (0,
+                                                            ((const unsigned char*) &zone->Sequence),
+                                                            (sizeof(DAN_Zone_Record_Struct)
+                                                                            - DAN_ZONE_RECORD_CHECKSUM_ADJUST)))
+                            && !ZoneCanMatch (query, &zone->Zone))
+            {
+                query->BlocksPruned++;
+                continue;
+            }
+        }
+
+        query->BlocksRead++;
+        if (!ReadBlock (p_file, b, &block))
+        {
+            query->BlocksRejected++;
+            continue;
+        }
+        if ((block.Header.Num_Samples == 0) || (SampleMs (&block.Sample[0]) > endMs))
+        {
+            break;
+        }
+
+        samples.Samples = (const UINT8 *) block.Sample;
+        samples.SampleCount = block.Header.Num_Samples;
+        samples.SampleBytes = samples.SampleCount * sizeof(RTDM_Struct);
+        columns.Capacity = DAN_BLOCK_SAMPLES;
+        columns.Rows = 0;
+        AppendSignalColumns (&samples, &columns);
+
+        for (r = 0; r < columns.Rows; r++)
+        {
+            sampleMs = (timeS[r] * 1000ULL) + timeMs[r];
+            if ((sampleMs < startMs) || (sampleMs > endMs) || !RowMatches (query, values, r))
+            {
+                continue;
+            }
+
+            for (c = 0; c < query->NumColumns; c++)
+            {
+                row[c] = values[query->Signal[query->Column[c]].Id][r];
+            }
+            rowFunction (context, timeS[r], timeMs[r], row);
+            query->Rows++;
+        }
+    }
+
+    free (zones);
+    fclose (p_file);
+}
+
+/* Narrow [low, high) to the index entries around the start; untouched if there is no index or
+ * it fails its checks */
+static void SearchIndex (FILE *p_file, const QuerySegmentStr *segment,
+                unsigned long long startMs, UINT32 *low, UINT32 *high)
+{
+    DAN_Index_Header_Struct header;
+    DAN_Index_Entry_Struct *entry = NULL;
+    UINT32 indexCrc = 0;
+    UINT32 first = 0;
+    UINT32 last = 0;
+    UINT32 middle = 0;
+
+    fseek (p_file, sizeof(DAN_Header_Struct) + (segment->NumBlocks * sizeof(DAN_Block_Struct)),
+                    SEEK_SET);
+
+    if ((fread (&header, 1, sizeof(header), p_file) != sizeof(header))
+                    || (memcmp (header.Delimiter, "DIDX", sizeof(header.Delimiter)) != 0)
+                    || (header.Header_Version != DAN_INDEX_VERSION)
+                    || (header.Header_Size != sizeof(DAN_Index_Header_Struct))
+                    || (header.Entry_Size != sizeof(DAN_Index_Entry_Struct))
+                    || (header.Num_Entries == 0) || (header.Num_Entries > segment->NumBlocks))
+    {
+        return;
+    }
+
+    entry = (DAN_Index_Entry_Struct *) malloc (header.Num_Entries * sizeof(DAN_Index_Entry_Struct));
+    if ((entry == NULL)
+                    || (fread (entry, sizeof(DAN_Index_Entry_Struct), header.Num_Entries, p_file)
+                                    != header.Num_Entries))
+    {
+        free (entry);
+        return;
+    }
+
+    indexCrc = crc32_fast (0, ((unsigned char*) &header.Header_Version),
+                    (sizeof(DAN_Index_Header_Struct) - DAN_INDEX_CHECKSUM_ADJUST));
+    indexCrc = crc32_fast (indexCrc, (unsigned char*) entry,
+                    (header.Num_Entries * sizeof(DAN_Index_Entry_Struct)));
+    if (indexCrc != header.Index_Checksum)
+    {
+        free (entry);
+        return;
+    }
+
+    /* First entry starting at or after the start; the block of the entry before it may end
+     * inside the window, nothing before that block does */
+    first = 0;
+    last = header.Num_Entries;
+    while (first < last)
+    {
+        middle = first + ((last - first) / 2);
+        if (((entry[middle].TimeStamp_S * 1000ULL) + entry[middle].TimeStamp_mS) < startMs)
+        {
+            first = middle + 1;
+        }
+        else
+        {
+            last = middle;
+        }
+    }
+
+    if (first > 0)
+    {
+        *low = entry[first - 1].Sequence;
+    }
+    if (first < header.Num_Entries)
+    {
+        *high = entry[first].Sequence;
+    }
+    if ((*low > *high) || (*high > segment->NumBlocks))
+    {
+        *low = 0;
+        *high = segment->NumBlocks;
+    }
+
+    free (entry);
+}
+
+/* Open the zone map file of a closed segment and read its header; TRUE, with the file left open,
+ * only if it checks out and belongs to this pass of the segment */
+static BOOL ReadZoneHeader (const QuerySegmentStr *segment, FILE **p_file,
+                DAN_Zone_Header_Struct *zoneHeader)
+{
+    char path[QUERY_PATH_SIZE];
+    char *pExtension = NULL;
+    UINT32 headerCrc = 0;
+
+    if (!segment->Finalized)
+    {
+        return FALSE;
+    }
+
+    /* N.dan -> N.zon */
+    strncpy (path, segment->Path, sizeof(path) - 1);
+    path[sizeof(path) - 1] = '\0';
+    pExtension = strrchr (path, '.');
+    if ((pExtension == NULL) || (strlen (pExtension) != 4))
+    {
+        return FALSE;
+    }
+    memcpy (pExtension, ".zon", 4);
+
+    *p_file = fopen (path, "rb");
+    if (*p_file == NULL)
+    {
+        return FALSE;
+    }
+
+    headerCrc = 0;
+    if (fread (zoneHeader, 1, sizeof(DAN_Zone_Header_Struct), *p_file)
+                    == sizeof(DAN_Zone_Header_Struct))
+    {
+        headerCrc = crc32_fast (0, ((unsigned char*) &zoneHeader->Header_Version),
+                        (sizeof(DAN_Zone_Header_Struct) - DAN_ZONE_CHECKSUM_ADJUST));
+    }
+
+    if ((headerCrc == 0) || (headerCrc != zoneHeader->Header_Checksum)
+                    || (memcmp (zoneHeader->Delimiter, "DZON", sizeof(zoneHeader->Delimiter)) != 0)
+                    || (zoneHeader->Header_Version != DAN_ZONE_VERSION)
+                    || (zoneHeader->Record_Size != sizeof(DAN_Zone_Record_Struct))
+                    || (zoneHeader->Num_Signals != DAN_ZONE_SIGNALS)
+                    || (zoneHeader->Num_Records != segment->NumBlocks)
+                    || (zoneHeader->Segment_Checksum != segment->Checksum))
+    {
+        fclose (*p_file);
+        *p_file = NULL;
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+/* Zone map record of every block of a closed segment, NULL if there are none to trust */
+static DAN_Zone_Record_Struct *ReadZoneRecords (const QuerySegmentStr *segment)
+{
+    DAN_Zone_Header_Struct zoneHeader;
+    DAN_Zone_Record_Struct *zones = NULL;
+    FILE *p_file = NULL;
+
+    if (!ReadZoneHeader (segment, &p_file, &zoneHeader))
+    {
+        return NULL;
+    }
+
+    zones = (DAN_Zone_Record_Struct *) malloc (segment->NumBlocks * sizeof(DAN_Zone_Record_Struct));
+    if ((zones != NULL)
+                    && (fread (zones, sizeof(DAN_Zone_Record_Struct), segment->NumBlocks, p_file)
+                                    != segment->NumBlocks))
+    {
+        free (zones);
+        zones = NULL;
+    }
+
+    fclose (p_file);
+
+    return zones;
+}
+
+/* FALSE if some predicate can hold for no value within the zone */
+static BOOL ZoneCanMatch (const QueryStr *query, const DAN_Zone_Struct *zone)
+{
+    const QueryPredicateStr *predicate = NULL;
+    UINT16 id = 0;
+    UINT16 p = 0;
+    BOOL canMatch = TRUE;
+
+    for (p = 0; (p < query->NumPredicates) && canMatch; p++)
+    {
+        predicate = &query->Predicate[p];
+        id = query->Signal[predicate->Signal].Id;
+
+        /* Nothing recorded for the signal, e.g. an empty block */
+        if (zone->Min[id] > zone->Max[id])
+        {
+            return FALSE;
+        }
+
+        switch (predicate->Operator)
+        {
+            case QUERY_LESS:
+                canMatch = (zone->Min[id] < predicate->Value);
+                break;
+
+            case QUERY_LESS_EQUAL:
+                canMatch = (zone->Min[id] <= predicate->Value);
+                break;
+
+            case QUERY_GREATER:
+                canMatch = (zone->Max[id] > predicate->Value);
+                break;
+
+            case QUERY_GREATER_EQUAL:
+                canMatch = (zone->Max[id] >= predicate->Value);
+                break;
+
+            case QUERY_EQUAL:
+                canMatch = (zone->Min[id] <= predicate->Value) && (zone->Max[id] >= predicate->Value);
+                break;
+
+            case QUERY_NOT_EQUAL:
+                canMatch = (zone->Min[id] != zone->Max[id]) || (zone->Min[id] != predicate->Value);
+                break;
+
+            case QUERY_ANY_BITS:
+                /* Any_Set is only kept for the 8 bit discretes */
+                if ((id >= FIRST_DISCRETE_ID) && (id <= LAST_DISCRETE_ID))
+                {
+                    canMatch = ((zone->Any_Set[id] & (UINT32) predicate->Value) != 0);
+                }
+                break;
+
+            default:
+                break;
+        }
+    }
+
+    return canMatch;
+}
+
+/* TRUE if every predicate holds for the sample */
+static BOOL RowMatches (const QueryStr *query, INT32 values[][DAN_BLOCK_SAMPLES], UINT16 row)
+{
+    const QueryPredicateStr *predicate = NULL;
+    INT32 value = 0;
+    UINT16 p = 0;
+
+    for (p = 0; p < query->NumPredicates; p++)
+    {
+        predicate = &query->Predicate[p];
+        value = values[query->Signal[predicate->Signal].Id][row];
+
+        switch (predicate->Operator)
+        {
+            case QUERY_LESS:
+                if (!(value < predicate->Value))
+                {
+                    return FALSE;
+                }
+                break;
+
+            case QUERY_LESS_EQUAL:
+                if (!(value <= predicate->Value))
+                {
+                    return FALSE;
+                }
+                break;
+
+            case QUERY_GREATER:
+                if (!(value > predicate->Value))
+                {
+                    return FALSE;
+                }
+                break;
+
+            case QUERY_GREATER_EQUAL:
+                if (!(value >= predicate->Value))
+                {
+                    return FALSE;
+                }
+                break;
+
+            case QUERY_EQUAL:
+                if (value != predicate->Value)
+                {
+                    return FALSE;
+                }
+                break;
+
+            case QUERY_NOT_EQUAL:
+                if (value == predicate->Value)
+                {
+                    return FALSE;
+                }
+                break;
+
+            case QUERY_ANY_BITS:
+                if ((value & (INT32) predicate->Value) == 0)
+                {
+                    return FALSE;
+                }
+                break;
+
+            default:
+                break;
+        }
+    }
+
+    return TRUE;
+}
+
+/* Read the block at blockNumber and verify its framing and CRC, as ReadDanBlock() in RtdmDataLog.c */
+static BOOL ReadBlock (FILE *p_file, UINT32 blockNumber, DAN_Block_Struct *block)
+{
+    UINT32 blockCrc = 0;
+
+    fseek (p_file, sizeof(DAN_Header_Struct) + (blockNumber * sizeof(DAN_Block_Struct)), SEEK_SET);
+
+    if (fread (block, 1, sizeof(DAN_Block_Struct), p_file) != sizeof(DAN_Block_Struct))
+    {
+        return FALSE;
+    }
+
+    if ((memcmp (block->Header.Delimiter, "DBLK", sizeof(block->Header.Delimiter)) != 0)
+                    || (block->Header.Block_Size != sizeof(DAN_Block_Struct))
+                    || (block->Header.Sequence != blockNumber)
+                    || (block->Header.Num_Samples > DAN_BLOCK_SAMPLES))
+    {
+        return FALSE;
+    }
+
+    blockCrc = crc32_fast (0, ((unsigned char*) &block->Header.Sequence),
+                    (sizeof(DAN_Block_Struct) - DAN_BLOCK_CHECKSUM_ADJUST));
+
+    return (blockCrc == block->Header.Block_Checksum);
+}
+
+static unsigned long long SampleMs (const RTDM_Struct *sample)
+{
+    return (sample->TimeStamp.seconds * 1000ULL) + sample->TimeStamp.msecs;
+}
@@ -0,0 +1,142 @@
+/*
+ * RtdmQuery.h
+ *
+ *  Interface of RtdmQuery.c: off-board query engine over the data log ring.
+ */
+
+#ifndef RTDMQUERY_H_
+#define RTDMQUERY_H_
+
+/*******************************************************************
+ *
+ *     C  O  N  S  T  A  N  T  S
+ *
+ *******************************************************************/
+/* The data log ring, as named in RtdmDataLog.c */
+#define QUERY_RING_FILES            25
+
+#define QUERY_NAME_SIZE             48
+#define QUERY_UNIT_SIZE             16
+#define QUERY_PATH_SIZE             512
+#define QUERY_MAX_PREDICATES        8
+
+/* Predicate operators */
+#define QUERY_LESS                  0
+#define QUERY_LESS_EQUAL            1
+#define QUERY_GREATER               2
+#define QUERY_GREATER_EQUAL         3
+#define QUERY_EQUAL                 4
+#define QUERY_NOT_EQUAL             5
+#define QUERY_ANY_BITS              6 /* raw value AND mask is not 0 */
+
+/* Results */
+#define QUERY_OK                    0
+#define QUERY_NO_CONFIG             1 /* .xml missing or without Signal elements */
+#define QUERY_NO_SIGNAL             2 /* name not in the .xml */
+#define QUERY_TOO_MANY_COLUMNS      3
+#define QUERY_BAD_RANGE             4 /* end before start */
+#define QUERY_TOO_MANY_PREDICATES   5
+#define QUERY_BAD_PREDICATE         6
+
+/*******************************************************************
+ *
+ *     E  N  U  M  S
+ *
+ *******************************************************************/
+
+/*******************************************************************
+ *
+ *    S  T  R  U  C  T  S
+ *
+ *******************************************************************/
+/* A Signal element of the .xml configuration */
+typedef struct
+{
+    UINT16 Id; /* value Id of SignalStr */
+    char Name[QUERY_NAME_SIZE]; /* last part of name, e.g. ICarSpeed */
+    char FriendlyName[QUERY_NAME_SIZE];
+    char Unit[QUERY_UNIT_SIZE];
+    double Scale; /* 1 if not given */
+    UINT16 Decimals;
+} QuerySignalStr;
+
+/* What is known of a ring segment without reading its blocks */
+typedef struct
+{
+    char Path[QUERY_PATH_SIZE];
+    BOOL Present; /* a data log segment with at least one good block */
+    BOOL Open; /* being written, named after the one in DanFileTracker.txt */
+    BOOL Finalized; /* header checks out, the segment may have an index after its blocks */
+    UINT32 NumBlocks;
+    UINT32 FirstTimeStamp_S;
+    UINT16 FirstTimeStamp_mS;
+    UINT32 LastTimeStamp_S;
+    UINT16 LastTimeStamp_mS;
+    UINT32 Checksum; /* Header_Checksum when Finalized, ties the zone map file to the segment */
+} QuerySegmentStr;
+
+/* Rows are returned only where every predicate holds */
+typedef struct
+{
+    UINT16 Signal; /* index into Signal[] */
+    UINT16 Operator;
+    double Value; /* raw, the engineering value divided by the scale; the mask for QUERY_ANY_BITS */
+} QueryPredicateStr;
+
+typedef struct
+{
+    char Directory[QUERY_PATH_SIZE];
+    BOOL Catalog; /* closed segments described by DanCatalog.bin */
+
+    QuerySignalStr Signal[DECODE_SIGNAL_COUNT];
+    UINT16 NumSignals;
+
+    /* Ring order, see GetDanFileName() */
+    QuerySegmentStr Segment[QUERY_RING_FILES];
+
+    /* Requested signals, by index into Signal[] */
+    UINT16 Column[DECODE_SIGNAL_COUNT];
+    UINT16 NumColumns;
+
+    QueryPredicateStr Predicate[QUERY_MAX_PREDICATES];
+    UINT16 NumPredicates;
+
+    /* Statistics of the last RunQuery() */
+    UINT16 SegmentsRead;
+    UINT16 SegmentsSkipped;
+    UINT16 SegmentsPruned; /* by the zone of the whole segment */
+    UINT32 BlocksRead; /* searching included */
+    UINT16 IndexesUsed; /* segment indexes that narrowed the search */
+    UINT32 BlocksRejected;
+    UINT32 BlocksPruned; /* by block zone maps, not read */
+    UINT32 Rows;
+    UINT16 RollupsRead; /* segments answered from N.rol by RunRollupQuery() */
+    UINT32 RollupBytes; /* read from them */
+} QueryStr;
+
+/* Called for every sample in the window, value[c] is the raw value of column c */
+typedef void (*QueryRowFunc) (void *context, UINT32 timeStampS, UINT16 timeStampMs,
+                const INT32 *value);
+
+/*******************************************************************
+ *
+ *    E  X  T  E  R  N      V  A  R  I  A  B  L  E  S
+ *
+ *******************************************************************/
+
+/*******************************************************************
+ *
+ *    E  X  T  E  R  N      F  U  N  C  T  I  O  N  S
+ *
+ *******************************************************************/
+
+UINT16 OpenQuery (QueryStr *query, const char *xmlFileName, const char *directory);
+INT16 FindQuerySignal (const QueryStr *query, const char *name);
+UINT16 AddQueryColumn (QueryStr *query, const char *name);
+UINT16 AddQueryPredicate (QueryStr *query, const char *name, UINT16 op, double value);
+BOOL GetRingTimeRange (const QueryStr *query, UINT32 *firstS, UINT32 *lastS);
+UINT16 RunQuery (QueryStr *query, UINT32 startS, UINT16 startMs, UINT32 endS, UINT16 endMs,
+                QueryRowFunc rowFunction, void *context);
+const char *QueryResultText (UINT16 result);
+
+#endif /* RTDMQUERY_H_ */
@@ -0,0 +1,754 @@
+/****************************************************************************************************************
+ * PROJECT    : BART
+ *
+ * MODULE     : RtdmRollup.c
+ *
+ * DESCRIPTON : 	Off-board rollups of the data log ring (N.dan segments, RtdmDataLog.c) for long-range
+ *	charts: the smallest, largest, mean and last value and the number of samples of every signal per
+ *	second and per minute.
+ *
+ *	UpdateRollups() writes the rollups of each closed segment next to it as N.rol
+ *	(ROLLUP_Header_Struct). A rollup carries the Header_Checksum of the segment it was built from, so
+ *	a segment that already has a current one is not read again and only the segments closed since the
+ *	last update are built; the rollup of a segment that has since been reopened by the ring is
+ *	removed. Run after each download, or as often as wanted, the work is one segment per rotation.
+ *
+ *	RunRollupQuery() returns the rollups of the requested columns over a time window, oldest first.
+ *	Within a level the interval table comes first, then the values signal by signal, so a chart reads
+ *	the interval table and its own signals within the window and nothing else: a day of one signal at
+ *	1 min is about 40 kB against about 170 MB of blocks. A segment without a current rollup, the one
+ *	being written in particular, is rolled up from its blocks on the fly. An interval split between
+ *	two segments, or longer than a Count can hold, is returned once, merged.
+ *
+ *	Values are raw, as recorded; the caller applies the scale. IOdometer (9) is compared and summed
+ *	unsigned.
+ *
+ * FUNCTIONS:
+ *	UINT16 UpdateRollups (QueryStr *query, UINT16 *built, UINT16 *removed)
+ *	UINT16 RunRollupQuery (QueryStr *query, UINT16 level, UINT32 startS, UINT32 endS,
+ *	                RollupRowFunc rowFunction, void *context)
+ *
+ **********************************************************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "MyTypes.h"
+#include "RTDM_Stream_ext.h"
+#include "crc32.h"
+#include "RtdmDecoder.h"
+#include "RtdmDanMap.h"
+#include "RtdmQuery.h"
+#include "RtdmRollup.h"
+
+/*******************************************************************
+ *
+ *     C  O  N  S  T  A  N  T  S
+ *
+ *******************************************************************/
+/* The only signal carried as a UINT32 */
+#define UNSIGNED_SIGNAL_ID          9
+
+/* Intervals allocated at a time while a segment is rolled up */
+#define ROLLUP_GROWTH               1024
+
+/* Bytes of one interval of a level in the file */
+#define LEVEL_INTERVAL_SIZE         (sizeof(ROLLUP_Interval_Struct) \
+                                        + (DECODE_SIGNAL_COUNT * sizeof(ROLLUP_Value_Struct)))
+
+/*******************************************************************
+ *
+ *    S  T  R  U  C  T  S
+ *
+ *******************************************************************/
+/* A level being built, interval by interval with every signal */
+typedef struct
+{
+    ROLLUP_Interval_Struct *Interval;
+    ROLLUP_Value_Struct *Value; /* [interval * DECODE_SIGNAL_COUNT + signal] */
+    UINT32 NumIntervals;
+    UINT32 Capacity;
+} RollupLevelStr;
+
+typedef struct
+{
+    RollupLevelStr Level[ROLLUP_LEVELS];
+} RollupStr;
+
+/* The interval held back by RunRollupQuery() in case the next segment goes on with it */
+typedef struct
+{
+    BOOL Valid;
+    UINT32 TimeStamp_S;
+    UINT32 Count;
+    ROLLUP_Value_Struct Value[DECODE_SIGNAL_COUNT]; /* by column */
+} RollupPendingStr;
+
+/*******************************************************************
+ *
+ *    S  T  A  T  I  C      V  A  R  I  A  B  L  E  S
+ *
+ *******************************************************************/
+static const UINT16 m_IntervalS[ROLLUP_LEVELS] =
+{ 1, 60 };
+
+/*******************************************************************
+ *
+ *    S  T  A  T  I  C      F  U  N  C  T  I  O  N  S
+ *
+ *******************************************************************/
+static void GetRollupPath (const QueryStr *query, UINT16 index, char *path, size_t size);
+static BOOL ReadRollupHeader (FILE *p_file, const QuerySegmentStr *segment,
+                ROLLUP_Header_Struct *header);
+static BOOL BuildRollup (QueryStr *query, const QuerySegmentStr *segment, RollupStr *rollup);
+static BOOL AddSample (RollupStr *rollup, UINT32 timeStampS, INT32 values[][DAN_BLOCK_SAMPLES],
+                UINT16 row);
+static BOOL WriteRollup (const RollupStr *rollup, UINT32 segmentChecksum, const char *path);
+static void FreeRollup (RollupStr *rollup);
+static void QueryRollupFile (QueryStr *query, FILE *p_file, const ROLLUP_Header_Struct *header,
+                UINT16 level, UINT32 startS, UINT32 endS, RollupPendingStr *pending,
+                RollupRowFunc rowFunction, void *context);
+static void QueryRollup (QueryStr *query, const RollupStr *rollup, UINT16 level, UINT32 startS,
+                UINT32 endS, RollupPendingStr *pending, RollupRowFunc rowFunction, void *context);
+static void MergeInterval (QueryStr *query, RollupPendingStr *pending, UINT32 timeStampS,
+                UINT32 count, const ROLLUP_Value_Struct *value, RollupRowFunc rowFunction,
+                void *context);
+static void FlushInterval (QueryStr *query, RollupPendingStr *pending, RollupRowFunc rowFunction,
+                void *context);
+static long long RawValue (UINT16 signalId, INT32 value);
+
+/*******************************************************************************************
+ *
+ *   Procedure Name : UpdateRollups
+ *
+ *   Functional Description : Write N.rol for every closed segment without a current one and
+ *   remove the rollups of segments that are no longer closed
+ *
+ *   Parameters : query - from OpenQuery(), built, removed - rollups written and removed
+ *
+ *   Returned :  Closed segments with a current rollup afterwards
+ *
+ ******************************************************************************************/
+UINT16 UpdateRollups (QueryStr *query, UINT16 *built, UINT16 *removed)
+{
+    ROLLUP_Header_Struct header;
+    RollupStr rollup;
+    const QuerySegmentStr *segment = NULL;
+    char path[QUERY_PATH_SIZE + 32];
+    FILE *p_file = NULL;
+    BOOL current = FALSE;
+    UINT16 numCurrent = 0;
+    UINT16 i = 0;
+
+    *built = 0;
+    *removed = 0;
+    query->BlocksRead = 0;
+    query->BlocksRejected = 0;
+
+    for (i = 0; i < QUERY_RING_FILES; i++)
+    {
+        segment = &query->Segment[i];
+        GetRollupPath (query, i, path, sizeof(path));
+
+        if (!segment->Present || !segment->Finalized)
+        {
+            if (remove (path) == 0)
+            {
+                (*removed)++;
+            }
+            continue;
+        }
+
+        current = FALSE;
+        p_file = fopen (path, "rb");
+        if (p_file != NULL)
+        {
+            current = ReadRollupHeader (p_file, segment, &header);
+            fclose (p_file);
+        }
+        if (current)
+        {
+            numCurrent++;
+            continue;
+        }
+
+        if (BuildRollup (query, segment, &rollup) && WriteRollup (&rollup, segment->Checksum, path))
+        {
+            (*built)++;
+            numCurrent++;
+        }
+        FreeRollup (&rollup);
+    }
+
+    return numCurrent;
+}
+
+/*******************************************************************************************
+ *
+ *   Procedure Name : RunRollupQuery
+ *
+ *   Functional Description : Hand the rollup of every interval from start to end to the row
+ *   function, in time order, with the requested columns. An interval is returned if it
+ *   starts within the window or the window starts within it.
+ *
+ *   Parameters : query, level - ROLLUP_SECOND or ROLLUP_MINUTE, startS, endS, rowFunction,
+ *                context - passed on
+ *
+ *   Returned :  QUERY_OK or QUERY_BAD_RANGE
+ *
+ ******************************************************************************************/
+UINT16 RunRollupQuery (QueryStr *query, UINT16 level, UINT32 startS, UINT32 endS,
+                RollupRowFunc rowFunction, void *context)
+{
+    static RollupPendingStr pending;
+    ROLLUP_Header_Struct header;
+    RollupStr rollup;
+    const QuerySegmentStr *segment = NULL;
+    char path[QUERY_PATH_SIZE + 32];
+    FILE *p_file = NULL;
+    UINT16 order[QUERY_RING_FILES];
+    UINT16 numPresent = 0;
+    UINT16 i = 0;
+    UINT16 j = 0;
+
+    if ((endS < startS) || (level >= ROLLUP_LEVELS))
+    {
+        return QUERY_BAD_RANGE;
+    }
+
+    /* The interval the window starts in */
+    startS -= startS % m_IntervalS[level];
+
+    query->SegmentsRead = 0;
+    query->SegmentsSkipped = 0;
+    query->BlocksRead = 0;
+    query->BlocksRejected = 0;
+    query->RollupsRead = 0;
+    query->RollupBytes = 0;
+    query->Rows = 0;
+    memset (&pending, 0, sizeof(pending));
+
+    /* Oldest first, as RunQuery() */
+    for (i = 0; i < QUERY_RING_FILES; i++)
+    {
+        if (!query->Segment[i].Present)
+        {
+            continue;
+        }
+        j = numPresent;
+        while ((j > 0) && (query->Segment[order[j - 1]].FirstTimeStamp_S
+                        > query->Segment[i].FirstTimeStamp_S))
+        {
+            order[j] = order[j - 1];
+            j--;
+        }
+        order[j] = i;
+        numPresent++;
+    }
+
+    for (i = 0; i < numPresent; i++)
+    {
+        segment = &query->Segment[order[i]];
+        if ((segment->LastTimeStamp_S < startS) || (segment->FirstTimeStamp_S > endS))
+        {
+            query->SegmentsSkipped++;
+            continue;
+        }
+
+        if (segment->Finalized)
+        {
+            GetRollupPath (query, order[i], path, sizeof(path));
+            p_file = fopen (path, "rb");
+            if (p_file != NULL)
+            {
+                if (ReadRollupHeader (p_file, segment, &header))
+                {
+                    query->RollupsRead++;
+                    query->RollupBytes += sizeof(header);
+                    QueryRollupFile (query, p_file, &header, level, startS, endS, &pending,
+                                    rowFunction, context);
+                    fclose (p_file);
+                    continue;
+                }
+                fclose (p_file);
+            }
+        }
+
+        /* Open, or closed since the last UpdateRollups() */
+        query->SegmentsRead++;
+        if (BuildRollup (query, segment, &rollup))
+        {
+            QueryRollup (query, &rollup, level, startS, endS, &pending, rowFunction, context);
+        }
+        FreeRollup (&rollup);
+    }
+
+    FlushInterval (query, &pending, rowFunction, context);
+
+    return QUERY_OK;
+}
+
+/* N.rol of the segment N.dan */
+static void GetRollupPath (const QueryStr *query, UINT16 index, char *path, size_t size)
+{
+    snprintf (path, size, "%s/%u.rol", query->Directory, (unsigned int) (index + 1));
+}
+
+/* TRUE if the header checks out and was built from this segment as it is now */
+static BOOL ReadRollupHeader (FILE *p_file, const QuerySegmentStr *segment,
+                ROLLUP_Header_Struct *header)
+{
+    UINT32 headerCrc = 0;
+    UINT16 i = 0;
+
+    if ((fread (header, 1, sizeof(ROLLUP_Header_Struct), p_file) != sizeof(ROLLUP_Header_Struct))
+                    || (memcmp (header->Delimiter, "DROL", sizeof(header->Delimiter)) != 0)
+                    || (header->Header_Version != ROLLUP_VERSION)
+                    || (header->Header_Size != sizeof(ROLLUP_Header_Struct))
+                    || (header->Num_Signals != DECODE_SIGNAL_COUNT)
+                    || (header->Num_Levels != ROLLUP_LEVELS))
+    {
+        return FALSE;
+    }
+
+    headerCrc = crc32 (0, ((unsigned char*) &header->Header_Version),
+                    (sizeof(ROLLUP_Header_Struct) - ROLLUP_CHECKSUM_ADJUST));
+    if ((headerCrc != header->Header_Checksum) || (header->Segment_Checksum != segment->Checksum))
+    {
+        return FALSE;
+    }
+
+    for (i = 0; i < ROLLUP_LEVELS; i++)
+    {
+        if (header->Level[i].Interval_S != m_IntervalS[i])
+        {
+            return FALSE;
+        }
+    }
+
+    return TRUE;
+}
+
+/*******************************************************************************************
+ *
+ *   Procedure Name : BuildRollup
+ *
+ *   Functional Description : Roll up every good block of a segment, mapped (RtdmDanMap.c) and
+ *   taken front to back. A block failing its checks, as in ReadDanBlock() of RtdmDataLog.c, is
+ *   counted and skipped.
+ *
+ *   Parameters : query - for the counts, segment, rollup - filled in, FreeRollup() after
+ *
+ *   Returned :  FALSE if the segment can not be read or memory ran out
+ *
+ ******************************************************************************************/
+static BOOL BuildRollup (QueryStr *query, const QuerySegmentStr *segment, RollupStr *rollup)
+{
+    static UINT32 timeS[DAN_BLOCK_SAMPLES];
+    static INT32 values[DECODE_SIGNAL_COUNT][DAN_BLOCK_SAMPLES];
+    StrmColumnsStr columns;
+    DanMapStr map;
+    UINT32 numBlocks = 0;
+    UINT32 b = 0;
+    UINT16 r = 0;
+    UINT16 s = 0;
+
+    memset (rollup, 0, sizeof(RollupStr));
+
+    if (OpenDanMap (&map, segment->Path) != DANMAP_OK)
+    {
+        return FALSE;
+    }
+
+    /* The segment being written may have grown since the ring was scanned */
+    numBlocks = GetDanMapBlockCount (&map);
+    if (numBlocks > segment->NumBlocks)
+    {
+        numBlocks = segment->NumBlocks;
+    }
+
+    memset (&columns, 0, sizeof(columns));
+    columns.TimeStamp_S = timeS;
+    for (s = 0; s < DECODE_SIGNAL_COUNT; s++)
+    {
+        columns.Value[s] = values[s];
+    }
+
+    for (b = 0; b < numBlocks; b++)
+    {
+        query->BlocksRead++;
+
+        if (GetDanMapBlock (&map, b) == NULL)
+        {
+            query->BlocksRejected++;
+            continue;
+        }
+
+        columns.Capacity = DAN_BLOCK_SAMPLES;
+        columns.Rows = 0;
+        DecodeDanMapBlock (&map, b, &columns);
+
+        for (r = 0; r < columns.Rows; r++)
+        {
+            if (!AddSample (rollup, timeS[r], values, r))
+            {
+                CloseDanMap (&map);
+                return FALSE;
+            }
+        }
+    }
+
+    CloseDanMap (&map);
+
+    return TRUE;
+}
+
+/* One sample into the interval of each level it falls in */
+static BOOL AddSample (RollupStr *rollup, UINT32 timeStampS, INT32 values[][DAN_BLOCK_SAMPLES],
+                UINT16 row)
+{
+    RollupLevelStr *level = NULL;
+    ROLLUP_Interval_Struct *interval = NULL;
+    ROLLUP_Value_Struct *value = NULL;
+    void *grown = NULL;
+    UINT32 start = 0;
+    UINT16 l = 0;
+    UINT16 s = 0;
+    INT32 raw = 0;
+
+    for (l = 0; l < ROLLUP_LEVELS; l++)
+    {
+        level = &rollup->Level[l];
+        start = timeStampS - (timeStampS % m_IntervalS[l]);
+        interval = (level->NumIntervals != 0) ? &level->Interval[level->NumIntervals - 1] : NULL;
+
+        if ((interval != NULL) && (interval->TimeStamp_S == start) && (interval->Count < 0xFFFF))
+        {
+            value = &level->Value[(level->NumIntervals - 1) * DECODE_SIGNAL_COUNT];
+            for (s = 0; s < DECODE_SIGNAL_COUNT; s++)
+            {
+                raw = values[s][row];
+                if (RawValue (s, raw) < RawValue (s, value[s].Min))
+                {
+                    value[s].Min = raw;
+                }
+                if (RawValue (s, raw) > RawValue (s, value[s].Max))
+                {
+                    value[s].Max = raw;
+                }
+                value[s].Last = raw;
+                value[s].Sum += RawValue (s, raw);
+            }
+            interval->Count++;
+            continue;
+        }
+
+        if (level->NumIntervals == level->Capacity)
+        {
+            grown = realloc (level->Interval,
+                            (level->Capacity + ROLLUP_GROWTH) * sizeof(ROLLUP_Interval_Struct));
+            if (grown == NULL)
+            {
+                return FALSE;
+            }
+            level->Interval = (ROLLUP_Interval_Struct *) grown;
+
+            grown = realloc (level->Value, (level->Capacity + ROLLUP_GROWTH) * DECODE_SIGNAL_COUNT
+                            * sizeof(ROLLUP_Value_Struct));
+            if (grown == NULL)
+            {
+                return FALSE;
+            }
+            level->Value = (ROLLUP_Value_Struct *) grown;
+            level->Capacity += ROLLUP_GROWTH;
+        }
+
+        interval = &level->Interval[level->NumIntervals];
+        interval->TimeStamp_S = start;
+        interval->Count = 1;
+
+        value = &level->Value[level->NumIntervals * DECODE_SIGNAL_COUNT];
+        for (s = 0; s < DECODE_SIGNAL_COUNT; s++)
+        {
+            raw = values[s][row];
+            value[s].Min = raw;
+            value[s].Max = raw;
+            value[s].Last = raw;
+            value[s].Sum = RawValue (s, raw);
+        }
+        level->NumIntervals++;
+    }
+
+    return TRUE;
+}
+
+/*******************************************************************************************
+ *
+ *   Procedure Name : WriteRollup
+ *
+ *   Functional Description : Header, then per level the interval table and the values signal
+ *   by signal. Written under another name and renamed, so a reader never sees half a file.
+ *
+ *   Parameters : rollup, segmentChecksum - Header_Checksum of the segment, path - N.rol
+ *
+ *   Returned :  FALSE if the file could not be written
+ *
+ ******************************************************************************************/
+static BOOL WriteRollup (const RollupStr *rollup, UINT32 segmentChecksum, const char *path)
+{
+    ROLLUP_Header_Struct header;
+    const RollupLevelStr *level = NULL;
+    char tempPath[QUERY_PATH_SIZE + 48];
+    FILE *p_file = NULL;
+    UINT32 offset = sizeof(ROLLUP_Header_Struct);
+    UINT32 i = 0;
+    UINT16 l = 0;
+    UINT16 s = 0;
+    BOOL written = TRUE;
+
+    memset (&header, 0, sizeof(header));
+    memcpy (header.Delimiter, "DROL", sizeof(header.Delimiter));
+    header.Endiannes = BIG_ENDIAN;
+    header.Header_Size = sizeof(ROLLUP_Header_Struct);
+    header.Header_Version = ROLLUP_VERSION;
+    header.Segment_Checksum = segmentChecksum;
+    header.Num_Signals = DECODE_SIGNAL_COUNT;
+    header.Num_Levels = ROLLUP_LEVELS;
+    for (l = 0; l < ROLLUP_LEVELS; l++)
+    {
+        header.Level[l].Interval_S = m_IntervalS[l];
+        header.Level[l].Num_Intervals = rollup->Level[l].NumIntervals;
+        header.Level[l].Offset = offset;
+        offset += rollup->Level[l].NumIntervals * LEVEL_INTERVAL_SIZE;
+    }
+
+    /* crc = 0 is flipped in crc.c to 0xFFFFFFFF */
+    header.Header_Checksum = crc32 (0, ((unsigned char*) &header.Header_Version),
+                    (sizeof(ROLLUP_Header_Struct) - ROLLUP_CHECKSUM_ADJUST));
+
+    snprintf (tempPath, sizeof(tempPath), "%s.tmp", path);
+    p_file = fopen (tempPath, "wb");
+    if (p_file == NULL)
+    {
+        return FALSE;
+    }
+
+    written = (fwrite (&header, 1, sizeof(header), p_file) == sizeof(header));
+
+    for (l = 0; written && (l < ROLLUP_LEVELS); l++)
+    {
+        level = &rollup->Level[l];
+        written = (fwrite (level->Interval, sizeof(ROLLUP_Interval_Struct), level->NumIntervals,
+                        p_file) == level->NumIntervals);
+
+        for (s = 0; written && (s < DECODE_SIGNAL_COUNT); s++)
+        {
+            for (i = 0; written && (i < level->NumIntervals); i++)
+            {
+                written = (fwrite (&level->Value[(i * DECODE_SIGNAL_COUNT) + s],
+                                sizeof(ROLLUP_Value_Struct), 1, p_file) == 1);
+            }
+        }
+    }
+
+    if (fclose (p_file) != 0)
+    {
+        written = FALSE;
+    }
+
+    /* rename() does not replace an existing file everywhere */
+    remove (path);
+    if (!written || (rename (tempPath, path) != 0))
+    {
+        remove (tempPath);
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+static void FreeRollup (RollupStr *rollup)
+{
+    UINT16 l = 0;
+
+    for (l = 0; l < ROLLUP_LEVELS; l++)
+    {
+        free (rollup->Level[l].Interval);
+        free (rollup->Level[l].Value);
+    }
+    memset (rollup, 0, sizeof(RollupStr));
+}
+
+/*******************************************************************************************
+ *
+ *   Procedure Name : QueryRollupFile
+ *
+ *   Functional Description : The intervals of one level of N.rol within the window: its
+ *   interval table, then for each column only the values of those intervals
+ *
+ *   Parameters : query, p_file - after the header, header, level, startS, endS, pending,
+ *                rowFunction, context
+ *
+ *   Returned :  None
+ *
+ ******************************************************************************************/
+static void QueryRollupFile (QueryStr *query, FILE *p_file, const ROLLUP_Header_Struct *header,
+                UINT16 level, UINT32 startS, UINT32 endS, RollupPendingStr *pending,
+                RollupRowFunc rowFunction, void *context)
+{
+    static ROLLUP_Value_Struct row[DECODE_SIGNAL_COUNT];
+    const ROLLUP_Level_Struct *levelHeader = &header->Level[level];
+    ROLLUP_Interval_Struct *interval = NULL;
+    ROLLUP_Value_Struct *value[DECODE_SIGNAL_COUNT];
+    UINT32 numIntervals = levelHeader->Num_Intervals;
+    UINT32 first = 0;
+    UINT32 last = 0;
+    UINT32 count = 0;
+    UINT32 i = 0;
+    UINT16 c = 0;
+    UINT16 id = 0;
+    BOOL good = TRUE;
+
+    memset (value, 0, sizeof(value));
+
+    interval = (ROLLUP_Interval_Struct *) malloc ((numIntervals + 1)
+                    * sizeof(ROLLUP_Interval_Struct));
+    if ((interval == NULL) || (fseek (p_file, (long) levelHeader->Offset, SEEK_SET) != 0)
+                    || (fread (interval, sizeof(ROLLUP_Interval_Struct), numIntervals, p_file)
+                                    != numIntervals))
+    {
+        free (interval);
+        return;
+    }
+    query->RollupBytes += numIntervals * sizeof(ROLLUP_Interval_Struct);
+
+    /* In time order, so the window is one run */
+    while ((first < numIntervals) && (interval[first].TimeStamp_S < startS))
+    {
+        first++;
+    }
+    last = first;
+    while ((last < numIntervals) && (interval[last].TimeStamp_S <= endS))
+    {
+        last++;
+    }
+    count = last - first;
+
+    for (c = 0; good && (c < query->NumColumns) && (count != 0); c++)
+    {
+        id = query->Signal[query->Column[c]].Id;
+        value[c] = (ROLLUP_Value_Struct *) malloc (count * sizeof(ROLLUP_Value_Struct));
+        good = (value[c] != NULL)
+                        && (fseek (p_file, (long) (levelHeader->Offset
+                                        + (numIntervals * sizeof(ROLLUP_Interval_Struct))
+                                        + (((id * numIntervals) + first)
+                                                        * sizeof(ROLLUP_Value_Struct))), SEEK_SET) == 0)
+                        && (fread (value[c], sizeof(ROLLUP_Value_Struct), count, p_file) == count);
+        query->RollupBytes += count * sizeof(ROLLUP_Value_Struct);
+    }
+
+    for (i = 0; good && (i < count); i++)
+    {
+        for (c = 0; c < query->NumColumns; c++)
+        {
+            row[c] = value[c][i];
+        }
+        MergeInterval (query, pending, interval[first + i].TimeStamp_S,
+                        interval[first + i].Count, row, rowFunction, context);
+    }
+
+    for (c = 0; c < query->NumColumns; c++)
+    {
+        free (value[c]);
+    }
+    free (interval);
+}
+
+/* As QueryRollupFile(), from a rollup built in memory */
+static void QueryRollup (QueryStr *query, const RollupStr *rollup, UINT16 level, UINT32 startS,
+                UINT32 endS, RollupPendingStr *pending, RollupRowFunc rowFunction, void *context)
+{
+    static ROLLUP_Value_Struct row[DECODE_SIGNAL_COUNT];
+    const RollupLevelStr *rollupLevel = &rollup->Level[level];
+    const ROLLUP_Interval_Struct *interval = NULL;
+    UINT32 i = 0;
+    UINT16 c = 0;
+
+    for (i = 0; i < rollupLevel->NumIntervals; i++)
+    {
+        interval = &rollupLevel->Interval[i];
+        if ((interval->TimeStamp_S < startS) || (interval->TimeStamp_S > endS))
+        {
+            continue;
+        }
+
+        for (c = 0; c < query->NumColumns; c++)
+        {
+            row[c] = rollupLevel->Value[(i * DECODE_SIGNAL_COUNT)
+                            + query->Signal[query->Column[c]].Id];
+        }
+        MergeInterval (query, pending, interval->TimeStamp_S, interval->Count, row, rowFunction,
+                        context);
+    }
+}
+
+/* Held back until an interval with another start comes, merged if it has the same start */
+static void MergeInterval (QueryStr *query, RollupPendingStr *pending, UINT32 timeStampS,
+                UINT32 count, const ROLLUP_Value_Struct *value, RollupRowFunc rowFunction,
+                void *context)
+{
+    UINT16 c = 0;
+    UINT16 id = 0;
+
+    if (pending->Valid && (pending->TimeStamp_S == timeStampS))
+    {
+        for (c = 0; c < query->NumColumns; c++)
+        {
+            id = query->Signal[query->Column[c]].Id;
+            if (RawValue (id, value[c].Min) < RawValue (id, pending->Value[c].Min))
+            {
+                pending->Value[c].Min = value[c].Min;
+            }
+            if (RawValue (id, value[c].Max) > RawValue (id, pending->Value[c].Max))
+            {
+                pending->Value[c].Max = value[c].Max;
+            }
+            pending->Value[c].Last = value[c].Last;
+            pending->Value[c].Sum += value[c].Sum;
+        }
+        pending->Count += count;
+        return;
+    }
+
+    FlushInterval (query, pending, rowFunction, context);
+
+    pending->Valid = TRUE;
+    pending->TimeStamp_S = timeStampS;
+    pending->Count = count;
+    memcpy (pending->Value, value, query->NumColumns * sizeof(ROLLUP_Value_Struct));
+}
+
+static void FlushInterval (QueryStr *query, RollupPendingStr *pending, RollupRowFunc rowFunction,
+                void *context)
+{
+    if (!pending->Valid)
+    {
+        return;
+    }
+
+    rowFunction (context, pending->TimeStamp_S, pending->Count, pending->Value);
+    query->Rows++;
+    pending->Valid = FALSE;
+}
+
+/* A raw value as recorded, IOdometer unsigned */
+static long long RawValue (UINT16 signalId, INT32 value)
+{
+    if (signalId == UNSIGNED_SIGNAL_ID)
+    {
+        return (long long) (UINT32) value;
+    }
+
+    return (long long) value;
+}
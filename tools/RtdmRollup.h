@@ -0,0 +1,94 @@
+/*
+ * RtdmRollup.h
+ *
+ *  Interface of RtdmRollup.c: off-board 1 s / 1 min rollups of the data log ring.
+ */
+
+#ifndef RTDMROLLUP_H_
+#define RTDMROLLUP_H_
+
+/*******************************************************************
+ *
+ *     C  O  N  S  T  A  N  T  S
+ *
+ *******************************************************************/
+#define ROLLUP_VERSION              1
+
+/* 1 s and 1 min */
+#define ROLLUP_LEVELS               2
+#define ROLLUP_SECOND               0
+#define ROLLUP_MINUTE               1
+
+/* Rollup Header Checksum does not include the first 11 bytes, starts at Version, covers the levels */
+#define ROLLUP_CHECKSUM_ADJUST      11
+
+/*******************************************************************
+ *
+ *     E  N  U  M  S
+ *
+ *******************************************************************/
+
+/*******************************************************************
+ *
+ *    S  T  R  U  C  T  S
+ *
+ *******************************************************************/
+/* One resolution of a rollup file */
+typedef struct
+{
+    uint16_t Interval_S __attribute__ ((packed)); /* 1 or 60 */
+    uint32_t Num_Intervals __attribute__ ((packed));
+    uint32_t Offset __attribute__ ((packed)); /* of its interval table from the start of the file */
+} ROLLUP_Level_Struct;
+
+/* Head of N.rol, the rollups of the closed segment N.dan */
+typedef struct
+{
+    char Delimiter[4]; /* "DROL" */
+    uint8_t Endiannes;
+    uint16_t Header_Size __attribute__ ((packed));
+    uint32_t Header_Checksum __attribute__ ((packed));
+    uint8_t Header_Version;
+    uint32_t Segment_Checksum __attribute__ ((packed)); /* Header_Checksum of the N.dan summarized */
+    uint16_t Num_Signals __attribute__ ((packed)); /* DECODE_SIGNAL_COUNT, by signal ID */
+    uint16_t Num_Levels __attribute__ ((packed));
+    ROLLUP_Level_Struct Level[ROLLUP_LEVELS];
+} ROLLUP_Header_Struct;
+
+/* A level is Num_Intervals of these in time order ... */
+typedef struct
+{
+    uint32_t TimeStamp_S __attribute__ ((packed)); /* start of the interval */
+    uint16_t Count __attribute__ ((packed)); /* samples in it */
+} ROLLUP_Interval_Struct;
+
+/* ... then Num_Intervals of these for signal 0, for signal 1, ..., so a chart reads only its own */
+typedef struct
+{
+    int32_t Min __attribute__ ((packed));
+    int32_t Max __attribute__ ((packed));
+    int32_t Last __attribute__ ((packed));
+    int64_t Sum __attribute__ ((packed)); /* mean = Sum / Count */
+} ROLLUP_Value_Struct;
+
+/* Called for every interval in the window, value[c] is the rollup of column c */
+typedef void (*RollupRowFunc) (void *context, UINT32 timeStampS, UINT32 count,
+                const ROLLUP_Value_Struct *value);
+
+/*******************************************************************
+ *
+ *    E  X  T  E  R  N      V  A  R  I  A  B  L  E  S
+ *
+ *******************************************************************/
+
+/*******************************************************************
+ *
+ *    E  X  T  E  R  N      F  U  N  C  T  I  O  N  S
+ *
+ *******************************************************************/
+
+UINT16 UpdateRollups (QueryStr *query, UINT16 *built, UINT16 *removed);
+UINT16 RunRollupQuery (QueryStr *query, UINT16 level, UINT32 startS, UINT32 endS,
+                RollupRowFunc rowFunction, void *context);
+
+#endif /* RTDMROLLUP_H_ */
@@ -0,0 +1,216 @@
+/****************************************************************************************************************
+ * PROJECT    : BART
+ *
+ * MODULE     : RtdmSeqTracker.c
+ *
+ * DESCRIPTON : 	Receiver side tracker of the stream sequence number (STRM header extension,
+ *	Stream_Sequence) with statistics per car.
+ *
+ *	Each car keeps the highest number seen and a bitmap of the TRACKER_WINDOW numbers behind it:
+ *	   above the highest      - numbers skipped on the way are counted missing (a gap)
+ *	   behind, bit clear      - a missing number arrived late (reordered), it is no longer missing
+ *	   behind, bit set        - duplicate
+ *	   more than the window   - the sender started over (sequence file lost), tracking restarts
+ *	A number that is still missing once it falls out of the window stays counted as missing.
+ *
+ * FUNCTIONS:
+ *	void InitializeTracker (SeqTrackerStr *tracker)
+ *	UINT16 TrackSequence (SeqTrackerStr *tracker, const UINT8 carId[16], UINT32 sequence)
+ *	void PrintTracker (SeqTrackerStr *tracker, FILE *out)
+ *
+ **********************************************************************************************************************/
+
+#include <stdio.h>
+#include <string.h>
+
+#include "MyTypes.h"
+#include "RtdmSeqTracker.h"
+
+/*******************************************************************
+ *
+ *     C  O  N  S  T  A  N  T  S
+ *
+ *******************************************************************/
+#define WINDOW_MASK                 (TRACKER_WINDOW - 1)
+
+/*******************************************************************
+ *
+ *    S  T  A  T  I  C      F  U  N  C  T  I  O  N  S
+ *
+ *******************************************************************/
+static CarTrackStr *FindCar (SeqTrackerStr *tracker, const UINT8 carId[16]);
+static void StartCar (CarTrackStr *car, UINT32 sequence);
+static BOOL TestBit (const CarTrackStr *car, UINT32 sequence);
+static void SetBit (CarTrackStr *car, UINT32 sequence);
+static void ClearBit (CarTrackStr *car, UINT32 sequence);
+
+void InitializeTracker (SeqTrackerStr *tracker)
+{
+    memset (tracker, 0, sizeof(SeqTrackerStr));
+}
+
+/*******************************************************************************************
+ *
+ *   Procedure Name : TrackSequence
+ *
+ *   Functional Description : Account for one received stream message
+ *
+ *   Parameters : tracker, carId - Car_ID field of the STRM header, sequence - Stream_Sequence
+ *
+ *   Returned :  TRACK_IN_ORDER, TRACK_GAP, TRACK_REORDERED, TRACK_DUPLICATE, TRACK_RESTART
+ *               or TRACK_NO_ROOM
+ *
+ ******************************************************************************************/
+UINT16 TrackSequence (SeqTrackerStr *tracker, const UINT8 carId[16], UINT32 sequence)
+{
+    CarTrackStr *car = FindCar (tracker, carId);
+    UINT32 skipped = 0;
+    UINT32 s = 0;
+
+    if (car == NULL)
+    {
+        tracker->NoRoom++;
+        return TRACK_NO_ROOM;
+    }
+
+    car->Received++;
+
+    /* First message of this car */
+    if (car->Highest == 0)
+    {
+        StartCar (car, sequence);
+        return TRACK_IN_ORDER;
+    }
+
+    if (sequence > car->Highest)
+    {
+        skipped = sequence - car->Highest - 1;
+
+        /* Numbers in between are now missing; a jump past the window clears it all */
+        if (skipped >= TRACKER_WINDOW)
+        {
+            memset (car->Seen, 0, sizeof(car->Seen));
+        }
+        else
+        {
+            for (s = car->Highest + 1; s < sequence; s++)
+            {
+                ClearBit (car, s);
+            }
+        }
+        SetBit (car, sequence);
+        car->Highest = sequence;
+
+        if (skipped == 0)
+        {
+            return TRACK_IN_ORDER;
+        }
+
+        car->Missing += skipped;
+        car->Gaps++;
+        return TRACK_GAP;
+    }
+
+    if ((car->Highest - sequence) < TRACKER_WINDOW)
+    {
+        if (TestBit (car, sequence))
+        {
+            car->Duplicates++;
+            return TRACK_DUPLICATE;
+        }
+
+        SetBit (car, sequence);
+        car->Reordered++;
+        if (car->Missing != 0)
+        {
+            car->Missing--;
+        }
+        return TRACK_REORDERED;
+    }
+
+    car->Restarts++;
+    StartCar (car, sequence);
+    return TRACK_RESTART;
+}
+
+/* One line per car */
+void PrintTracker (SeqTrackerStr *tracker, FILE *out)
+{
+    CarTrackStr *car = NULL;
+    UINT16 i = 0;
+
+    fprintf (out, "%-16s %10s %10s %8s %8s %10s %10s %8s\n", "car", "last seq", "received",
+                    "missing", "gaps", "reordered", "duplicate", "restart");
+
+    for (i = 0; i < tracker->CarCount; i++)
+    {
+        car = &tracker->Car[i];
+        fprintf (out, "%-16s %10u %10u %8u %8u %10u %10u %8u\n", car->CarId,
+                        (unsigned int) car->Highest, (unsigned int) car->Received,
+                        (unsigned int) car->Missing, (unsigned int) car->Gaps,
+                        (unsigned int) car->Reordered, (unsigned int) car->Duplicates,
+                        (unsigned int) car->Restarts);
+    }
+
+    if (tracker->NoRoom != 0)
+    {
+        fprintf (out, "%u messages from cars beyond %d not tracked\n",
+                        (unsigned int) tracker->NoRoom, TRACKER_MAX_CARS);
+    }
+}
+
+static CarTrackStr *FindCar (SeqTrackerStr *tracker, const UINT8 carId[16])
+{
+    CarTrackStr *car = NULL;
+    UINT16 i = 0;
+
+    for (i = 0; i < tracker->CarCount; i++)
+    {
+        if (strncmp (tracker->Car[i].CarId, (const char *) carId, 16) == 0)
+        {
+            return &tracker->Car[i];
+        }
+    }
+
+    if (tracker->CarCount >= TRACKER_MAX_CARS)
+    {
+        return NULL;
+    }
+
+    car = &tracker->Car[tracker->CarCount];
+    tracker->CarCount++;
+
+    memset (car, 0, sizeof(CarTrackStr));
+    memcpy (car->CarId, carId, 16);
+    car->CarId[16] = '\0';
+
+    return car;
+}
+
+static void StartCar (CarTrackStr *car, UINT32 sequence)
+{
+    memset (car->Seen, 0, sizeof(car->Seen));
+    car->Highest = sequence;
+    SetBit (car, sequence);
+}
+
+static BOOL TestBit (const CarTrackStr *car, UINT32 sequence)
+{
+    UINT32 bit = sequence & WINDOW_MASK;
+
+    return (car->Seen[bit / 8] & (1 << (bit % 8))) != 0;
+}
+
+static void SetBit (CarTrackStr *car, UINT32 sequence)
+{
+    UINT32 bit = sequence & WINDOW_MASK;
+
+    car->Seen[bit / 8] |= (UINT8) (1 << (bit % 8));
+}
+
+static void ClearBit (CarTrackStr *car, UINT32 sequence)
+{
+    UINT32 bit = sequence & WINDOW_MASK;
+
+    car->Seen[bit / 8] &= (UINT8) ~(1 << (bit % 8));
+}
@@ -0,0 +1,76 @@
+/*
+ * RtdmSeqTracker.h
+ *
+ *  Interface of RtdmSeqTracker.c: receiver side tracker of the stream sequence number.
+ */
+
+#ifndef RTDMSEQTRACKER_H_
+#define RTDMSEQTRACKER_H_
+
+/*******************************************************************
+ *
+ *     C  O  N  S  T  A  N  T  S
+ *
+ *******************************************************************/
+/* Cars tracked at the same time */
+#define TRACKER_MAX_CARS            32
+
+/* Sequence numbers remembered behind the highest one, a power of 2 */
+#define TRACKER_WINDOW              1024
+
+/* Results of TrackSequence() */
+#define TRACK_IN_ORDER              0
+#define TRACK_GAP                   1 /* newer than expected, the numbers in between are missing */
+#define TRACK_REORDERED             2 /* late arrival of a number counted missing */
+#define TRACK_DUPLICATE             3
+#define TRACK_RESTART               4 /* far behind the highest, the sender started over */
+#define TRACK_NO_ROOM               5 /* more than TRACKER_MAX_CARS cars */
+
+/*******************************************************************
+ *
+ *     E  N  U  M  S
+ *
+ *******************************************************************/
+
+/*******************************************************************
+ *
+ *    S  T  R  U  C  T  S
+ *
+ *******************************************************************/
+typedef struct
+{
+    char CarId[17]; /* Car_ID from the STRM header, terminated */
+    UINT32 Highest; /* highest sequence number seen */
+    UINT32 Received; /* messages received, duplicates included */
+    UINT32 Missing; /* numbers skipped and not (yet) received late */
+    UINT32 Gaps; /* times one or more numbers were skipped */
+    UINT32 Reordered; /* numbers received after a higher one */
+    UINT32 Duplicates; /* numbers received twice */
+    UINT32 Restarts; /* sequence started over */
+    UINT8 Seen[TRACKER_WINDOW / 8]; /* one bit per number up to TRACKER_WINDOW behind Highest */
+} CarTrackStr;
+
+typedef struct
+{
+    CarTrackStr Car[TRACKER_MAX_CARS];
+    UINT16 CarCount;
+    UINT32 NoRoom; /* messages from cars beyond TRACKER_MAX_CARS */
+} SeqTrackerStr;
+
+/*******************************************************************
+ *
+ *    E  X  T  E  R  N      V  A  R  I  A  B  L  E  S
+ *
+ *******************************************************************/
+
+/*******************************************************************
+ *
+ *    E  X  T  E  R  N      F  U  N  C  T  I  O  N  S
+ *
+ *******************************************************************/
+
+void InitializeTracker (SeqTrackerStr *tracker);
+UINT16 TrackSequence (SeqTrackerStr *tracker, const UINT8 carId[16], UINT32 sequence);
+void PrintTracker (SeqTrackerStr *tracker, FILE *out);
+
+#endif /* RTDMSEQTRACKER_H_ */
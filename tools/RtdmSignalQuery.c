@@ -0,0 +1,300 @@
+/****************************************************************************************************************
+ * PROJECT    : BART
+ *
+ * MODULE     : RtdmSignalQuery.c
+ *
+ * DESCRIPTON : 	Off-board tool that prints the values of named signals between two times from the data
+ *	log ring (N.dan segments), e.g. ICarSpeed from 14:02 to 14:05.
+ *
+ *	The query engine (RtdmQuery.c) only opens the segments whose time range overlaps the window and
+ *	seeks to the first block of the window within them, so a few minutes out of a full ring costs a
+ *	few blocks rather than a full export. Values are scaled with the scale and nbDecimals of the .xml
+ *	and printed as CSV on stdout; what was read goes to stderr.
+ *
+ *	Times are UTC and given as seconds since 1970, "YYYY-MM-DD HH:MM:SS[.mmm]", or "HH:MM:SS[.mmm]"
+ *	for that time on the day of the newest sample in the ring.
+ *
+ *	A signal followed by <, <=, >, >=, =, != and a value in engineering units, or & and a raw mask,
+ *	is a predicate: only the samples where every predicate holds are printed, and segments and
+ *	blocks whose zone maps rule the predicate out are not read. The signal is printed as well.
+ *
+ * BUILD :
+ *	gcc -O2 -DTEST_ON_PC -DTARGET_SIM_DLL -I../src RtdmSignalQuery.c RtdmQuery.c RtdmDecoder.c
+ *	    ../src/crc32.c -fcommon -o RtdmSignalQuery
+ *
+ * USAGE :
+ *	RtdmSignalQuery config.xml directory start end signal[op value] [signal[op value] ...]
+ *	e.g. RtdmSignalQuery rtdm_config.xml . 14:02 14:05 ICarSpeed IOdometer
+ *	     RtdmSignalQuery rtdm_config.xml . 0 4000000000 "IDcLinkVoltage<600" ICarSpeed
+ *
+ **********************************************************************************************************************/
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "MyTypes.h"
+#include "RTDM_Stream_ext.h"
+#include "RtdmDecoder.h"
+#include "RtdmQuery.h"
+
+/*******************************************************************
+ *
+ *     C  O  N  S  T  A  N  T  S
+ *
+ *******************************************************************/
+#define SECONDS_PER_DAY             86400
+
+/*******************************************************************
+ *
+ *    S  T  A  T  I  C      F  U  N  C  T  I  O  N  S
+ *
+ *******************************************************************/
+static BOOL ParseTime (const char *text, UINT32 day, UINT32 *seconds, UINT16 *msecs);
+static UINT16 AddArgument (QueryStr *query, const char *argument);
+static void PrintRow (void *context, UINT32 timeStampS, UINT16 timeStampMs, const INT32 *value);
+
+int main (int argc, char *argv[])
+{
+    QueryStr *query = NULL;
+    UINT32 firstS = 0;
+    UINT32 lastS = 0;
+    UINT32 startS = 0;
+    UINT32 endS = 0;
+    UINT16 startMs = 0;
+    UINT16 endMs = 0;
+    UINT16 result = 0;
+    UINT16 c = 0;
+    const QuerySignalStr *signal = NULL;
+    struct timespec begin;
+    struct timespec finish;
+    int i = 0;
+
+    if (argc < 6)
+    {
+        fprintf (stderr, "usage: %s config.xml directory start end signal[op value] ...\n", argv[0]);
+        return 2;
+    }
+
+    query = (QueryStr *) malloc (sizeof(QueryStr));
+    if (query == NULL)
+    {
+        return 1;
+    }
+
+    clock_gettime (CLOCK_MONOTONIC, &begin);
+
+    result = OpenQuery (query, argv[1], argv[2]);
+    if (result != QUERY_OK)
+    {
+        fprintf (stderr, "%s: %s\n", argv[1], QueryResultText (result));
+        free (query);
+        return 1;
+    }
+
+    for (i = 5; i < argc; i++)
+    {
+        result = AddArgument (query, argv[i]);
+        if (result != QUERY_OK)
+        {
+            fprintf (stderr, "%s: %s\n", argv[i], QueryResultText (result));
+            free (query);
+            return 1;
+        }
+    }
+
+    if (!GetRingTimeRange (query, &firstS, &lastS))
+    {
+        fprintf (stderr, "No data log segments in %s\n", argv[2]);
+        free (query);
+        return 1;
+    }
+
+    if (!ParseTime (argv[3], lastS - (lastS % SECONDS_PER_DAY), &startS, &startMs)
+                    || !ParseTime (argv[4], lastS - (lastS % SECONDS_PER_DAY), &endS, &endMs))
+    {
+        fprintf (stderr, "Times are seconds, YYYY-MM-DD HH:MM:SS[.mmm] or HH:MM:SS[.mmm]\n");
+        free (query);
+        return 2;
+    }
+
+    /* Header */
+    printf ("time");
+    for (c = 0; c < query->NumColumns; c++)
+    {
+        signal = &query->Signal[query->Column[c]];
+        if (signal->Unit[0] != '\0')
+        {
+            printf (",%s [%s]", signal->Name, signal->Unit);
+        }
+        else
+        {
+            printf (",%s", signal->Name);
+        }
+    }
+    printf ("\n");
+
+    result = RunQuery (query, startS, startMs, endS, endMs, PrintRow, query);
+    if (result != QUERY_OK)
+    {
+        fprintf (stderr, "%s .. %s: %s\n", argv[3], argv[4], QueryResultText (result));
+        free (query);
+        return 2;
+    }
+
+    clock_gettime (CLOCK_MONOTONIC, &finish);
+
+    fprintf (stderr, "%u rows, %u segments read, %u skipped%s, %u pruned, %u indexes used, "
+                    "%u blocks read, %u pruned, %u rejected, %.1f ms\n", query->Rows,
+                    query->SegmentsRead, query->SegmentsSkipped,
+                    query->Catalog ? " by catalog" : "", query->SegmentsPruned, query->IndexesUsed,
+                    query->BlocksRead, query->BlocksPruned, query->BlocksRejected,
+                    ((finish.tv_sec - begin.tv_sec) * 1000.0)
+                                    + ((finish.tv_nsec - begin.tv_nsec) / 1000000.0));
+
+    free (query);
+
+    return 0;
+}
+
+/* A signal to print, with a predicate on it if an operator follows the name */
+static UINT16 AddArgument (QueryStr *query, const char *argument)
+{
+    /* Two character operators first so <= is not read as < */
+    static const char *operatorText[] =
+    { "<=", ">=", "!=", "<", ">", "=", "&" };
+    static const UINT16 operatorCode[] =
+    { QUERY_LESS_EQUAL, QUERY_GREATER_EQUAL, QUERY_NOT_EQUAL, QUERY_LESS, QUERY_GREATER,
+      QUERY_EQUAL, QUERY_ANY_BITS };
+    char name[QUERY_NAME_SIZE];
+    const char *pOperator = NULL;
+    const char *pValue = NULL;
+    char *pEnd = NULL;
+    size_t nameLength = 0;
+    double value = 0.0;
+    UINT16 i = 0;
+    UINT16 result = 0;
+
+    pOperator = strpbrk (argument, "<>=!&");
+    if (pOperator == NULL)
+    {
+        return AddQueryColumn (query, argument);
+    }
+
+    nameLength = (size_t) (pOperator - argument);
+    if ((nameLength == 0) || (nameLength >= sizeof(name)))
+    {
+        return QUERY_BAD_PREDICATE;
+    }
+    memcpy (name, argument, nameLength);
+    name[nameLength] = '\0';
+
+    for (i = 0; i < (sizeof(operatorText) / sizeof(operatorText[0])); i++)
+    {
+        if (strncmp (pOperator, operatorText[i], strlen (operatorText[i])) == 0)
+        {
+            pValue = pOperator + strlen (operatorText[i]);
+            break;
+        }
+    }
+    if (pValue == NULL)
+    {
+        return QUERY_BAD_PREDICATE;
+    }
+
+    value = strtod (pValue, &pEnd);
+    if ((pEnd == pValue) || (*pEnd != '\0'))
+    {
+        return QUERY_BAD_PREDICATE;
+    }
+
+    result = AddQueryPredicate (query, name, operatorCode[i], value);
+    if (result != QUERY_OK)
+    {
+        return result;
+    }
+
+    return AddQueryColumn (query, name);
+}
+
+/* Seconds since 1970, a UTC date and time, or a time on the given day */
+static BOOL ParseTime (const char *text, UINT32 day, UINT32 *seconds, UINT16 *msecs)
+{
+    struct tm date;
+    unsigned int hour = 0;
+    unsigned int minute = 0;
+    unsigned int second = 0;
+    unsigned int msec = 0;
+    char *pEnd = NULL;
+    const char *pTime = text;
+    unsigned long value = 0;
+    int fields = 0;
+
+    *msecs = 0;
+
+    if (strchr (text, ':') == NULL)
+    {
+        value = strtoul (text, &pEnd, 10);
+        if ((pEnd == text) || (*pEnd != '\0'))
+        {
+            return FALSE;
+        }
+        *seconds = (UINT32) value;
+        return TRUE;
+    }
+
+    memset (&date, 0, sizeof(date));
+    if (strchr (text, '-') != NULL)
+    {
+        if (sscanf (text, "%d-%d-%d", &date.tm_year, &date.tm_mon, &date.tm_mday) != 3)
+        {
+            return FALSE;
+        }
+        date.tm_year -= 1900;
+        date.tm_mon -= 1;
+        day = (UINT32) timegm (&date);
+
+        pTime = strpbrk (text, " T");
+        if (pTime == NULL)
+        {
+            return FALSE;
+        }
+        pTime++;
+    }
+
+    fields = sscanf (pTime, "%u:%u:%u.%u", &hour, &minute, &second, &msec);
+    if ((fields < 2) || (hour > 23) || (minute > 59) || (second > 59) || (msec > 999))
+    {
+        return FALSE;
+    }
+
+    *seconds = day + (hour * 3600) + (minute * 60) + second;
+    *msecs = (UINT16) msec;
+
+    return TRUE;
+}
+
+/* One CSV row, values scaled and rounded to the decimals of the .xml */
+static void PrintRow (void *context, UINT32 timeStampS, UINT16 timeStampMs, const INT32 *value)
+{
+    const QueryStr *query = (const QueryStr *) context;
+    const QuerySignalStr *signal = NULL;
+    struct tm date;
+    time_t seconds = (time_t) timeStampS;
+    UINT16 c = 0;
+
+    gmtime_r (&seconds, &date);
+    printf ("%04d-%02d-%02d %02d:%02d:%02d.%03u", date.tm_year + 1900, date.tm_mon + 1,
+                    date.tm_mday, date.tm_hour, date.tm_min, date.tm_sec,
+                    (unsigned int) timeStampMs);
+
+    for (c = 0; c < query->NumColumns; c++)
+    {
+        signal = &query->Signal[query->Column[c]];
+        printf (",%.*f", (int) signal->Decimals, value[c] * signal->Scale);
+    }
+    printf ("\n");
+}
@@ -0,0 +1,312 @@
+/****************************************************************************************************************
+ * PROJECT    : BART
+ *
+ * MODULE     : RtdmStreamMonitor.c
+ *
+ * DESCRIPTON : 	Off-board receiver for the UDP and UNIX stand-in transports (src/RtdmTransport.c) that
+ *	reports lost, duplicated and reordered stream messages per car.
+ *
+ *	Datagrams are put back together when the recorder fragments them (transportMtu), then every STRM
+ *	message has its header checksum checked and its Stream_Sequence (header extension, Header_Version
+ *	3) passed to the sequence tracker (RtdmSeqTracker.c). Messages replayed from the data log
+ *	(STREAM_SEQUENCE_REPLAY) and EVNT messages are counted. A report per car is printed at the given
+ *	interval and once more at the end.
+ *
+ * BUILD :
+ *	gcc -O2 -DTEST_ON_PC -DTARGET_SIM_DLL -I../src RtdmStreamMonitor.c RtdmSeqTracker.c
+ *	    ../src/RtdmFragment.c ../src/crc32.c -fcommon -o RtdmStreamMonitor
+ *
+ * USAGE :
+ *	RtdmStreamMonitor UDP|UNIX address [report seconds, default 10] [run seconds, default 0 = forever]
+ *	e.g. RtdmStreamMonitor UDP 127.0.0.1:20550 5
+ *
+ **********************************************************************************************************************/
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include "MyTypes.h"
+#include "RTDM_Stream_ext.h"
+#include "RtdmFragment.h"
+#include "RtdmSeqTracker.h"
+
+/*******************************************************************
+ *
+ *     C  O  N  S  T  A  N  T  S
+ *
+ *******************************************************************/
+/* IBufferSize (2) + STRM header (85) + header extension (7) + 60,000 byte buffer */
+#define MAX_MESSAGE_SIZE        60094
+
+#define REASSEMBLY_TIMEOUT_MS   1000
+
+/* The STRM header follows IBufferSize */
+#define STRM_OFFSET             2
+
+/*******************************************************************
+ *
+ *    S  T  A  T  I  C      V  A  R  I  A  B  L  E  S
+ *
+ *******************************************************************/
+static SeqTrackerStr m_Tracker;
+static ReassemblerStr m_Reassembler;
+
+static unsigned long m_Messages = 0;
+static unsigned long m_BadChecksum = 0;
+static unsigned long m_NoSequence = 0;
+static unsigned long m_Replayed = 0;
+static unsigned long m_Events = 0;
+static unsigned long m_Unknown = 0;
+
+static volatile int m_Stop = 0;
+
+/*******************************************************************
+ *
+ *    S  T  A  T  I  C      F  U  N  C  T  I  O  N  S
+ *
+ *******************************************************************/
+static int OpenSocket (const char *type, const char *address);
+static void HandleMessage (const UINT8 *message, UINT32 messageSize);
+static void Report (void);
+static void StopHandler (int signal);
+static UINT32 NowMs (void);
+
+int main (int argc, char *argv[])
+{
+    static UINT8 datagram[FRAG_MAX_MTU + MAX_MESSAGE_SIZE];
+    const UINT8 *message = NULL;
+    UINT32 messageSize = 0;
+    int reportSeconds = 10;
+    int runSeconds = 0;
+    time_t start = 0;
+    time_t lastReport = 0;
+    ssize_t length = 0;
+    int sock = -1;
+
+    if (argc < 3)
+    {
+        printf ("usage: %s UDP|UNIX address [report seconds] [run seconds]\n", argv[0]);
+        return 2;
+    }
+    if (argc > 3)
+    {
+        reportSeconds = atoi (argv[3]);
+    }
+    if (argc > 4)
+    {
+        runSeconds = atoi (argv[4]);
+    }
+
+    sock = OpenSocket (argv[1], argv[2]);
+    if (sock < 0)
+    {
+        return 1;
+    }
+
+    InitializeTracker (&m_Tracker);
+    InitializeReassembler (&m_Reassembler, MAX_MESSAGE_SIZE, REASSEMBLY_TIMEOUT_MS);
+
+    signal (SIGINT, StopHandler);
+    signal (SIGTERM, StopHandler);
+
+    start = time (NULL);
+    lastReport = start;
+
+    while (!m_Stop)
+    {
+        length = recv (sock, datagram, sizeof(datagram), 0);
+        if (length > 0)
+        {
+            if ((length >= 4) && (memcmp (datagram, "FRAG", 4) == 0))
+            {
+                if (ReassembleFragment (&m_Reassembler, datagram, (UINT32) length, NowMs (),
+                                &message, &messageSize) == FRAG_COMPLETE)
+                {
+                    HandleMessage (message, messageSize);
+                }
+            }
+            else
+            {
+                HandleMessage (datagram, (UINT32) length);
+            }
+        }
+        ExpireReassembly (&m_Reassembler, NowMs ());
+
+        if ((reportSeconds > 0) && ((time (NULL) - lastReport) >= reportSeconds))
+        {
+            Report ();
+            lastReport = time (NULL);
+        }
+
+        if ((runSeconds > 0) && ((time (NULL) - start) >= runSeconds))
+        {
+            break;
+        }
+    }
+
+    Report ();
+    close (sock);
+
+    return 0;
+}
+
+/* Bound receiving socket with a short timeout so reports and the run time are kept */
+static int OpenSocket (const char *type, const char *address)
+{
+    struct sockaddr_in udpAddress;
+    struct sockaddr_un unixAddress;
+    struct timeval timeout;
+    char host[64];
+    unsigned int port = 0;
+    int receiveBufferSize = 4 * 1024 * 1024;
+    int sock = -1;
+
+    if (strcmp (type, "UDP") == 0)
+    {
+        memset (&udpAddress, 0, sizeof(udpAddress));
+        memset (host, 0, sizeof(host));
+        if ((sscanf (address, "%63[^:]:%u", host, &port) != 2)
+                        || (inet_pton (AF_INET, host, &udpAddress.sin_addr) != 1))
+        {
+            printf ("UDP address %s is not host:port\n", address);
+            return -1;
+        }
+        udpAddress.sin_family = AF_INET;
+        udpAddress.sin_port = htons ((unsigned short) port);
+
+        sock = socket (AF_INET, SOCK_DGRAM, 0);
+        if ((sock < 0) || (bind (sock, (struct sockaddr *) &udpAddress, sizeof(udpAddress)) != 0))
+        {
+            printf ("UDP %s could not be bound\n", address);
+            return -1;
+        }
+    }
+    else if (strcmp (type, "UNIX") == 0)
+    {
+        memset (&unixAddress, 0, sizeof(unixAddress));
+        if (strlen (address) >= sizeof(unixAddress.sun_path))
+        {
+            printf ("UNIX path %s is too long\n", address);
+            return -1;
+        }
+        unixAddress.sun_family = AF_UNIX;
+        strcpy (unixAddress.sun_path, address);
+        unlink (address);
+
+        sock = socket (AF_UNIX, SOCK_DGRAM, 0);
+        if ((sock < 0)
+                        || (bind (sock, (struct sockaddr *) &unixAddress, sizeof(unixAddress)) != 0))
+        {
+            printf ("UNIX %s could not be bound\n", address);
+            return -1;
+        }
+    }
+    else
+    {
+        printf ("Transport %s is not UDP or UNIX\n", type);
+        return -1;
+    }
+
+    setsockopt (sock, SOL_SOCKET, SO_RCVBUF, &receiveBufferSize, sizeof(receiveBufferSize));
+
+    timeout.tv_sec = 0;
+    timeout.tv_usec = 200000;
+    setsockopt (sock, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+    return sock;
+}
+
+/* One complete message, STRM or EVNT */
+static void HandleMessage (const UINT8 *message, UINT32 messageSize)
+{
+    const STRM_Header_Struct *header = NULL;
+    const STRM_Header_Ext_Struct *extension = NULL;
+    const EVNT_Header_Struct *event = NULL;
+    UINT32 checksum = 0;
+
+    if ((messageSize >= sizeof(EVNT_Header_Struct)) && (memcmp (message, "EVNT", 4) == 0))
+    {
+        event = (const EVNT_Header_Struct *) message;
+        m_Events += event->Num_Events;
+        return;
+    }
+
+    if ((messageSize < (STRM_OFFSET + sizeof(STRM_Header_Struct)))
+                    || (memcmp (&message[STRM_OFFSET], "STRM", 4) != 0))
+    {
+        m_Unknown++;
+        return;
+    }
+
+    m_Messages++;
+    header = (const STRM_Header_Struct *) &message[STRM_OFFSET];
+
+    if ((header->Header_Size < sizeof(STRM_Header_Struct))
+                    || ((UINT32) (STRM_OFFSET + header->Header_Size) > messageSize))
+    {
+        m_BadChecksum++;
+        return;
+    }
+
+    checksum = crc32 (0, &message[STRM_OFFSET + STREAM_HEADER_CHECKSUM_ADJUST],
+                    header->Header_Size - STREAM_HEADER_CHECKSUM_ADJUST);
+    if (checksum != header->Header_Checksum)
+    {
+        m_BadChecksum++;
+        return;
+    }
+
+    if ((header->Header_Version < 3)
+                    || (header->Header_Size < (sizeof(STRM_Header_Struct) + STREAM_HEADER_EXT_SIZE)))
+    {
+        m_NoSequence++;
+        return;
+    }
+
+    extension = (const STRM_Header_Ext_Struct *) &message[STRM_OFFSET + sizeof(STRM_Header_Struct)];
+
+    /* Not part of the live sequence */
+    if (extension->Stream_Sequence == STREAM_SEQUENCE_REPLAY)
+    {
+        m_Replayed++;
+        return;
+    }
+
+    TrackSequence (&m_Tracker, header->Car_ID, extension->Stream_Sequence);
+}
+
+static void Report (void)
+{
+    printf ("\n%lu stream messages, %lu bad header, %lu without sequence, %lu replayed, %lu events, "
+                    "%lu other\n", m_Messages, m_BadChecksum, m_NoSequence, m_Replayed, m_Events,
+                    m_Unknown);
+    printf ("fragments: %u messages timed out, %u evicted\n",
+                    (unsigned int) m_Reassembler.TimedOut, (unsigned int) m_Reassembler.Evicted);
+    PrintTracker (&m_Tracker, stdout);
+    fflush (stdout);
+}
+
+static void StopHandler (int signal)
+{
+    (void) signal;
+    m_Stop = 1;
+}
+
+static UINT32 NowMs (void)
+{
+    struct timespec now;
+
+    clock_gettime (CLOCK_MONOTONIC, &now);
+
+    return (UINT32) ((now.tv_sec * 1000) + (now.tv_nsec / 1000000));
+}
@@ -0,0 +1,295 @@
+/****************************************************************************************************************
+ * PROJECT    : BART
+ *
+ * MODULE     : RtdmTransportBench.c
+ *
+ * DESCRIPTON : 	Linux bench for the stream transports in src/RtdmTransport.c.
+ *
+ *	Messages of the stream sizes the recorder produces are pushed through TransportSend() as fast as
+ *	the backend accepts them for a fixed time. For UDP and UNIX a receiver thread bound to the same
+ *	address counts what actually arrives, so datagrams dropped by the kernel show up as loss. For FILE
+ *	the sink file size is checked afterwards. Reported per message size:
+ *	   msgs/s, MB/s             - accepted by the backend
+ *	   avg/max send usec        - time spent inside TransportSend()
+ *	   received, loss           - UDP / UNIX / FILE only
+ *
+ * BUILD :
+ *	gcc -O2 -DTEST_ON_PC -DTARGET_SIM_DLL -I../src RtdmTransportBench.c ../src/RtdmTransport.c
+ *	    ../src/RtdmFragment.c ../src/crc32.c ../src/MyFuncs.c ../src/MySleep.c -fcommon -lpthread
+ *	    -o RtdmTransportBench
+ *
+ * USAGE :
+ *	RtdmTransportBench UDP 127.0.0.1:20550 [seconds per size, default 2] [message size]
+ *	RtdmTransportBench UNIX /tmp/rtdm.sock
+ *	RtdmTransportBench FILE /tmp/rtdm_stream.bin
+ *	RtdmTransportBench IPTCOM -            (PC stub, measures the call overhead only)
+ *
+ **********************************************************************************************************************/
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include "MyTypes.h"
+#include "RtdmTransport.h"
+
+/*******************************************************************
+ *
+ *     C  O  N  S  T  A  N  T  S
+ *
+ *******************************************************************/
+/* IBufferSize (2) + STRM header (85) */
+#define MESSAGE_OVERHEAD        87
+
+/* Largest stream message, 60,000 byte buffer */
+#define MAX_MESSAGE_SIZE        (MESSAGE_OVERHEAD + 60000)
+
+/*******************************************************************
+ *
+ *    S  T  R  U  C  T  S
+ *
+ *******************************************************************/
+typedef struct
+{
+    int socket;
+    volatile int stop;
+    unsigned long messages;
+    unsigned long long bytes;
+} ReceiverStr;
+
+/*******************************************************************
+ *
+ *    S  T  A  T  I  C      V  A  R  I  A  B  L  E  S
+ *
+ *******************************************************************/
+/* 1,000 / 10,000 / 60,000 byte buffers plus the header */
+static const unsigned int m_DefaultSizes[] =
+{ MESSAGE_OVERHEAD + 1000, MESSAGE_OVERHEAD + 10000, MAX_MESSAGE_SIZE };
+
+#define NUM_DEFAULT_SIZES   (sizeof(m_DefaultSizes) / sizeof(unsigned int))
+
+/*******************************************************************
+ *
+ *    S  T  A  T  I  C      F  U  N  C  T  I  O  N  S
+ *
+ *******************************************************************/
+static int OpenReceiver (const char *type, const char *address, ReceiverStr *receiver);
+static void *ReceiverThread (void *arg);
+static void RunSize (const char *type, const char *address, unsigned int size, double seconds);
+static double NowSeconds (void);
+
+int main (int argc, char *argv[])
+{
+    double seconds = 2.0;
+    unsigned int i = 0;
+
+    if (argc < 3)
+    {
+        printf ("usage: %s UDP|UNIX|FILE|IPTCOM address [seconds] [message size]\n", argv[0]);
+        return 2;
+    }
+
+    if (argc > 3)
+    {
+        seconds = atof (argv[3]);
+    }
+
+    printf ("%-8s %10s %10s %10s %10s %10s %12s %8s\n", "backend", "size", "msgs/s", "MB/s",
+                    "avg usec", "max usec", "received", "loss %");
+
+    if (argc > 4)
+    {
+        RunSize (argv[1], argv[2], (unsigned int) atoi (argv[4]), seconds);
+    }
+    else
+    {
+        for (i = 0; i < NUM_DEFAULT_SIZES; i++)
+        {
+            RunSize (argv[1], argv[2], m_DefaultSizes[i], seconds);
+        }
+    }
+
+    return 0;
+}
+
+static void RunSize (const char *type, const char *address, unsigned int size, double seconds)
+{
+    ReceiverStr receiver;
+    pthread_t thread;
+    TransportStatsStr stats;
+    TransportChannelStr channel;
+    UINT8 *message = NULL;
+    struct stat fileStat;
+    double start = 0.0;
+    double elapsed = 0.0;
+    unsigned long received = 0;
+    unsigned int i = 0;
+    int haveReceiver = 0;
+
+    if ((size < MESSAGE_OVERHEAD) || (size > MAX_MESSAGE_SIZE))
+    {
+        printf ("message size must be %d to %d\n", MESSAGE_OVERHEAD, MAX_MESSAGE_SIZE);
+        return;
+    }
+
+    message = (UINT8 *) malloc (size);
+    for (i = 0; i < size; i++)
+    {
+        message[i] = (UINT8) i;
+    }
+
+    memset (&receiver, 0, sizeof(receiver));
+    haveReceiver = OpenReceiver (type, address, &receiver);
+    if (haveReceiver)
+    {
+        pthread_create (&thread, NULL, ReceiverThread, &receiver);
+    }
+
+    if (OpenTransport (&channel, type, address, 800310015UL, "grpRTDM.lCar.lCst", 0) != 0)
+    {
+        printf ("%s %s could not be opened\n", type, address);
+        CloseTransport (&channel);
+        free (message);
+        return;
+    }
+
+    start = NowSeconds ();
+    do
+    {
+        /* A refused datagram is counted as a failure by the transport, keep going */
+        TransportSend (&channel, message, size);
+        elapsed = NowSeconds () - start;
+    } while (elapsed < seconds);
+
+    GetTransportStats (&channel, &stats);
+    CloseTransport (&channel);
+
+    if (haveReceiver)
+    {
+        /* Let the receiver drain the socket */
+        usleep (200000);
+        receiver.stop = 1;
+        pthread_join (thread, NULL);
+        close (receiver.socket);
+        received = receiver.messages;
+    }
+    else if ((strcmp (type, "FILE") == 0) && (stat (address, &fileStat) == 0))
+    {
+        received = (unsigned long) (fileStat.st_size / size);
+    }
+
+    printf ("%-8s %10u %10.0f %10.1f %10.1f %10lu", GetTransportName (&channel), size,
+                    stats.Messages / elapsed, (stats.Bytes / elapsed) / 1.0e6,
+                    (elapsed * 1.0e6) / (stats.Messages + stats.Failures),
+                    (unsigned long) stats.MaxSendUs);
+
+    if (haveReceiver || (strcmp (type, "FILE") == 0))
+    {
+        printf (" %12lu %8.2f\n", received,
+                        stats.Messages ? (100.0 * (stats.Messages - received)) / stats.Messages : 0.0);
+    }
+    else
+    {
+        printf (" %12s %8s\n", "-", "-");
+    }
+
+    free (message);
+}
+
+/* Bind a receiving socket for the socket backends; returns 1 if there is one */
+static int OpenReceiver (const char *type, const char *address, ReceiverStr *receiver)
+{
+    struct sockaddr_in udpAddress;
+    struct sockaddr_un unixAddress;
+    struct timeval timeout;
+    char host[64];
+    unsigned int port = 0;
+    int receiveBufferSize = 8 * 1024 * 1024;
+
+    if (strcmp (type, "UDP") == 0)
+    {
+        if (sscanf (address, "%63[^:]:%u", host, &port) != 2)
+        {
+            return 0;
+        }
+        memset (&udpAddress, 0, sizeof(udpAddress));
+        udpAddress.sin_family = AF_INET;
+        udpAddress.sin_port = htons ((unsigned short) port);
+        inet_pton (AF_INET, host, &udpAddress.sin_addr);
+
+        receiver->socket = socket (AF_INET, SOCK_DGRAM, 0);
+        setsockopt (receiver->socket, SOL_SOCKET, SO_RCVBUF, &receiveBufferSize,
+                        sizeof(receiveBufferSize));
+        if (bind (receiver->socket, (struct sockaddr *) &udpAddress, sizeof(udpAddress)) != 0)
+        {
+            perror ("bind");
+            close (receiver->socket);
+            return 0;
+        }
+    }
+    else if (strcmp (type, "UNIX") == 0)
+    {
+        memset (&unixAddress, 0, sizeof(unixAddress));
+        unixAddress.sun_family = AF_UNIX;
+        strncpy (unixAddress.sun_path, address, sizeof(unixAddress.sun_path) - 1);
+        unlink (address);
+
+        receiver->socket = socket (AF_UNIX, SOCK_DGRAM, 0);
+        setsockopt (receiver->socket, SOL_SOCKET, SO_RCVBUF, &receiveBufferSize,
+                        sizeof(receiveBufferSize));
+        if (bind (receiver->socket, (struct sockaddr *) &unixAddress, sizeof(unixAddress)) != 0)
+        {
+            perror ("bind");
+            close (receiver->socket);
+            return 0;
+        }
+    }
+    else
+    {
+        return 0;
+    }
+
+    timeout.tv_sec = 0;
+    timeout.tv_usec = 100000;
+    setsockopt (receiver->socket, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+    return 1;
+}
+
+static void *ReceiverThread (void *arg)
+{
+    ReceiverStr *receiver = (ReceiverStr *) arg;
+    static UINT8 buffer[MAX_MESSAGE_SIZE + 1];
+    ssize_t length = 0;
+
+    while (!receiver->stop)
+    {
+        length = recv (receiver->socket, buffer, sizeof(buffer), 0);
+        if (length > 0)
+        {
+            receiver->messages++;
+            receiver->bytes += (unsigned long long) length;
+        }
+    }
+
+    return NULL;
+}
+
+static double NowSeconds (void)
+{
+    struct timespec now;
+
+    clock_gettime (CLOCK_MONOTONIC, &now);
+
+    return (double) now.tv_sec + ((double) now.tv_nsec / 1.0e9);
+}
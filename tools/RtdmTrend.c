@@ -0,0 +1,282 @@
+/****************************************************************************************************************
+ * PROJECT    : BART
+ *
+ * MODULE     : RtdmTrend.c
+ *
+ * DESCRIPTON : 	Off-board tool that keeps the rollups of the data log ring up to date and prints them
+ *	for long-range charts: per second or per minute, the smallest, largest, mean and last value and the
+ *	number of samples of named signals, e.g. ICarSpeed per minute over the last day.
+ *
+ *	Every run first brings the rollups (N.rol, RtdmRollup.c) in line with the ring, which builds the
+ *	segments closed since the last run and removes those the ring has reopened, then answers from
+ *	them. Run with only the directory it just does the update, e.g. after each download.
+ *
+ *	Values are scaled with the scale and nbDecimals of the .xml and printed as CSV on stdout, one row
+ *	per interval: time, then min, max, mean and last of each signal, then count. What was read goes to
+ *	stderr. Times are as for RtdmSignalQuery: seconds since 1970, "YYYY-MM-DD HH:MM:SS" or "HH:MM:SS"
+ *	on the day of the newest sample in the ring, UTC.
+ *
+ * BUILD :
+ *	gcc -O2 -DTEST_ON_PC -DTARGET_SIM_DLL -I../src RtdmTrend.c RtdmRollup.c RtdmDanMap.c RtdmQuery.c
+ *	    RtdmDecoder.c ../src/crc32.c -fcommon -o RtdmTrend
+ *
+ * USAGE :
+ *	RtdmTrend config.xml directory [1s|1m start end signal [signal ...]]
+ *	e.g. RtdmTrend rtdm_config.xml /media/datalog
+ *	     RtdmTrend rtdm_config.xml /media/datalog 1m 0 4000000000 ICarSpeed IDcLinkVoltage
+ *
+ **********************************************************************************************************************/
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "MyTypes.h"
+#include "RTDM_Stream_ext.h"
+#include "RtdmDecoder.h"
+#include "RtdmQuery.h"
+#include "RtdmRollup.h"
+
+/*******************************************************************
+ *
+ *     C  O  N  S  T  A  N  T  S
+ *
+ *******************************************************************/
+#define SECONDS_PER_DAY             86400
+
+/*******************************************************************
+ *
+ *    S  T  A  T  I  C      F  U  N  C  T  I  O  N  S
+ *
+ *******************************************************************/
+static BOOL ParseTime (const char *text, UINT32 day, UINT32 *seconds);
+static void PrintRow (void *context, UINT32 timeStampS, UINT32 count,
+                const ROLLUP_Value_Struct *value);
+static double Seconds (const struct timespec *begin);
+
+int main (int argc, char *argv[])
+{
+    QueryStr *query = NULL;
+    const QuerySignalStr *signal = NULL;
+    struct timespec begin;
+    UINT32 firstS = 0;
+    UINT32 lastS = 0;
+    UINT32 startS = 0;
+    UINT32 endS = 0;
+    UINT16 level = ROLLUP_MINUTE;
+    UINT16 numCurrent = 0;
+    UINT16 built = 0;
+    UINT16 removed = 0;
+    UINT16 result = 0;
+    UINT16 c = 0;
+    int i = 0;
+
+    if ((argc != 3) && (argc < 7))
+    {
+        fprintf (stderr, "usage: %s config.xml directory [1s|1m start end signal ...]\n", argv[0]);
+        return 2;
+    }
+
+    query = (QueryStr *) malloc (sizeof(QueryStr));
+    if (query == NULL)
+    {
+        return 1;
+    }
+
+    clock_gettime (CLOCK_MONOTONIC, &begin);
+
+    result = OpenQuery (query, argv[1], argv[2]);
+    if (result != QUERY_OK)
+    {
+        fprintf (stderr, "%s: %s\n", argv[1], QueryResultText (result));
+        free (query);
+        return 1;
+    }
+
+    numCurrent = UpdateRollups (query, &built, &removed);
+    fprintf (stderr, "%u rollups current, %u built from %u blocks (%u rejected), %u removed, "
+                    "%.1f ms\n", numCurrent, built, (unsigned int) query->BlocksRead,
+                    (unsigned int) query->BlocksRejected, removed, Seconds (&begin) * 1000.0);
+
+    if (argc == 3)
+    {
+        free (query);
+        return 0;
+    }
+
+    if (strcmp (argv[3], "1s") == 0)
+    {
+        level = ROLLUP_SECOND;
+    }
+    else if (strcmp (argv[3], "1m") != 0)
+    {
+        fprintf (stderr, "Resolution %s is not 1s or 1m\n", argv[3]);
+        free (query);
+        return 2;
+    }
+
+    for (i = 6; i < argc; i++)
+    {
+        result = AddQueryColumn (query, argv[i]);
+        if (result != QUERY_OK)
+        {
+            fprintf (stderr, "%s: %s\n", argv[i], QueryResultText (result));
+            free (query);
+            return 1;
+        }
+    }
+
+    if (!GetRingTimeRange (query, &firstS, &lastS))
+    {
+        fprintf (stderr, "No data log segments in %s\n", argv[2]);
+        free (query);
+        return 1;
+    }
+
+    if (!ParseTime (argv[4], lastS - (lastS % SECONDS_PER_DAY), &startS)
+                    || !ParseTime (argv[5], lastS - (lastS % SECONDS_PER_DAY), &endS))
+    {
+        fprintf (stderr, "Times are seconds, YYYY-MM-DD HH:MM:SS or HH:MM:SS\n");
+        free (query);
+        return 2;
+    }
+
+    /* Header */
+    printf ("time");
+    for (c = 0; c < query->NumColumns; c++)
+    {
+        signal = &query->Signal[query->Column[c]];
+        if (signal->Unit[0] != '\0')
+        {
+            printf (",%s min [%s],%s max [%s],%s mean [%s],%s last [%s]", signal->Name,
+                            signal->Unit, signal->Name, signal->Unit, signal->Name, signal->Unit,
+                            signal->Name, signal->Unit);
+        }
+        else
+        {
+            printf (",%s min,%s max,%s mean,%s last", signal->Name, signal->Name, signal->Name,
+                            signal->Name);
+        }
+    }
+    printf (",count\n");
+
+    clock_gettime (CLOCK_MONOTONIC, &begin);
+
+    result = RunRollupQuery (query, level, startS, endS, PrintRow, query);
+    if (result != QUERY_OK)
+    {
+        fprintf (stderr, "%s .. %s: %s\n", argv[4], argv[5], QueryResultText (result));
+        free (query);
+        return 2;
+    }
+
+    fprintf (stderr, "%u rows, %u rollups read (%u bytes), %u segments rolled up from %u blocks, "
+                    "%u skipped, %.1f ms\n", (unsigned int) query->Rows, query->RollupsRead,
+                    (unsigned int) query->RollupBytes, query->SegmentsRead,
+                    (unsigned int) query->BlocksRead, query->SegmentsSkipped,
+                    Seconds (&begin) * 1000.0);
+
+    free (query);
+
+    return 0;
+}
+
+/* Seconds since 1970, a UTC date and time, or a time on the given day */
+static BOOL ParseTime (const char *text, UINT32 day, UINT32 *seconds)
+{
+    struct tm date;
+    unsigned int hour = 0;
+    unsigned int minute = 0;
+    unsigned int second = 0;
+    char *pEnd = NULL;
+    const char *pTime = text;
+    unsigned long value = 0;
+    int fields = 0;
+
+    if (strchr (text, ':') == NULL)
+    {
+        value = strtoul (text, &pEnd, 10);
+        if ((pEnd == text) || (*pEnd != '\0'))
+        {
+            return FALSE;
+        }
+        *seconds = (UINT32) value;
+        return TRUE;
+    }
+
+    memset (&date, 0, sizeof(date));
+    if (strchr (text, '-') != NULL)
+    {
+        if (sscanf (text, "%d-%d-%d", &date.tm_year, &date.tm_mon, &date.tm_mday) != 3)
+        {
+            return FALSE;
+        }
+        date.tm_year -= 1900;
+        date.tm_mon -= 1;
+        day = (UINT32) timegm (&date);
+
+        pTime = strpbrk (text, " T");
+        if (pTime == NULL)
+        {
+            return FALSE;
+        }
+        pTime++;
+    }
+
+    fields = sscanf (pTime, "%u:%u:%u", &hour, &minute, &second);
+    if ((fields < 2) || (hour > 23) || (minute > 59) || (second > 59))
+    {
+        return FALSE;
+    }
+
+    *seconds = day + (hour * 3600) + (minute * 60) + second;
+
+    return TRUE;
+}
+
+/* One CSV row, values scaled and rounded to the decimals of the .xml, the mean with one more */
+static void PrintRow (void *context, UINT32 timeStampS, UINT32 count,
+                const ROLLUP_Value_Struct *value)
+{
+    const QueryStr *query = (const QueryStr *) context;
+    const QuerySignalStr *signal = NULL;
+    struct tm date;
+    time_t seconds = (time_t) timeStampS;
+    double scale = 0.0;
+    int decimals = 0;
+    BOOL isUnsigned = FALSE;
+    UINT16 c = 0;
+
+    gmtime_r (&seconds, &date);
+    printf ("%04d-%02d-%02d %02d:%02d:%02d", date.tm_year + 1900, date.tm_mon + 1, date.tm_mday,
+                    date.tm_hour, date.tm_min, date.tm_sec);
+
+    for (c = 0; c < query->NumColumns; c++)
+    {
+        signal = &query->Signal[query->Column[c]];
+        scale = signal->Scale;
+        decimals = (int) signal->Decimals;
+        isUnsigned = (signal->Id == 9);
+
+        printf (",%.*f,%.*f,%.*f,%.*f", decimals,
+                        (isUnsigned ? (double) (UINT32) value[c].Min : (double) value[c].Min) * scale,
+                        decimals,
+                        (isUnsigned ? (double) (UINT32) value[c].Max : (double) value[c].Max) * scale,
+                        decimals + 1, ((double) value[c].Sum / count) * scale, decimals,
+                        (isUnsigned ? (double) (UINT32) value[c].Last : (double) value[c].Last)
+                                        * scale);
+    }
+    printf (",%u\n", (unsigned int) count);
+}
+
+static double Seconds (const struct timespec *begin)
+{
+    struct timespec now;
+
+    clock_gettime (CLOCK_MONOTONIC, &now);
+
+    return (double) (now.tv_sec - begin->tv_sec) + ((now.tv_nsec - begin->tv_nsec) / 1.0e9);
+}